@@ -32,6 +32,7 @@ netsnmp_feature_child_of(agent_handler, libnetsnmpagent);
 netsnmp_feature_child_of(handler_mark_requests_as_delegated, agent_handler);
 
 static netsnmp_mib_handler *_clone_handler(netsnmp_mib_handler *it);
+static void _latency_stats_free(void);
 
 /***********************************************************************/
 /*
@@ -578,6 +579,8 @@ netsnmp_call_handlers(netsnmp_handler_registration *reginfo,
 {
     netsnmp_request_info *request;
     int             status;
+    struct timeval  start;
+    int             timed;
 
     if (reginfo == NULL || reqinfo == NULL || requests == NULL) {
         snmp_log(LOG_ERR, "netsnmp_call_handlers() called illegally\n");
@@ -628,8 +631,24 @@ netsnmp_call_handlers(netsnmp_handler_registration *reginfo,
         request->processed = 0;
     }
 
+    timed = netsnmp_ds_get_boolean(NETSNMP_DS_APPLICATION_ID,
+                                   NETSNMP_DS_AGENT_LATENCY_STATS);
+    if (timed)
+        netsnmp_get_monotonic_clock(&start);
+
     status = netsnmp_call_handler(reginfo->handler, reginfo, reqinfo, requests);
 
+    if (timed) {
+        if (!reginfo->latency)
+            reginfo->latency =
+                netsnmp_latency_stats_get(NETSNMP_LATENCY_HANDLER,
+                                          reginfo->handlerName,
+                                          reginfo->contextName,
+                                          reginfo->rootoid,
+                                          reginfo->rootoid_len);
+        netsnmp_latency_stats_record(reginfo->latency, &start);
+    }
+
     return status;
 }
 
@@ -818,6 +837,7 @@ netsnmp_handler_registration_dup(netsnmp_handler_registration *reginfo)
     r->timeout = reginfo->timeout;
     r->range_ubound = reginfo->range_ubound;
     r->rootoid_len = reginfo->rootoid_len;
+    r->latency = reginfo->latency;
 
     if (reginfo->handlerName != NULL) {
         r->handlerName = strdup(reginfo->handlerName);
@@ -1168,6 +1188,205 @@ netsnmp_clear_handler_list(void)
     DEBUGMSGTL(("agent_handler", "netsnmp_clear_handler_list() called\n"));
     netsnmp_free_all_list_data(handler_reg);
     handler_reg = NULL;
+    _latency_stats_free();
+}
+
+/*
+ * Latency statistics.
+ *
+ * Entries are never freed while the agent runs, so that the counters of
+ * a module which is unregistered and registered again (e.g. an AgentX
+ * subagent reconnecting) carry on where they left off and so that
+ * registrations may keep a plain pointer to theirs.  The list is kept in
+ * index order for the nsLatencyTable.
+ */
+static netsnmp_latency_stats *latency_stats = NULL;
+static netsnmp_latency_stats *latency_stats_last = NULL;
+
+static const u_long latency_bucket_limit[NETSNMP_LATENCY_BUCKETS - 1] =
+    { 10, 100, 1000, 10000, 100000, 1000000 };
+
+static const char *
+_latency_type_name(int type)
+{
+    switch (type) {
+    case NETSNMP_LATENCY_HANDLER:
+        return "handler";
+    case NETSNMP_LATENCY_CACHE:
+        return "cache";
+    case NETSNMP_LATENCY_AGENTX:
+        return "agentx";
+    }
+    return "unknown";
+}
+
+static void
+_latency_stats_free(void)
+{
+    netsnmp_latency_stats *stats;
+
+    while ((stats = latency_stats) != NULL) {
+        latency_stats = stats->next;
+        SNMP_FREE(stats->name);
+        SNMP_FREE(stats->context);
+        SNMP_FREE(stats->rootoid);
+        free(stats);
+    }
+    latency_stats_last = NULL;
+}
+
+/** Finds the latency statistics of a registration, cache or subagent,
+ *  creating them if needed.
+ *
+ *  @param type is one of NETSNMP_LATENCY_HANDLER, NETSNMP_LATENCY_CACHE
+ *         or NETSNMP_LATENCY_AGENTX
+ *  @param name is the registration (or cache) name, may be NULL
+ *  @param context is the context name, NULL for the default context
+ *  @param rootoid is the registration point, may be NULL
+ *  @param rootoid_len is the length of rootoid
+ *
+ *  @return the statistics, or NULL if they could not be allocated
+ */
+netsnmp_latency_stats *
+netsnmp_latency_stats_get(int type, const char *name, const char *context,
+                          const oid *rootoid, size_t rootoid_len)
+{
+    netsnmp_latency_stats *stats;
+
+    if (!name)
+        name = "";
+    if (!context)
+        context = "";
+    if (!rootoid)
+        rootoid_len = 0;
+
+    for (stats = latency_stats; stats; stats = stats->next)
+        if (stats->type == type &&
+            snmp_oid_compare(stats->rootoid, stats->rootoid_len,
+                             rootoid, rootoid_len) == 0 &&
+            strcmp(stats->context, context) == 0 &&
+            strcmp(stats->name, name) == 0)
+            return stats;
+
+    stats = SNMP_MALLOC_TYPEDEF(netsnmp_latency_stats);
+    if (!stats)
+        return NULL;
+    stats->type = type;
+    stats->name = strdup(name);
+    stats->context = strdup(context);
+    if (rootoid_len)
+        stats->rootoid = snmp_duplicate_objid(rootoid, rootoid_len);
+    stats->rootoid_len = rootoid_len;
+    if (!stats->name || !stats->context ||
+        (rootoid_len && !stats->rootoid)) {
+        SNMP_FREE(stats->name);
+        SNMP_FREE(stats->context);
+        SNMP_FREE(stats->rootoid);
+        free(stats);
+        return NULL;
+    }
+
+    stats->index = latency_stats_last ? latency_stats_last->index + 1 : 1;
+    if (latency_stats_last)
+        latency_stats_last->next = stats;
+    else
+        latency_stats = stats;
+    latency_stats_last = stats;
+
+    DEBUGMSGTL(("stats:latency", "new %s entry %d: %s ",
+                _latency_type_name(type), stats->index, name));
+    DEBUGMSGOID(("stats:latency", rootoid, rootoid_len));
+    DEBUGMSG(("stats:latency", "\n"));
+    return stats;
+}
+
+/** Adds the time elapsed since start to the latency statistics.
+ *
+ *  @param stats is the entry to update, may be NULL
+ *  @param start is a netsnmp_get_monotonic_clock() timestamp
+ */
+void
+netsnmp_latency_stats_record(netsnmp_latency_stats *stats,
+                             const struct timeval *start)
+{
+    struct timeval  now, diff;
+    u_long          usec;
+    int             i;
+
+    if (!stats)
+        return;
+
+    netsnmp_get_monotonic_clock(&now);
+    NETSNMP_TIMERSUB(&now, start, &diff);
+    usec = diff.tv_sec * 1000000UL + diff.tv_usec;
+
+    for (i = 0; i < NETSNMP_LATENCY_BUCKETS - 1; i++)
+        if (usec <= latency_bucket_limit[i])
+            break;
+    stats->buckets[i]++;
+    stats->count++;
+    incrByU32(&stats->total, usec);
+    if (usec > stats->max)
+        stats->max = usec;
+
+    DEBUGMSGTL(("stats:latency", "%s %d (%s): %lu usec\n",
+                _latency_type_name(stats->type), stats->index, stats->name,
+                usec));
+}
+
+/** Returns the first latency statistics entry; the others follow
+ *  through the next pointers, in index order.
+ */
+netsnmp_latency_stats *
+netsnmp_latency_stats_first(void)
+{
+    return latency_stats;
+}
+
+/** Clears the counters of all latency statistics entries. */
+void
+netsnmp_latency_stats_reset(void)
+{
+    netsnmp_latency_stats *stats;
+
+    for (stats = latency_stats; stats; stats = stats->next) {
+        stats->count = 0;
+        stats->total.high = stats->total.low = 0;
+        stats->max = 0;
+        memset(stats->buckets, 0, sizeof(stats->buckets));
+    }
+}
+
+/** Logs the latency statistics of everything which has been called,
+ *  loaded or sent to since they were enabled.
+ */
+void
+netsnmp_latency_stats_dump(void)
+{
+    netsnmp_latency_stats *stats;
+    char            total[I64CHARSZ + 1];
+    u_char         *buf = NULL;
+    size_t          buf_len = 0, out_len;
+
+    for (stats = latency_stats; stats; stats = stats->next) {
+        if (!stats->count)
+            continue;
+        out_len = 0;
+        if (!sprint_realloc_objid(&buf, &buf_len, &out_len, 1,
+                                  stats->rootoid, stats->rootoid_len))
+            continue;
+        printU64(total, &stats->total);
+        snmp_log(LOG_INFO, "latency %s %d %s%s%s (%s): %lu calls, "
+                 "%s usec total, max %lu usec, "
+                 "buckets %lu/%lu/%lu/%lu/%lu/%lu/%lu\n",
+                 _latency_type_name(stats->type), stats->index,
+                 stats->context, *stats->context ? ":" : "",
+                 buf, stats->name, stats->count, total, stats->max,
+                 stats->buckets[0], stats->buckets[1], stats->buckets[2],
+                 stats->buckets[3], stats->buckets[4], stats->buckets[5],
+                 stats->buckets[6]);
+    }
+    SNMP_FREE(buf);
 }
 
 /** @private
@@ -260,6 +260,12 @@ init_agent_read_config(const char *app)
     netsnmp_ds_register_config(ASN_OCTET_STR, app, "v1trapaddress", 
                                NETSNMP_DS_APPLICATION_ID, 
                                NETSNMP_DS_AGENT_TRAP_ADDR);
+    netsnmp_ds_register_config(ASN_INTEGER, app, "informMaxInFlight",
+                               NETSNMP_DS_APPLICATION_ID,
+                               NETSNMP_DS_AGENT_INFORM_MAX_INFLIGHT);
+    netsnmp_ds_register_config(ASN_INTEGER, app, "informQueueLength",
+                               NETSNMP_DS_APPLICATION_ID,
+                               NETSNMP_DS_AGENT_INFORM_QUEUE_LENGTH);
 #ifdef HAVE_UNISTD_H
     register_app_config_handler("agentuser",
                                 snmpd_set_agent_user, NULL, "userid");
@@ -297,6 +303,9 @@ init_agent_read_config(const char *app)
                                NETSNMP_DS_APPLICATION_ID,
                                NETSNMP_DS_AGENT_PDU_STATS_THRESHOLD);
 #endif /* NETSNMP_NO_PDU_STATS */
+    netsnmp_ds_register_config(ASN_BOOLEAN, app, "latencyStats",
+                               NETSNMP_DS_APPLICATION_ID,
+                               NETSNMP_DS_AGENT_LATENCY_STATS);
 
     netsnmp_init_handler_conf();
 
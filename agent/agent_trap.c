@@ -133,6 +133,9 @@ int             snmp_enableauthentrapsset = 0;
   * static void send_v1_trap (netsnmp_session *, int, int);
   * static void send_v2_trap (netsnmp_session *, int, int, int);
   */
+int             handle_inform_response(int op, netsnmp_session * session,
+                                       int reqid, netsnmp_pdu *pdu,
+                                       void *magic);
 
 
         /*******************
@@ -182,6 +185,225 @@ _dump_trap_stats(netsnmp_session *sess)
 }
 #endif /* NETSNMP_NO_TRAP_STATS */
 
+/*
+ * The variable-bindings of the notification templates being sent by
+ * netsnmp_send_traps(), encoded once for all of the sinks.
+ */
+#define ENCODED_TEMPLATES 2
+
+typedef struct encoded_template_s {
+    const netsnmp_pdu *pdu;
+    netsnmp_encoded_varbinds *variables;
+} encoded_template;
+
+static encoded_template encoded_templates[ENCODED_TEMPLATES];
+
+static const netsnmp_encoded_varbinds *
+_template_encoded_variables(const netsnmp_pdu *template_pdu)
+{
+    int             i;
+
+    for (i = 0; i < ENCODED_TEMPLATES; i++)
+        if (encoded_templates[i].pdu == template_pdu)
+            return encoded_templates[i].variables;
+    return NULL;
+}
+
+/*
+ * Informs to a session are limited to informMaxInFlight unacknowledged
+ * ones.  Further informs wait in a queue of up to informQueueLength
+ * entries and are sent as earlier ones are acknowledged or time out.
+ * The state is kept only while a session has informs in flight.
+ */
+#define INFORM_QUEUE_LENGTH_DEFAULT 100
+
+typedef struct inform_state_s {
+    netsnmp_session *session;
+    u_long          inflight;
+    u_long          queued;
+    netsnmp_pdu   **queue;          /* a ring of queue_size entries */
+    size_t          queue_size;
+    size_t          queue_head;
+    int             sending;        /* inside snmp_async_send() */
+    struct inform_state_s *next;
+} inform_state;
+
+static inform_state *inform_states = NULL;
+
+static inform_state *
+_inform_state_find(netsnmp_session *sess)
+{
+    inform_state   *state;
+
+    for (state = inform_states; state; state = state->next)
+        if (state->session == sess)
+            return state;
+    return NULL;
+}
+
+static inform_state *
+_inform_state_get(netsnmp_session *sess)
+{
+    inform_state   *state;
+
+    state = _inform_state_find(sess);
+    if (state)
+        return state;
+
+    state = SNMP_MALLOC_TYPEDEF(inform_state);
+    if (!state)
+        return NULL;
+    state->session = sess;
+    state->next = inform_states;
+    inform_states = state;
+    return state;
+}
+
+static void
+_inform_queue_clear(inform_state *state)
+{
+    for (; state->queued; state->queued--) {
+        snmp_free_pdu(state->queue[state->queue_head]);
+        state->queue_head = (state->queue_head + 1) % state->queue_size;
+    }
+}
+
+/*
+ * Forget a session's state once it has no informs in flight or queued.
+ */
+static void
+_inform_state_release(inform_state *state)
+{
+    inform_state  **prevNext;
+
+    if (!state || state->inflight || state->queued || state->sending)
+        return;
+    for (prevNext = &inform_states; *prevNext; prevNext = &(*prevNext)->next) {
+        if (*prevNext == state) {
+            *prevNext = state->next;
+            break;
+        }
+    }
+    free(state->queue);
+    free(state);
+}
+
+static int
+_inform_send(netsnmp_session *sess, netsnmp_pdu *pdu,
+             const netsnmp_encoded_varbinds *variables)
+{
+    inform_state   *state = _inform_state_find(sess);
+    int             result;
+
+    if (!state)
+        return snmp_async_send_encoded(sess, pdu, variables,
+                                       &handle_inform_response, NULL);
+
+    state->sending = 1;
+    result = snmp_async_send_encoded(sess, pdu, variables,
+                                     &handle_inform_response, state);
+    state->sending = 0;
+    if (result)
+        ++state->inflight;
+    return result;
+}
+
+/*
+ * Returns 1 if the inform was queued (or dropped), 0 if it may be sent.
+ */
+static int
+_inform_enqueue(netsnmp_session *sess, netsnmp_pdu *pdu)
+{
+    inform_state   *state;
+    int             max_inflight, length;
+    size_t          i;
+
+    max_inflight = netsnmp_ds_get_int(NETSNMP_DS_APPLICATION_ID,
+                                      NETSNMP_DS_AGENT_INFORM_MAX_INFLIGHT);
+    if (max_inflight <= 0)
+        return 0;
+    state = _inform_state_get(sess);
+    if (NULL == state ||
+        (state->inflight < (u_long)max_inflight && !state->queued))
+        return 0;
+
+    length = netsnmp_ds_get_int(NETSNMP_DS_APPLICATION_ID,
+                                NETSNMP_DS_AGENT_INFORM_QUEUE_LENGTH);
+    if (length <= 0)
+        length = INFORM_QUEUE_LENGTH_DEFAULT;
+    if (state->queued >= (u_long)length) {
+        DEBUGMSGTL(("trap", "inform queue of %s full, dropping reqid=%ld\n",
+                    sess->paramName ? sess->paramName : "UNKNOWN",
+                    pdu->reqid));
+        snmp_free_pdu(pdu);
+        return 1;
+    }
+
+    if (state->queued == state->queue_size) {
+        size_t          size = state->queue_size ?
+            2 * state->queue_size : 8;
+        netsnmp_pdu   **queue = malloc(size * sizeof(*queue));
+
+        if (NULL == queue) {
+            snmp_free_pdu(pdu);
+            return 1;
+        }
+        for (i = 0; i < state->queued; i++)
+            queue[i] = state->queue[(state->queue_head + i) %
+                                    state->queue_size];
+        free(state->queue);
+        state->queue = queue;
+        state->queue_size = size;
+        state->queue_head = 0;
+    }
+    state->queue[(state->queue_head + state->queued) %
+                 state->queue_size] = pdu;
+    ++state->queued;
+    DEBUGMSGTL(("trap", "queued inform reqid=%ld for %s (%lu queued)\n",
+                pdu->reqid, sess->paramName ? sess->paramName : "UNKNOWN",
+                state->queued));
+    return 1;
+}
+
+/*
+ * Send queued informs while fewer than informMaxInFlight are in flight.
+ */
+static void
+_inform_dispatch(inform_state *state)
+{
+    netsnmp_session *sess = state->session;
+    netsnmp_pdu    *pdu;
+    int             max_inflight;
+
+    max_inflight = netsnmp_ds_get_int(NETSNMP_DS_APPLICATION_ID,
+                                      NETSNMP_DS_AGENT_INFORM_MAX_INFLIGHT);
+    while (state->queued && (max_inflight <= 0 ||
+                             state->inflight < (u_long)max_inflight)) {
+        pdu = state->queue[state->queue_head];
+        state->queue_head = (state->queue_head + 1) % state->queue_size;
+        --state->queued;
+
+        if (_inform_send(sess, pdu, NULL) == 0) {
+            /* most likely the session is being closed */
+            DEBUGMSGTL(("trap", "failed to send a queued inform to %s, "
+                        "dropping %lu more\n",
+                        sess->paramName ? sess->paramName : "UNKNOWN",
+                        state->queued));
+            snmp_free_pdu(pdu);
+            _inform_queue_clear(state);
+            break;
+        }
+        snmp_increment_statistic(STAT_SNMPOUTTRAPS);
+        snmp_increment_statistic(STAT_SNMPOUTPKTS);
+#ifndef NETSNMP_NO_TRAP_STATS
+        if (sess->trap_stats) {
+            sess->trap_stats->sent_last_sent = netsnmp_get_agent_uptime();
+            ++sess->trap_stats->sent_count;
+        }
+#endif /* NETSNMP_NO_TRAP_STATS */
+    }
+}
+
 int
 netsnmp_add_closable_notification_session(netsnmp_session *ss, int close_sess, int pdutype,
                                           int confirm, int version, const char *name,
@@ -812,7 +1034,8 @@ netsnmp_send_traps(int trap, int specific,
     u_long                 uptime;
     struct trap_sink *sink;
     const char            *v1trapaddress;
-    int                    res = 0;
+    encoded_template       saved_templates[ENCODED_TEMPLATES];
+    int                    res = 0, i;
 
     DEBUGMSGTL(( "trap", "send_trap %d %d ", trap, specific));
     DEBUGMSGOID(("trap", enterprise, enterprise_length));
@@ -990,6 +1213,25 @@ netsnmp_send_traps(int trap, int specific,
 	}
     }
 
+    /*
+     * The varbinds are the same for every sink (and every target of the
+     * notification MIB callbacks), so encode them once per template.
+     * Only the message header and PDU fields are then built per sink.
+     * A notification sent from a callback has templates of its own.
+     */
+    memcpy(saved_templates, encoded_templates, sizeof(saved_templates));
+    memset(encoded_templates, 0, sizeof(encoded_templates));
+    if (template_v1pdu) {
+        encoded_templates[0].pdu = template_v1pdu;
+        encoded_templates[0].variables =
+            snmp_pdu_encode_variables(template_v1pdu);
+    }
+    if (template_v2pdu) {
+        encoded_templates[1].pdu = template_v2pdu;
+        encoded_templates[1].variables =
+            snmp_pdu_encode_variables(template_v2pdu);
+    }
+
     /*
      *  Now loop through the list of trap sinks
      *   and call the trap callback routines,
@@ -1018,6 +1260,9 @@ netsnmp_send_traps(int trap, int specific,
     if (template_v2pdu)
         snmp_call_callbacks(SNMP_CALLBACK_APPLICATION,
                         SNMPD_CALLBACK_SEND_TRAP2, template_v2pdu);
+    for (i = 0; i < ENCODED_TEMPLATES; i++)
+        snmp_free_encoded_variables(encoded_templates[i].variables);
+    memcpy(encoded_templates, saved_templates, sizeof(encoded_templates));
     snmp_free_pdu(template_v1pdu);
     snmp_free_pdu(template_v2pdu);
     return 0;
@@ -1098,6 +1343,8 @@ handle_inform_response(int op, netsnmp_session * session,
                        int reqid, netsnmp_pdu *pdu,
                        void *magic)
 {
+    inform_state   *state;
+
     if (NULL == session)
         return 0;
 
@@ -1178,6 +1425,27 @@ handle_inform_response(int op, netsnmp_session * session,
         DEBUGMSGTL(("trap", "received op=%d for reqid=%d when trying to send an inform\n", op, reqid));
     }
 
+    /*
+     * Once the library is done with an inform (acknowledged, or failed
+     * for good), queued informs may take its place.  Failures while it
+     * is still being sent are not counted, as it never got in flight.
+     */
+    state = _inform_state_find(session);
+    if (state && state == magic && !state->sending &&
+        ((op == NETSNMP_CALLBACK_OP_RECEIVED_MESSAGE &&
+          pdu->command != SNMP_MSG_REPORT) ||
+         op == NETSNMP_CALLBACK_OP_SEC_ERROR ||
+         op == NETSNMP_CALLBACK_OP_TIMED_OUT ||
+         op == NETSNMP_CALLBACK_OP_SEND_FAILED)) {
+        if (state->inflight)
+            --state->inflight;
+        _inform_dispatch(state);
+        DEBUGMSGTL(("trap", "%lu informs in flight, %lu queued for %s\n",
+                    state->inflight, state->queued,
+                    session->paramName ? session->paramName : "UNKNOWN"));
+        _inform_state_release(state);
+    }
+
 #ifndef NETSNMP_NO_TRAP_STATS
     if (session->trap_stats)
         _dump_trap_stats(session);
@@ -1194,6 +1462,7 @@ handle_inform_response(int op, netsnmp_session * session,
 void
 send_trap_to_sess(netsnmp_session * sess, netsnmp_pdu *template_pdu)
 {
+    const netsnmp_encoded_varbinds *variables;
     netsnmp_pdu    *pdu;
     int            result;
 
@@ -1233,6 +1502,7 @@ send_trap_to_sess(netsnmp_session * sess, netsnmp_pdu *template_pdu)
         snmp_log(LOG_WARNING, "send_trap: failed to clone PDU\n");
         return;
     }
+    variables = _template_encoded_variables(template_pdu);
 
     pdu->sessid = sess->sessid; /* AgentX only ? */
     /*
@@ -1260,13 +1530,17 @@ send_trap_to_sess(netsnmp_session * sess, netsnmp_pdu *template_pdu)
     }
 #endif /* NETSNMP_NO_TRAP_STATS */
 
-    if ( template_pdu->command == SNMP_MSG_INFORM
+    if (template_pdu->command == SNMP_MSG_INFORM) {
+        if (_inform_enqueue(sess, pdu))
+            return;
+        result = _inform_send(sess, pdu, variables);
+        if (result == 0)
+            _inform_state_release(_inform_state_find(sess));
 #ifdef USING_AGENTX_PROTOCOL_MODULE
-         || template_pdu->command == AGENTX_MSG_NOTIFY
-#endif
-       ) {
+    } else if (template_pdu->command == AGENTX_MSG_NOTIFY) {
         result =
             snmp_async_send(sess, pdu, &handle_inform_response, NULL);
+#endif
     } else {
         if ((sess->version == SNMP_VERSION_3) &&
                 (pdu->command == SNMP_MSG_TRAP2) &&
@@ -1278,7 +1552,8 @@ send_trap_to_sess(netsnmp_session * sess, netsnmp_pdu *template_pdu)
             pdu->securityEngineIDLen = len;
         }
 
-        result = snmp_async_send(sess, pdu, &handle_trap_callback, NULL);
+        result = snmp_async_send_encoded(sess, pdu, variables,
+                                         &handle_trap_callback, NULL);
     }
 
     if (result == 0) {
@@ -730,6 +730,13 @@ static int
 _cache_load( netsnmp_cache *cache )
 {
     int ret = -1;
+    struct timeval start;
+    int timed;
+
+    timed = netsnmp_ds_get_boolean(NETSNMP_DS_APPLICATION_ID,
+                                   NETSNMP_DS_AGENT_LATENCY_STATS);
+    if (timed)
+        netsnmp_get_monotonic_clock(&start);
 
     /*
      * If we've got a valid cache, then release it before reloading
@@ -740,6 +747,17 @@ _cache_load( netsnmp_cache *cache )
 
     if ( cache->load_cache)
         ret = cache->load_cache(cache, cache->magic);
+
+    /*
+     * caches are identified by their registration point alone, as in
+     * the nsCacheTable.  Loads are rare enough not to need the entry
+     * to be remembered.
+     */
+    if (timed)
+        netsnmp_latency_stats_record(
+            netsnmp_latency_stats_get(NETSNMP_LATENCY_CACHE, NULL, NULL,
+                                      cache->rootoid, cache->rootoid_len),
+            &start);
     if (ret < 0) {
         DEBUGMSGT(("helper:cache_handler", " load failed (%d)\n", ret));
         cache->valid = 0;
@@ -1,6 +1,16 @@
 
 #include <net-snmp/net-snmp-config.h>
 #include <net-snmp/net-snmp-features.h>
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef HAVE_SYS_WAIT_H
+#include <sys/wait.h>
+#endif
+#include <signal.h>
+#include <errno.h>
+
 #include <net-snmp/net-snmp-includes.h>
 #include <net-snmp/agent/net-snmp-agent-includes.h>
 #include <net-snmp/agent/watcher.h>
@@ -24,6 +34,27 @@ netsnmp_feature_require(insert_table_row);
 
 oid  ns_extend_oid[]    = { 1, 3, 6, 1, 4, 1, 8072, 1, 3, 2 };
 
+#define NS_EXTEND_MAX_OUTPUT          (1024*100)
+#define NS_EXTEND_DEFAULT_MAX_RUNNING 4
+#define NS_EXTEND_DEFAULT_TIMEOUT     60
+
+/*
+ * Once a run-on-read entry has produced some output, later runs happen
+ *  in the background (at most 'extendMaxRunning' at once, the rest
+ *  waiting in a queue) while the previous output continues to be served.
+ */
+#if defined(USING_UTILITIES_EXECUTE_MODULE) && defined(HAVE_EXECV)
+#define NS_EXTEND_ASYNC 1
+#endif
+#define NS_EXTEND_FLAGS_QUEUED      0x10
+
+static int extend_max_running = NS_EXTEND_DEFAULT_MAX_RUNNING;
+static int extend_timeout     = NS_EXTEND_DEFAULT_TIMEOUT;
+#ifdef NS_EXTEND_ASYNC
+static int extend_running;
+static netsnmp_extend *extend_queue_head, *extend_queue_tail;
+#endif
+
 typedef struct extend_registration_block_s {
     netsnmp_table_data *dinfo;
     oid                *root_oid;
@@ -268,6 +299,8 @@ extend_clear_callback(int majorID, int minorID,
 {
     extend_registration_block *eptr, *enext = NULL;
 
+    extend_max_running = NS_EXTEND_DEFAULT_MAX_RUNNING;
+    extend_timeout     = NS_EXTEND_DEFAULT_TIMEOUT;
     for ( eptr=ereg_head; eptr; eptr=enext ) {
         enext=eptr->next;
         netsnmp_table_data_delete_table(eptr->dinfo);
@@ -283,6 +316,21 @@ extend_clear_callback(int majorID, int minorID,
     return 0;
 }
 
+static void
+extend_parse_int(const char *token, char *cptr)
+{
+    int  i = atoi(cptr);
+
+    if (i < 0) {
+        config_perror("value must not be negative");
+        return;
+    }
+    if (!strcasecmp(token, "extendMaxRunning"))
+        extend_max_running = i;
+    else
+        extend_timeout = i;
+}
+
 void init_extend( void )
 {
     snmpd_register_config_handler("extend",    extend_parse_config, NULL, NULL);
@@ -291,6 +339,10 @@ void init_extend( void )
     snmpd_register_config_handler("exec2", extend_parse_config, NULL, NULL);
     snmpd_register_config_handler("sh2",   extend_parse_config, NULL, NULL);
     snmpd_register_config_handler("execFix2", extend_parse_config, NULL, NULL);
+    snmpd_register_config_handler("extendMaxRunning", extend_parse_int,
+                                  NULL, "count");
+    snmpd_register_config_handler("extendTimeout", extend_parse_int,
+                                  NULL, "seconds");
     (void)_register_extend( ns_extend_oid, OID_LENGTH(ns_extend_oid));
 
 #ifndef USING_UCD_SNMP_EXTENSIBLE_MODULE
@@ -319,6 +371,8 @@ shutdown_extend(void)
 	_unregister_extend(ereg_head);
 }
 
+void extend_free_cache(netsnmp_cache *cache, void *magic);
+
         /*************************
          *
          *  Cached-data hooks
@@ -326,6 +380,264 @@ shutdown_extend(void)
          *
          *************************/
 
+static void
+_extend_cmdline(netsnmp_extend *extension, char *buf, size_t len)
+{
+    if ( extension->args )
+        snprintf( buf, len, "%s %s", extension->command, extension->args );
+    else 
+        snprintf( buf, len, "%s", extension->command );
+}
+
+/*
+ * Publish the (malloc-ed) output of a command,
+ *   and pick it apart into separate lines.
+ */
+static void
+_extend_store_output(netsnmp_extend *extension, char *output, int out_len)
+{
+    char *cp;
+    int   i;
+
+    if (out_len > 0 && output[out_len - 1] == '\n')
+        output[--out_len] = '\0';	/* Strip trailing newline */
+    extension->output   = output;
+    extension->out_len  = out_len;
+    extension->numlines = 1;
+    for (cp = output; *cp; cp++) {
+        if (*cp == '\n')
+            extension->numlines++;
+    }
+    if ( extension->numlines > 1 ) {
+        extension->lines = calloc(extension->numlines, sizeof(char *));
+        if (!extension->lines) {
+            extension->numlines = 1;
+            extension->lines = &extension->output;
+            return;
+        }
+        extension->lines[0] = output;
+        for (cp = output, i = 1; *cp; cp++) {
+            if (*cp == '\n')
+                extension->lines[ i++ ] = cp+1;
+        }
+    } else {
+        extension->lines = &extension->output;
+    }
+}
+
+static void
+_extend_note_runtime(netsnmp_extend *extension)
+{
+    struct timeval now;
+
+    netsnmp_get_monotonic_clock(&now);
+    extension->last_runtime =
+        (now.tv_sec  - extension->started.tv_sec) * 1000 +
+        (now.tv_usec - extension->started.tv_usec) / 1000;
+    extension->runs++;
+}
+
+#ifdef NS_EXTEND_ASYNC
+static void _extend_run_queue(void);
+
+static void
+_extend_finish(netsnmp_extend *extension, int result, int publish)
+{
+    netsnmp_cache *cache = extension->cache;
+
+    if (extension->timer) {
+        snmp_alarm_unregister(extension->timer);
+        extension->timer = 0;
+    }
+    if (extension->reap_timer) {
+        snmp_alarm_unregister(extension->reap_timer);
+        extension->reap_timer = 0;
+    }
+    if (extension->fd >= 0) {
+        unregister_readfd(extension->fd);
+        close(extension->fd);
+        extension->fd = -1;
+    }
+    extension->pid = 0;
+    extend_running--;
+    _extend_note_runtime(extension);
+    DEBUGMSGTL(( "nsExtendTable:async", "%s finished after %u ms: %d\n",
+                 extension->token, extension->last_runtime, result));
+
+    if (publish) {
+        extend_free_cache(cache, extension);
+        extension->rbuf[ extension->rlen ] = '\0';
+        _extend_store_output(extension, extension->rbuf, extension->rlen);
+        extension->rbuf   = NULL;
+        extension->result = result;
+        cache->valid   = 1;
+        cache->expired = 0;
+        netsnmp_set_monotonic_marker(&cache->timestampM);
+    } else {
+        SNMP_FREE(extension->rbuf);
+    }
+    extension->rlen = 0;
+}
+
+static void
+_extend_check_exit(netsnmp_extend *extension)
+{
+    int  status = 0;
+    int  rc;
+
+    rc = waitpid(extension->pid, &status, WNOHANG);
+    if (rc == 0)
+        return;         /* output closed, but still running */
+    if (rc < 0)
+        snmp_log_perror("waitpid");
+    _extend_finish(extension, rc < 0 ? -1 : WEXITSTATUS(status), 1);
+    _extend_run_queue();
+}
+
+static void
+_extend_reap(unsigned int clientreg, void *clientarg)
+{
+    _extend_check_exit((netsnmp_extend *)clientarg);
+}
+
+static void
+_extend_readable(int fd, void *data)
+{
+    netsnmp_extend *extension = (netsnmp_extend *)data;
+    char            discard[1024];
+    ssize_t         count;
+
+    if (extension->rlen < NS_EXTEND_MAX_OUTPUT - 1)
+        count = read(fd, extension->rbuf + extension->rlen,
+                     NS_EXTEND_MAX_OUTPUT - 1 - extension->rlen);
+    else
+        count = read(fd, discard, sizeof(discard));
+    if (count > 0) {
+        if (extension->rlen < NS_EXTEND_MAX_OUTPUT - 1)
+            extension->rlen += count;
+        return;
+    }
+    if (count < 0 && (errno == EAGAIN || errno == EINTR))
+        return;
+
+    /*
+     * End of output - the command should be exiting
+     */
+    unregister_readfd(fd);
+    close(fd);
+    extension->fd = -1;
+    _extend_check_exit(extension);
+    if (extension->pid && !extension->reap_timer) {
+        struct timeval t = { 0, 100000 };
+        extension->reap_timer =
+            snmp_alarm_register_hr(t, SA_REPEAT, _extend_reap, extension);
+    }
+}
+
+static void
+_extend_kill(netsnmp_extend *extension)
+{
+    kill(extension->pid, SIGKILL);
+    if (waitpid(extension->pid, NULL, 0) < 0)
+        snmp_log_perror("waitpid");
+    _extend_finish(extension, -1, 0);
+}
+
+static void
+_extend_timed_out(unsigned int clientreg, void *clientarg)
+{
+    netsnmp_extend *extension = (netsnmp_extend *)clientarg;
+
+    extension->timer = 0;
+    snmp_log(LOG_WARNING, "extend %s: timed out, killing process %d\n",
+             extension->token, extension->pid);
+    extension->timeouts++;
+    _extend_kill(extension);
+    _extend_run_queue();
+}
+
+static int
+_extend_start(netsnmp_extend *extension)
+{
+    char cmd_buf[ 255*2 + 2 ];	/* 2 * DisplayStrings */
+    int  timeout;
+    int  pid, fd;
+
+    _extend_cmdline(extension, cmd_buf, sizeof(cmd_buf));
+    extension->rbuf = malloc(NS_EXTEND_MAX_OUTPUT);
+    if (!extension->rbuf)
+        return -1;
+    pid = run_command_async(cmd_buf, extension->input,
+                            extension->flags & NS_EXTEND_FLAGS_SHELL, &fd);
+    if (pid < 0) {
+        SNMP_FREE(extension->rbuf);
+        return -1;
+    }
+    DEBUGMSGTL(( "nsExtendTable:async", "%s started: %d\n",
+                 extension->token, pid));
+    extension->pid  = pid;
+    extension->fd   = fd;
+    extension->rlen = 0;
+    netsnmp_get_monotonic_clock(&extension->started);
+    register_readfd(fd, _extend_readable, extension);
+    timeout = extension->timeout ? extension->timeout : extend_timeout;
+    if (timeout > 0)
+        extension->timer = snmp_alarm_register(timeout, 0, _extend_timed_out,
+                                               extension);
+    extend_running++;
+    return 0;
+}
+
+static void
+_extend_run_queue(void)
+{
+    netsnmp_extend *extension;
+
+    while (extend_queue_head && extend_running < extend_max_running) {
+        extension = extend_queue_head;
+        extend_queue_head = extension->next_queued;
+        if (!extend_queue_head)
+            extend_queue_tail = NULL;
+        extension->next_queued = NULL;
+        extension->flags &= ~NS_EXTEND_FLAGS_QUEUED;
+        if (_extend_start(extension) < 0)
+            DEBUGMSGTL(( "nsExtendTable:async", "%s: start failed\n",
+                         extension->token));
+    }
+}
+
+/*
+ * Stop any background run of an entry that is about to be released.
+ * This doesn't start queued commands: it is called while entries are
+ * being torn down.
+ */
+static void
+_extend_cancel(netsnmp_extend *extension)
+{
+    netsnmp_extend *eptr, *eprev = NULL;
+
+    if (extension->flags & NS_EXTEND_FLAGS_QUEUED) {
+        for (eptr = extend_queue_head; eptr; eptr = eptr->next_queued) {
+            if (eptr == extension)
+                break;
+            eprev = eptr;
+        }
+        if (eptr) {
+            if (eprev)
+                eprev->next_queued = eptr->next_queued;
+            else
+                extend_queue_head = eptr->next_queued;
+            if (extend_queue_tail == eptr)
+                extend_queue_tail = eprev;
+        }
+        extension->next_queued = NULL;
+        extension->flags &= ~NS_EXTEND_FLAGS_QUEUED;
+    }
+    if (extension->pid)
+        _extend_kill(extension);
+}
+#endif /* NS_EXTEND_ASYNC */
+
 int
 extend_load_cache(netsnmp_cache *cache, void *magic)
 {
@@ -333,52 +645,54 @@ extend_load_cache(netsnmp_cache *cache, void *magic)
     NETSNMP_LOGONCE((LOG_WARNING,"support for run_exec_command not available\n"));
     return -1;
 #else
-    int  out_len = 1024*100;
-    char out_buf[ 1024*100 ];
-    int  cmd_len = 255*2 + 2;	/* 2 * DisplayStrings */
-    char cmd_buf[ 255*2 + 2 ];
+    int  out_len = NS_EXTEND_MAX_OUTPUT;
+    char out_buf[ NS_EXTEND_MAX_OUTPUT ];
+    char cmd_buf[ 255*2 + 2 ];	/* 2 * DisplayStrings */
     int  ret;
-    char *cp;
-    char *line_buf[ 1024 ];
     netsnmp_extend *extension = (netsnmp_extend *)magic;
 
     if (!magic)
         return -1;
     DEBUGMSGTL(( "nsExtendTable:cache", "load %s", extension->token ));
-    if ( extension->args )
-        snprintf( cmd_buf, cmd_len, "%s %s", extension->command, extension->args );
-    else 
-        snprintf( cmd_buf, cmd_len, "%s", extension->command );
+#ifdef NS_EXTEND_ASYNC
+    if (extension->pid || (extension->flags & NS_EXTEND_FLAGS_QUEUED)) {
+        DEBUGMSG(( "nsExtendTable:cache", ": refresh pending\n"));
+        return 0;
+    }
+    if (extension->output && extend_max_running > 0 &&
+        !(extension->flags & NS_EXTEND_FLAGS_WRITEABLE)) {
+        if (extend_running >= extend_max_running) {
+            DEBUGMSG(( "nsExtendTable:cache", ": queued\n"));
+            extension->flags |= NS_EXTEND_FLAGS_QUEUED;
+            extension->next_queued = NULL;
+            if (extend_queue_tail)
+                extend_queue_tail->next_queued = extension;
+            else
+                extend_queue_head = extension;
+            extend_queue_tail = extension;
+            return 0;
+        }
+        if (_extend_start(extension) == 0) {
+            DEBUGMSG(( "nsExtendTable:cache", ": started\n"));
+            return 0;
+        }
+        /* otherwise fall back to running it here and now */
+    }
+#endif
+    _extend_cmdline(extension, cmd_buf, sizeof(cmd_buf));
+    netsnmp_get_monotonic_clock(&extension->started);
     if ( extension->flags & NS_EXTEND_FLAGS_SHELL )
         ret = run_shell_command( cmd_buf, extension->input, out_buf, &out_len);
     else
         ret = run_exec_command(  cmd_buf, extension->input, out_buf, &out_len);
+    _extend_note_runtime(extension);
     DEBUGMSG(( "nsExtendTable:cache", ": %s : %d\n", cmd_buf, ret));
+    extend_free_cache(cache, magic);
     if (ret >= 0) {
-        if (out_len > 0 && out_buf[out_len - 1] == '\n')
-            out_buf[--out_len] = '\0';	/* Strip trailing newline */
-        extension->output   = strdup( out_buf );
-        extension->out_len  = out_len;
-        /*
-         * Now we need to pick the output apart into separate lines.
-         * Start by counting how many lines we've got, and keeping
-         * track of where each line starts in a static buffer
-         */
-        extension->numlines = 1;
-        line_buf[ 0 ] = extension->output;
-        for (cp=extension->output; *cp; cp++) {
-            if (*cp == '\n') {
-                line_buf[ extension->numlines++ ] = cp+1;
-            }
-        }
-        if ( extension->numlines > 1 ) {
-            extension->lines = calloc(extension->numlines, sizeof(char *));
-            if (extension->lines)
-                memcpy(extension->lines, line_buf,
-                       sizeof(char *) * extension->numlines);
-        } else {
-            extension->lines = &extension->output;
-        }
+        char *output = strdup( out_buf );
+
+        if (output)
+            _extend_store_output(extension, output, out_len);
     }
     extension->result = ret;
     return ret;
@@ -441,6 +755,9 @@ _free_extension( netsnmp_extend *extension, extend_registration_block *ereg )
         netsnmp_table_data_remove_and_delete_row( ereg->dinfo, extension->row);
     }
 
+#ifdef NS_EXTEND_ASYNC
+    _extend_cancel( extension );
+#endif
     SNMP_FREE( extension->token );
     SNMP_FREE( extension->cache );
     SNMP_FREE( extension->command );
@@ -467,8 +784,16 @@ _new_extension( char *exec_name, int exec_flags, extend_registration_block *ereg
     extension->flags    = exec_flags;
     extension->cache    = netsnmp_cache_create( 0, extend_load_cache,
                                                    extend_free_cache, NULL, 0 );
-    if (extension->cache)
+    extension->fd       = -1;
+    if (extension->cache) {
         extension->cache->magic = extension;
+        /*
+         * Keep the previous output (even once expired) to be
+         *   served while the command is re-run in the background
+         */
+        extension->cache->flags |= NETSNMP_CACHE_DONT_FREE_BEFORE_LOAD |
+                                   NETSNMP_CACHE_DONT_AUTO_RELEASE;
+    }
 
     row = netsnmp_create_table_data_row();
     if (!row || !extension->cache) {
@@ -527,25 +852,34 @@ extend_parse_config(const char *token, char *cptr)
     extend_registration_block *eptr;
     int  flags;
     int cache_timeout = 0;
+    int run_timeout = 0;
     int exec_type = NS_EXTEND_ETYPE_EXEC;
 
     cptr = copy_nword(cptr, exec_name, sizeof(exec_name));
-    if (strcmp(exec_name, "-cacheTime") == 0) {
-        char cache_timeout_str[32];
-
-        cptr = copy_nword(cptr, cache_timeout_str, sizeof(cache_timeout_str));
-        /* If atoi can't do the conversion, it returns 0 */
-        cache_timeout = atoi(cache_timeout_str);
-        cptr = copy_nword(cptr, exec_name, sizeof(exec_name));
-    }
-    if (strcmp(exec_name, "-execType") == 0) {
-        char exec_type_str[16];
-
-        cptr = copy_nword(cptr, exec_type_str, sizeof(exec_type_str));
-        if (strcmp(exec_type_str, "sh") == 0)
-            exec_type = NS_EXTEND_ETYPE_SHELL;
-        else
-            exec_type = NS_EXTEND_ETYPE_EXEC;
+    for (;;) {
+        if (strcmp(exec_name, "-cacheTime") == 0) {
+            char cache_timeout_str[32];
+
+            cptr = copy_nword(cptr, cache_timeout_str,
+                              sizeof(cache_timeout_str));
+            /* If atoi can't do the conversion, it returns 0 */
+            cache_timeout = atoi(cache_timeout_str);
+        } else if (strcmp(exec_name, "-execType") == 0) {
+            char exec_type_str[16];
+
+            cptr = copy_nword(cptr, exec_type_str, sizeof(exec_type_str));
+            if (strcmp(exec_type_str, "sh") == 0)
+                exec_type = NS_EXTEND_ETYPE_SHELL;
+            else
+                exec_type = NS_EXTEND_ETYPE_EXEC;
+        } else if (strcmp(exec_name, "-timeout") == 0) {
+            char run_timeout_str[32];
+
+            cptr = copy_nword(cptr, run_timeout_str,
+                              sizeof(run_timeout_str));
+            run_timeout = atoi(run_timeout_str);
+        } else
+            break;
         cptr = copy_nword(cptr, exec_name, sizeof(exec_name));
     }
     if ( *exec_name == '.' ) {
@@ -597,6 +931,8 @@ extend_parse_config(const char *token, char *cptr)
             extension->args = strdup( cptr );
         if (cache_timeout != 0)
             extension->cache->timeout = cache_timeout;
+        if (run_timeout > 0)
+            extension->timeout = run_timeout;
     } else {
         snmp_log(LOG_ERR, "Failed to register extend entry '%s' - possibly duplicate name.\n", exec_name );
         return;
@@ -1076,6 +1412,10 @@ handle_nsExtendConfigTable(netsnmp_mib_handler          *handler,
                     eptr = _find_extension_block( request->requestvb->name,
                                                   request->requestvb->name_length );
                     _free_extension( extension, eptr );
+#ifdef NS_EXTEND_ASYNC
+                    /* it may have been running: pass on its slot */
+                    _extend_run_queue();
+#endif
                     break;
                 }
             }
@@ -1211,6 +1551,23 @@ handle_nsExtendOutput1Table(netsnmp_mib_handler          *handler,
                      request->requestvb, ASN_INTEGER,
                     (u_char*)&extension->result, sizeof(int));
                 break;
+            case COLUMN_EXTOUT1_RUNS:
+                snmp_set_var_typed_value(
+                     request->requestvb, ASN_COUNTER,
+                    (u_char*)&extension->runs, sizeof(extension->runs));
+                break;
+            case COLUMN_EXTOUT1_TIMEOUTS:
+                snmp_set_var_typed_value(
+                     request->requestvb, ASN_COUNTER,
+                    (u_char*)&extension->timeouts,
+                     sizeof(extension->timeouts));
+                break;
+            case COLUMN_EXTOUT1_RUNTIME:
+                snmp_set_var_typed_value(
+                     request->requestvb, ASN_GAUGE,
+                    (u_char*)&extension->last_runtime,
+                     sizeof(extension->last_runtime));
+                break;
             default:
                 netsnmp_set_request_error(reqinfo, request, SNMP_NOSUCHOBJECT);
                 continue;
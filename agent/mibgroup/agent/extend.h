@@ -21,6 +21,23 @@ typedef struct netsnmp_extend_s {
     int      result;
 
     int      flags;
+    int      timeout;      /* run time limit in seconds, 0 = extendTimeout */
+
+    /* background refresh, while the previous output is still served */
+    int      pid;
+    int      fd;
+    char    *rbuf;
+    int      rlen;
+    struct timeval started;
+    unsigned int   timer;
+    unsigned int   reap_timer;
+    struct netsnmp_extend_s *next_queued;
+
+    /* runtime statistics */
+    u_int    runs;
+    u_int    timeouts;
+    u_int    last_runtime; /* milliseconds */
+
     netsnmp_cache     *cache;
     netsnmp_table_row *row;
     netsnmp_table_data *dinfo;
@@ -50,8 +67,11 @@ void                 extend_parse_config(const char*, char*);
 #define COLUMN_EXTOUT1_OUTPUT2	2	/* Full Output */
 #define COLUMN_EXTOUT1_NUMLINES	3
 #define COLUMN_EXTOUT1_RESULT	4
+#define COLUMN_EXTOUT1_RUNS	5
+#define COLUMN_EXTOUT1_TIMEOUTS	6
+#define COLUMN_EXTOUT1_RUNTIME	7
 #define COLUMN_EXTOUT1_FIRST_COLUMN	COLUMN_EXTOUT1_OUTPUT1
-#define COLUMN_EXTOUT1_LAST_COLUMN	COLUMN_EXTOUT1_RESULT
+#define COLUMN_EXTOUT1_LAST_COLUMN	COLUMN_EXTOUT1_RUNTIME
 
 #define COLUMN_EXTOUT2_OUTLINE	2
 #define COLUMN_EXTOUT2_FIRST_COLUMN	COLUMN_EXTOUT2_OUTLINE
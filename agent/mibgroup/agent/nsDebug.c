@@ -414,8 +414,10 @@ handle_nsDebugTable(netsnmp_mib_handler *handler,
             case RS_NOTINSERVICE:
                 debug_entry = (netsnmp_token_descr*)
                                netsnmp_extract_iterator_context(request);
-                if (debug_entry)
+                if (debug_entry) {
 		    debug_entry->enabled = *request->requestvb->val.integer;
+		    debug_token_generation++;
+		}
 		break;
 
             case RS_CREATEANDWAIT:
@@ -443,6 +445,7 @@ handle_nsDebugTable(netsnmp_mib_handler *handler,
 		    debug_entry->enabled = 0;
 		    free(debug_entry->token_name);
 		    debug_entry->token_name = NULL;
+		    debug_token_generation++;
 		}
 		break;
 	    }
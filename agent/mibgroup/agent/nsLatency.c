@@ -0,0 +1,325 @@
+#include <net-snmp/net-snmp-config.h>
+#include <net-snmp/net-snmp-features.h>
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/agent/net-snmp-agent-includes.h>
+#include <net-snmp/agent/scalar.h>
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#include <strings.h>
+#endif
+
+#include "agent/nsLatency.h"
+
+
+#define nsLatency 1, 3, 6, 1, 4, 1, 8072, 1, 11
+
+/*
+ * columns of the latency table
+ */
+#define NSLATENCY_TYPE          2
+#define NSLATENCY_CONTEXT       3
+#define NSLATENCY_REGPOINT      4
+#define NSLATENCY_NAME          5
+#define NSLATENCY_COUNT         6
+#define NSLATENCY_TOTAL         7
+#define NSLATENCY_MAX           8
+#define NSLATENCY_BUCKET10US    9
+#define NSLATENCY_BUCKETOVER1S  (NSLATENCY_BUCKET10US + NETSNMP_LATENCY_BUCKETS - 1)
+
+#define TV_TRUE  1
+#define TV_FALSE 2
+
+
+void
+init_nsLatency(void)
+{
+    const oid nsLatencyEnabled_oid[]  = { nsLatency, 1 };
+    const oid nsLatencyReset_oid[]    = { nsLatency, 2 };
+    const oid nsLatencyTable_oid[]    = { nsLatency, 3 };
+
+    netsnmp_table_registration_info *table_info;
+    netsnmp_iterator_info           *iinfo;
+
+    /*
+     * Register the scalar objects...
+     */
+    DEBUGMSGTL(("nsLatencyScalars", "Initializing\n"));
+    netsnmp_register_scalar(
+        netsnmp_create_handler_registration(
+            "nsLatencyEnabled", handle_nsLatencyEnabled,
+            nsLatencyEnabled_oid, OID_LENGTH(nsLatencyEnabled_oid),
+            HANDLER_CAN_RWRITE)
+        );
+    netsnmp_register_scalar(
+        netsnmp_create_handler_registration(
+            "nsLatencyReset", handle_nsLatencyReset,
+            nsLatencyReset_oid, OID_LENGTH(nsLatencyReset_oid),
+            HANDLER_CAN_RWRITE)
+        );
+
+    /*
+     * ... and the table.
+     */
+    table_info = SNMP_MALLOC_TYPEDEF(netsnmp_table_registration_info);
+    if (!table_info) {
+        return;
+    }
+    netsnmp_table_helper_add_indexes(table_info, ASN_INTEGER, 0);
+    table_info->min_column = NSLATENCY_TYPE;
+    table_info->max_column = NSLATENCY_BUCKETOVER1S;
+
+    iinfo      = SNMP_MALLOC_TYPEDEF(netsnmp_iterator_info);
+    if (!iinfo) {
+        SNMP_FREE(table_info);
+        return;
+    }
+    iinfo->get_first_data_point = get_first_latency_entry;
+    iinfo->get_next_data_point  = get_next_latency_entry;
+    iinfo->table_reginfo        = table_info;
+    /*
+     * the rows are kept in index order
+     */
+    iinfo->flags               |= NETSNMP_ITERATOR_FLAG_SORTED;
+
+    netsnmp_register_table_iterator2(
+        netsnmp_create_handler_registration(
+            "nsLatencyTable", handle_nsLatencyTable,
+            nsLatencyTable_oid, OID_LENGTH(nsLatencyTable_oid),
+            HANDLER_CAN_RONLY),
+        iinfo);
+}
+
+
+/*
+ * nsLatency scalar handling
+ */
+
+int
+handle_nsLatencyEnabled(netsnmp_mib_handler *handler,
+                netsnmp_handler_registration *reginfo,
+                netsnmp_agent_request_info *reqinfo,
+                netsnmp_request_info *requests)
+{
+    long enabled;
+    netsnmp_request_info *request=NULL;
+
+    switch (reqinfo->mode) {
+
+    case MODE_GET:
+        enabled = (netsnmp_ds_get_boolean(NETSNMP_DS_APPLICATION_ID,
+                                          NETSNMP_DS_AGENT_LATENCY_STATS)
+                   ? TV_TRUE : TV_FALSE);
+        for (request = requests; request; request=request->next) {
+            snmp_set_var_typed_value(request->requestvb, ASN_INTEGER,
+                                     (u_char*)&enabled, sizeof(enabled));
+        }
+        break;
+
+
+#ifndef NETSNMP_NO_WRITE_SUPPORT
+    case MODE_SET_RESERVE1:
+        for (request = requests; request; request=request->next) {
+            if ( request->status != 0 ) {
+                return SNMP_ERR_NOERROR;	/* Already got an error */
+            }
+            if ( request->requestvb->type != ASN_INTEGER ) {
+                netsnmp_set_request_error(reqinfo, request, SNMP_ERR_WRONGTYPE);
+                return SNMP_ERR_WRONGTYPE;
+            }
+            if ((*request->requestvb->val.integer != TV_TRUE) &&
+                (*request->requestvb->val.integer != TV_FALSE)) {
+                netsnmp_set_request_error(reqinfo, request, SNMP_ERR_WRONGVALUE);
+                return SNMP_ERR_WRONGVALUE;
+            }
+        }
+        break;
+
+    case MODE_SET_COMMIT:
+        enabled = (*requests->requestvb->val.integer == TV_TRUE);
+        netsnmp_ds_set_boolean(NETSNMP_DS_APPLICATION_ID,
+                               NETSNMP_DS_AGENT_LATENCY_STATS, enabled);
+        break;
+#endif /* !NETSNMP_NO_WRITE_SUPPORT */
+    }
+
+    return SNMP_ERR_NOERROR;
+}
+
+
+int
+handle_nsLatencyReset(netsnmp_mib_handler *handler,
+                netsnmp_handler_registration *reginfo,
+                netsnmp_agent_request_info *reqinfo,
+                netsnmp_request_info *requests)
+{
+    long value = TV_FALSE;
+    netsnmp_request_info *request=NULL;
+
+    switch (reqinfo->mode) {
+
+    case MODE_GET:
+        for (request = requests; request; request=request->next) {
+            snmp_set_var_typed_value(request->requestvb, ASN_INTEGER,
+                                     (u_char*)&value, sizeof(value));
+        }
+        break;
+
+
+#ifndef NETSNMP_NO_WRITE_SUPPORT
+    case MODE_SET_RESERVE1:
+        for (request = requests; request; request=request->next) {
+            if ( request->status != 0 ) {
+                return SNMP_ERR_NOERROR;	/* Already got an error */
+            }
+            if ( request->requestvb->type != ASN_INTEGER ) {
+                netsnmp_set_request_error(reqinfo, request, SNMP_ERR_WRONGTYPE);
+                return SNMP_ERR_WRONGTYPE;
+            }
+            if ((*request->requestvb->val.integer != TV_TRUE) &&
+                (*request->requestvb->val.integer != TV_FALSE)) {
+                netsnmp_set_request_error(reqinfo, request, SNMP_ERR_WRONGVALUE);
+                return SNMP_ERR_WRONGVALUE;
+            }
+        }
+        break;
+
+    case MODE_SET_COMMIT:
+        if (*requests->requestvb->val.integer == TV_TRUE)
+            netsnmp_latency_stats_reset();
+        break;
+#endif /* !NETSNMP_NO_WRITE_SUPPORT */
+    }
+
+    return SNMP_ERR_NOERROR;
+}
+
+
+/*
+ * nsLatencyTable handling
+ */
+
+netsnmp_variable_list *
+get_first_latency_entry(void **loop_context, void **data_context,
+                        netsnmp_variable_list *index,
+                        netsnmp_iterator_info *data)
+{
+    netsnmp_latency_stats *stats = netsnmp_latency_stats_first();
+
+    if ( !stats )
+        return NULL;
+
+    snmp_set_var_typed_integer(index, ASN_INTEGER, stats->index);
+    *loop_context = (void*)stats;
+    *data_context = (void*)stats;
+    return index;
+}
+
+netsnmp_variable_list *
+get_next_latency_entry(void **loop_context, void **data_context,
+                       netsnmp_variable_list *index,
+                       netsnmp_iterator_info *data)
+{
+    netsnmp_latency_stats *stats = (netsnmp_latency_stats *)*loop_context;
+    stats = stats->next;
+
+    if ( !stats )
+        return NULL;
+
+    snmp_set_var_typed_integer(index, ASN_INTEGER, stats->index);
+    *loop_context = (void*)stats;
+    *data_context = (void*)stats;
+    return index;
+}
+
+
+int
+handle_nsLatencyTable(netsnmp_mib_handler *handler,
+                netsnmp_handler_registration *reginfo,
+                netsnmp_agent_request_info *reqinfo,
+                netsnmp_request_info *requests)
+{
+    netsnmp_request_info       *request    = NULL;
+    netsnmp_table_request_info *table_info = NULL;
+    netsnmp_latency_stats      *stats      = NULL;
+    u_long                      value;
+
+    switch (reqinfo->mode) {
+
+    case MODE_GET:
+        for (request=requests; request; request=request->next) {
+            if (request->processed != 0)
+                continue;
+
+            stats      = (netsnmp_latency_stats*)netsnmp_extract_iterator_context(request);
+            table_info =                         netsnmp_extract_table_info(request);
+            if (!stats) {
+                netsnmp_set_request_error(reqinfo, request, SNMP_NOSUCHINSTANCE);
+                continue;
+            }
+
+            switch (table_info->colnum) {
+            case NSLATENCY_TYPE:
+                snmp_set_var_typed_integer(request->requestvb, ASN_INTEGER,
+                                           stats->type);
+                break;
+
+            case NSLATENCY_CONTEXT:
+                snmp_set_var_typed_value(request->requestvb, ASN_OCTET_STR,
+                                         stats->context,
+                                         strlen(stats->context));
+                break;
+
+            case NSLATENCY_REGPOINT:
+                if (stats->rootoid_len)
+                    snmp_set_var_typed_value(request->requestvb,
+                                             ASN_OBJECT_ID, stats->rootoid,
+                                             stats->rootoid_len * sizeof(oid));
+                else
+                    snmp_set_var_typed_value(request->requestvb,
+                                             ASN_OBJECT_ID, nullOid,
+                                             nullOidLen);
+                break;
+
+            case NSLATENCY_NAME:
+                snmp_set_var_typed_value(request->requestvb, ASN_OCTET_STR,
+                                         stats->name, strlen(stats->name));
+                break;
+
+            case NSLATENCY_COUNT:
+                snmp_set_var_typed_integer(request->requestvb, ASN_COUNTER,
+                                           stats->count & 0xffffffff);
+                break;
+
+            case NSLATENCY_TOTAL:
+                snmp_set_var_typed_value(request->requestvb, ASN_COUNTER64,
+                                         (u_char*)&stats->total,
+                                         sizeof(stats->total));
+                break;
+
+            case NSLATENCY_MAX:
+                value = stats->max > 0xffffffffUL ? 0xffffffffUL : stats->max;
+                snmp_set_var_typed_integer(request->requestvb, ASN_UNSIGNED,
+                                           value);
+                break;
+
+            default:
+                if (table_info->colnum >= NSLATENCY_BUCKET10US &&
+                    table_info->colnum <= NSLATENCY_BUCKETOVER1S) {
+                    value = stats->buckets[table_info->colnum -
+                                           NSLATENCY_BUCKET10US];
+                    snmp_set_var_typed_integer(request->requestvb,
+                                               ASN_COUNTER,
+                                               value & 0xffffffff);
+                    break;
+                }
+                netsnmp_set_request_error(reqinfo, request, SNMP_NOSUCHOBJECT);
+                continue;
+            }
+        }
+        break;
+    }
+
+    return SNMP_ERR_NOERROR;
+}
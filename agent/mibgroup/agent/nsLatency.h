@@ -0,0 +1,22 @@
+#ifndef NSLATENCY_H
+#define NSLATENCY_H
+
+/*
+ * function declarations 
+ */
+void            init_nsLatency(void);
+
+/*
+ * Handlers for the scalar objects
+ */
+Netsnmp_Node_Handler handle_nsLatencyEnabled;
+Netsnmp_Node_Handler handle_nsLatencyReset;
+
+/*
+ * Handler and iterators for the latency table
+ */
+Netsnmp_Node_Handler handle_nsLatencyTable;
+Netsnmp_First_Data_Point  get_first_latency_entry;
+Netsnmp_Next_Data_Point   get_next_latency_entry;
+
+#endif /* NSLATENCY_H */
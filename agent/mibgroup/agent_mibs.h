@@ -4,6 +4,7 @@ config_require(agent/nsModuleTable);
 config_require(agent/nsDebug);
 #endif
 config_require(agent/nsCache);
+config_require(agent/nsLatency);
 config_require(agent/nsLogging);
 config_require(agent/nsVacmAccessTable);
 config_add_mib(NET-SNMP-AGENT-MIB);
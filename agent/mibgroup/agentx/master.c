@@ -203,6 +203,604 @@ real_init_master(void)
     DEBUGMSGTL(("agentx/master", "initializing...   DONE\n"));
 }
 
+/*
+ * Request pipelining.
+ *
+ * Each subagent connection may have at most agentxMaxOutstanding AgentX
+ * requests in flight (0 means no limit).  Requests beyond that wait in a
+ * FIFO queue and are released as responses come back, so that a slow
+ * subagent can't accumulate an unbounded backlog.  While queued, read
+ * requests which belong to the same SNMP transaction (e.g. a GET touching
+ * several subtrees registered by one subagent) are coalesced into a single
+ * AgentX PDU.
+ */
+typedef struct agentx_master_pending_s {
+    netsnmp_pdu    *pdu;
+    netsnmp_delegated_cache *cache;     /* NULL for CleanupSet */
+    struct timeval  queued;
+    struct agentx_master_pending_s *next;
+} agentx_master_pending;
+
+typedef struct agentx_master_part_s {
+    netsnmp_delegated_cache *cache;
+    int             nvars;
+} agentx_master_part;
+
+typedef struct agentx_master_inflight_s {
+    netsnmp_session *session;
+    u_long          state_id;
+    struct timeval  sent;
+    int             sending;
+    int             done;
+    int             nparts;
+    agentx_master_part *parts;
+} agentx_master_inflight;
+
+typedef struct agentx_master_state_s {
+    netsnmp_session *session;
+    u_long          id;
+    int             busy;
+    int             closed;
+    int             outstanding;
+    int             queued;
+    agentx_master_pending *head;
+    agentx_master_pending *tail;
+
+    /*
+     * statistics
+     */
+    u_long          sent;
+    u_long          coalesced;
+    u_long          responses;
+    u_long          failures;
+    u_long          queued_total;
+    int             max_outstanding;
+    int             max_queued;
+    u_long          latency_count;
+    u_long          latency_total;      /* usec */
+    u_long          latency_max;        /* usec */
+    u_long          wait_total;         /* usec */
+
+    struct agentx_master_state_s *next;
+} agentx_master_state;
+
+static agentx_master_state *agentx_master_states = NULL;
+
+int agentx_got_response(int, netsnmp_session *, int, netsnmp_pdu *, void *);
+static void _agentx_master_pump(agentx_master_state *state);
+
+static u_long
+_agentx_master_usec_since(const struct timeval *then)
+{
+    struct timeval  now, diff;
+
+    netsnmp_get_monotonic_clock(&now);
+    NETSNMP_TIMERSUB(&now, then, &diff);
+    return diff.tv_sec * 1000000UL + diff.tv_usec;
+}
+
+static agentx_master_state *
+_agentx_master_state_find(netsnmp_session *session, u_long id)
+{
+    agentx_master_state *state;
+
+    for (state = agentx_master_states; state; state = state->next)
+        if (state->session == session && !state->closed &&
+            (id == 0 || state->id == id))
+            return state;
+    return NULL;
+}
+
+static agentx_master_state *
+_agentx_master_state_get(netsnmp_session *session)
+{
+    static u_long   last_id = 0;
+    agentx_master_state *state;
+
+    state = _agentx_master_state_find(session, 0);
+    if (state)
+        return state;
+
+    state = SNMP_MALLOC_TYPEDEF(agentx_master_state);
+    if (!state)
+        return NULL;
+    state->session = session;
+    state->id = ++last_id;
+    state->next = agentx_master_states;
+    agentx_master_states = state;
+    return state;
+}
+
+static void
+_agentx_master_state_free(agentx_master_state *state)
+{
+    agentx_master_state **prevNext;
+
+    for (prevNext = &agentx_master_states; *prevNext;
+         prevNext = &(*prevNext)->next) {
+        if (*prevNext == state) {
+            *prevNext = state->next;
+            break;
+        }
+    }
+    free(state);
+}
+
+/*
+ * Give up on a delegated request which never made it to the subagent
+ */
+static void
+_agentx_master_fail_cache(netsnmp_delegated_cache *cache)
+{
+    if (netsnmp_handler_check_cache(cache)) {
+        netsnmp_handler_mark_requests_as_delegated(cache->requests,
+                                                   REQUEST_IS_NOT_DELEGATED);
+        netsnmp_set_request_error(cache->reqinfo, cache->requests,
+                                  SNMP_ERR_GENERR);
+    }
+    netsnmp_free_delegated_cache(cache);
+}
+
+static void
+_agentx_master_log_stats(int pri, agentx_master_state *state)
+{
+    netsnmp_session *sp = state->session->subsession;
+
+    snmp_log(pri, "AgentX subagent %s (session %p): %lu sent, %lu coalesced, "
+             "%lu responses, %lu failures, %d outstanding (max %d), "
+             "%d queued (max %d, total %lu), latency avg %lu max %lu usec, "
+             "queue wait avg %lu usec\n",
+             (sp && sp->securityName) ? sp->securityName : "-",
+             state->session, state->sent, state->coalesced,
+             state->responses, state->failures, state->outstanding,
+             state->max_outstanding, state->queued, state->max_queued,
+             state->queued_total,
+             state->latency_count ?
+                 state->latency_total / state->latency_count : 0,
+             state->latency_max,
+             state->queued_total ? state->wait_total / state->queued_total : 0);
+}
+
+/*
+ * Log the pipelining statistics of all connected subagents
+ */
+void
+agentx_master_dump_stats(void)
+{
+    agentx_master_state *state;
+
+    for (state = agentx_master_states; state; state = state->next)
+        if (!state->closed)
+            _agentx_master_log_stats(LOG_INFO, state);
+}
+
+/*
+ * Called when a subagent connection goes away: fail whatever is still
+ * waiting in its queue and forget about it.
+ */
+void
+agentx_master_release_session(netsnmp_session *session)
+{
+    agentx_master_state *state;
+    agentx_master_pending *p;
+
+    state = _agentx_master_state_find(session, 0);
+    if (!state)
+        return;
+
+    if (snmp_get_do_debugging()) {
+        DEBUGIF("stats:agentx") {
+            _agentx_master_log_stats(LOG_DEBUG, state);
+        }
+    }
+
+    while ((p = state->head) != NULL) {
+        state->head = p->next;
+        if (p->cache)
+            _agentx_master_fail_cache(p->cache);
+        snmp_free_pdu(p->pdu);
+        free(p);
+    }
+    state->tail = NULL;
+    state->queued = 0;
+    state->closed = 1;
+    if (!state->busy)
+        _agentx_master_state_free(state);
+}
+
+/*
+ * The async callback for all pipelined requests.  Splits the response of
+ * a coalesced PDU back into the original delegated requests.
+ */
+static int
+agentx_master_got_response(int operation, netsnmp_session *session,
+                           int reqid, netsnmp_pdu *pdu, void *magic)
+{
+    agentx_master_inflight *inflight = (agentx_master_inflight *) magic;
+    agentx_master_state *state;
+    netsnmp_variable_list *var, *next_part;
+    int             i, j, base;
+
+    if (operation == NETSNMP_CALLBACK_OP_RESEND)
+        return 0;
+
+    state = _agentx_master_state_find(inflight->session, inflight->state_id);
+    if (state) {
+        state->outstanding--;
+        if (operation == NETSNMP_CALLBACK_OP_RECEIVED_MESSAGE) {
+            u_long          usec = _agentx_master_usec_since(&inflight->sent);
+            state->responses++;
+            state->latency_count++;
+            state->latency_total += usec;
+            if (usec > state->latency_max)
+                state->latency_max = usec;
+        } else
+            state->failures++;
+    }
+
+    if (operation == NETSNMP_CALLBACK_OP_RECEIVED_MESSAGE &&
+        netsnmp_ds_get_boolean(NETSNMP_DS_APPLICATION_ID,
+                               NETSNMP_DS_AGENT_LATENCY_STATS)) {
+        /*
+         * the round trip, as opposed to the time it took to hand the
+         * request to the subagent, which is what netsnmp_call_handlers()
+         * sees of delegated registrations
+         */
+        for (i = 0; i < inflight->nparts; i++) {
+            netsnmp_delegated_cache *cache =
+                netsnmp_handler_check_cache(inflight->parts[i].cache);
+            netsnmp_handler_registration *reginfo;
+
+            if (!cache || !(reginfo = cache->reginfo))
+                continue;
+            netsnmp_latency_stats_record(
+                netsnmp_latency_stats_get(NETSNMP_LATENCY_AGENTX,
+                                          reginfo->handlerName,
+                                          reginfo->contextName,
+                                          reginfo->rootoid,
+                                          reginfo->rootoid_len),
+                &inflight->sent);
+        }
+    }
+
+    if (inflight->nparts == 1) {
+        agentx_got_response(operation, session, reqid, pdu,
+                            inflight->parts[0].cache);
+    } else if (operation != NETSNMP_CALLBACK_OP_RECEIVED_MESSAGE) {
+        /*
+         * only the first part gets to tear down the session
+         */
+        agentx_got_response(operation, session, reqid, pdu,
+                            inflight->parts[0].cache);
+        for (i = 1; i < inflight->nparts; i++)
+            _agentx_master_fail_cache(inflight->parts[i].cache);
+    } else {
+        var = pdu->variables;
+        for (i = 0, base = 0; i < inflight->nparts; i++) {
+            agentx_master_part *part = &inflight->parts[i];
+            netsnmp_variable_list *last = NULL;
+            netsnmp_pdu     sub = *pdu;
+
+            sub.variables = var;
+            for (j = 0; j < part->nvars && var; j++) {
+                last = var;
+                var = var->next_variable;
+            }
+            next_part = var;
+            if (last)
+                last->next_variable = NULL;
+
+            if (pdu->errstat != AGENTX_ERR_NOERROR &&
+                (pdu->errindex <= base || pdu->errindex > base + part->nvars)
+                && !(pdu->errindex == 0 && i == 0)) {
+                /*
+                 * the error belongs to another part of this PDU
+                 */
+                if (netsnmp_handler_check_cache(part->cache))
+                    netsnmp_handler_mark_requests_as_delegated(
+                        part->cache->requests, REQUEST_IS_NOT_DELEGATED);
+                netsnmp_free_delegated_cache(part->cache);
+            } else {
+                if (pdu->errstat != AGENTX_ERR_NOERROR && pdu->errindex)
+                    sub.errindex = pdu->errindex - base;
+                agentx_got_response(operation, session, reqid, &sub,
+                                    part->cache);
+            }
+
+            if (last)
+                last->next_variable = next_part;
+            base += part->nvars;
+        }
+    }
+
+    if (inflight->sending) {
+        /*
+         * failed synchronously inside snmp_async_send(); our caller
+         * cleans up and keeps pumping
+         */
+        inflight->done = 1;
+        return 1;
+    }
+    session = inflight->session;
+    free(inflight->parts);
+    free(inflight);
+
+    state = _agentx_master_state_find(session, 0);
+    if (state)
+        _agentx_master_pump(state);
+    return 1;
+}
+
+static int
+_agentx_master_can_coalesce(netsnmp_pdu *pdu, agentx_master_pending *p)
+{
+    netsnmp_pdu    *other = p->pdu;
+
+    if (!p->cache || other->command != pdu->command ||
+        (pdu->command != AGENTX_MSG_GET && pdu->command != AGENTX_MSG_GETNEXT))
+        return 0;
+    if (other->transid != pdu->transid || other->sessid != pdu->sessid ||
+        other->flags != pdu->flags ||
+        other->community_len != pdu->community_len)
+        return 0;
+    if (pdu->community_len &&
+        memcmp(other->community, pdu->community, pdu->community_len) != 0)
+        return 0;
+    return 1;
+}
+
+/*
+ * Take the head of the queue (plus anything that can be merged into it)
+ * and send it to the subagent.
+ */
+static void
+_agentx_master_send_next(agentx_master_state *state)
+{
+    agentx_master_pending *p, *q;
+    agentx_master_inflight *inflight;
+    netsnmp_variable_list *vtail;
+    netsnmp_pdu    *pdu;
+    int             n, result;
+
+    p = state->head;
+    state->head = p->next;
+    if (!state->head)
+        state->tail = NULL;
+    state->queued--;
+    pdu = p->pdu;
+
+    if (p->queued.tv_sec || p->queued.tv_usec)
+        state->wait_total += _agentx_master_usec_since(&p->queued);
+
+    if (!p->cache) {
+        /*
+         * CleanupSet: no response, doesn't occupy a slot
+         */
+        free(p);
+        if (snmp_async_send(state->session, pdu, NULL, NULL) == 0)
+            snmp_free_pdu(pdu);
+        state->sent++;
+        return;
+    }
+
+    for (n = 1, q = state->head; q && _agentx_master_can_coalesce(pdu, q);
+         q = q->next)
+        n++;
+
+    inflight = SNMP_MALLOC_TYPEDEF(agentx_master_inflight);
+    if (inflight)
+        inflight->parts = calloc(n, sizeof(agentx_master_part));
+    if (!inflight || !inflight->parts) {
+        free(inflight);
+        _agentx_master_fail_cache(p->cache);
+        snmp_free_pdu(pdu);
+        free(p);
+        return;
+    }
+    inflight->session = state->session;
+    inflight->state_id = state->id;
+    inflight->nparts = n;
+    inflight->parts[0].cache = p->cache;
+    inflight->parts[0].nvars = count_varbinds(pdu->variables);
+    free(p);
+
+    for (vtail = pdu->variables; vtail && vtail->next_variable;
+         vtail = vtail->next_variable)
+        ;
+    for (n = 1; n < inflight->nparts; n++) {
+        q = state->head;
+        state->head = q->next;
+        if (!state->head)
+            state->tail = NULL;
+        state->queued--;
+        state->coalesced++;
+        if (q->queued.tv_sec || q->queued.tv_usec)
+            state->wait_total += _agentx_master_usec_since(&q->queued);
+
+        inflight->parts[n].cache = q->cache;
+        inflight->parts[n].nvars = count_varbinds(q->pdu->variables);
+        if (vtail)
+            vtail->next_variable = q->pdu->variables;
+        else
+            pdu->variables = q->pdu->variables;
+        q->pdu->variables = NULL;
+        for (; vtail && vtail->next_variable; vtail = vtail->next_variable)
+            ;
+        if (!vtail)
+            vtail = pdu->variables;
+        snmp_free_pdu(q->pdu);
+        free(q);
+    }
+    if (inflight->nparts > 1)
+        DEBUGMSGTL(("agentx/master", "coalesced %d requests into req=0x%x\n",
+                    inflight->nparts, (unsigned)pdu->reqid));
+
+    state->outstanding++;
+    if (state->outstanding > state->max_outstanding)
+        state->max_outstanding = state->outstanding;
+    state->sent++;
+
+    DEBUGMSGTL(("agentx/master", "sending pdu (req=0x%x,trans=0x%x,sess=0x%x)\n",
+                (unsigned)pdu->reqid, (unsigned)pdu->transid, (unsigned)pdu->sessid));
+    netsnmp_get_monotonic_clock(&inflight->sent);
+    inflight->sending = 1;
+    result = snmp_async_send(state->session, pdu,
+                             agentx_master_got_response, inflight);
+    if (result == 0) {
+        DEBUGMSGTL(("agentx/master", "failed to send pdu (req=0x%x)\n",
+                    (unsigned)pdu->reqid));
+        /*
+         * still "sending", so that the callback leaves inflight to us
+         */
+        if (!inflight->done)
+            agentx_master_got_response(NETSNMP_CALLBACK_OP_SEND_FAILED,
+                                       state->session, pdu->reqid, pdu,
+                                       inflight);
+        snmp_free_pdu(pdu);
+        free(inflight->parts);
+        free(inflight);
+        return;
+    }
+    inflight->sending = 0;
+}
+
+static void
+_agentx_master_pump(agentx_master_state *state)
+{
+    int             window =
+        netsnmp_ds_get_int(NETSNMP_DS_APPLICATION_ID,
+                           NETSNMP_DS_AGENT_AGENTX_MAX_OUTSTANDING);
+
+    if (state->busy)
+        return;
+    state->busy = 1;
+    while (state->head && !state->closed &&
+           (window <= 0 || state->outstanding < window || !state->head->cache))
+        _agentx_master_send_next(state);
+    state->busy = 0;
+    if (state->closed)
+        _agentx_master_state_free(state);
+}
+
+/*
+ * Queue an AgentX request for a subagent and send it if the window allows
+ */
+static void
+_agentx_master_queue(netsnmp_session *session, netsnmp_pdu *pdu,
+                     netsnmp_delegated_cache *cache)
+{
+    agentx_master_state *state;
+    agentx_master_pending *p;
+    int             window;
+
+    state = _agentx_master_state_get(session);
+    p = SNMP_MALLOC_TYPEDEF(agentx_master_pending);
+    if (!state || !p) {
+        free(p);
+        if (cache)
+            _agentx_master_fail_cache(cache);
+        snmp_free_pdu(pdu);
+        return;
+    }
+    p->pdu = pdu;
+    p->cache = cache;
+
+    window = netsnmp_ds_get_int(NETSNMP_DS_APPLICATION_ID,
+                                NETSNMP_DS_AGENT_AGENTX_MAX_OUTSTANDING);
+    if (state->head || (cache && window > 0 && state->outstanding >= window)) {
+        netsnmp_get_monotonic_clock(&p->queued);
+        state->queued_total++;
+        DEBUGMSGTL(("agentx/master", "queueing pdu (req=0x%x), %d outstanding,"
+                    " %d queued\n", (unsigned)pdu->reqid, state->outstanding,
+                    state->queued));
+    }
+    if (state->tail)
+        state->tail->next = p;
+    else
+        state->head = p;
+    state->tail = p;
+    state->queued++;
+    if (state->queued > state->max_queued)
+        state->max_queued = state->queued;
+
+    _agentx_master_pump(state);
+}
+
+/*
+ * Distribute the varbinds of an AgentX GetBulk response over the
+ * repetitions of the original requests.  The response holds up to
+ * max_repetitions rows of one varbind per request, interleaved.  For each
+ * request we take rows until the subagent runs past the end of the
+ * registration (endOfMibView or an OID outside the search range); the
+ * agent's getnext loop then carries on from there into the next
+ * registration, exactly as it would after a single GetNext.
+ */
+static void
+_agentx_master_merge_bulk(netsnmp_request_info *requests, netsnmp_pdu *pdu)
+{
+    netsnmp_request_info *request;
+    netsnmp_variable_list *row, *var;
+    int             nreq, r, i;
+
+    nreq = 0;
+    for (request = requests; request; request = request->next)
+        nreq++;
+
+    for (request = requests, row = pdu->variables, r = 0; request;
+         request = request->next, r++) {
+
+        request->delegated = REQUEST_IS_NOT_DELEGATED;
+
+        /*
+         * var is the entry for this request in the current row
+         */
+        for (var = row, i = 0; var && i < r; i++)
+            var = var->next_variable;
+
+        for (i = 0; var; i++) {
+            int             in_range;
+            int             k;
+
+            DEBUGMSGTL(("agentx/master", "  bulk repetition %d: ", i));
+            DEBUGMSGOID(("agentx/master", var->name, var->name_length));
+            DEBUGMSG(("agentx/master", "\n"));
+
+            if (var->type == SNMP_ENDOFMIBVIEW)
+                break;
+            in_range = (request->range_end == NULL ||
+                        snmp_oid_compare(var->name, var->name_length,
+                                         request->range_end,
+                                         request->range_end_len) < 0);
+            if (i > 0 && !in_range)
+                break;
+
+            snmp_set_var_typed_value(request->requestvb, var->type,
+                                     var->val.string, var->val_len);
+            snmp_set_var_objid(request->requestvb, var->name,
+                               var->name_length);
+
+            /*
+             * same as netsnmp_bulk_to_next_fix_requests(): move on to the
+             * next repetition if there is one left
+             */
+            if (!in_range || request->repeat <= 0 ||
+                !request->requestvb->next_variable)
+                break;
+            request->repeat--;
+            snmp_set_var_objid(request->requestvb->next_variable,
+                               request->requestvb->name,
+                               request->requestvb->name_length);
+            request->requestvb = request->requestvb->next_variable;
+            request->requestvb->type = ASN_PRIV_RETRY;
+            if (2 == request->inclusive)
+                request->inclusive = 0;
+
+            for (k = 0; var && k < nreq; k++)
+                var = var->next_variable;
+        }
+    }
+}
+
         /*
          * Handle the response from an AgentX subagent,
          *   merging the answers back into the original query
@@ -325,10 +923,22 @@ agentx_got_response(int operation,
          *      (see section 7.2.6, "Sending the SNMP Response-PDU").
          */
         int err;
+        long errindex = pdu->errindex;
 
         DEBUGMSGTL(("agentx/master",
                     "agentx_got_response() error branch\n"));
 
+        if (cache->reqinfo->mode == MODE_GETBULK && errindex > 0) {
+            /*
+             * GetBulk responses are interleaved: map the index back to
+             * the request it was generated for
+             */
+            for (request = requests, i = 0; request; request = request->next)
+                i++;
+            if (i > 0)
+                errindex = ((errindex - 1) % i) + 1;
+        }
+
         switch (pdu->errstat) {
         case AGENTX_ERR_PARSE_FAILED:
         case AGENTX_ERR_REQUEST_DENIED:
@@ -342,7 +952,7 @@ agentx_got_response(int operation,
         ret = 0;
         for (request = requests, i = 1; request;
              request = request->next, i++) {
-            if (i == pdu->errindex) {
+            if (i == errindex) {
                 /*
                  * Mark this varbind as the one generating the error.
                  * Note that the AgentX errindex may not match the
@@ -364,9 +974,12 @@ agentx_got_response(int operation,
         netsnmp_free_delegated_cache(cache);
         DEBUGMSGTL(("agentx/master", "end error branch\n"));
         return 1;
+    } else if (cache->reqinfo->mode == MODE_GETBULK) {
+        DEBUGMSGTL(("agentx/master",
+                    "agentx_got_response() bulk beginning...\n"));
+        _agentx_master_merge_bulk(requests, pdu);
     } else if (cache->reqinfo->mode == MODE_GET ||
-               cache->reqinfo->mode == MODE_GETNEXT ||
-               cache->reqinfo->mode == MODE_GETBULK) {
+               cache->reqinfo->mode == MODE_GETNEXT) {
         /*
          * Replace varbinds for data request types, but not SETs.  
          */
@@ -409,9 +1022,6 @@ agentx_got_response(int operation,
             netsnmp_set_request_error(cache->reqinfo, requests,
                                       SNMP_ERR_GENERR);
         }
-
-        if (cache->reqinfo->mode == MODE_GETBULK)
-            netsnmp_bulk_to_next_fix_requests(requests);
     } else {
         /*
          * mark set requests as handled 
@@ -449,7 +1059,6 @@ agentx_master_handler(netsnmp_mib_handler *handler,
     netsnmp_request_info *request = requests;
     netsnmp_pdu    *pdu;
     void           *cb_data;
-    int             result;
 
     DEBUGMSGTL(("agentx/master",
                 "agentx master handler starting, mode = 0x%02x\n",
@@ -472,8 +1081,8 @@ agentx_master_handler(netsnmp_mib_handler *handler,
         pdu = snmp_pdu_create(AGENTX_MSG_GETNEXT);
         break;
 
-    case MODE_GETBULK:         /* WWWXXX */
-        pdu = snmp_pdu_create(AGENTX_MSG_GETNEXT);
+    case MODE_GETBULK:
+        pdu = snmp_pdu_create(AGENTX_MSG_GETBULK);
         break;
 
 #ifndef NETSNMP_NO_WRITE_SUPPORT
@@ -591,6 +1200,18 @@ agentx_master_handler(netsnmp_mib_handler *handler,
         else
             request->delegated = REQUEST_IS_NOT_DELEGATED;
 
+        /*
+         * let the subagent walk as many repetitions as any request
+         * still wants in one go.  Every request repeats: the response is
+         * merged back as rows of one varbind per request, and the
+         * agent's own non-repeaters arrive here with repeat == 0.
+         */
+        if (reqinfo->mode == MODE_GETBULK) {
+            pdu->non_repeaters = 0;
+            if (request->repeat + 1 > pdu->max_repetitions)
+                pdu->max_repetitions = SNMP_MIN(request->repeat + 1, 0xffff);
+        }
+
         /*
          * next... 
          */
@@ -610,14 +1231,9 @@ agentx_master_handler(netsnmp_mib_handler *handler,
         cb_data = NULL;
 
     /*
-     * send the requests out.
+     * send the requests out, subject to the subagent's window.
      */
-    DEBUGMSGTL(("agentx/master", "sending pdu (req=0x%x,trans=0x%x,sess=0x%x)\n",
-                (unsigned)pdu->reqid, (unsigned)pdu->transid, (unsigned)pdu->sessid));
-    result = snmp_async_send(ax_session, pdu, agentx_got_response, cb_data);
-    if (result == 0) {
-        snmp_free_pdu(pdu);
-    }
+    _agentx_master_queue(ax_session, pdu, cb_data);
 
     return SNMP_ERR_NOERROR;
 }
@@ -10,5 +10,7 @@ config_require(agentx/agentx_config);
      void            init_master(void);
      void            real_init_master(void);
      Netsnmp_Node_Handler agentx_master_handler;
+     void            agentx_master_release_session(netsnmp_session *session);
+     void            agentx_master_dump_stats(void);
 
 #endif                          /* _AGENTX_MASTER_H */
@@ -131,6 +131,11 @@ close_agentx_session(netsnmp_session * session, int sessid)
 
     DEBUGMSGTL(("agentx/master", "close %8p, %d\n", session, sessid));
     if (sessid == -1) {
+        /*
+         * Fail anything still queued for this subagent
+         */
+        agentx_master_release_session(session);
+
         /*
          * The following is necessary to avoid locking up the agent when
          * a subagent dies during a set request. We must clean up the
@@ -1205,10 +1205,8 @@ agentx_parse_oid(const u_char *data, size_t *length, int *inc,
     }
 
     for (i = 0; i < n_subid; i++) {
-	int x;
-
-	x = agentx_parse_int(buf_ptr, network_byte_order);
-        *oid_ptr++ = x;
+        /* sub-identifiers are unsigned 32 bit values */
+        *oid_ptr++ = (u_int) agentx_parse_int(buf_ptr, network_byte_order);
         buf_ptr += 4;
         *length -= 4;
     }
@@ -1226,9 +1224,14 @@ agentx_parse_oid(const u_char *data, size_t *length, int *inc,
 
 
 
+/*
+ * Parse an octet string without copying it: *str points into the packet,
+ * which is fine for callers that copy the value into a varbind anyway.
+ */
 static const u_char *
-agentx_parse_string(const u_char *data, size_t *length, struct rszbuf *string,
-                    u_int network_byte_order)
+agentx_parse_string_view(const u_char *data, size_t *length,
+                         const u_char **str, size_t *str_len,
+                         u_int network_byte_order)
 {
     u_int           len;
 
@@ -1248,13 +1251,8 @@ agentx_parse_string(const u_char *data, size_t *length, struct rszbuf *string,
                     (int)*length));
         return NULL;
     }
-    if (!increase_size(string, len + 1)) {
-        DEBUGMSGTL(("agentx", "Out of memory\n"));
-        return NULL;
-    }
-    memmove(string->buf, data + 4, len);
-    memset((char *)string->buf + len, '\0', 1);
-    string->used = len;
+    *str = data + 4;
+    *str_len = len;
 
     len = (len + 3) & ~3UL; /* Include padding. */
 
@@ -1271,7 +1269,7 @@ agentx_parse_string(const u_char *data, size_t *length, struct rszbuf *string,
         size_t          buf_len = 0, out_len = 0;
 
         if (sprint_realloc_asciistring(&buf, &buf_len, &out_len, 1,
-                                       string->buf, string->used)) {
+                                       *str, *str_len)) {
             DEBUGMSG(("dumpv_recv", "String: %s\n", buf));
         } else {
             DEBUGMSG(("dumpv_recv", "String: %s [TRUNCATED]\n", buf));
@@ -1283,6 +1281,27 @@ agentx_parse_string(const u_char *data, size_t *length, struct rszbuf *string,
     return data + (len + 4);
 }
 
+static const u_char *
+agentx_parse_string(const u_char *data, size_t *length, struct rszbuf *string,
+                    u_int network_byte_order)
+{
+    const u_char   *str, *next;
+    size_t          str_len;
+
+    next = agentx_parse_string_view(data, length, &str, &str_len,
+                                    network_byte_order);
+    if (next == NULL)
+        return NULL;
+    if (!increase_size(string, str_len + 1)) {
+        DEBUGMSGTL(("agentx", "Out of memory\n"));
+        return NULL;
+    }
+    memmove(string->buf, str, str_len);
+    memset((char *)string->buf + str_len, '\0', 1);
+    string->used = str_len;
+    return next;
+}
+
 static const u_char *
 agentx_parse_opaque(const u_char *data, size_t *length, int *type,
                     struct rszbuf *opaque_buf, u_int network_byte_order)
@@ -1350,9 +1369,14 @@ agentx_parse_opaque(const u_char *data, size_t *length, int *type,
 }
 
 
+/*
+ * On success *val and *val_len describe the value: normally the contents
+ * of data_buf, but octet strings are left in place in the packet.
+ */
 static const u_char *
 agentx_parse_varbind(const u_char *data, size_t *length, int *type,
                      struct rszbuf *oid_buf, struct rszbuf *data_buf,
+                     const void **val, size_t *val_len,
                      u_int network_byte_order)
 {
     const u_char   *bufp = data;
@@ -1393,8 +1417,11 @@ agentx_parse_varbind(const u_char *data, size_t *length, int *type,
 
     case ASN_OCTET_STR:
     case ASN_IPADDRESS:
-        bufp = agentx_parse_string(bufp, length, data_buf, network_byte_order);
-        break;
+        bufp = agentx_parse_string_view(bufp, length,
+                                        (const u_char **) val, val_len,
+                                        network_byte_order);
+        DEBUGINDENTLESS();
+        return bufp;
 
     case ASN_OPAQUE:
         bufp = agentx_parse_opaque(bufp, length, type, data_buf,
@@ -1447,6 +1474,8 @@ agentx_parse_varbind(const u_char *data, size_t *length, int *type,
         DEBUGINDENTLESS();
         return NULL;
     }
+    *val = data_buf->buf;
+    *val_len = data_buf->used;
     DEBUGINDENTLESS();
     return bufp;
 }
@@ -1560,17 +1589,21 @@ agentx_parse(netsnmp_session * session, netsnmp_pdu *pdu, u_char * data,
              size_t len)
 {
     const u_char   *bufp = data;
-    char            data_buffer[64];
+    /*
+     * Scratch space is large enough for any OID the agent accepts, so
+     * well-formed packets parse without touching the heap.
+     */
+    oid             data_buffer[MAX_OID_LEN];
     struct rszbuf   data_buf = {
         data_buffer,
         -(int)sizeof(data_buffer)
     };
-    oid             oid_buffer[32];
+    oid             oid_buffer[MAX_OID_LEN];
     struct rszbuf   oid_buf = {
         oid_buffer,
         -(int)sizeof(oid_buffer)
     };
-    oid             end_oid_buffer[32];
+    oid             end_oid_buffer[MAX_OID_LEN];
     struct rszbuf   end_oid_buf = {
         end_oid_buffer,
         -(int)sizeof(end_oid_buffer)
@@ -1578,6 +1611,8 @@ agentx_parse(netsnmp_session * session, netsnmp_pdu *pdu, u_char * data,
     int             range_bound;        /* OID-range upper bound */
     int             inc;        /* Inclusive SearchRange flag */
     int             type;       /* VarBind data type */
+    const void     *val;        /* VarBind or string value */
+    size_t          val_len;
     size_t         *length = &len;
     const int       dbgindent = debug_indent_get();
     int             res = SNMP_ERR_NOERROR;
@@ -1629,14 +1664,16 @@ agentx_parse(netsnmp_session * session, netsnmp_pdu *pdu, u_char * data,
      */
     if (pdu->flags & AGENTX_MSG_FLAG_NON_DEFAULT_CONTEXT) {
         DEBUGDUMPHEADER("recv", "Context");
-        bufp = agentx_parse_string(bufp, length, &data_buf, pdu->flags &
-                                   AGENTX_FLAGS_NETWORK_BYTE_ORDER);
+        bufp = agentx_parse_string_view(bufp, length,
+                                        (const u_char **) &val, &val_len,
+                                        pdu->flags &
+                                        AGENTX_FLAGS_NETWORK_BYTE_ORDER);
         DEBUGINDENTLESS();
         if (bufp == NULL)
             goto parse_err;
 
-        pdu->community_len = data_buf.used;
-        snmp_clone_mem((void **)&pdu->community, data_buf.buf, data_buf.used);
+        pdu->community_len = val_len;
+        snmp_clone_mem((void **)&pdu->community, val, val_len);
 		
         /* The NetSNMP API stuffs the context into the PDU's community string
          * field, when using the AgentX Protocol.  The rest of the code however,
@@ -1675,13 +1712,15 @@ agentx_parse(netsnmp_session * session, netsnmp_pdu *pdu, u_char * data,
         if (bufp == NULL)
             goto parse_err;
         DEBUGDUMPHEADER("recv", "Subagent Description");
-        bufp = agentx_parse_string(bufp, length, &data_buf, pdu->flags &
-                                   AGENTX_FLAGS_NETWORK_BYTE_ORDER);
+        bufp = agentx_parse_string_view(bufp, length,
+                                        (const u_char **) &val, &val_len,
+                                        pdu->flags &
+                                        AGENTX_FLAGS_NETWORK_BYTE_ORDER);
         DEBUGINDENTLESS();
         if (bufp == NULL)
             goto parse_err;
         snmp_pdu_add_variable(pdu, oid_buf.buf, oid_buf.used,
-                              ASN_OCTET_STR, data_buf.buf, data_buf.used);
+                              ASN_OCTET_STR, val, val_len);
         break;
 
     case AGENTX_MSG_CLOSE:
@@ -1828,12 +1867,13 @@ agentx_parse(netsnmp_session * session, netsnmp_pdu *pdu, u_char * data,
         DEBUGDUMPHEADER("recv", "VarBindList");
         while (*length > 0) {
             bufp = agentx_parse_varbind(bufp, length, &type, &oid_buf,
-                                        &data_buf, pdu->flags &
+                                        &data_buf, &val, &val_len,
+                                        pdu->flags &
                                         AGENTX_FLAGS_NETWORK_BYTE_ORDER);
             if (bufp == NULL)
                 goto parse_err;
             snmp_pdu_add_variable(pdu, oid_buf.buf, oid_buf.used, type,
-                                  data_buf.buf, data_buf.used);
+                                  val, val_len);
         }
         DEBUGINDENTLESS();
         break;
@@ -1857,12 +1897,14 @@ agentx_parse(netsnmp_session * session, netsnmp_pdu *pdu, u_char * data,
                                 pdu->flags & AGENTX_FLAGS_NETWORK_BYTE_ORDER);
         if (bufp == NULL)
             goto parse_err;
-        bufp = agentx_parse_string(bufp, length, &data_buf, pdu->flags &
-                                   AGENTX_FLAGS_NETWORK_BYTE_ORDER);
+        bufp = agentx_parse_string_view(bufp, length,
+                                        (const u_char **) &val, &val_len,
+                                        pdu->flags &
+                                        AGENTX_FLAGS_NETWORK_BYTE_ORDER);
         if (bufp == NULL)
             goto parse_err;
         snmp_pdu_add_variable(pdu, oid_buf.buf, oid_buf.used,
-                              ASN_OCTET_STR, data_buf.buf, data_buf.used);
+                              ASN_OCTET_STR, val, val_len);
         break;
 
     case AGENTX_MSG_REMOVE_AGENT_CAPS:
@@ -75,6 +75,7 @@ typedef struct _net_snmpsubagent_magic_s {
     int             original_command;
     netsnmp_session *session;
     netsnmp_variable_list *ovars;
+    long            non_repeaters;      /* GETBULK only */
 } ns_subagent_magic;
 
 struct agent_netsnmp_set_info {
@@ -383,10 +384,9 @@ handle_agentx_packet(int operation, netsnmp_session * session, int reqid,
         break;
 
     case AGENTX_MSG_GETBULK:
-        /*
-         * WWWXXX 
-         */
-        DEBUGMSGTL(("agentx/subagent", "  -> getbulk\n"));
+        DEBUGMSGTL(("agentx/subagent",
+                    "  -> getbulk (non_repeaters %ld, max_repetitions %ld)\n",
+                    pdu->non_repeaters, pdu->max_repetitions));
         pdu->command = SNMP_MSG_GETBULK;
 
         /*
@@ -396,6 +396,7 @@ handle_agentx_packet(int operation, netsnmp_session * session, int reqid,
          */
 
         smagic->ovars = snmp_clone_varbind(pdu->variables);
+        smagic->non_repeaters = pdu->non_repeaters;
         DEBUGMSGTL(("agentx/subagent", "saved variables at %p\n",
                     smagic->ovars));
         mycallback = handle_subagent_response;
@@ -611,10 +612,57 @@ handle_subagent_response(int op, netsnmp_session * session, int reqid,
         }
     }
 
-    /*
-     * XXXJBPN: similar for GETBULK but the varbinds can get re-ordered I
-     * think which makes it er more difficult.  
-     */
+    if (smagic->original_command == AGENTX_MSG_GETBULK &&
+        smagic->ovars != NULL) {
+        /*
+         * The response holds the non-repeaters first, followed by rows
+         * of one varbind per repeater, so the scope for varbind k is
+         * found from its position.  Once a repeater has left its scope
+         * every later repetition of it is endOfMibView as well.
+         */
+        netsnmp_variable_list **scope;
+        char           *done;
+        long            n, nvars, nonrep, k, r;
+
+        DEBUGMSGTL(("agentx/subagent", "do getBulk scope processing\n"));
+        for (nvars = 0, u = smagic->ovars; u; u = u->next_variable)
+            nvars++;
+        nonrep = SNMP_MAX(0, SNMP_MIN(smagic->non_repeaters, nvars));
+        scope = (netsnmp_variable_list **) calloc(nvars, sizeof(*scope));
+        done = (char *) calloc(nvars, 1);
+        if (scope && done) {
+            for (n = 0, u = smagic->ovars; u; u = u->next_variable)
+                scope[n++] = u;
+
+            for (k = 0, v = pdu->variables; v; v = v->next_variable, k++) {
+                if (k < nonrep)
+                    r = k;
+                else if (nvars > nonrep)
+                    r = nonrep + (k - nonrep) % (nvars - nonrep);
+                else
+                    break;
+                u = scope[r];
+                if (!done[r] &&
+                    snmp_oid_compare(u->val.objid, u->val_len / sizeof(oid),
+                                     nullOid, nullOidLen/sizeof(oid)) != 0 &&
+                    snmp_oid_compare(v->name, v->name_length, u->val.objid,
+                                     u->val_len / sizeof(oid)) >= 0) {
+                    DEBUGMSGTL(("agentx/subagent", "result "));
+                    DEBUGMSGOID(("agentx/subagent", v->name,
+                                 v->name_length));
+                    DEBUGMSG(("agentx/subagent",
+                              " out of scope -- return endOfMibView\n"));
+                    done[r] = 1;
+                }
+                if (done[r]) {
+                    snmp_set_var_objid(v, u->name, u->name_length);
+                    snmp_set_var_typed_value(v, SNMP_ENDOFMIBVIEW, NULL, 0);
+                }
+            }
+        }
+        free(scope);
+        free(done);
+    }
 
     if (smagic->ovars != NULL) {
         snmp_free_varbind(smagic->ovars);
@@ -0,0 +1,389 @@
+/**  @example benchmark.c
+ *  This example registers synthetic objects of a configurable size
+ *  under netSnmpExampleTables.4, one set for each of the common ways of
+ *  implementing a MIB module, so that their throughput can be compared
+ *  (see testing/RUNBENCH and snmpbench):
+ *
+ *  - netSnmpExampleTables.4.1.N.0      read-write INTEGER scalars,
+ *                                      each an instance registration
+ *  - netSnmpExampleTables.4.2          a table_container table
+ *  - netSnmpExampleTables.4.3          a table_iterator table
+ *  - netSnmpExampleTables.4.4          a table_dataset table
+ *
+ *  Each table is indexed by an INTEGER from 1, and has a read-write
+ *  INTEGER column 2 and a read-only OCTET STRING column 3.  The sizes
+ *  are read from snmpd.conf when the agent starts:
+ *
+ *  - benchmarkScalars N          number of scalars (default 10)
+ *  - benchmarkContainerRows N    rows of the table_container table
+ *  - benchmarkIteratorRows N     rows of the table_iterator table
+ *  - benchmarkDatasetRows N      rows of the table_dataset table
+ *                                (default 100 each)
+ *
+ *  Run it inside a subagent (snmpd -X) to measure the AgentX path.
+ */
+
+#include <net-snmp/net-snmp-config.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#include <strings.h>
+#endif
+
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/agent/net-snmp-agent-includes.h>
+
+#include "benchmark.h"
+
+#define BENCHMARK_OID   1, 3, 6, 1, 4, 1, 8072, 2, 2, 4
+
+#define BENCHMARK_COL_VALUE     2
+#define BENCHMARK_COL_DESCR     3
+
+typedef struct benchmark_row_s {
+    netsnmp_index   idx;        /* table_container key, must come first */
+    oid             idx_oid;
+    long            value;
+    char            descr[24];
+} benchmark_row;
+
+static u_long   benchmark_scalars = 10;
+static u_long   benchmark_container_rows = 100;
+static u_long   benchmark_iterator_rows = 100;
+static u_long   benchmark_dataset_rows = 100;
+
+static long    *scalar_values;
+static benchmark_row *container_rows;
+static benchmark_row *iterator_rows;
+
+static void
+benchmark_parse_config(const char *token, char *cptr)
+{
+    long            x = atol(cptr);
+
+    if (x < 0) {
+        config_perror("benchmark: value must not be negative");
+        return;
+    }
+    if (!strcasecmp(token, "benchmarkScalars"))
+        benchmark_scalars = x;
+    else if (!strcasecmp(token, "benchmarkContainerRows"))
+        benchmark_container_rows = x;
+    else if (!strcasecmp(token, "benchmarkIteratorRows"))
+        benchmark_iterator_rows = x;
+    else
+        benchmark_dataset_rows = x;
+}
+
+static benchmark_row *
+benchmark_create_rows(u_long count)
+{
+    benchmark_row  *rows;
+    u_long          i;
+
+    if (count == 0)
+        return NULL;
+    rows = calloc(count, sizeof(benchmark_row));
+    if (!rows)
+        return NULL;
+    for (i = 0; i < count; i++) {
+        rows[i].idx_oid = i + 1;
+        rows[i].idx.oids = &rows[i].idx_oid;
+        rows[i].idx.len = 1;
+        rows[i].value = i + 1;
+        snprintf(rows[i].descr, sizeof(rows[i].descr), "row %lu", i + 1);
+    }
+    return rows;
+}
+
+/*
+ * Answer one column of one row of either table.  Only the value column
+ * is writable, and rows can't be created.
+ */
+static void
+benchmark_row_request(netsnmp_agent_request_info *reqinfo,
+                      netsnmp_request_info *request, benchmark_row *row)
+{
+    netsnmp_table_request_info *table_info =
+        netsnmp_extract_table_info(request);
+    int             ret;
+
+    switch (reqinfo->mode) {
+    case MODE_GET:
+        if (!row) {
+            netsnmp_set_request_error(reqinfo, request, SNMP_NOSUCHINSTANCE);
+            break;
+        }
+        switch (table_info->colnum) {
+        case BENCHMARK_COL_VALUE:
+            snmp_set_var_typed_integer(request->requestvb, ASN_INTEGER,
+                                       row->value);
+            break;
+        case BENCHMARK_COL_DESCR:
+            snmp_set_var_typed_value(request->requestvb, ASN_OCTET_STR,
+                                     row->descr, strlen(row->descr));
+            break;
+        default:
+            netsnmp_set_request_error(reqinfo, request, SNMP_NOSUCHOBJECT);
+            break;
+        }
+        break;
+
+#ifndef NETSNMP_NO_WRITE_SUPPORT
+    case MODE_SET_RESERVE1:
+        if (!row) {
+            netsnmp_set_request_error(reqinfo, request, SNMP_ERR_NOCREATION);
+            break;
+        }
+        if (table_info->colnum != BENCHMARK_COL_VALUE) {
+            netsnmp_set_request_error(reqinfo, request,
+                                      SNMP_ERR_NOTWRITABLE);
+            break;
+        }
+        ret = netsnmp_check_vb_type(request->requestvb, ASN_INTEGER);
+        if (ret != SNMP_ERR_NOERROR)
+            netsnmp_set_request_error(reqinfo, request, ret);
+        break;
+
+    case MODE_SET_COMMIT:
+        row->value = *request->requestvb->val.integer;
+        break;
+#endif /* NETSNMP_NO_WRITE_SUPPORT */
+    }
+}
+
+static int
+benchmark_container_handler(netsnmp_mib_handler *handler,
+                            netsnmp_handler_registration *reginfo,
+                            netsnmp_agent_request_info *reqinfo,
+                            netsnmp_request_info *requests)
+{
+    netsnmp_request_info *request;
+
+    for (request = requests; request; request = request->next) {
+        if (request->processed)
+            continue;
+        benchmark_row_request(reqinfo, request, (benchmark_row *)
+                              netsnmp_container_table_extract_context
+                              (request));
+    }
+    return SNMP_ERR_NOERROR;
+}
+
+static int
+benchmark_iterator_handler(netsnmp_mib_handler *handler,
+                           netsnmp_handler_registration *reginfo,
+                           netsnmp_agent_request_info *reqinfo,
+                           netsnmp_request_info *requests)
+{
+    netsnmp_request_info *request;
+
+    for (request = requests; request; request = request->next) {
+        if (request->processed)
+            continue;
+        benchmark_row_request(reqinfo, request, (benchmark_row *)
+                              netsnmp_extract_iterator_context(request));
+    }
+    return SNMP_ERR_NOERROR;
+}
+
+static netsnmp_variable_list *
+benchmark_iterator_next(void **loop_context, void **data_context,
+                        netsnmp_variable_list *index,
+                        netsnmp_iterator_info *data)
+{
+    benchmark_row  *row = (benchmark_row *) *loop_context;
+
+    if (!row || row >= iterator_rows + benchmark_iterator_rows)
+        return NULL;
+    snmp_set_var_typed_integer(index, ASN_INTEGER, row->idx_oid);
+    *data_context = row;
+    *loop_context = row + 1;
+    return index;
+}
+
+static netsnmp_variable_list *
+benchmark_iterator_first(void **loop_context, void **data_context,
+                         netsnmp_variable_list *index,
+                         netsnmp_iterator_info *data)
+{
+    *loop_context = iterator_rows;
+    return benchmark_iterator_next(loop_context, data_context, index, data);
+}
+
+static void
+benchmark_register_scalars(void)
+{
+    oid             name[] = { BENCHMARK_OID, 1, 0, 0 };
+    u_long          i;
+
+    if (benchmark_scalars == 0)
+        return;
+    scalar_values = calloc(benchmark_scalars, sizeof(long));
+    if (!scalar_values)
+        return;
+    for (i = 0; i < benchmark_scalars; i++) {
+        name[OID_LENGTH(name) - 2] = i + 1;
+        scalar_values[i] = i + 1;
+        netsnmp_register_long_instance("benchmarkScalar", name,
+                                       OID_LENGTH(name), &scalar_values[i],
+                                       NULL);
+    }
+}
+
+static void
+benchmark_register_container_table(void)
+{
+    static const oid table_oid[] = { BENCHMARK_OID, 2 };
+    netsnmp_handler_registration *reg;
+    netsnmp_table_registration_info *table_info;
+    netsnmp_container *container;
+    u_long          i;
+
+    container_rows = benchmark_create_rows(benchmark_container_rows);
+    container = netsnmp_container_find("benchmarkContainerTable:"
+                                       "table_container");
+    table_info = SNMP_MALLOC_TYPEDEF(netsnmp_table_registration_info);
+    reg = netsnmp_create_handler_registration("benchmarkContainerTable",
+                                              benchmark_container_handler,
+                                              table_oid,
+                                              OID_LENGTH(table_oid),
+                                              HANDLER_CAN_RWRITE);
+    if (!container || !table_info || !reg) {
+        snmp_log(LOG_ERR, "benchmark: can't create the container table\n");
+        if (container)
+            CONTAINER_FREE(container);
+        SNMP_FREE(table_info);
+        if (reg)
+            netsnmp_handler_registration_free(reg);
+        return;
+    }
+    for (i = 0; container_rows && i < benchmark_container_rows; i++)
+        CONTAINER_INSERT(container, &container_rows[i]);
+
+    netsnmp_table_helper_add_indexes(table_info, ASN_INTEGER, 0);
+    table_info->min_column = BENCHMARK_COL_VALUE;
+    table_info->max_column = BENCHMARK_COL_DESCR;
+    netsnmp_container_table_register(reg, table_info, container,
+                                     TABLE_CONTAINER_KEY_NETSNMP_INDEX);
+}
+
+static void
+benchmark_register_iterator_table(void)
+{
+    static const oid table_oid[] = { BENCHMARK_OID, 3 };
+    netsnmp_table_registration_info *table_info;
+    netsnmp_iterator_info *iinfo;
+
+    iterator_rows = benchmark_create_rows(benchmark_iterator_rows);
+    table_info = SNMP_MALLOC_TYPEDEF(netsnmp_table_registration_info);
+    iinfo = SNMP_MALLOC_TYPEDEF(netsnmp_iterator_info);
+    if (!table_info || !iinfo) {
+        SNMP_FREE(table_info);
+        SNMP_FREE(iinfo);
+        return;
+    }
+    netsnmp_table_helper_add_indexes(table_info, ASN_INTEGER, 0);
+    table_info->min_column = BENCHMARK_COL_VALUE;
+    table_info->max_column = BENCHMARK_COL_DESCR;
+
+    iinfo->get_first_data_point = benchmark_iterator_first;
+    iinfo->get_next_data_point = benchmark_iterator_next;
+    iinfo->table_reginfo = table_info;
+    iinfo->flags |= NETSNMP_ITERATOR_FLAG_SORTED;
+
+    netsnmp_register_table_iterator2(
+        netsnmp_create_handler_registration("benchmarkIteratorTable",
+                                            benchmark_iterator_handler,
+                                            table_oid, OID_LENGTH(table_oid),
+                                            HANDLER_CAN_RWRITE),
+        iinfo);
+}
+
+static void
+benchmark_register_dataset_table(void)
+{
+    static const oid table_oid[] = { BENCHMARK_OID, 4 };
+    netsnmp_table_data_set *table_set;
+    netsnmp_table_row *row;
+    char            descr[24];
+    u_long          i;
+    long            value;
+
+    table_set = netsnmp_create_table_data_set("benchmarkDatasetTable");
+    if (!table_set)
+        return;
+    netsnmp_table_dataset_add_index(table_set, ASN_INTEGER);
+    netsnmp_table_set_multi_add_default_row(table_set,
+                                            BENCHMARK_COL_VALUE,
+                                            ASN_INTEGER, 1, NULL, 0,
+                                            BENCHMARK_COL_DESCR,
+                                            ASN_OCTET_STR, 0, NULL, 0,
+                                            0);
+    netsnmp_register_table_data_set(
+        netsnmp_create_handler_registration("benchmarkDatasetTable", NULL,
+                                            table_oid, OID_LENGTH(table_oid),
+                                            HANDLER_CAN_RWRITE),
+        table_set, NULL);
+
+    for (i = 0; i < benchmark_dataset_rows; i++) {
+        row = netsnmp_create_table_data_row();
+        if (!row)
+            break;
+        value = i + 1;
+        snprintf(descr, sizeof(descr), "row %lu", i + 1);
+        netsnmp_table_row_add_index(row, ASN_INTEGER, &value, sizeof(value));
+        netsnmp_set_row_column(row, BENCHMARK_COL_VALUE, ASN_INTEGER,
+                               &value, sizeof(value));
+        netsnmp_mark_row_column_writable(row, BENCHMARK_COL_VALUE, 1);
+        netsnmp_set_row_column(row, BENCHMARK_COL_DESCR, ASN_OCTET_STR,
+                               descr, strlen(descr));
+        netsnmp_table_dataset_add_row(table_set, row);
+    }
+}
+
+/*
+ * The objects are created once the sizes are known.  They are not
+ * resized when the configuration is read again.
+ */
+static int
+benchmark_register(int majorID, int minorID, void *serverarg,
+                   void *clientarg)
+{
+    static int      done;
+
+    if (done++)
+        return SNMP_ERR_NOERROR;
+
+    DEBUGMSGTL(("benchmark", "%lu scalars, %lu/%lu/%lu table rows\n",
+                benchmark_scalars, benchmark_container_rows,
+                benchmark_iterator_rows, benchmark_dataset_rows));
+    benchmark_register_scalars();
+    benchmark_register_container_table();
+    benchmark_register_iterator_table();
+    benchmark_register_dataset_table();
+    return SNMP_ERR_NOERROR;
+}
+
+void
+init_benchmark(void)
+{
+    snmpd_register_config_handler("benchmarkScalars",
+                                  benchmark_parse_config, NULL,
+                                  "number of scalars");
+    snmpd_register_config_handler("benchmarkContainerRows",
+                                  benchmark_parse_config, NULL,
+                                  "rows of the table_container table");
+    snmpd_register_config_handler("benchmarkIteratorRows",
+                                  benchmark_parse_config, NULL,
+                                  "rows of the table_iterator table");
+    snmpd_register_config_handler("benchmarkDatasetRows",
+                                  benchmark_parse_config, NULL,
+                                  "rows of the table_dataset table");
+    snmp_register_callback(SNMP_CALLBACK_LIBRARY,
+                           SNMP_CALLBACK_POST_READ_CONFIG,
+                           benchmark_register, NULL);
+}
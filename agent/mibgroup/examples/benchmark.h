@@ -0,0 +1,14 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void            init_benchmark(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BENCHMARK_H */
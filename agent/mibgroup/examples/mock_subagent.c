@@ -0,0 +1,230 @@
+/**  @example mock_subagent.c
+ *  This example implements a synthetic, read-only table under
+ *  netSnmpExampleTables.3 whose size and response time are set from
+ *  snmpd.conf.  It is meant for load testing the AgentX master: run it
+ *  inside a subagent (snmpd -X) and point a walker at the master.
+ *
+ *  - mockSubagentRows N      number of rows (default 100)
+ *  - mockSubagentColumns N   number of columns (default 3)
+ *  - mockSubagentDelay MSEC  answer every request MSEC milliseconds
+ *                            late, using delegated requests (default 0)
+ *
+ *  Row r, column c holds the INTEGER r * 1000 + c.  Values are computed
+ *  rather than stored, so tables with millions of rows cost nothing.
+ */
+
+#include <net-snmp/net-snmp-config.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#include <strings.h>
+#endif
+
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/agent/net-snmp-agent-includes.h>
+
+#include "mock_subagent.h"
+
+static oid      mock_table_oid[] = { 1, 3, 6, 1, 4, 1, 8072, 2, 2, 3, 1 };
+#define MOCK_ENTRY_LEN  OID_LENGTH(mock_table_oid)
+
+static u_long   mock_rows = 100;
+static u_long   mock_columns = 3;
+static u_long   mock_delay = 0;         /* milliseconds */
+
+static void
+mock_subagent_parse_config(const char *token, char *cptr)
+{
+    long            x = atol(cptr);
+
+    if (x < 0) {
+        config_perror("mock_subagent: value must not be negative");
+        return;
+    }
+    if (!strcasecmp(token, "mockSubagentRows"))
+        mock_rows = x;
+    else if (!strcasecmp(token, "mockSubagentColumns"))
+        mock_columns = x;
+    else
+        mock_delay = x;
+}
+
+void
+init_mock_subagent(void)
+{
+    netsnmp_handler_registration *reg;
+
+    reg = netsnmp_create_handler_registration("mock_subagent",
+                                              mock_subagent_handler,
+                                              mock_table_oid,
+                                              OID_LENGTH(mock_table_oid) - 1,
+                                              HANDLER_CAN_RONLY |
+                                              HANDLER_CAN_GETBULK);
+    if (!reg || netsnmp_register_handler(reg) != MIB_REGISTERED_OK) {
+        snmp_log(LOG_ERR, "mock_subagent: registration failed\n");
+        return;
+    }
+
+    snmpd_register_config_handler("mockSubagentRows",
+                                  mock_subagent_parse_config, NULL,
+                                  "number of rows");
+    snmpd_register_config_handler("mockSubagentColumns",
+                                  mock_subagent_parse_config, NULL,
+                                  "number of columns");
+    snmpd_register_config_handler("mockSubagentDelay",
+                                  mock_subagent_parse_config, NULL,
+                                  "response delay in milliseconds");
+}
+
+static void
+mock_set_value(netsnmp_variable_list *var, oid column, oid row)
+{
+    long            value = row * 1000 + column;
+
+    if (var->name_length != MOCK_ENTRY_LEN + 2 ||
+        snmp_oid_compare(var->name, MOCK_ENTRY_LEN, mock_table_oid,
+                         MOCK_ENTRY_LEN) != 0) {
+        oid             name[MAX_OID_LEN];
+
+        memcpy(name, mock_table_oid, sizeof(mock_table_oid));
+        name[MOCK_ENTRY_LEN] = column;
+        name[MOCK_ENTRY_LEN + 1] = row;
+        snmp_set_var_objid(var, name, MOCK_ENTRY_LEN + 2);
+    } else {
+        var->name[MOCK_ENTRY_LEN] = column;
+        var->name[MOCK_ENTRY_LEN + 1] = row;
+    }
+    snmp_set_var_typed_integer(var, ASN_INTEGER, value);
+}
+
+/*
+ * Work out the answer for one varbind.  For GETNEXT requests past the
+ * end of the table the varbind is left alone, so the agent moves on to
+ * the next registration.  GETBULK is answered one repetition at a time,
+ * like GETNEXT.
+ */
+static void
+mock_answer(netsnmp_agent_request_info *reqinfo,
+            netsnmp_request_info *request)
+{
+    netsnmp_variable_list *var = request->requestvb;
+    oid             column = 0, row = 0;
+    int             cmp;
+
+    cmp = snmp_oid_compare(var->name, SNMP_MIN(var->name_length,
+                                               MOCK_ENTRY_LEN),
+                           mock_table_oid, MOCK_ENTRY_LEN);
+    if (var->name_length > MOCK_ENTRY_LEN && cmp == 0)
+        column = var->name[MOCK_ENTRY_LEN];
+    if (var->name_length > MOCK_ENTRY_LEN + 1 && cmp == 0)
+        row = var->name[MOCK_ENTRY_LEN + 1];
+
+    switch (reqinfo->mode) {
+    case MODE_GET:
+        if (cmp != 0 || var->name_length != MOCK_ENTRY_LEN + 2 ||
+            column < 1 || column > mock_columns)
+            netsnmp_set_request_error(reqinfo, request, SNMP_NOSUCHOBJECT);
+        else if (row < 1 || row > mock_rows)
+            netsnmp_set_request_error(reqinfo, request,
+                                      SNMP_NOSUCHINSTANCE);
+        else
+            mock_set_value(var, column, row);
+        break;
+
+    case MODE_GETNEXT:
+    case MODE_GETBULK:
+        if (cmp > 0)
+            break;
+        if (cmp < 0 || column < 1) {
+            column = 1;
+            row = 1;
+        } else if (var->name_length == MOCK_ENTRY_LEN + 1) {
+            row = 1;
+        } else if (row < mock_rows) {
+            /*
+             * anything below an instance sorts before the next row
+             */
+            row++;
+        } else {
+            column++;
+            row = 1;
+        }
+        if (column <= mock_columns && mock_rows > 0)
+            mock_set_value(var, column, row);
+        break;
+
+    default:
+        netsnmp_set_request_error(reqinfo, request, SNMP_ERR_GENERR);
+        break;
+    }
+}
+
+static void
+mock_answer_all(netsnmp_agent_request_info *reqinfo,
+                netsnmp_request_info *requests)
+{
+    netsnmp_request_info *request;
+
+    for (request = requests; request; request = request->next) {
+        request->delegated = 0;
+        if (request->processed)
+            continue;
+        mock_answer(reqinfo, request);
+    }
+    /*
+     * the handler is registered HANDLER_CAN_GETBULK so that delayed
+     * answers still see the original mode; step to the next repetition
+     */
+    if (reqinfo->mode == MODE_GETBULK)
+        netsnmp_bulk_to_next_fix_requests(requests);
+}
+
+void
+mock_subagent_delayed_response(unsigned int clientreg, void *clientarg)
+{
+    netsnmp_delegated_cache *cache = (netsnmp_delegated_cache *) clientarg;
+
+    if (netsnmp_handler_check_cache(cache)) {
+        DEBUGMSGTL(("mock_subagent", "answering delayed request\n"));
+        mock_answer_all(cache->reqinfo, cache->requests);
+    }
+    netsnmp_free_delegated_cache(cache);
+}
+
+int
+mock_subagent_handler(netsnmp_mib_handler *handler,
+                      netsnmp_handler_registration *reginfo,
+                      netsnmp_agent_request_info *reqinfo,
+                      netsnmp_request_info *requests)
+{
+    netsnmp_delegated_cache *cache;
+    netsnmp_request_info *request;
+    struct timeval  delay;
+
+    DEBUGMSGTL(("mock_subagent", "Got request, mode = %d\n",
+                reqinfo->mode));
+
+    if (mock_delay == 0) {
+        mock_answer_all(reqinfo, requests);
+        return SNMP_ERR_NOERROR;
+    }
+
+    cache = netsnmp_create_delegated_cache(handler, reginfo, reqinfo,
+                                           requests, NULL);
+    if (!cache) {
+        netsnmp_set_request_error(reqinfo, requests,
+                                  SNMP_ERR_RESOURCEUNAVAILABLE);
+        return SNMP_ERR_NOERROR;
+    }
+    for (request = requests; request; request = request->next)
+        request->delegated = 1;
+
+    delay.tv_sec = mock_delay / 1000;
+    delay.tv_usec = (mock_delay % 1000) * 1000;
+    snmp_alarm_register_hr(delay, 0, mock_subagent_delayed_response, cache);
+
+    return SNMP_ERR_NOERROR;
+}
@@ -0,0 +1,16 @@
+#ifndef MOCK_SUBAGENT_H
+#define MOCK_SUBAGENT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+Netsnmp_Node_Handler mock_subagent_handler;
+void            init_mock_subagent(void);
+SNMPAlarmCallback mock_subagent_delayed_response;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MOCK_SUBAGENT_H */
@@ -15,15 +15,11 @@
 #include <net-snmp/agent/ds_agent.h>
 #include <net-snmp/agent/instance.h>
 #include <net-snmp/agent/table.h>
-#include <net-snmp/agent/table_data.h>
-#include <net-snmp/agent/table_dataset.h>
 #include "net-snmp/agent/sysORTable.h"
 #include "notification_log.h"
 
 netsnmp_feature_require(register_ulong_instance_context);
 netsnmp_feature_require(register_read_only_counter32_instance_context);
-netsnmp_feature_require(delete_table_data_set);
-netsnmp_feature_require(table_dataset);
 netsnmp_feature_require(date_n_time);
 
 /*
@@ -62,68 +58,75 @@ static u_long   num_deleted = 0;
 static u_long   max_logged = 1000;      /* goes against the mib default of infinite */
 static u_long   max_age = 1440; /* 1440 = 24 hours, which is the mib default */
 
-static netsnmp_table_data_set *nlmLogTable;
-static netsnmp_table_data_set *nlmLogVarTable;
-
 static oid nlm_module_oid[] = { SNMP_OID_MIB2, 92 }; /* NOTIFICATION-LOG-MIB::notificationLogMIB */
 
+/*
+ * Logged notifications are kept in a ring of records, oldest first.
+ * Each record is a single allocation holding the nlmLogTable columns
+ * and the notification's varbinds (the nlmLogVariableTable rows).
+ * nlmLogIndex values are consecutive, so the record for an index is
+ * found by its distance from the oldest one, and ageing or bumping the
+ * oldest notification frees a single record.
+ */
+typedef struct nlm_log_var_s {
+    const oid      *name;
+    size_t          name_len;
+    const u_char   *val;
+    size_t          val_len;
+    u_char          type;
+} nlm_log_var;
+
+typedef struct nlm_log_entry_s {
+    u_long          index;          /* nlmLogIndex */
+    u_long          time;           /* nlmLogTime */
+    u_char          date[11];       /* nlmLogDateAndTime */
+    size_t          date_len;
+    const u_char   *engineid;
+    size_t          engineid_len;
+    const u_char   *taddress;       /* NULL if not known */
+    size_t          taddress_len;
+    const oid      *tdomain;        /* NULL if not known */
+    size_t          tdomain_len;
+    const u_char   *context_engineid;
+    size_t          context_engineid_len;
+    const u_char   *context_name;
+    size_t          context_name_len;
+    const oid      *notification_id;        /* NULL if not known */
+    size_t          notification_id_len;
+    size_t          var_count;
+    nlm_log_var     vars[1];
+} nlm_log_entry;
+
+#define NLM_LOG_ALIGN(n) (((n) + sizeof(long) - 1) & ~(sizeof(long) - 1))
+
+static int      nlm_log_registered;
+static nlm_log_entry **nlm_log_ring;
+static size_t   nlm_log_ring_size;
+static size_t   nlm_log_head;           /* slot of the oldest entry */
+static size_t   nlm_log_count;
+
+/* nlmLogName, as an index: only the default log is supported */
+static const oid nlm_log_name[] = { 7, 'd', 'e', 'f', 'a', 'u', 'l', 't' };
+#define NLM_LOG_NAME_LEN OID_LENGTH(nlm_log_name)
+
+static nlm_log_entry *
+nlm_log_get(size_t pos)
+{
+    return nlm_log_ring[(nlm_log_head + pos) % nlm_log_ring_size];
+}
+
 static void
 netsnmp_notif_log_remove_oldest(int count)
 {
-    netsnmp_table_row *deleterow, *tmprow, *deletevarrow;
-    
     DEBUGMSGTL(("notification_log", "deleting %d log entry(s)\n", count));
 
-    deleterow = netsnmp_table_data_set_get_first_row(nlmLogTable);
-    for (; count && deleterow; deleterow = tmprow, --count) {
-        /*
-         * delete contained varbinds
-         * xxx-rks: note that this assumes that only the default
-         * log is used (ie for the first nlmLogTable row, the
-         * first nlmLogVarTable rows will be the right ones).
-         * the right thing to do would be to do a find based on
-         * the nlmLogTable oid.
-         */
-        DEBUGMSGTL(("9:notification_log", "  deleting notification\n"));
-        DEBUGIF("9:notification_log") {
-            DEBUGMSGTL(("9:notification_log",
-                        " base oid:"));
-            DEBUGMSGOID(("9:notification_log", deleterow->index_oid,
-                         deleterow->index_oid_len));
-            DEBUGMSG(("9:notification_log", "\n"));
-        }
-        deletevarrow = netsnmp_table_data_set_get_first_row(nlmLogVarTable);
-        for (; deletevarrow; deletevarrow = tmprow) {
-
-            tmprow = netsnmp_table_data_set_get_next_row(nlmLogVarTable,
-                                                          deletevarrow);
-            
-            DEBUGIF("9:notification_log") {
-                DEBUGMSGTL(("9:notification_log",
-                            "         :"));
-                DEBUGMSGOID(("9:notification_log", deletevarrow->index_oid,
-                             deletevarrow->index_oid_len));
-                DEBUGMSG(("9:notification_log", "\n"));
-            }
-            if ((deleterow->index_oid_len == deletevarrow->index_oid_len - 1) &&
-                snmp_oid_compare(deleterow->index_oid,
-                                 deleterow->index_oid_len,
-                                 deletevarrow->index_oid,
-                                 deleterow->index_oid_len) == 0) {
-                DEBUGMSGTL(("9:notification_log", "    deleting varbind\n"));
-                netsnmp_table_dataset_remove_and_delete_row(nlmLogVarTable,
-                                                             deletevarrow);
-            }
-            else
-                break;
-        }
-        
-        /*
-         * delete the master row 
-         */
-        tmprow = netsnmp_table_data_set_get_next_row(nlmLogTable, deleterow);
-        netsnmp_table_dataset_remove_and_delete_row(nlmLogTable,
-                                                     deleterow);
+    for (; count && nlm_log_count; --count) {
+        DEBUGMSGTL(("9:notification_log", "  deleting notification %lu\n",
+                    nlm_log_ring[nlm_log_head]->index));
+        free(nlm_log_ring[nlm_log_head]);
+        nlm_log_ring[nlm_log_head] = NULL;
+        nlm_log_head = (nlm_log_head + 1) % nlm_log_ring_size;
+        --nlm_log_count;
         num_deleted++;
     }
     /** should have deleted all of them */
@@ -133,27 +136,19 @@ netsnmp_notif_log_remove_oldest(int count)
 static void
 check_log_size(unsigned int clientreg, void *clientarg)
 {
-    netsnmp_table_row *row;
-    netsnmp_table_data_set_storage *data;
     u_long          count = 0;
     u_long          uptime;
 
     uptime = netsnmp_get_agent_uptime();
 
-    if (!nlmLogTable || !nlmLogTable->table )  {
-        DEBUGMSGTL(("notification_log", "missing log table\n"));
-        return;
-    }
-
     /*
      * check max allowed count
      */
-    count = netsnmp_table_set_num_rows(nlmLogTable);
     DEBUGMSGTL(("notification_log",
                 "logged notifications %lu; max %lu\n",
-                    count, max_logged));
-    if (count > max_logged) {
-        count = count - max_logged;
+                    (u_long)nlm_log_count, max_logged));
+    if (nlm_log_count > max_logged) {
+        count = nlm_log_count - max_logged;
         DEBUGMSGTL(("notification_log", "removing %lu extra notifications\n",
                     count));
         netsnmp_notif_log_remove_oldest(count);
@@ -164,18 +159,9 @@ check_log_size(unsigned int clientreg, void *clientarg)
      */
     if (0 == max_age)
         return;
-    count = 0;
-    for (row = netsnmp_table_data_set_get_first_row(nlmLogTable);
-         row;
-         row = netsnmp_table_data_set_get_next_row(nlmLogTable, row)) {
-
-        data = (netsnmp_table_data_set_storage *) row->data;
-        data = netsnmp_table_data_set_find_column(data, COLUMN_NLMLOGTIME);
-
-        if (uptime < ((u_long)(*(data->data.integer) + max_age * 100 * 60)))
+    for (count = 0; count < nlm_log_count; ++count)
+        if (uptime < nlm_log_get(count)->time + max_age * 100 * 60)
             break;
-        ++count;
-    }
 
     if (count) {
         DEBUGMSGTL(("notification_log", "removing %lu expired notifications\n",
@@ -184,277 +170,366 @@ check_log_size(unsigned int clientreg, void *clientarg)
     }
 }
 
-
-/** Initialize the nlmLogVariableTable table by defining its contents and how it's structured */
+/*
+ * Append an entry, bumping the oldest one if the log is full.
+ */
 static void
-initialize_table_nlmLogVariableTable(const char * context)
+nlm_log_append(nlm_log_entry *entry)
 {
-    static oid      nlmLogVariableTable_oid[] =
-        { 1, 3, 6, 1, 2, 1, 92, 1, 3, 2 };
-    size_t          nlmLogVariableTable_oid_len =
-        OID_LENGTH(nlmLogVariableTable_oid);
-    netsnmp_table_data_set *table_set;
-    netsnmp_handler_registration *reginfo;
+    nlm_log_entry **ring;
+    size_t          size, i;
 
-    /*
-     * create the table structure itself 
-     */
-    table_set = netsnmp_create_table_data_set("nlmLogVariableTable");
-    nlmLogVarTable = table_set;
-    nlmLogVarTable->table->store_indexes = 1;
+    if (0 == max_logged) {
+        free(entry);
+        num_deleted++;
+        return;
+    }
+    if (nlm_log_count >= max_logged)
+        netsnmp_notif_log_remove_oldest(nlm_log_count - max_logged + 1);
 
-    /***************************************************
-     * Adding indexes
-     */
-    /*
-     * declaring the nlmLogName index
-     */
-    DEBUGMSGTL(("initialize_table_nlmLogVariableTable",
-                "adding index nlmLogName of type ASN_OCTET_STR to table nlmLogVariableTable\n"));
-    netsnmp_table_dataset_add_index(table_set, ASN_OCTET_STR);
-    /*
-     * declaring the nlmLogIndex index
-     */
-    DEBUGMSGTL(("initialize_table_nlmLogVariableTable",
-                "adding index nlmLogIndex of type ASN_UNSIGNED to table nlmLogVariableTable\n"));
-    netsnmp_table_dataset_add_index(table_set, ASN_UNSIGNED);
-    /*
-     * declaring the nlmLogVariableIndex index
-     */
-    DEBUGMSGTL(("initialize_table_nlmLogVariableTable",
-                "adding index nlmLogVariableIndex of type ASN_UNSIGNED to table nlmLogVariableTable\n"));
-    netsnmp_table_dataset_add_index(table_set, ASN_UNSIGNED);
+    if (nlm_log_count == nlm_log_ring_size) {
+        /*
+         * grow up to the entry limit; the ring is linearized on the way
+         */
+        size = nlm_log_ring_size ? 2 * nlm_log_ring_size : 16;
+        if (size > max_logged)
+            size = max_logged;
+        ring = calloc(size, sizeof(*ring));
+        if (NULL == ring) {
+            snmp_log(LOG_ERR, "notification_log: out of memory\n");
+            free(entry);
+            num_deleted++;
+            return;
+        }
+        for (i = 0; i < nlm_log_count; i++)
+            ring[i] = nlm_log_get(i);
+        free(nlm_log_ring);
+        nlm_log_ring = ring;
+        nlm_log_ring_size = size;
+        nlm_log_head = 0;
+    }
+    nlm_log_ring[(nlm_log_head + nlm_log_count) % nlm_log_ring_size] = entry;
+    ++nlm_log_count;
+}
 
-    /*
-     * adding column nlmLogVariableID of type ASN_OBJECT_ID and access of
-     * ReadOnly 
-     */
-    DEBUGMSGTL(("initialize_table_nlmLogVariableTable",
-                "adding column nlmLogVariableID (#2) of type ASN_OBJECT_ID to table nlmLogVariableTable\n"));
-    netsnmp_table_set_add_default_row(table_set, COLUMN_NLMLOGVARIABLEID,
-                                      ASN_OBJECT_ID, 0, NULL, 0);
-    /*
-     * adding column nlmLogVariableValueType of type ASN_INTEGER and
-     * access of ReadOnly 
-     */
-    DEBUGMSGTL(("initialize_table_nlmLogVariableTable",
-                "adding column nlmLogVariableValueType (#3) of type ASN_INTEGER to table nlmLogVariableTable\n"));
-    netsnmp_table_set_add_default_row(table_set,
-                                      COLUMN_NLMLOGVARIABLEVALUETYPE,
-                                      ASN_INTEGER, 0, NULL, 0);
-    /*
-     * adding column nlmLogVariableCounter32Val of type ASN_COUNTER and
-     * access of ReadOnly 
-     */
-    DEBUGMSGTL(("initialize_table_nlmLogVariableTable",
-                "adding column nlmLogVariableCounter32Val (#4) of type ASN_COUNTER to table nlmLogVariableTable\n"));
-    netsnmp_table_set_add_default_row(table_set,
-                                      COLUMN_NLMLOGVARIABLECOUNTER32VAL,
-                                      ASN_COUNTER, 0, NULL, 0);
-    /*
-     * adding column nlmLogVariableUnsigned32Val of type ASN_UNSIGNED and
-     * access of ReadOnly 
-     */
-    DEBUGMSGTL(("initialize_table_nlmLogVariableTable",
-                "adding column nlmLogVariableUnsigned32Val (#5) of type ASN_UNSIGNED to table nlmLogVariableTable\n"));
-    netsnmp_table_set_add_default_row(table_set,
-                                      COLUMN_NLMLOGVARIABLEUNSIGNED32VAL,
-                                      ASN_UNSIGNED, 0, NULL, 0);
-    /*
-     * adding column nlmLogVariableTimeTicksVal of type ASN_TIMETICKS and
-     * access of ReadOnly 
-     */
-    DEBUGMSGTL(("initialize_table_nlmLogVariableTable",
-                "adding column nlmLogVariableTimeTicksVal (#6) of type ASN_TIMETICKS to table nlmLogVariableTable\n"));
-    netsnmp_table_set_add_default_row(table_set,
-                                      COLUMN_NLMLOGVARIABLETIMETICKSVAL,
-                                      ASN_TIMETICKS, 0, NULL, 0);
-    /*
-     * adding column nlmLogVariableInteger32Val of type ASN_INTEGER and
-     * access of ReadOnly 
-     */
-    DEBUGMSGTL(("initialize_table_nlmLogVariableTable",
-                "adding column nlmLogVariableInteger32Val (#7) of type ASN_INTEGER to table nlmLogVariableTable\n"));
-    netsnmp_table_set_add_default_row(table_set,
-                                      COLUMN_NLMLOGVARIABLEINTEGER32VAL,
-                                      ASN_INTEGER, 0, NULL, 0);
-    /*
-     * adding column nlmLogVariableOctetStringVal of type ASN_OCTET_STR
-     * and access of ReadOnly 
-     */
-    DEBUGMSGTL(("initialize_table_nlmLogVariableTable",
-                "adding column nlmLogVariableOctetStringVal (#8) of type ASN_OCTET_STR to table nlmLogVariableTable\n"));
-    netsnmp_table_set_add_default_row(table_set,
-                                      COLUMN_NLMLOGVARIABLEOCTETSTRINGVAL,
-                                      ASN_OCTET_STR, 0, NULL, 0);
-    /*
-     * adding column nlmLogVariableIpAddressVal of type ASN_IPADDRESS and
-     * access of ReadOnly 
-     */
-    DEBUGMSGTL(("initialize_table_nlmLogVariableTable",
-                "adding column nlmLogVariableIpAddressVal (#9) of type ASN_IPADDRESS to table nlmLogVariableTable\n"));
-    netsnmp_table_set_add_default_row(table_set,
-                                      COLUMN_NLMLOGVARIABLEIPADDRESSVAL,
-                                      ASN_IPADDRESS, 0, NULL, 0);
-    /*
-     * adding column nlmLogVariableOidVal of type ASN_OBJECT_ID and access 
-     * of ReadOnly 
-     */
-    DEBUGMSGTL(("initialize_table_nlmLogVariableTable",
-                "adding column nlmLogVariableOidVal (#10) of type ASN_OBJECT_ID to table nlmLogVariableTable\n"));
-    netsnmp_table_set_add_default_row(table_set,
-                                      COLUMN_NLMLOGVARIABLEOIDVAL,
-                                      ASN_OBJECT_ID, 0, NULL, 0);
-    /*
-     * adding column nlmLogVariableCounter64Val of type ASN_COUNTER64 and
-     * access of ReadOnly 
-     */
-    DEBUGMSGTL(("initialize_table_nlmLogVariableTable",
-                "adding column nlmLogVariableCounter64Val (#11) of type ASN_COUNTER64 to table nlmLogVariableTable\n"));
-    netsnmp_table_set_add_default_row(table_set,
-                                      COLUMN_NLMLOGVARIABLECOUNTER64VAL,
-                                      ASN_COUNTER64, 0, NULL, 0);
-    /*
-     * adding column nlmLogVariableOpaqueVal of type ASN_OPAQUE and access 
-     * of ReadOnly 
-     */
-    DEBUGMSGTL(("initialize_table_nlmLogVariableTable",
-                "adding column nlmLogVariableOpaqueVal (#12) of type ASN_OPAQUE to table nlmLogVariableTable\n"));
-    netsnmp_table_set_add_default_row(table_set,
-                                      COLUMN_NLMLOGVARIABLEOPAQUEVAL,
-                                      ASN_OPAQUE, 0, NULL, 0);
+/*
+ * Find the position in the ring of the entry for index_oid (a GET), or
+ * of the first entry with an index greater than index_oid (a GETNEXT;
+ * *var is then the first variable following index_oid).  For the
+ * nlmLogVariableTable, *var is the 1-based nlmLogVariableIndex, which
+ * is checked against the entry.  Returns nlm_log_count if there is no
+ * such entry.
+ */
+static size_t
+nlm_log_find(const oid *index_oid, size_t index_oid_len, int exact,
+             int is_var_table, size_t *var)
+{
+    size_t          pos, name_len, idx_len = is_var_table ? 2 : 1;
+    u_long          first;
+    int             rc;
+
+    *var = 1;
+    if (0 == nlm_log_count)
+        return 0;
+    first = nlm_log_get(0)->index;
+
+    if (exact) {
+        if (index_oid_len != NLM_LOG_NAME_LEN + idx_len ||
+            snmp_oid_compare(index_oid, NLM_LOG_NAME_LEN,
+                             nlm_log_name, NLM_LOG_NAME_LEN) != 0 ||
+            index_oid[NLM_LOG_NAME_LEN] < first ||
+            index_oid[NLM_LOG_NAME_LEN] - first >= nlm_log_count)
+            return nlm_log_count;
+        pos = index_oid[NLM_LOG_NAME_LEN] - first;
+        if (is_var_table) {
+            *var = index_oid[NLM_LOG_NAME_LEN + 1];
+            if (*var < 1 || *var > nlm_log_get(pos)->var_count)
+                return nlm_log_count;
+        }
+        return pos;
+    }
 
-    /*
-     * registering the table with the master agent 
-     */
-    /*
-     * note: if you don't need a subhandler to deal with any aspects of
-     * the request, change nlmLogVariableTable_handler to "NULL" 
-     */
-    reginfo =
-        netsnmp_create_handler_registration ("nlmLogVariableTable",
-                                             NULL,
-                                             nlmLogVariableTable_oid,
-                                             nlmLogVariableTable_oid_len,
-                                             HANDLER_CAN_RWRITE);
-    if (NULL != context)
-        reginfo->contextName = strdup(context);
-    netsnmp_register_table_data_set(reginfo, table_set, NULL);
+    name_len = SNMP_MIN(index_oid_len, NLM_LOG_NAME_LEN);
+    rc = snmp_oid_compare(index_oid, name_len, nlm_log_name, name_len);
+    if (rc > 0)
+        return nlm_log_count;
+    if (rc < 0 || index_oid_len <= NLM_LOG_NAME_LEN)
+        return 0;
+
+    if (index_oid[NLM_LOG_NAME_LEN] < first)
+        return 0;
+    pos = index_oid[NLM_LOG_NAME_LEN] - first;
+    if (pos >= nlm_log_count)
+        return nlm_log_count;
+    if (!is_var_table)
+        return pos + 1;
+
+    if (index_oid_len > NLM_LOG_NAME_LEN + 1)
+        *var = index_oid[NLM_LOG_NAME_LEN + 1] + 1;
+    if (*var == 0 || *var > nlm_log_get(pos)->var_count) {
+        *var = 1;
+        ++pos;
+    }
+    return pos;
 }
 
-/** Initialize the nlmLogTable table by defining its contents and how it's structured */
-static void
-initialize_table_nlmLogTable(const char * context)
+/*
+ * Set request to the column of an nlmLogTable entry.  Returns 0 if the
+ * entry has no value for the column.
+ */
+static int
+nlm_log_set_column(netsnmp_variable_list *var, const nlm_log_entry *entry,
+                   int column)
 {
-    static oid      nlmLogTable_oid[] = { 1, 3, 6, 1, 2, 1, 92, 1, 3, 1 };
-    size_t          nlmLogTable_oid_len = OID_LENGTH(nlmLogTable_oid);
-    netsnmp_handler_registration *reginfo;
+    switch (column) {
+    case COLUMN_NLMLOGTIME:
+        snmp_set_var_typed_integer(var, ASN_TIMETICKS, entry->time);
+        break;
+    case COLUMN_NLMLOGDATEANDTIME:
+        snmp_set_var_typed_value(var, ASN_OCTET_STR, entry->date,
+                                 entry->date_len);
+        break;
+    case COLUMN_NLMLOGENGINEID:
+        snmp_set_var_typed_value(var, ASN_OCTET_STR, entry->engineid,
+                                 entry->engineid_len);
+        break;
+    case COLUMN_NLMLOGENGINETADDRESS:
+        if (NULL == entry->taddress)
+            return 0;
+        snmp_set_var_typed_value(var, ASN_OCTET_STR, entry->taddress,
+                                 entry->taddress_len);
+        break;
+    case COLUMN_NLMLOGENGINETDOMAIN:
+        if (NULL == entry->tdomain)
+            return 0;
+        snmp_set_var_typed_value(var, ASN_OBJECT_ID,
+                                 (const u_char *) entry->tdomain,
+                                 entry->tdomain_len * sizeof(oid));
+        break;
+    case COLUMN_NLMLOGCONTEXTENGINEID:
+        snmp_set_var_typed_value(var, ASN_OCTET_STR,
+                                 entry->context_engineid,
+                                 entry->context_engineid_len);
+        break;
+    case COLUMN_NLMLOGCONTEXTNAME:
+        snmp_set_var_typed_value(var, ASN_OCTET_STR, entry->context_name,
+                                 entry->context_name_len);
+        break;
+    case COLUMN_NLMLOGNOTIFICATIONID:
+        if (NULL == entry->notification_id)
+            return 0;
+        snmp_set_var_typed_value(var, ASN_OBJECT_ID,
+                                 (const u_char *) entry->notification_id,
+                                 entry->notification_id_len * sizeof(oid));
+        break;
+    default:
+        return 0;
+    }
+    return 1;
+}
 
-    /*
-     * create the table structure itself 
-     */
-    nlmLogTable = netsnmp_create_table_data_set("nlmLogTable");
+/*
+ * Map a varbind type to its nlmLogVariableValueType and value column.
+ * Returns 0 for types the MIB cannot represent.
+ */
+static int
+nlm_log_var_type(u_char type, u_long *value_type)
+{
+    switch (type) {
+    case ASN_COUNTER:
+        *value_type = 1;
+        return COLUMN_NLMLOGVARIABLECOUNTER32VAL;
+    case ASN_UNSIGNED:
+        *value_type = 2;
+        return COLUMN_NLMLOGVARIABLEUNSIGNED32VAL;
+    case ASN_TIMETICKS:
+        *value_type = 3;
+        return COLUMN_NLMLOGVARIABLETIMETICKSVAL;
+    case ASN_INTEGER:
+        *value_type = 4;
+        return COLUMN_NLMLOGVARIABLEINTEGER32VAL;
+    case ASN_IPADDRESS:
+        *value_type = 5;
+        return COLUMN_NLMLOGVARIABLEIPADDRESSVAL;
+    case ASN_OCTET_STR:
+        *value_type = 6;
+        return COLUMN_NLMLOGVARIABLEOCTETSTRINGVAL;
+    case ASN_OBJECT_ID:
+        *value_type = 7;
+        return COLUMN_NLMLOGVARIABLEOIDVAL;
+    case ASN_COUNTER64:
+        *value_type = 8;
+        return COLUMN_NLMLOGVARIABLECOUNTER64VAL;
+    case ASN_OPAQUE:
+        *value_type = 9;
+        return COLUMN_NLMLOGVARIABLEOPAQUEVAL;
+    default:
+        return 0;
+    }
+}
 
-    /***************************************************
-     * Adding indexes
-     */
-    /*
-     * declaring the nlmLogIndex index
-     */
-    DEBUGMSGTL(("initialize_table_nlmLogTable",
-                "adding index nlmLogName of type ASN_OCTET_STR to table nlmLogTable\n"));
-    netsnmp_table_dataset_add_index(nlmLogTable, ASN_OCTET_STR);
+/*
+ * Set request to the column of an nlmLogVariableTable entry.  Returns 0
+ * if the entry has no value for the column.
+ */
+static int
+nlm_log_var_set_column(netsnmp_variable_list *var, const nlm_log_var *lv,
+                       int column)
+{
+    u_long          value_type;
+    int             value_column = nlm_log_var_type(lv->type, &value_type);
+
+    switch (column) {
+    case COLUMN_NLMLOGVARIABLEID:
+        snmp_set_var_typed_value(var, ASN_OBJECT_ID,
+                                 (const u_char *) lv->name,
+                                 lv->name_len * sizeof(oid));
+        break;
+    case COLUMN_NLMLOGVARIABLEVALUETYPE:
+        snmp_set_var_typed_integer(var, ASN_INTEGER, value_type);
+        break;
+    default:
+        if (column != value_column)
+            return 0;
+        snmp_set_var_typed_value(var, lv->type, lv->val, lv->val_len);
+        break;
+    }
+    return 1;
+}
 
-    DEBUGMSGTL(("initialize_table_nlmLogTable",
-                "adding index nlmLogIndex of type ASN_UNSIGNED to table nlmLogTable\n"));
-    netsnmp_table_dataset_add_index(nlmLogTable, ASN_UNSIGNED);
+/** handles requests for the nlmLogTable and nlmLogVariableTable */
+static int
+nlm_log_table_handler(netsnmp_mib_handler *handler,
+                      netsnmp_handler_registration *reginfo,
+                      netsnmp_agent_request_info *reqinfo,
+                      netsnmp_request_info *requests)
+{
+    /* nlmLogTable is table.1, nlmLogVariableTable is table.2 */
+    int             is_var_table =
+        (2 == reginfo->rootoid[reginfo->rootoid_len - 1]);
+    netsnmp_request_info *request;
+    netsnmp_table_request_info *tinfo;
+    const nlm_log_entry *entry;
+    size_t          pos, var;
+    oid             name[MAX_OID_LEN];
+    size_t          name_len;
+    int             found;
+
+    if (reqinfo->mode != MODE_GET && reqinfo->mode != MODE_GETNEXT)
+        return SNMP_ERR_NOERROR;
+
+    for (request = requests; request; request = request->next) {
+        if (request->processed)
+            continue;
+        tinfo = netsnmp_extract_table_info(request);
+        if (NULL == tinfo)
+            continue;
+
+        pos = nlm_log_find(tinfo->index_oid, tinfo->index_oid_len,
+                           reqinfo->mode == MODE_GET, is_var_table, &var);
+        for (found = 0; !found && pos < nlm_log_count; ) {
+            entry = nlm_log_get(pos);
+            if (is_var_table && var > entry->var_count)
+                found = 0;
+            else if (is_var_table)
+                found = nlm_log_var_set_column(request->requestvb,
+                                               &entry->vars[var - 1],
+                                               tinfo->colnum);
+            else
+                found = nlm_log_set_column(request->requestvb, entry,
+                                           tinfo->colnum);
+            if (found || reqinfo->mode == MODE_GET)
+                break;
+            if (is_var_table && var < entry->var_count)
+                ++var;
+            else {
+                var = 1;
+                ++pos;
+            }
+        }
 
-    /*
-     * adding column nlmLogTime of type ASN_TIMETICKS and access of
-     * ReadOnly 
-     */
-    DEBUGMSGTL(("initialize_table_nlmLogTable",
-                "adding column nlmLogTime (#2) of type ASN_TIMETICKS to table nlmLogTable\n"));
-    netsnmp_table_set_add_default_row(nlmLogTable, COLUMN_NLMLOGTIME,
-                                      ASN_TIMETICKS, 0, NULL, 0);
-    /*
-     * adding column nlmLogDateAndTime of type ASN_OCTET_STR and access of 
-     * ReadOnly 
-     */
-    DEBUGMSGTL(("initialize_table_nlmLogTable",
-                "adding column nlmLogDateAndTime (#3) of type ASN_OCTET_STR to table nlmLogTable\n"));
-    netsnmp_table_set_add_default_row(nlmLogTable,
-                                      COLUMN_NLMLOGDATEANDTIME,
-                                      ASN_OCTET_STR, 0, NULL, 0);
-    /*
-     * adding column nlmLogEngineID of type ASN_OCTET_STR and access of
-     * ReadOnly 
-     */
-    DEBUGMSGTL(("initialize_table_nlmLogTable",
-                "adding column nlmLogEngineID (#4) of type ASN_OCTET_STR to table nlmLogTable\n"));
-    netsnmp_table_set_add_default_row(nlmLogTable, COLUMN_NLMLOGENGINEID,
-                                      ASN_OCTET_STR, 0, NULL, 0);
-    /*
-     * adding column nlmLogEngineTAddress of type ASN_OCTET_STR and access 
-     * of ReadOnly 
-     */
-    DEBUGMSGTL(("initialize_table_nlmLogTable",
-                "adding column nlmLogEngineTAddress (#5) of type ASN_OCTET_STR to table nlmLogTable\n"));
-    netsnmp_table_set_add_default_row(nlmLogTable,
-                                      COLUMN_NLMLOGENGINETADDRESS,
-                                      ASN_OCTET_STR, 0, NULL, 0);
-    /*
-     * adding column nlmLogEngineTDomain of type ASN_OBJECT_ID and access
-     * of ReadOnly 
-     */
-    DEBUGMSGTL(("initialize_table_nlmLogTable",
-                "adding column nlmLogEngineTDomain (#6) of type ASN_OBJECT_ID to table nlmLogTable\n"));
-    netsnmp_table_set_add_default_row(nlmLogTable,
-                                      COLUMN_NLMLOGENGINETDOMAIN,
-                                      ASN_OBJECT_ID, 0, NULL, 0);
-    /*
-     * adding column nlmLogContextEngineID of type ASN_OCTET_STR and
-     * access of ReadOnly 
-     */
-    DEBUGMSGTL(("initialize_table_nlmLogTable",
-                "adding column nlmLogContextEngineID (#7) of type ASN_OCTET_STR to table nlmLogTable\n"));
-    netsnmp_table_set_add_default_row(nlmLogTable,
-                                      COLUMN_NLMLOGCONTEXTENGINEID,
-                                      ASN_OCTET_STR, 0, NULL, 0);
-    /*
-     * adding column nlmLogContextName of type ASN_OCTET_STR and access of 
-     * ReadOnly 
-     */
-    DEBUGMSGTL(("initialize_table_nlmLogTable",
-                "adding column nlmLogContextName (#8) of type ASN_OCTET_STR to table nlmLogTable\n"));
-    netsnmp_table_set_add_default_row(nlmLogTable,
-                                      COLUMN_NLMLOGCONTEXTNAME,
-                                      ASN_OCTET_STR, 0, NULL, 0);
-    /*
-     * adding column nlmLogNotificationID of type ASN_OBJECT_ID and access 
-     * of ReadOnly 
-     */
-    DEBUGMSGTL(("initialize_table_nlmLogTable",
-                "adding column nlmLogNotificationID (#9) of type ASN_OBJECT_ID to table nlmLogTable\n"));
-    netsnmp_table_set_add_default_row(nlmLogTable,
-                                      COLUMN_NLMLOGNOTIFICATIONID,
-                                      ASN_OBJECT_ID, 0, NULL, 0);
+        if (!found) {
+            netsnmp_set_request_error(reqinfo, request,
+                                      (reqinfo->mode == MODE_GET) ?
+                                      SNMP_NOSUCHINSTANCE :
+                                      SNMP_NOSUCHOBJECT);
+            continue;
+        }
+        if (reqinfo->mode == MODE_GETNEXT) {
+            /*
+             * table.entry.column.nlmLogName.nlmLogIndex[.nlmLogVariableIndex]
+             */
+            memcpy(name, reginfo->rootoid, reginfo->rootoid_len * sizeof(oid));
+            name_len = reginfo->rootoid_len;
+            name[name_len++] = 1;
+            name[name_len++] = tinfo->colnum;
+            memcpy(name + name_len, nlm_log_name, sizeof(nlm_log_name));
+            name_len += NLM_LOG_NAME_LEN;
+            name[name_len++] = entry->index;
+            if (is_var_table)
+                name[name_len++] = var;
+            snmp_set_var_objid(request->requestvb, name, name_len);
+        }
+    }
+    return SNMP_ERR_NOERROR;
+}
 
-    /*
-     * registering the table with the master agent 
-     */
-    /*
-     * note: if you don't need a subhandler to deal with any aspects of
-     * the request, change nlmLogTable_handler to "NULL" 
-     */
-    reginfo =
-        netsnmp_create_handler_registration("nlmLogTable", NULL,
-                                            nlmLogTable_oid,
-                                            nlmLogTable_oid_len,
-                                            HANDLER_CAN_RWRITE);
+static void
+nlm_log_register_table(const char *name, const oid *table_oid,
+                       size_t table_oid_len, int is_var_table,
+                       unsigned int max_column, const char *context)
+{
+    netsnmp_handler_registration *reginfo;
+    netsnmp_table_registration_info *table_info;
+
+    reginfo = netsnmp_create_handler_registration(name,
+                                                  nlm_log_table_handler,
+                                                  table_oid, table_oid_len,
+                                                  HANDLER_CAN_RONLY);
+    table_info = SNMP_MALLOC_TYPEDEF(netsnmp_table_registration_info);
+    if (!reginfo || !table_info) {
+        snmp_log(LOG_ERR, "notification_log: failed to register %s\n",
+                 name);
+        netsnmp_handler_registration_free(reginfo);
+        SNMP_FREE(table_info);
+        return;
+    }
     if (NULL != context)
         reginfo->contextName = strdup(context);
-    netsnmp_register_table_data_set(reginfo, nlmLogTable, NULL);
+
+    if (is_var_table)
+        netsnmp_table_helper_add_indexes(table_info, ASN_OCTET_STR,
+                                         ASN_UNSIGNED, ASN_UNSIGNED, 0);
+    else
+        netsnmp_table_helper_add_indexes(table_info, ASN_OCTET_STR,
+                                         ASN_UNSIGNED, 0);
+    table_info->min_column = 2;
+    table_info->max_column = max_column;
+
+    netsnmp_register_table(reginfo, table_info);
+}
+
+/** Initialize the nlmLogVariableTable table */
+static void
+initialize_table_nlmLogVariableTable(const char * context)
+{
+    static oid      nlmLogVariableTable_oid[] =
+        { 1, 3, 6, 1, 2, 1, 92, 1, 3, 2 };
+
+    nlm_log_register_table("nlmLogVariableTable", nlmLogVariableTable_oid,
+                           OID_LENGTH(nlmLogVariableTable_oid), 1,
+                           COLUMN_NLMLOGVARIABLEOPAQUEVAL, context);
+}
+
+/** Initialize the nlmLogTable table */
+static void
+initialize_table_nlmLogTable(const char * context)
+{
+    static oid      nlmLogTable_oid[] = { 1, 3, 6, 1, 2, 1, 92, 1, 3, 1 };
+
+    nlm_log_register_table("nlmLogTable", nlmLogTable_oid,
+                           OID_LENGTH(nlmLogTable_oid), 0,
+                           COLUMN_NLMLOGNOTIFICATIONID, context);
 
     /*
      * hmm...  5 minutes seems like a reasonable time to check for out
@@ -537,6 +612,7 @@ init_notification_log(void)
      */
     initialize_table_nlmLogVariableTable(context);
     initialize_table_nlmLogTable(context);
+    nlm_log_registered = 1;
 
     /*
      * disable flag 
@@ -566,67 +642,52 @@ init_notification_log(void)
 void
 shutdown_notification_log(void)
 {
-    max_logged = 0;
-    check_log_size(0, NULL);
-    netsnmp_delete_table_data_set(nlmLogTable);
-    nlmLogTable = NULL;
+    nlm_log_registered = 0;
+    netsnmp_notif_log_remove_oldest(nlm_log_count);
+    SNMP_FREE(nlm_log_ring);
+    nlm_log_ring_size = 0;
+    nlm_log_head = 0;
 
     UNREGISTER_SYSOR_ENTRY(nlm_module_oid);
 }
 
+static const void *
+nlm_log_copy(u_char **cp, const void *data, size_t len)
+{
+    const void     *copy = *cp;
+
+    if (len)
+        memcpy(*cp, data, len);
+    *cp += NLM_LOG_ALIGN(len);
+    return copy;
+}
+
 void
 log_notification(netsnmp_pdu *pdu, netsnmp_transport *transport)
 {
-    long            tmpl;
-    netsnmp_table_row *row;
-
     static u_long   default_num = 0;
 
     static oid      snmptrapoid[] = { 1, 3, 6, 1, 6, 3, 1, 1, 4, 1, 0 };
     size_t          snmptrapoid_len = OID_LENGTH(snmptrapoid);
-    netsnmp_variable_list *vptr;
-    u_char         *logdate;
-    size_t          logdate_size;
+    netsnmp_variable_list *vptr, *trapoid = NULL;
+    nlm_log_entry  *entry;
+    nlm_log_var    *lv;
+    u_char         *logdate, *cp;
+    size_t          logdate_size, size, var_count = 0;
     time_t          timetnow;
-
-    u_long          vbcount = 0;
-    u_long          tmpul;
-    int             col;
+    u_long          value_type;
+    u_char          taddress[sizeof(in_addr_t) + sizeof(u_short)];
+    size_t          taddress_len = 0;
     netsnmp_pdu    *orig_pdu = pdu;
 
-    if (!nlmLogVarTable
+    if (!nlm_log_registered
         || netsnmp_ds_get_boolean(NETSNMP_DS_APPLICATION_ID,
                                   NETSNMP_DS_APP_DONT_LOG)) {
         return;
     }
 
     DEBUGMSGTL(("notification_log", "logging something\n"));
-    row = netsnmp_create_table_data_row();
 
-    ++num_received;
-    default_num++;
-
-    /*
-     * indexes to the table 
-     */
-    netsnmp_table_row_add_index(row, ASN_OCTET_STR, "default",
-                                strlen("default"));
-    netsnmp_table_row_add_index(row, ASN_UNSIGNED, &default_num,
-                                sizeof(default_num));
-
-    /*
-     * add the data 
-     */
-    tmpl = netsnmp_get_agent_uptime();
-    netsnmp_set_row_column(row, COLUMN_NLMLOGTIME, ASN_TIMETICKS,
-                           &tmpl, sizeof(tmpl));
-    time(&timetnow);
-    logdate = date_n_time(&timetnow, &logdate_size);
-    netsnmp_set_row_column(row, COLUMN_NLMLOGDATEANDTIME, ASN_OCTET_STR,
-                           logdate, logdate_size);
-    netsnmp_set_row_column(row, COLUMN_NLMLOGENGINEID, ASN_OCTET_STR,
-                           pdu->securityEngineID,
-                           pdu->securityEngineIDLen);
     if (transport && transport->domain == netsnmpUDPDomain) {
         /*
          * check for the udp domain 
@@ -634,136 +695,114 @@ log_notification(netsnmp_pdu *pdu, netsnmp_transport *transport)
         struct sockaddr_in *addr =
             (struct sockaddr_in *) pdu->transport_data;
         if (addr) {
-            char            buf[sizeof(in_addr_t) +
-                                sizeof(addr->sin_port)];
             in_addr_t       locaddr = htonl(addr->sin_addr.s_addr);
             u_short         portnum = htons(addr->sin_port);
-            memcpy(buf, &locaddr, sizeof(in_addr_t));
-            memcpy(buf + sizeof(in_addr_t), &portnum,
+            memcpy(taddress, &locaddr, sizeof(in_addr_t));
+            memcpy(taddress + sizeof(in_addr_t), &portnum,
                    sizeof(addr->sin_port));
-            netsnmp_set_row_column(row, COLUMN_NLMLOGENGINETADDRESS,
-                                   ASN_OCTET_STR, buf,
-                                   sizeof(in_addr_t) +
-                                   sizeof(addr->sin_port));
+            taddress_len = sizeof(in_addr_t) + sizeof(addr->sin_port);
         }
     }
-    if (transport)
-        netsnmp_set_row_column(row, COLUMN_NLMLOGENGINETDOMAIN,
-                               ASN_OBJECT_ID,
-                               transport->domain,
-                               sizeof(oid) * transport->domain_length);
-    netsnmp_set_row_column(row, COLUMN_NLMLOGCONTEXTENGINEID,
-                           ASN_OCTET_STR, pdu->contextEngineID,
-                           pdu->contextEngineIDLen);
-    netsnmp_set_row_column(row, COLUMN_NLMLOGCONTEXTNAME, ASN_OCTET_STR,
-                           pdu->contextName, pdu->contextNameLen);
 
     if (pdu->command == SNMP_MSG_TRAP)
 	pdu = convert_v1pdu_to_v2(orig_pdu);
+    if (NULL == pdu)
+        return;
+
+    /*
+     * size up the record: the entry, its variables, then their contents
+     */
+    size = NLM_LOG_ALIGN(pdu->securityEngineIDLen) +
+        NLM_LOG_ALIGN(taddress_len) +
+        NLM_LOG_ALIGN(pdu->contextEngineIDLen) +
+        NLM_LOG_ALIGN(pdu->contextNameLen);
+    if (transport)
+        size += NLM_LOG_ALIGN(transport->domain_length * sizeof(oid));
     for (vptr = pdu->variables; vptr; vptr = vptr->next_variable) {
         if (snmp_oid_compare(snmptrapoid, snmptrapoid_len,
                              vptr->name, vptr->name_length) == 0) {
-            netsnmp_set_row_column(row, COLUMN_NLMLOGNOTIFICATIONID,
-                                   ASN_OBJECT_ID, vptr->val.string,
-                                   vptr->val_len);
+            trapoid = vptr;
+            size += NLM_LOG_ALIGN(vptr->val_len);
+        } else if (nlm_log_var_type(vptr->type, &value_type)) {
+            ++var_count;
+            size += NLM_LOG_ALIGN(vptr->name_length * sizeof(oid)) +
+                NLM_LOG_ALIGN(vptr->val_len);
         } else {
-            netsnmp_table_row *myrow;
-            myrow = netsnmp_create_table_data_row();
-
-            /*
-             * indexes to the table 
-             */
-            netsnmp_table_row_add_index(myrow, ASN_OCTET_STR, "default",
-                                        strlen("default"));
-            netsnmp_table_row_add_index(myrow, ASN_UNSIGNED, &default_num,
-                                        sizeof(default_num));
-            vbcount++;
-            netsnmp_table_row_add_index(myrow, ASN_UNSIGNED, &vbcount,
-                                        sizeof(vbcount));
-
-            /*
-             * OID 
-             */
-            netsnmp_set_row_column(myrow, COLUMN_NLMLOGVARIABLEID,
-                                   ASN_OBJECT_ID, vptr->name,
-                                   vptr->name_length * sizeof(oid));
-
-            /*
-             * value 
-             */
-            switch (vptr->type) {
-            case ASN_OBJECT_ID:
-                tmpul = 7;
-                col = COLUMN_NLMLOGVARIABLEOIDVAL;
-                break;
-
-            case ASN_INTEGER:
-                tmpul = 4;
-                col = COLUMN_NLMLOGVARIABLEINTEGER32VAL;
-                break;
-
-            case ASN_UNSIGNED:
-                tmpul = 2;
-                col = COLUMN_NLMLOGVARIABLEUNSIGNED32VAL;
-                break;
-
-            case ASN_COUNTER:
-                tmpul = 1;
-                col = COLUMN_NLMLOGVARIABLECOUNTER32VAL;
-                break;
-
-            case ASN_TIMETICKS:
-                tmpul = 3;
-                col = COLUMN_NLMLOGVARIABLETIMETICKSVAL;
-                break;
-
-            case ASN_OCTET_STR:
-                tmpul = 6;
-                col = COLUMN_NLMLOGVARIABLEOCTETSTRINGVAL;
-                break;
-
-            case ASN_IPADDRESS:
-                tmpul = 5;
-                col = COLUMN_NLMLOGVARIABLEIPADDRESSVAL;
-                break;
-
-            case ASN_COUNTER64:
-                tmpul = 8;
-                col = COLUMN_NLMLOGVARIABLECOUNTER64VAL;
-                break;
-
-            case ASN_OPAQUE:
-                tmpul = 9;
-                col = COLUMN_NLMLOGVARIABLEOPAQUEVAL;
-                break;
-
-            default:
-                /*
-                 * unsupported 
-                 */
-                DEBUGMSGTL(("notification_log",
-                            "skipping type %d\n", vptr->type));
-                (void)netsnmp_table_dataset_delete_row(myrow);
-                continue;
-            }
-            netsnmp_set_row_column(myrow, COLUMN_NLMLOGVARIABLEVALUETYPE,
-                                   ASN_INTEGER, & tmpul,
-                                   sizeof(tmpul));
-            netsnmp_set_row_column(myrow, col, vptr->type,
-                                   vptr->val.string, vptr->val_len);
             DEBUGMSGTL(("notification_log",
-                        "adding a row to the variables table\n"));
-            netsnmp_table_dataset_add_row(nlmLogVarTable, myrow);
+                        "skipping type %d\n", vptr->type));
         }
     }
+    size += NLM_LOG_ALIGN(sizeof(*entry) +
+                          (var_count ? var_count - 1 : 0) *
+                          sizeof(nlm_log_var));
+
+    entry = calloc(1, size);
+    if (NULL == entry) {
+        snmp_log(LOG_ERR, "notification_log: out of memory\n");
+        if (pdu != orig_pdu)
+            snmp_free_pdu(pdu);
+        return;
+    }
+    cp = (u_char *) entry + NLM_LOG_ALIGN(sizeof(*entry) +
+                                          (var_count ? var_count - 1 : 0) *
+                                          sizeof(nlm_log_var));
+
+    ++num_received;
+    entry->index = ++default_num;
+    entry->time = netsnmp_get_agent_uptime();
+    time(&timetnow);
+    logdate = date_n_time(&timetnow, &logdate_size);
+    if (logdate_size > sizeof(entry->date))
+        logdate_size = sizeof(entry->date);
+    memcpy(entry->date, logdate, logdate_size);
+    entry->date_len = logdate_size;
+    entry->engineid = nlm_log_copy(&cp, pdu->securityEngineID,
+                                   pdu->securityEngineIDLen);
+    entry->engineid_len = pdu->securityEngineIDLen;
+    if (taddress_len) {
+        entry->taddress = nlm_log_copy(&cp, taddress, taddress_len);
+        entry->taddress_len = taddress_len;
+    }
+    if (transport) {
+        entry->tdomain = nlm_log_copy(&cp, transport->domain,
+                                      transport->domain_length *
+                                      sizeof(oid));
+        entry->tdomain_len = transport->domain_length;
+    }
+    entry->context_engineid = nlm_log_copy(&cp, pdu->contextEngineID,
+                                           pdu->contextEngineIDLen);
+    entry->context_engineid_len = pdu->contextEngineIDLen;
+    entry->context_name = nlm_log_copy(&cp, pdu->contextName,
+                                       pdu->contextNameLen);
+    entry->context_name_len = pdu->contextNameLen;
+    if (trapoid) {
+        entry->notification_id = nlm_log_copy(&cp, trapoid->val.objid,
+                                              trapoid->val_len);
+        entry->notification_id_len = trapoid->val_len / sizeof(oid);
+    }
+
+    lv = entry->vars;
+    for (vptr = pdu->variables; vptr; vptr = vptr->next_variable) {
+        if (vptr == trapoid || !nlm_log_var_type(vptr->type, &value_type))
+            continue;
+        lv->name = nlm_log_copy(&cp, vptr->name,
+                                vptr->name_length * sizeof(oid));
+        lv->name_len = vptr->name_length;
+        lv->val = nlm_log_copy(&cp, vptr->val.string, vptr->val_len);
+        lv->val_len = vptr->val_len;
+        lv->type = vptr->type;
+        ++lv;
+    }
+    entry->var_count = var_count;
+    netsnmp_assert(cp == (u_char *) entry + size);
 
     if (pdu != orig_pdu)
         snmp_free_pdu( pdu );
 
     /*
-     * store the row 
+     * store the record 
      */
-    netsnmp_table_dataset_add_row(nlmLogTable, row);
+    nlm_log_append(entry);
 
     check_log_size(0, NULL);
     DEBUGMSGTL(("notification_log", "done logging something\n"));
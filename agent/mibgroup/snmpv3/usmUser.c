@@ -76,11 +76,30 @@ static const oid usmUser_variables_oid[] = { 1, 3, 6, 1, 6, 3, 15, 1, 2 };
 static unsigned int usmUserSpinLock = 0;
 #endif
 
+static void
+usmUser_parse_workers(const char *token, char *line)
+{
+    int             workers = atoi(line);
+
+    if (workers < 0) {
+        config_perror("the number of workers can't be negative");
+        return;
+    }
+    usm_set_create_user_workers(workers);
+}
+
 void
 init_usmUser(void)
 {
     REGISTER_MIB("snmpv3/usmUser", usmUser_variables, variable4,
                  usmUser_variables_oid);
+
+    /*
+     * the library derives createUser keys in-process unless told that
+     * forking workers is fine, which it is in the agent
+     */
+    snmpd_register_config_handler("createUserWorkers",
+                                  usmUser_parse_workers, NULL, "NUMBER");
 }
 
 #ifndef NETSNMP_FEATURE_REMOVE_INIT_REGISTER_USMUSER_CONTEXT
@@ -9,3 +9,4 @@ config_add_mib(SNMP-TLS-TM-MIB);
 config_add_mib(SNMP-TSM-MIB);
 
 #define SNMP_TLS_TM_BASE     1, 3, 6, 1, 2, 1, 198
+#define NETSNMP_TLSTM_BASE   1, 3, 6, 1, 4, 1, 8072, 1, 10
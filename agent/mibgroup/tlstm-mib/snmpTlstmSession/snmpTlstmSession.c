@@ -10,6 +10,7 @@
 #include "snmpTlstmSession.h"
 
 static netsnmp_handler_registration* _myreg = NULL;
+static netsnmp_handler_registration* _nsreg = NULL;
 
 /** Initializes the snmpTlstmSession module */
 void
@@ -36,6 +37,26 @@ init_snmpTlstmSession(void)
         _myreg = NULL;
     }
 
+    /* NET-SNMP-AGENT-MIB::nsTlstm handshake counters */
+    {
+        static oid      nsoid[] = { NETSNMP_TLSTM_BASE };
+
+        _nsreg = netsnmp_create_handler_registration("nsTlstm", NULL,
+                                                     nsoid, OID_LENGTH(nsoid),
+                                                     HANDLER_CAN_RONLY);
+        if (NULL == _nsreg) {
+            snmp_log(LOG_ERR, "failed to create handler registration for "
+                     "nsTlstm\n");
+            return;
+        }
+
+        rc = NETSNMP_REGISTER_STATISTIC_HANDLER(_nsreg, 1, NSTLSTM);
+        if (MIB_REGISTERED_OK != rc) {
+            snmp_log(LOG_ERR, "failed to register nsTlstm statistics\n");
+            netsnmp_handler_registration_free(_nsreg);
+            _nsreg = NULL;
+        }
+    }
 }
 
 
@@ -46,4 +67,8 @@ shutdown_snmpTlstmSession(void)
         netsnmp_unregister_handler(_myreg);
         _myreg = NULL;
     }
+    if (_nsreg) {
+        netsnmp_unregister_handler(_nsreg);
+        _nsreg = NULL;
+    }
 }
@@ -18,6 +18,15 @@
 #include <errno.h>
 #include <regex.h>
 #include <time.h>
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#endif
 
 #include <net-snmp/net-snmp-includes.h>
 #include <net-snmp/agent/net-snmp-agent-includes.h>
@@ -77,12 +86,29 @@ logmatch_update_filename(const char * pattern, char * currentFilename)
     }
 }
 
-struct logmatchstat {
+/*
+ * A log file scanned by one or more logmatch entries.  The file is kept
+ * open between scans and read once for all entries using it; rotation
+ * is detected by a change of inode.
+ */
+struct logmatchfile {
     char            filenamePattern[256];
     char            filename[256];
+    FILE           *logfile;
+    dev_t           dev;            /* of the file last opened */
+    ino_t           ino;
+    int             identified;     /* dev and ino are set */
+    long            position;       /* where the next scan starts */
+    int             frequency;      /* shortest cycle time of its entries */
+    int             users;          /* entries with a valid regex */
+    unsigned int    alarm;
+    int             watch;          /* inotify watch, or -1 */
+};
+
+struct logmatchstat {
     char            regEx[256];
     char            name[256];
-    FILE           *logfile;
+    char            literal[256];   /* must occur in any matching line */
     long            currentFilePosition;
     unsigned long   globalMatchCounter;
     unsigned long   currentMatchCounter;
@@ -90,262 +116,537 @@ struct logmatchstat {
     regex_t         regexBuffer;
     int             myRegexError;
     int             virgin;
+    int             dirty;          /* position not saved yet */
     int             thisIndex;
+    int             fileIndex;
     int             frequency;
 };
 
 #define MAXLOGMATCH   250
 
+/* how often (seconds) changed file positions are saved */
+#define LOGMATCH_SAVE_INTERVAL 60
+
 static struct logmatchstat logmatchTable[MAXLOGMATCH];
 static int                 logmatchCount = 0;
+static struct logmatchfile logmatchFiles[MAXLOGMATCH];
+static int                 logmatchFileCount = 0;
 
-/***************************************************************
-*                                                              *
-* updateLogmatch                                               *
-* this function is called back by snmpd alarms                 *
-*                                                              *
-***************************************************************/
+#ifdef HAVE_SYS_INOTIFY_H
+static int                 logmatchInotify = -1;
+#endif
+
+/*
+ * ------------------------------------------------
+ *  Find the longest run of characters that any
+ *  line matched by the extended regular expression
+ *  regex must contain, so that lines without it can
+ *  be skipped without calling regexec().  Leaves
+ *  literal empty if no such run is easily found.
+ *  -------------------------------------------------
+ */
 
 static void
-updateLogmatch(int iindex)
+logmatch_find_literal(const char *regex, char *literal, size_t size)
 {
+    char            run[256];
+    size_t          run_len = 0, best_len = 0;
+    int             depth = 0;
+    const char     *cp;
+    char            c;
+
+    literal[0] = '\0';
+    for (cp = regex; ; cp++) {
+        c = *cp;
+        if (c == '\\' && cp[1] && strchr(".[]()*+?{}^$|\\/", cp[1])) {
+            c = *++cp;          /* escaped metacharacter: a literal */
+        } else if (c == '\0' || strchr(".[]()*+?{}^$|\\", c)) {
+            if (run_len > best_len && run_len < size) {
+                memcpy(literal, run, run_len);
+                literal[run_len] = '\0';
+                best_len = run_len;
+            }
+            run_len = 0;
+            if (c == '\0')
+                break;
+            if (c == '|' && depth == 0) {
+                literal[0] = '\0';     /* alternatives: nothing required */
+                break;
+            }
+            if (c == '(')
+                depth++;
+            else if (c == ')')
+                depth--;
+            else if (c == '\\' && cp[1])
+                cp++;           /* \w, \b...: not a literal character */
+            else if (c == '[') {
+                /* skip the bracket expression, including []...] */
+                if (cp[1] == '^')
+                    cp++;
+                if (cp[1] == ']')
+                    cp++;
+                while (cp[1] && cp[1] != ']')
+                    cp++;
+                if (cp[1] == '\0')
+                    break;
+                cp++;
+            } else if (c == '{') {
+                /* skip the interval: its counts are not literals */
+                while (cp[1] && cp[1] != '}')
+                    cp++;
+                if (cp[1] == '\0')
+                    break;
+                cp++;
+            }
+            continue;
+        }
+        if (depth > 0)
+            continue;
+        if (cp[1] && strchr("*?{", cp[1])) {
+            /* an optional character ends the run */
+            if (run_len > best_len && run_len < size) {
+                memcpy(literal, run, run_len);
+                literal[run_len] = '\0';
+                best_len = run_len;
+            }
+            run_len = 0;
+            continue;
+        }
+        if (run_len < sizeof(run) - 1)
+            run[run_len++] = c;
+        if (cp[1] == '+') {
+            /* the character is required, but may repeat */
+            if (run_len > best_len && run_len < size) {
+                memcpy(literal, run, run_len);
+                literal[run_len] = '\0';
+                best_len = run_len;
+            }
+            run_len = 0;
+            cp++;
+        }
+    }
+}
 
-    int             matchResultCode;
-    char            inbuf[1024];
+/*
+ * ------------------------------------------------
+ *  Restore the counters and file position of an
+ *  entry from its persistent data file.
+ *  -------------------------------------------------
+ */
+
+static void
+logmatch_restore(struct logmatchstat *logmatch)
+{
     char            perfilename[1024];
+    char            lastFilename[256];
     FILE           *perfile;
     unsigned long   pos, ccounter, counter;
-    int             result;
-    int             toobig;
-    int             anyChanges = FALSE;
-    struct stat     sb;
-    char            lastFilename[256];
-
-    if (iindex >= MAXLOGMATCH)
-        return;
-
-    /*
-     * ------------------------------------ 
-     * we can never be sure if this is the  
-     * last time we are being called here,  
-     * so we always update a persistent     
-     * data file with our current file      
-     * position                             
-     * ------------------------------------ 
-     */
+    struct logmatchfile *file = &logmatchFiles[logmatch->fileIndex];
 
     snprintf(perfilename, sizeof(perfilename), "%s/snmpd_logmatch_%s.pos",
-             get_persistent_directory(), logmatchTable[iindex].name);
+             get_persistent_directory(), logmatch->name);
 
-    if (logmatchTable[iindex].virgin) {
+    if (!(perfile = fopen(perfilename, "r")))
+        return;
 
+    pos = counter = ccounter = 0;
+    if (fscanf(perfile, "%lu %lu %lu %255s",
+               &pos, &ccounter, &counter, lastFilename) == 4) {
         /*
-         * ------------------------------------ 
-         * this is the first time we are being  
-         * called; let's try to find an old     
-         * file position stored in a persistent 
-         * data file and restore it             
-         * ------------------------------------ 
+         * ------------------------------------
+         * only trust the position if the file
+         * name is still the one it was saved
+         * for; a position past the end of the
+         * file is caught when scanning
+         * ------------------------------------
          */
+        if (logmatch_update_filename(file->filenamePattern,
+                                     lastFilename) == 0 &&
+            strcmp(lastFilename, file->filename) == 0 && (long)pos >= 0) {
+            logmatch->currentFilePosition = pos;
+            logmatch->currentMatchCounter = ccounter;
+        }
+        logmatch->globalMatchCounter = counter;
+    }
+    fclose(perfile);
+}
 
-        if ((perfile = fopen(perfilename, "r"))) {
-
-            /*
-             * ------------------------------------ 
-             * the persistent data file exists so   
-             * let's read it out                    
-             * ------------------------------------ 
-             */
-
-
-            pos = counter = ccounter = 0;
-
-            if (fscanf(perfile, "%lu %lu %lu %255s",
-                       &pos, &ccounter, &counter, lastFilename)) {
-
-
-                /*
-                 * ------------------------------------ 
-                 * the data could be read; now let's    
-                 * try to open the  logfile to be       
-                 * scanned                              
-                 * ------------------------------------ 
-                 */
-
-                if (logmatch_update_filename(logmatchTable[iindex].filenamePattern,
-                                             lastFilename) == 0) {
-
-                    /*
-                     * ---------------------------------
-                     * the filename is still the same as 
-                     * the one stored in the persistent
-                     * data file.
-                     * ---------------------------------
-                     */
-
-                    if ((logmatchTable[iindex].logfile =
-                        fopen(logmatchTable[iindex].filename, "r"))) {
-
-
-                        /*
-                         * ------------------------------------ 
-                         * the log file could be opened; now    
-                         * let's try to set the pointer         
-                         * ------------------------------------ 
-                         */
-
-                        if ((long)pos >= 0 &&
-                            !fseek(logmatchTable[iindex].logfile, pos,
-                                   SEEK_SET)) {
-
-
-                            /*
-                             * ------------------------------------ 
-                             * the pointer could be set - this is   
-                             * the most that we can do: if the      
-                             * pointer is smaller than the file     
-                             * size we must assume that the pointer 
-                             * still points to where it read the    
-                             * file last time; let's restore the    
-                             * data                                 
-                             * ------------------------------------ 
-                             */
-
-                            logmatchTable[iindex].currentFilePosition = pos;
-                            logmatchTable[iindex].currentMatchCounter =
-                                ccounter;
-                        }
-
-                        fclose(logmatchTable[iindex].logfile);
-                    }
-                }
-                logmatchTable[iindex].globalMatchCounter = counter;
-            }
+/*
+ * ------------------------------------------------
+ *  Write the persistent data files of all entries
+ *  whose position changed since they were last
+ *  written.
+ *  -------------------------------------------------
+ */
+
+static void
+logmatch_save_positions(void)
+{
+    char            perfilename[1024];
+    FILE           *perfile;
+    struct logmatchstat *logmatch;
+    int             i;
 
+    for (i = 0; i < logmatchCount; i++) {
+        logmatch = &logmatchTable[i];
+        if (!logmatch->dirty)
+            continue;
+        snprintf(perfilename, sizeof(perfilename),
+                 "%s/snmpd_logmatch_%s.pos", get_persistent_directory(),
+                 logmatch->name);
+        if ((perfile = fopen(perfilename, "w"))) {
+            fprintf(perfile, "%lu %lu %lu %s\n",
+                    logmatch->currentFilePosition,
+                    logmatch->currentMatchCounter,
+                    logmatch->globalMatchCounter,
+                    logmatchFiles[logmatch->fileIndex].filename);
             fclose(perfile);
         }
-
-        logmatchTable[iindex].virgin = FALSE;
+        logmatch->dirty = FALSE;
     }
+}
 
-    /*
-     * -------------------------------------------
-     * check if a new input file needs to be opened
-     * if yes, reset counter and position
-     * -------------------------------------------
-     */
+static void
+logmatch_save_positions_Scheduled(unsigned int registrationNumber, void *p)
+{
+    logmatch_save_positions();
+}
+
+static int
+logmatch_store_data(int majorID, int minorID, void *serverarg,
+                    void *clientarg)
+{
+    logmatch_save_positions();
+    return SNMPERR_SUCCESS;
+}
 
-    if (logmatch_update_filename(logmatchTable[iindex].filenamePattern,
-                                 logmatchTable[iindex].filename) == 1) {
-        logmatchTable[iindex].currentFilePosition = 0; 
-        logmatchTable[iindex].currentMatchCounter = 0;
+static void
+logmatch_close_file(struct logmatchfile *file)
+{
+#ifdef HAVE_SYS_INOTIFY_H
+    if (file->watch >= 0 && logmatchInotify >= 0)
+        inotify_rm_watch(logmatchInotify, file->watch);
+#endif
+    file->watch = -1;
+    if (file->logfile) {
+        fclose(file->logfile);
+        file->logfile = NULL;
     }
+}
 
+/*
+ * ------------------------------------------------
+ *  Read the lines added to file since the last
+ *  scan and count them against every entry using
+ *  the file.  An entry restored from an older
+ *  position only counts lines past it.
+ *  -------------------------------------------------
+ */
 
-    /*
-     * ------------------------------------ 
-     * now the pointer and the counter are  
-     * set either zero or reset to old      
-     * value; now let's try to read some    
-     * data                                 
-     * ------------------------------------ 
-     */
+static void
+logmatch_read_lines(int findex)
+{
+    struct logmatchfile *file = &logmatchFiles[findex];
+    struct logmatchstat *logmatch;
+    char            inbuf[1024];
+    long            linestart;
+    int             i;
 
-    if (stat(logmatchTable[iindex].filename, &sb) == 0) {
+    if (fseek(file->logfile, file->position, SEEK_SET))
+        return;
 
-        if (logmatchTable[iindex].currentFilePosition > sb.st_size) {
-            toobig = TRUE;
-        } else {
-            toobig = FALSE;
+    linestart = file->position;
+    while (fgets(inbuf, sizeof(inbuf), file->logfile)) {
+        for (i = 0; i < logmatchCount; i++) {
+            logmatch = &logmatchTable[i];
+            if (logmatch->fileIndex != findex || logmatch->myRegexError ||
+                linestart < logmatch->currentFilePosition)
+                continue;
+            if (logmatch->literal[0] &&
+                strstr(inbuf, logmatch->literal) == NULL)
+                continue;
+            if (regexec(&logmatch->regexBuffer, inbuf, 0, NULL,
+                        REG_NOTEOL) == 0) {
+                logmatch->globalMatchCounter++;
+                logmatch->currentMatchCounter++;
+                logmatch->matchCounter++;
+            }
         }
+        linestart += strlen(inbuf);
+    }
+    clearerr(file->logfile);
+    file->position = ftell(file->logfile);
 
-        if ((logmatchTable[iindex].logfile =
-            fopen(logmatchTable[iindex].filename, "r"))) {
+    for (i = 0; i < logmatchCount; i++) {
+        logmatch = &logmatchTable[i];
+        if (logmatch->fileIndex != findex || logmatch->myRegexError ||
+            logmatch->currentFilePosition == file->position)
+            continue;
+        logmatch->currentFilePosition = file->position;
+        logmatch->dirty = TRUE;
+    }
+}
 
-            result =
-                fseek(logmatchTable[iindex].logfile,
-                      logmatchTable[iindex].currentFilePosition, SEEK_SET);
+/***************************************************************
+*                                                              *
+* updateLogmatchFile                                           *
+* scan a log file for all entries using it                     *
+*                                                              *
+***************************************************************/
 
-            if (result || toobig || (errno == EINVAL)
-                || feof(logmatchTable[iindex].logfile)) {
+static void
+updateLogmatchFile(int findex)
+{
+    struct logmatchfile *file = &logmatchFiles[findex];
+    struct logmatchstat *logmatch;
+    struct stat     sb;
+    int             i, reset = FALSE;
 
+    DEBUGMSGTL(("logmatch", "scanning %s\n", file->filename));
 
-                /*
-                 * ------------------------------------ 
-                 * when we are here that means we       
-                 * couldn't set the file position maybe  
-                 * the file was rotated; let's reset    
-                 * the filepointer, but not the counter 
-                 * ------------------------------------ 
-                 */
+    /*
+     * ------------------------------------
+     * the first scan restores positions
+     * and counters from persistent storage
+     * ------------------------------------
+     */
+    for (i = 0; i < logmatchCount; i++) {
+        logmatch = &logmatchTable[i];
+        if (logmatch->fileIndex == findex && !logmatch->myRegexError &&
+            logmatch->virgin) {
+            logmatch_restore(logmatch);
+            logmatch->virgin = FALSE;
+        }
+    }
 
+    /*
+     * -------------------------------------------
+     * check if a new input file needs to be opened
+     * -------------------------------------------
+     */
+    if (logmatch_update_filename(file->filenamePattern,
+                                 file->filename) == 1) {
+        logmatch_close_file(file);
+        file->identified = FALSE;
+        reset = TRUE;
+    }
 
-                logmatchTable[iindex].currentFilePosition = 0;
-                logmatchTable[iindex].currentMatchCounter = 0;
-                fseek(logmatchTable[iindex].logfile, 0, SEEK_SET);
-                anyChanges = TRUE;
-            }
+    if (stat(file->filename, &sb) != 0) {
+        /*
+         * ------------------------------------
+         * the file was moved away or deleted;
+         * keep reading what is still written
+         * to it until a new one shows up
+         * ------------------------------------
+         */
+        if (file->logfile)
+            logmatch_read_lines(findex);
+        return;
+    }
 
-            while (fgets
-                   (inbuf, sizeof(inbuf), logmatchTable[iindex].logfile)) {
+    if (file->identified && (sb.st_ino != file->ino || sb.st_dev != file->dev)) {
+        /*
+         * ------------------------------------
+         * the file was rotated: finish reading
+         * the old one, then start over on the
+         * new one
+         * ------------------------------------
+         */
+        DEBUGMSGTL(("logmatch", "%s was rotated\n", file->filename));
+        if (file->logfile)
+            logmatch_read_lines(findex);
+        logmatch_close_file(file);
+        reset = TRUE;
+    }
 
-                matchResultCode =
-                    regexec(&(logmatchTable[iindex].regexBuffer),
-                            inbuf, 0, NULL, REG_NOTEOL);
+    if (!file->logfile) {
+        if (!(file->logfile = fopen(file->filename, "r")))
+            return;
+#ifdef FD_CLOEXEC
+        fcntl(fileno(file->logfile), F_SETFD, FD_CLOEXEC);
+#endif
+        file->dev = sb.st_dev;
+        file->ino = sb.st_ino;
+        file->identified = TRUE;
+        file->position = -1;
+        for (i = 0; i < logmatchCount; i++) {
+            logmatch = &logmatchTable[i];
+            if (logmatch->fileIndex != findex || logmatch->myRegexError)
+                continue;
+            if (reset)
+                logmatch->currentFilePosition = 0;
+            if (file->position < 0 ||
+                logmatch->currentFilePosition < file->position)
+                file->position = logmatch->currentFilePosition;
+        }
+        if (file->position < 0)
+            file->position = 0;
+#ifdef HAVE_SYS_INOTIFY_H
+        if (logmatchInotify >= 0)
+            file->watch = inotify_add_watch(logmatchInotify, file->filename,
+                                            IN_MODIFY | IN_MOVE_SELF |
+                                            IN_DELETE_SELF);
+#endif
+    }
 
-                if (matchResultCode == 0) {
-                    logmatchTable[iindex].globalMatchCounter++;
-                    logmatchTable[iindex].currentMatchCounter++;
-                    logmatchTable[iindex].matchCounter++;
-                    anyChanges = TRUE;
-                }
-            }
+    if (file->position > sb.st_size) {
+        /*
+         * ------------------------------------
+         * the file shrank - it was truncated;
+         * start over at its beginning
+         * ------------------------------------
+         */
+        file->position = 0;
+        reset = TRUE;
+    }
 
-            logmatchTable[iindex].currentFilePosition =
-                ftell(logmatchTable[iindex].logfile);
-            fclose(logmatchTable[iindex].logfile);
+    if (reset) {
+        for (i = 0; i < logmatchCount; i++) {
+            logmatch = &logmatchTable[i];
+            if (logmatch->fileIndex != findex || logmatch->myRegexError)
+                continue;
+            logmatch->currentFilePosition = 0;
+            logmatch->currentMatchCounter = 0;
+            logmatch->dirty = TRUE;
         }
     }
 
+    logmatch_read_lines(findex);
+}
 
-    /*
-     * ------------------------------------ 
-     * at this point we can be safe that    
-     * our current file position is         
-     * straightened out o.k. - we never     
-     * know if this is the last time we are 
-     * being called so save the position    
-     * in a file                            
-     * ------------------------------------ 
-     */
+static void
+updateLogmatch(int iindex)
+{
+    if (iindex >= MAXLOGMATCH || logmatchTable[iindex].fileIndex < 0 ||
+        logmatchTable[iindex].myRegexError)
+        return;
+    updateLogmatchFile(logmatchTable[iindex].fileIndex);
+}
 
-    if (anyChanges && (perfile = fopen(perfilename, "w"))) {
+static void
+updateLogmatch_Scheduled(unsigned int registrationNumber, void *p)
+{
+    struct logmatchfile *file = p;
 
+    updateLogmatchFile(file - logmatchFiles);
+}
 
-        /*
-         * ------------------------------------ 
-         * o.k. lets write out our variable     
-         * ------------------------------------ 
-         */
+#ifdef HAVE_SYS_INOTIFY_H
+/*
+ * ------------------------------------------------
+ *  Scan the files inotify reports as changed, once
+ *  each however many events are queued for them.
+ *  -------------------------------------------------
+ */
 
-        fprintf(perfile, "%lu %lu %lu %s\n",
-                logmatchTable[iindex].currentFilePosition,
-                logmatchTable[iindex].currentMatchCounter,
-                logmatchTable[iindex].globalMatchCounter,
-                logmatchTable[iindex].filename);
+static void
+logmatch_inotify_read(int fd, void *data)
+{
+    long            buf[4096 / sizeof(long)];   /* aligned for events */
+    const struct inotify_event *event;
+    char            changed[MAXLOGMATCH];
+    ssize_t         len;
+    char           *cp;
+    int             i;
 
-        fclose(perfile);
+    memset(changed, 0, sizeof(changed));
+    while ((len = read(fd, buf, sizeof(buf))) > 0) {
+        for (cp = (char *) buf; cp < (char *) buf + len;
+             cp += sizeof(struct inotify_event) + event->len) {
+            event = (const struct inotify_event *) cp;
+            for (i = 0; i < logmatchFileCount; i++)
+                if (logmatchFiles[i].watch == event->wd)
+                    changed[i] = 1;
+        }
     }
+    for (i = 0; i < logmatchFileCount; i++)
+        if (changed[i])
+            updateLogmatchFile(i);
+}
+#endif /* HAVE_SYS_INOTIFY_H */
+
+/*
+ * ------------------------------------------------
+ *  Find the file entry for a filename pattern,
+ *  adding one if needed.  Returns -1 on failure.
+ *  -------------------------------------------------
+ */
 
+static int
+logmatch_get_file(const char *pattern, int frequency, int valid)
+{
+    struct logmatchfile *file;
+    int             i;
+
+    for (i = 0; i < logmatchFileCount; i++) {
+        file = &logmatchFiles[i];
+        if (strcmp(file->filenamePattern, pattern) == 0) {
+            if (frequency > 0 &&
+                (file->frequency <= 0 || frequency < file->frequency))
+                file->frequency = frequency;
+            if (valid)
+                file->users++;
+            return i;
+        }
+    }
+    if (logmatchFileCount >= MAXLOGMATCH)
+        return -1;
+
+    file = &logmatchFiles[logmatchFileCount];
+    memset(file, 0, sizeof(*file));
+    strlcpy(file->filenamePattern, pattern, sizeof(file->filenamePattern));
+    /* fill in filename with initial data */
+    strlcpy(file->filename, pattern, sizeof(file->filename));
+    logmatch_update_filename(file->filenamePattern, file->filename);
+    file->frequency = frequency;
+    file->users = valid ? 1 : 0;
+    file->watch = -1;
+    return logmatchFileCount++;
 }
 
+/*
+ * ------------------------------------------------
+ *  Start the periodic scans, once all entries have
+ *  been read and each file knows its shortest
+ *  cycle time.
+ *  -------------------------------------------------
+ */
 
-static void
-updateLogmatch_Scheduled(unsigned int registrationNumber, void *p)
+static int
+logmatch_start_scans(int majorID, int minorID, void *serverarg,
+                     void *clientarg)
 {
-    struct logmatchstat *logmatchtable = p;
+    static int      save_alarm;
+    int             i;
 
-    updateLogmatch(logmatchtable->thisIndex);
+#ifdef HAVE_SYS_INOTIFY_H
+    if (logmatchFileCount && logmatchInotify < 0) {
+        logmatchInotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (logmatchInotify >= 0)
+            register_readfd(logmatchInotify, logmatch_inotify_read, NULL);
+        else
+            DEBUGMSGTL(("logmatch", "inotify unavailable: %s\n",
+                        strerror(errno)));
+    }
+#endif
+
+    for (i = 0; i < logmatchFileCount; i++) {
+        if (!logmatchFiles[i].users)
+            continue;
+        if (logmatchFiles[i].frequency > 0 && !logmatchFiles[i].alarm)
+            logmatchFiles[i].alarm =
+                snmp_alarm_register(logmatchFiles[i].frequency, SA_REPEAT,
+                                    updateLogmatch_Scheduled,
+                                    &logmatchFiles[i]);
+        /* open (and watch) the file right away */
+        updateLogmatchFile(i);
+    }
+
+    if (logmatchFileCount && !save_alarm)
+        save_alarm = snmp_alarm_register(LOGMATCH_SAVE_INTERVAL, SA_REPEAT,
+                                         logmatch_save_positions_Scheduled,
+                                         NULL);
+    return SNMPERR_SUCCESS;
 }
 
 /***************************************************************
@@ -361,10 +662,12 @@ logmatch_parse_config(const char *token, char *cptr)
 
     char space_name;
     char space_path;
+    char filenamePattern[256];
 
     if (logmatchCount < MAXLOGMATCH) {
         logmatchTable[logmatchCount].frequency = 30;
         logmatchTable[logmatchCount].thisIndex = logmatchCount;
+        logmatchTable[logmatchCount].fileIndex = -1;
 
 
         /*
@@ -378,6 +681,7 @@ logmatch_parse_config(const char *token, char *cptr)
         logmatchTable[logmatchCount].currentMatchCounter = 0;
         logmatchTable[logmatchCount].matchCounter = 0;
         logmatchTable[logmatchCount].virgin = TRUE;
+        logmatchTable[logmatchCount].dirty = FALSE;
         logmatchTable[logmatchCount].currentFilePosition = 0;
 
 
@@ -389,21 +693,15 @@ logmatch_parse_config(const char *token, char *cptr)
          * ------------------------------------
          */
 
+        filenamePattern[0] = '\0';
         sscanf(cptr, "%255s%c%255s%c %d %255c\n",
                logmatchTable[logmatchCount].name,
 	       &space_name,
-               logmatchTable[logmatchCount].filenamePattern,
+               filenamePattern,
 	       &space_path,
                &(logmatchTable[logmatchCount].frequency),
                logmatchTable[logmatchCount].regEx);
 
-        /* fill in filename with initial data */
-        strlcpy(logmatchTable[logmatchCount].filename,
-                logmatchTable[logmatchCount].filenamePattern,
-                sizeof(logmatchTable[logmatchCount].filename));
-        logmatch_update_filename(logmatchTable[logmatchCount].filenamePattern,
-                                 logmatchTable[logmatchCount].filename);
-
 	/*
 	 * Log an error then return if any of the strings scanned in were
 	 * larger then they should have been.
@@ -450,11 +748,26 @@ logmatch_parse_config(const char *token, char *cptr)
             snmp_log(LOG_ERR, "Could not process the logmatch regex - %s," \
                      "\n since regcomp() failed with - %s\n",
                      logmatchTable[logmatchCount].regEx, regexErrorString);
+            logmatchTable[logmatchCount].fileIndex =
+                logmatch_get_file(filenamePattern, 0, FALSE);
+        } else {
+            logmatch_find_literal(logmatchTable[logmatchCount].regEx,
+                                  logmatchTable[logmatchCount].literal,
+                                  sizeof(logmatchTable[logmatchCount].literal));
+            logmatchTable[logmatchCount].fileIndex =
+                logmatch_get_file(filenamePattern,
+                                  logmatchTable[logmatchCount].frequency,
+                                  TRUE);
+            DEBUGMSGTL(("logmatch", "%s: file %d, literal \"%s\"\n",
+                        logmatchTable[logmatchCount].name,
+                        logmatchTable[logmatchCount].fileIndex,
+                        logmatchTable[logmatchCount].literal));
         }
-        else if (logmatchTable[logmatchCount].frequency > 0) {
-            snmp_alarm_register(logmatchTable[logmatchCount].frequency,
-                                SA_REPEAT, updateLogmatch_Scheduled,
-                                &logmatchTable[logmatchCount]);
+        if (logmatchTable[logmatchCount].fileIndex < 0) {
+            snmp_log(LOG_ERR, "logmatch_parse_config: too many log files\n");
+            if (logmatchTable[logmatchCount].myRegexError == 0)
+                regfree(&logmatchTable[logmatchCount].regexBuffer);
+            return;
         }
 
         logmatchCount++;
@@ -473,12 +786,14 @@ logmatch_free_config(void)
 {
     int             i;
 
-    /*
-     * ------------------------------------
-     * the only memory we have allocated
-     * is the memory allocated by regcomp
-     * ------------------------------------
-     */
+    logmatch_save_positions();
+
+    for (i = 0; i < logmatchFileCount; i++) {
+        logmatch_close_file(&logmatchFiles[i]);
+        if (logmatchFiles[i].alarm)
+            snmp_alarm_unregister(logmatchFiles[i].alarm);
+    }
+    logmatchFileCount = 0;
 
     for (i = 0; i < logmatchCount; i++) {
         if (logmatchTable[i].myRegexError == 0)
@@ -552,8 +867,8 @@ var_logmatch_table(struct variable *vp,
         return (u_char *) logmatch->name;
 
     case LOGMATCH_FILENAME:
-        *var_len = strlen(logmatch->filename);
-        return (u_char *) logmatch->filename;
+        *var_len = strlen(logmatchFiles[logmatch->fileIndex].filename);
+        return (u_char *) logmatchFiles[logmatch->fileIndex].filename;
 
     case LOGMATCH_REGEX:
         *var_len = strlen(logmatch->regEx);
@@ -658,6 +973,11 @@ init_logmatch(void)
     snmpd_register_config_handler("logmatch", logmatch_parse_config,
                                   logmatch_free_config,
                                   "logmatch name path cycletime regex");
+    snmp_register_callback(SNMP_CALLBACK_LIBRARY,
+                           SNMP_CALLBACK_POST_READ_CONFIG,
+                           logmatch_start_scans, NULL);
+    snmp_register_callback(SNMP_CALLBACK_LIBRARY, SNMP_CALLBACK_STORE_DATA,
+                           logmatch_store_data, NULL);
 
 }
 
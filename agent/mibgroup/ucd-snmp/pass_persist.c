@@ -35,6 +35,7 @@
 
 #include <net-snmp/net-snmp-includes.h>
 #include <net-snmp/agent/net-snmp-agent-includes.h>
+#include <net-snmp/library/large_fd_set.h>
 
 #include "struct.h"
 #include "pass_persist.h"
@@ -45,12 +46,46 @@
 netsnmp_feature_require(get_exten_instance);
 netsnmp_feature_require(parse_miboid);
 
+/*
+ * Helpers that answer PING with "PONG 2" speak protocol version 2: GET,
+ * GETNEXT and GETBULK requests are sent as one BATCH message per handler
+ * call and answered asynchronously, so a slow helper only delays its own
+ * varbinds.  Several batches may be outstanding; answers come back in
+ * order.
+ */
+#if !defined(WIN32) || defined(cygwin)
+#define PASS_PERSIST_HAVE_V2 1
+#endif
+/*
+ * how long to wait for a helper's answer, in seconds
+ */
+#define PASS_PERSIST_TIMEOUT    30
+/*
+ * how much output of a helper to buffer, in bytes, before giving up on
+ * it: more than the answer to a batch for the largest response
+ */
+#define PASS_PERSIST_MAX_OUTPUT (16 * SNMP_MAXBUF)
+
+struct pass_persist_batch {
+    unsigned int    tag;
+    int             nitems;
+    time_t          sent;
+    netsnmp_delegated_cache *cache;
+    struct pass_persist_batch *next;
+};
+
 struct extensible *persistpassthrus = NULL;
 int             numpersistpassthrus = 0;
 struct persist_pipe_type {
-    FILE           *fIn;
+    int             fdIn;
     int             fdOut;
     netsnmp_pid_t   pid;
+    int             version;    /* protocol version, from the PONG */
+    char           *rbuf;       /* output read from the helper so far */
+    size_t          rlen;
+    size_t          rsize;
+    unsigned int    next_tag;
+    struct pass_persist_batch *pending; /* v2: batches awaiting an answer */
 }              *persist_pipes = (struct persist_pipe_type *) NULL;
 static unsigned pipe_check_alarm_id;
 static int      init_persist_pipes(void);
@@ -59,6 +94,13 @@ static int      open_persist_pipe(int iindex, char *command);
 static void     check_persist_pipes(unsigned clientreg, void *clientarg);
 static void     destruct_persist_pipes(void);
 static int      write_persist_pipe(int iindex, const char *data);
+static void     pass_persist_register(struct extensible *persistpassthru);
+static char    *pass_persist_gets(int iindex, char *buf, size_t size);
+#ifdef PASS_PERSIST_HAVE_V2
+static void     pass_persist_readable(int fd, void *data);
+static void     pass_persist_drain(int iindex);
+static void     pass_persist_fail_batch(struct pass_persist_batch *batch);
+#endif
 
 /*
  * the relocatable extensible commands variables 
@@ -207,10 +249,7 @@ pass_persist_parse_config(const char *token, char *cptr)
     strlcpy((*ppass)->name, (*ppass)->command, sizeof((*ppass)->name));
     (*ppass)->next = NULL;
 
-    register_mib_priority("pass_persist",
-                 (struct variable *) extensible_persist_passthru_variables,
-                 sizeof(struct variable2), 1, (*ppass)->miboid,
-                 (*ppass)->miblen, (*ppass)->mibpriority);
+    pass_persist_register(*ppass);
 
     /*
      * argggg -- pasthrus must be sorted 
@@ -245,7 +284,6 @@ void
 pass_persist_free_config(void)
 {
     struct extensible *etmp, *etmp2;
-    int i;
 
     for (etmp = persistpassthrus; etmp != NULL;) {
         etmp2 = etmp;
@@ -253,11 +291,11 @@ pass_persist_free_config(void)
         unregister_mib_priority(etmp2->miboid, etmp2->miblen, etmp2->mibpriority);
         free(etmp2);
     }
-    if (persist_pipes) {
-        for (i = 0; i <= numpersistpassthrus; i++) {
-            close_persist_pipe(i);
-        }
-    }
+    /*
+     * the pipe table is sized for the current number of entries, so
+     * release it; it is rebuilt on first use
+     */
+    destruct_persist_pipes();
     persistpassthrus = NULL;
     numpersistpassthrus = 0;
 }
@@ -284,6 +322,194 @@ int get_exten_group_id(struct extensible *persistpassthru,
 }
 #endif /* USING_SINGLE_COMMON_PASSPERSIST_INSTANCE */
 
+static void    *
+pass_persist_clone_variable(void *p)
+{
+    return netsnmp_duplicate_variable((const struct variable *) p);
+}
+
+/*
+ * The subtree is served by the old API module function, which still does
+ * all of the version 1 work and SETs.  pass_persist_handler sits in front
+ * of it and takes over GET, GETNEXT and GETBULK for version 2 helpers.
+ */
+static void
+pass_persist_register(struct extensible *persistpassthru)
+{
+    netsnmp_handler_registration *reginfo;
+    netsnmp_mib_handler *oldapi, *handler;
+
+    oldapi = netsnmp_create_handler(OLD_API_NAME, netsnmp_old_api_helper);
+    if (!oldapi)
+        return;
+    oldapi->myvoid = netsnmp_duplicate_variable((struct variable *)
+                                       extensible_persist_passthru_variables);
+    oldapi->data_clone = pass_persist_clone_variable;
+    oldapi->data_free = free;
+
+    reginfo = netsnmp_handler_registration_create("pass_persist", oldapi,
+                                                  persistpassthru->miboid,
+                                                  persistpassthru->miblen,
+                                                  HANDLER_CAN_RWRITE |
+                                                  HANDLER_CAN_GETBULK);
+    handler = netsnmp_create_handler("pass_persist", pass_persist_handler);
+    if (!oldapi->myvoid || !reginfo || !handler) {
+        snmp_log(LOG_ERR, "pass_persist: out of memory\n");
+        netsnmp_handler_free(handler);
+        if (reginfo)
+            netsnmp_handler_registration_free(reginfo);
+        else
+            netsnmp_handler_free(oldapi);
+        return;
+    }
+    handler->myvoid = persistpassthru;
+    reginfo->priority = persistpassthru->mibpriority;
+
+    /*
+     * version 1 helpers get GETBULK as a series of GETNEXTs
+     */
+    netsnmp_inject_handler(reginfo, netsnmp_get_bulk_to_next_handler());
+    netsnmp_inject_handler(reginfo, handler);
+    netsnmp_register_handler(reginfo);
+}
+
+/*
+ * Find the pipe serving an entry; with a shared instance the entry is
+ * replaced by the one owning the pipe.  Returns -1 if it is gone.
+ */
+static int
+pass_persist_pipe_index(struct extensible **persistpassthru)
+{
+    int             i;
+
+    for (i = 1; i <= numpersistpassthrus; i++) {
+        if (get_exten_instance(persistpassthrus, i) != *persistpassthru)
+            continue;
+#ifdef USING_SINGLE_COMMON_PASSPERSIST_INSTANCE
+        {
+            int             pipe_idx =
+                get_exten_group_id((*persistpassthru)->passpersist_inst, i);
+
+            if (pipe_idx != i)
+                *persistpassthru = (*persistpassthru)->passpersist_inst;
+            return pipe_idx;
+        }
+#else
+        return i;
+#endif
+    }
+    return -1;
+}
+
+int
+pass_persist_handler(netsnmp_mib_handler *handler,
+                     netsnmp_handler_registration *reginfo,
+                     netsnmp_agent_request_info *reqinfo,
+                     netsnmp_request_info *requests)
+{
+#ifdef PASS_PERSIST_HAVE_V2
+    struct extensible *persistpassthru = handler->myvoid;
+    struct pass_persist_batch *batch, **bp;
+    netsnmp_request_info *request;
+    u_char         *msg = NULL;
+    size_t          msg_len = 0, out_len = 0;
+    char            buf[SNMP_MAXBUF + 32], oidbuf[SNMP_MAXBUF];
+    int             pipe_idx, n;
+
+    if (reqinfo->mode != MODE_GET && reqinfo->mode != MODE_GETNEXT &&
+        reqinfo->mode != MODE_GETBULK)
+        return netsnmp_call_next_handler(handler, reginfo, reqinfo,
+                                         requests);
+
+    pipe_idx = pass_persist_pipe_index(&persistpassthru);
+    if (pipe_idx < 0 || !init_persist_pipes())
+        return netsnmp_call_next_handler(handler, reginfo, reqinfo,
+                                         requests);
+    if (persist_pipes[pipe_idx].pid == NETSNMP_NO_SUCH_PROCESS &&
+        !open_persist_pipe(pipe_idx, persistpassthru->name)) {
+        if (reqinfo->mode == MODE_GET)
+            netsnmp_request_set_error_all(requests, SNMP_NOSUCHOBJECT);
+        return SNMP_ERR_NOERROR;
+    }
+    if (persist_pipes[pipe_idx].version < 2)
+        return netsnmp_call_next_handler(handler, reginfo, reqinfo,
+                                         requests);
+
+    /*
+     * one line per varbind, same OID choice as the version 1 code
+     */
+    n = 0;
+    for (request = requests; request; request = request->next) {
+        netsnmp_variable_list *var = request->requestvb;
+
+        if (request->processed)
+            continue;
+        if (reqinfo->mode != MODE_GET &&
+            (persistpassthru->miblen >= var->name_length ||
+             snmp_oidtree_compare(var->name, var->name_length,
+                                  persistpassthru->miboid,
+                                  persistpassthru->miblen) < 0))
+            sprint_mib_oid(oidbuf, persistpassthru->miboid,
+                           persistpassthru->miblen);
+        else
+            sprint_mib_oid(oidbuf, var->name, var->name_length);
+
+        if (reqinfo->mode == MODE_GET)
+            snprintf(buf, sizeof(buf), "get %s\n", oidbuf);
+        else if (reqinfo->mode == MODE_GETNEXT)
+            snprintf(buf, sizeof(buf), "getnext %s\n", oidbuf);
+        else
+            snprintf(buf, sizeof(buf), "next %d %s\n", request->repeat + 1,
+                     oidbuf);
+        if (!snmp_strcat(&msg, &msg_len, &out_len, 1, (u_char *) buf)) {
+            SNMP_FREE(msg);
+            netsnmp_request_set_error_all(requests, SNMP_ERR_GENERR);
+            return SNMP_ERR_NOERROR;
+        }
+        request->delegated = 1;
+        n++;
+    }
+    if (n == 0)
+        return SNMP_ERR_NOERROR;
+
+    batch = calloc(1, sizeof(*batch));
+    if (batch)
+        batch->cache = netsnmp_create_delegated_cache(handler, reginfo,
+                                                      reqinfo, requests,
+                                                      NULL);
+    if (!batch || !batch->cache) {
+        free(batch);
+        SNMP_FREE(msg);
+        for (request = requests; request; request = request->next)
+            request->delegated = 0;
+        netsnmp_request_set_error_all(requests, SNMP_ERR_GENERR);
+        return SNMP_ERR_NOERROR;
+    }
+    batch->tag = ++persist_pipes[pipe_idx].next_tag;
+    batch->nitems = n;
+    batch->sent = time(NULL);
+
+    snprintf(buf, sizeof(buf), "BATCH %u %d\n", batch->tag, n);
+    DEBUGMSGTL(("ucd-snmp/pass_persist", "persistpass-sending:\n%s%s",
+                buf, msg));
+    if (!write_persist_pipe(pipe_idx, buf) ||
+        !write_persist_pipe(pipe_idx, (char *) msg)) {
+        SNMP_FREE(msg);
+        close_persist_pipe(pipe_idx);
+        pass_persist_fail_batch(batch);
+        return SNMP_ERR_NOERROR;
+    }
+    SNMP_FREE(msg);
+
+    for (bp = &persist_pipes[pipe_idx].pending; *bp; bp = &(*bp)->next)
+        ;
+    *bp = batch;
+    return SNMP_ERR_NOERROR;
+#else
+    return netsnmp_call_next_handler(handler, reginfo, reqinfo, requests);
+#endif
+}
+
 u_char         *
 var_extensible_pass_persist(struct variable *vp,
                             oid * name,
@@ -296,7 +522,6 @@ var_extensible_pass_persist(struct variable *vp,
     char            buf[SNMP_MAXBUF];
     static char     buf2[SNMP_MAXBUF];
     struct extensible *persistpassthru;
-    FILE           *file;
     int             pipe_idx;
 
     /*
@@ -358,8 +583,8 @@ var_extensible_pass_persist(struct variable *vp,
              * valid call.  Exec and get output 
              */
 		
-            if ((file = persist_pipes[pipe_idx].fIn)) {
-                if (fgets(buf, sizeof(buf), file) == NULL) {
+            if (persist_pipes[pipe_idx].fdIn != -1) {
+                if (pass_persist_gets(pipe_idx, buf, sizeof(buf)) == NULL) {
                     *var_len = 0;
                     close_persist_pipe(pipe_idx);
                     return (NULL);
@@ -388,8 +613,9 @@ var_extensible_pass_persist(struct variable *vp,
                  */
                 *write_method = setPassPersist;
 
-                if (newlen == 0 || fgets(buf, sizeof(buf), file) == NULL
-                    || fgets(buf2, sizeof(buf2), file) == NULL) {
+                if (newlen == 0 ||
+                    pass_persist_gets(pipe_idx, buf, sizeof(buf)) == NULL ||
+                    pass_persist_gets(pipe_idx, buf2, sizeof(buf2)) == NULL) {
                     *var_len = 0;
                     close_persist_pipe(pipe_idx);
                     return (NULL);
@@ -470,7 +696,7 @@ setPassPersist(int action,
                 return SNMP_ERR_NOTWRITABLE;
             }
 
-            if (fgets(buf, sizeof(buf), persist_pipes[pipe_idx].fIn) == NULL) {
+            if (pass_persist_gets(pipe_idx, buf, sizeof(buf)) == NULL) {
                 close_persist_pipe(pipe_idx);
                 return SNMP_ERR_NOTWRITABLE;
             }
@@ -499,7 +725,7 @@ pass_persist_compare(const void *a, const void *b)
 /*
  * Initialize our persistent pipes
  *   - Returns 1 on success, 0 on failure.
- *   - Initializes all FILE pointers to NULL to indicate "closed"
+ *   - Initializes all file descriptors to -1 to indicate "closed"
  */
 static int
 init_persist_pipes(void)
@@ -520,9 +746,15 @@ init_persist_pipes(void)
     if (!persist_pipes)
         return 0;
     for (i = 0; i <= numpersistpassthrus; i++) {
-        persist_pipes[i].fIn = NULL;
+        persist_pipes[i].fdIn = -1;
         persist_pipes[i].fdOut = -1;
         persist_pipes[i].pid = NETSNMP_NO_SUCH_PROCESS;
+        persist_pipes[i].version = 0;
+        persist_pipes[i].rbuf = NULL;
+        persist_pipes[i].rlen = 0;
+        persist_pipes[i].rsize = 0;
+        persist_pipes[i].next_tag = 0;
+        persist_pipes[i].pending = NULL;
     }
     return 1;
 }
@@ -560,6 +792,12 @@ static void check_persist_pipes(unsigned clientreg, void *clientarg)
         if (process_stopped(i)) {
             snmp_log(LOG_INFO, "pass_persist[%d]: child process stopped - closing pipe\n", i);
             close_persist_pipe(i);
+        } else if (persist_pipes[i].pending &&
+                   persist_pipes[i].pending->sent + PASS_PERSIST_TIMEOUT <
+                   time(NULL)) {
+            snmp_log(LOG_WARNING, "pass_persist[%d]: no answer for %d seconds - closing pipe\n",
+                     i, PASS_PERSIST_TIMEOUT);
+            close_persist_pipe(i);
         }
     }
 }
@@ -621,11 +859,23 @@ open_persist_pipe(int iindex, char *command)
          */
         persist_pipes[iindex].pid = pid;
         persist_pipes[iindex].fdOut = fdOut;
-        persist_pipes[iindex].fIn = fdopen(fdIn, "r");
+        persist_pipes[iindex].fdIn = fdIn;
 
         DEBUGMSGTL(("ucd-snmp/pass_persist", "open_persist_pipe: opened the pipes\n"));
     }
 
+#ifdef PASS_PERSIST_HAVE_V2
+    /*
+     * version 1 exchanges are synchronous: finish the batches in flight
+     * first so that their answers are not mistaken for ours
+     */
+    pass_persist_drain(iindex);
+    if (persist_pipes[iindex].pid == NETSNMP_NO_SUCH_PROCESS) {
+        recurse = 0;
+        return 0;
+    }
+#endif
+
     /*
      * Send test packet always so we can self-catch 
      */
@@ -650,7 +900,7 @@ open_persist_pipe(int iindex, char *command)
             recurse = 0;
             return 0;
         }
-        if (fgets(buf, sizeof(buf), persist_pipes[iindex].fIn) == NULL) {
+        if (pass_persist_gets(iindex, buf, sizeof(buf)) == NULL) {
             DEBUGMSGTL(("ucd-snmp/pass_persist",
                         "open_persist_pipe: Error reading for PONG\n"));
             close_persist_pipe(iindex);
@@ -665,6 +915,23 @@ open_persist_pipe(int iindex, char *command)
             recurse = 0;
             return 0;
         }
+
+#ifdef PASS_PERSIST_HAVE_V2
+        /*
+         * "PONG 2" announces protocol version 2
+         */
+        if (persist_pipes[iindex].version == 0) {
+            persist_pipes[iindex].version =
+                atoi(buf + 4) >= 2 ? 2 : 1;
+            DEBUGMSGTL(("ucd-snmp/pass_persist",
+                        "open_persist_pipe: protocol version %d\n",
+                        persist_pipes[iindex].version));
+            if (persist_pipes[iindex].version == 2)
+                register_readfd(persist_pipes[iindex].fdIn,
+                                pass_persist_readable,
+                                (void *) (intptr_t) iindex);
+        }
+#endif
     }
 
     recurse = 0;
@@ -712,6 +979,21 @@ write_persist_pipe(int iindex, const char *data)
 static void
 close_persist_pipe(int iindex)
 {
+#ifdef PASS_PERSIST_HAVE_V2
+    struct pass_persist_batch *batch;
+
+    if (persist_pipes[iindex].version == 2 && persist_pipes[iindex].fdIn != -1)
+        unregister_readfd(persist_pipes[iindex].fdIn);
+    while ((batch = persist_pipes[iindex].pending) != NULL) {
+        persist_pipes[iindex].pending = batch->next;
+        pass_persist_fail_batch(batch);
+    }
+#endif
+    SNMP_FREE(persist_pipes[iindex].rbuf);
+    persist_pipes[iindex].rlen = 0;
+    persist_pipes[iindex].rsize = 0;
+    persist_pipes[iindex].version = 0;
+
     /*
      * Check and nix every item 
      */
@@ -719,9 +1001,9 @@ close_persist_pipe(int iindex)
         close(persist_pipes[iindex].fdOut);
         persist_pipes[iindex].fdOut = -1;
     }
-    if (persist_pipes[iindex].fIn) {
-        fclose(persist_pipes[iindex].fIn);
-        persist_pipes[iindex].fIn = (FILE *) 0;
+    if (persist_pipes[iindex].fdIn != -1) {
+        close(persist_pipes[iindex].fdIn);
+        persist_pipes[iindex].fdIn = -1;
     }
 
     if (persist_pipes[iindex].pid != NETSNMP_NO_SUCH_PROCESS) {
@@ -744,3 +1026,325 @@ close_persist_pipe(int iindex)
     }
 
 }
+
+/*
+ * Copy the next line (including its newline) out of [*cur, end).
+ * Returns 0 if the line is not complete yet.
+ */
+static int
+pass_persist_line(const char **cur, const char *end, char *buf, size_t size)
+{
+    const char     *nl;
+    size_t          len;
+
+    if (*cur >= end || (nl = memchr(*cur, '\n', end - *cur)) == NULL)
+        return 0;
+    len = nl + 1 - *cur;
+    if (len > size - 1)
+        len = size - 1;
+    memcpy(buf, *cur, len);
+    buf[len] = '\0';
+    *cur = nl + 1;
+    return 1;
+}
+
+/*
+ * All output of a helper goes through the pipe's buffer: read what is
+ * available, waiting at most timeout seconds for it.  Returns the number
+ * of bytes read, 0 if there was nothing to read in time, -1 if the
+ * helper closed its output and -2 if it wrote more than
+ * PASS_PERSIST_MAX_OUTPUT bytes without finishing an answer.
+ */
+static int
+pass_persist_fill(int iindex, int timeout)
+{
+    struct persist_pipe_type *pipe = &persist_pipes[iindex];
+    ssize_t         got;
+
+    if (pipe->rsize - pipe->rlen < 1024) {
+        size_t          size = pipe->rsize ? 2 * pipe->rsize : 4096;
+        char           *rbuf;
+
+        if (size > PASS_PERSIST_MAX_OUTPUT) {
+            snmp_log(LOG_ERR, "pass_persist[%d]: more than %d bytes of unanswered output - closing pipe\n",
+                     iindex, PASS_PERSIST_MAX_OUTPUT);
+            return -2;
+        }
+        rbuf = realloc(pipe->rbuf, size);
+        if (!rbuf)
+            return -1;
+        pipe->rbuf = rbuf;
+        pipe->rsize = size;
+    }
+
+#ifdef PASS_PERSIST_HAVE_V2
+    /*
+     * select() on pipes works wherever version 2 does
+     */
+    {
+        netsnmp_large_fd_set readfds;
+        struct timeval  tv;
+        int             count;
+
+        netsnmp_large_fd_set_init(&readfds, pipe->fdIn + 1);
+        NETSNMP_LARGE_FD_SET(pipe->fdIn, &readfds);
+        tv.tv_sec = timeout;
+        tv.tv_usec = 0;
+        count = netsnmp_large_fd_set_select(pipe->fdIn + 1, &readfds, NULL,
+                                            NULL, &tv);
+        netsnmp_large_fd_set_cleanup(&readfds);
+        if (count < 0 && errno == EINTR)
+            return 0;
+        if (count < 0)
+            return -1;
+        if (count == 0)
+            return 0;
+    }
+#endif
+
+    got = read(pipe->fdIn, pipe->rbuf + pipe->rlen, pipe->rsize - pipe->rlen);
+    if (got < 0 && (errno == EINTR || errno == EAGAIN))
+        return 0;
+    if (got <= 0)
+        return -1;
+    pipe->rlen += got;
+    return got;
+}
+
+/*
+ * fgets() for a helper's output, giving up after PASS_PERSIST_TIMEOUT
+ * seconds.  The caller closes the pipe if this returns NULL.
+ */
+static char *
+pass_persist_gets(int iindex, char *buf, size_t size)
+{
+    struct persist_pipe_type *pipe = &persist_pipes[iindex];
+    time_t          deadline = time(NULL) + PASS_PERSIST_TIMEOUT;
+    const char     *cur;
+    int             left;
+
+    for (;;) {
+        cur = pipe->rbuf;
+        if (pass_persist_line(&cur, pipe->rbuf + pipe->rlen, buf, size)) {
+            pipe->rlen -= cur - pipe->rbuf;
+            memmove(pipe->rbuf, cur, pipe->rlen);
+            return buf;
+        }
+        left = deadline - time(NULL);
+        if (left <= 0) {
+            snmp_log(LOG_WARNING, "pass_persist[%d]: no answer for %d seconds\n",
+                     iindex, PASS_PERSIST_TIMEOUT);
+            return NULL;
+        }
+        if (pass_persist_fill(iindex, left) < 0)
+            return NULL;
+    }
+}
+
+#ifdef PASS_PERSIST_HAVE_V2
+/*
+ * Give up on a batch: GETs get noSuchObject, GETNEXTs are left alone so
+ * that the agent moves on, as for a version 1 helper that went away.
+ */
+static void
+pass_persist_fail_batch(struct pass_persist_batch *batch)
+{
+    netsnmp_delegated_cache *cache;
+    netsnmp_request_info *request;
+
+    cache = netsnmp_handler_check_cache(batch->cache);
+    if (cache) {
+        for (request = cache->requests; request; request = request->next) {
+            if (!request->delegated)
+                continue;
+            request->delegated = 0;
+            if (cache->reqinfo->mode == MODE_GET)
+                netsnmp_set_request_error(cache->reqinfo, request,
+                                          SNMP_NOSUCHOBJECT);
+        }
+    }
+    netsnmp_free_delegated_cache(batch->cache);
+    free(batch);
+}
+
+/*
+ * Store one returned variable in a request.  Returns 0 once the request
+ * takes no more values.
+ */
+static int
+pass_persist_set_var(netsnmp_agent_request_info *reqinfo,
+                     netsnmp_request_info *request, int rep,
+                     char *oidline, char *typeline, char *valueline)
+{
+    struct variable var;
+    oid             newname[MAX_OID_LEN];
+    int             newlen;
+    u_char         *val;
+    size_t          val_len = 0;
+
+    newlen = parse_miboid(oidline, newname);
+    val = netsnmp_internal_pass_parse(typeline, valueline, &val_len, &var);
+    if (newlen == 0 || val == NULL) {
+        if (rep == 0 && reqinfo->mode == MODE_GET)
+            netsnmp_set_request_error(reqinfo, request, SNMP_NOSUCHOBJECT);
+        return 0;
+    }
+
+    if (reqinfo->mode != MODE_GET)
+        snmp_set_var_objid(request->requestvb, newname, newlen);
+    snmp_set_var_typed_value(request->requestvb, var.type, val, val_len);
+    if (reqinfo->mode != MODE_GETBULK)
+        return 0;
+
+    /*
+     * same as netsnmp_bulk_to_next_fix_requests(): the next value goes
+     * into the next repetition
+     */
+    if (request->repeat <= 0 || !request->requestvb->next_variable)
+        return 0;
+    request->repeat--;
+    snmp_set_var_objid(request->requestvb->next_variable,
+                       request->requestvb->name,
+                       request->requestvb->name_length);
+    request->requestvb = request->requestvb->next_variable;
+    request->requestvb->type = ASN_PRIV_RETRY;
+    if (request->inclusive == 2)
+        request->inclusive = 0;
+    return 1;
+}
+
+/*
+ * An answer is "BATCH <tag> <n>" followed, for each of the n lines of
+ * the request, by a count k and k OID/TYPE/VALUE triples.  Returns the
+ * number of bytes used, 0 if the answer is incomplete or -1 if it does
+ * not match the batch.
+ */
+static int
+pass_persist_parse_answer(const char *data, size_t len,
+                          struct pass_persist_batch *batch)
+{
+    const char     *cur = data, *end = data + len;
+    char            line[SNMP_MAXBUF], type[SNMP_MAXBUF];
+    char            value[SNMP_MAXBUF];
+    netsnmp_delegated_cache *cache;
+    netsnmp_request_info *request;
+    unsigned int    tag;
+    int             i, j, n, k;
+    int             pass;
+
+    /*
+     * first pass checks that the answer is complete, second one applies it
+     */
+    for (pass = 0; pass < 2; pass++) {
+        cur = data;
+        if (!pass_persist_line(&cur, end, line, sizeof(line)))
+            return 0;
+        if (sscanf(line, "BATCH %u %d", &tag, &n) != 2 ||
+            tag != batch->tag || n != batch->nitems)
+            return -1;
+
+        cache = pass ? netsnmp_handler_check_cache(batch->cache) : NULL;
+        request = cache ? cache->requests : NULL;
+
+        for (i = 0; i < n; i++) {
+            int             more;
+
+            while (request && !request->delegated)
+                request = request->next;
+            if (request)
+                request->delegated = 0;
+
+            if (!pass_persist_line(&cur, end, line, sizeof(line)))
+                return 0;
+            k = atoi(line);
+            if (k < 0)
+                return -1;
+            if (request && k == 0 && cache->reqinfo->mode == MODE_GET)
+                netsnmp_set_request_error(cache->reqinfo, request,
+                                          SNMP_NOSUCHOBJECT);
+            for (j = 0, more = 1; j < k; j++) {
+                if (!pass_persist_line(&cur, end, line, sizeof(line)) ||
+                    !pass_persist_line(&cur, end, type, sizeof(type)) ||
+                    !pass_persist_line(&cur, end, value, sizeof(value)))
+                    return 0;
+                if (request && more)
+                    more = pass_persist_set_var(cache->reqinfo, request, j,
+                                                line, type, value);
+            }
+            if (request)
+                request = request->next;
+        }
+    }
+    return cur - data;
+}
+
+/*
+ * Read answers for up to timeout seconds and apply the complete ones.
+ */
+static void
+pass_persist_read(int iindex, int timeout)
+{
+    struct persist_pipe_type *pipe = &persist_pipes[iindex];
+    struct pass_persist_batch *batch;
+    int             got, used;
+
+    got = pass_persist_fill(iindex, timeout);
+    if (got == 0)
+        return;
+    if (got < 0) {
+        if (got == -1)
+            snmp_log(LOG_INFO, "pass_persist[%d]: child process closed its output - closing pipe\n", iindex);
+        close_persist_pipe(iindex);
+        return;
+    }
+
+    while ((batch = pipe->pending) != NULL) {
+        used = pass_persist_parse_answer(pipe->rbuf, pipe->rlen, batch);
+        if (used == 0)
+            return;
+        if (used < 0)
+            break;
+        DEBUGMSGTL(("ucd-snmp/pass_persist", "persistpass-answered: %u\n",
+                    batch->tag));
+        pipe->pending = batch->next;
+        netsnmp_free_delegated_cache(batch->cache);
+        free(batch);
+        pipe->rlen -= used;
+        memmove(pipe->rbuf, pipe->rbuf + used, pipe->rlen);
+    }
+    if (pipe->rlen > 0) {
+        snmp_log(LOG_ERR, "pass_persist[%d]: unexpected output - closing pipe\n",
+                 iindex);
+        close_persist_pipe(iindex);
+    }
+}
+
+static void
+pass_persist_readable(int fd, void *data)
+{
+    pass_persist_read((int) (intptr_t) data, 0);
+}
+
+/*
+ * Wait for all outstanding batches of a pipe to be answered, closing the
+ * pipe if one of them is not answered within PASS_PERSIST_TIMEOUT.
+ */
+static void
+pass_persist_drain(int iindex)
+{
+    struct pass_persist_batch *batch;
+    int             left;
+
+    while ((batch = persist_pipes[iindex].pending) != NULL &&
+           persist_pipes[iindex].pid != NETSNMP_NO_SUCH_PROCESS) {
+        left = batch->sent + PASS_PERSIST_TIMEOUT - time(NULL);
+        if (left <= 0) {
+            snmp_log(LOG_WARNING, "pass_persist[%d]: no answer for %d seconds - closing pipe\n",
+                     iindex, PASS_PERSIST_TIMEOUT);
+            close_persist_pipe(iindex);
+            return;
+        }
+        pass_persist_read(iindex, left);
+    }
+}
+#endif /* PASS_PERSIST_HAVE_V2 */
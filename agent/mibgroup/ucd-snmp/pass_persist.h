@@ -12,6 +12,7 @@ void            init_pass_persist(void);
 void            shutdown_pass_persist(void);
 extern FindVarMethod var_extensible_pass_persist;
 extern WriteMethod setPassPersist;
+Netsnmp_Node_Handler pass_persist_handler;
 
 /*
  * config file parsing routines 
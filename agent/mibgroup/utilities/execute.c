@@ -18,6 +18,9 @@
 #include <malloc.h>
 #endif
 #include <sys/types.h>
+#ifdef HAVE_SPAWN_H
+#include <spawn.h>
+#endif
 #include <ctype.h>
 #ifdef HAVE_FCNTL_H
 #include <fcntl.h>
@@ -45,6 +48,20 @@
 #define pclose _pclose
 #endif
 
+/*
+ * posix_spawn() avoids duplicating the agent's address space for every
+ * command, but can only be used where it is able to close the agent's
+ * other file descriptors in the child.
+ */
+#if defined(HAVE_POSIX_SPAWN) && defined(HAVE_SPAWN_H) && defined(__GLIBC__)
+#if __GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 34)
+#define NETSNMP_EXEC_USE_SPAWN 1
+#ifndef __USE_GNU
+extern char **environ;
+#endif
+#endif
+#endif
+
 
 /**
  * Run a shell command by calling system() or popen().
@@ -186,44 +203,83 @@ tokenize_exec_command(const char *command, int *argc)
 
     return argv;
 }
-#endif
 
-/**
- * Run a command by calling execv().
- *
- * @command: Shell command to run.
- * @input:   Data to send to stdin. May be NULL.
- * @output:  Buffer in which to store the output written to stdout. May be NULL.
- * @out_len: Size of the output buffer. The actual number of bytes written is
- *           stored in *@out_len.
+static void
+free_exec_command(char **argv, int argc)
+{
+    int  i;
+
+    for (i = 0; i < argc; i++)
+        free(argv[i]);
+    free(argv);
+}
+
+/*
+ * Start a command with its stdin and stdout connected to new pipes,
+ *   and stderr sharing stdout.  The parent's end of each pipe is
+ *   returned via @in_fd and @out_fd.
  *
- * @return >= 0 if the command has been executed; -1 if the command could not
- *           be executed.
+ * @return the process ID of the child, or -1 on failure.
  */
-int
-run_exec_command(const char *command, const char *input,
-                 char *output, int *out_len)
+static int
+spawn_exec_command(const char *command, int shell, int *in_fd, int *out_fd)
 {
-#ifdef HAVE_EXECV
     int ipipe[2];
     int opipe[2];
-    int i;
     int pid;
-    int result;
     char **argv;
     int argc;
 
-    DEBUGMSGTL(("run:exec", "running '%s'\n", command));
+    if (shell) {
+        argc = 3;
+        argv = calloc(argc + 1, sizeof(char *));
+        if (argv) {
+            argv[0] = strdup("/bin/sh");
+            argv[1] = strdup("-c");
+            argv[2] = strdup(command);
+        }
+    } else
+        argv = tokenize_exec_command(command, &argc);
+    if (!argv)
+        return -1;
+
     if (pipe(ipipe) < 0) {
         snmp_log_perror("pipe");
+        free_exec_command(argv, argc);
         return -1;
     }
     if (pipe(opipe) < 0) {
         snmp_log_perror("pipe");
         close(ipipe[0]);
         close(ipipe[1]);
+        free_exec_command(argv, argc);
         return -1;
     }
+
+#ifdef NETSNMP_EXEC_USE_SPAWN
+    {
+        posix_spawn_file_actions_t file_actions;
+        pid_t child;
+        int rc;
+
+        posix_spawn_file_actions_init(&file_actions);
+        posix_spawn_file_actions_adddup2(&file_actions, ipipe[0],
+                                         STDIN_FILENO);
+        posix_spawn_file_actions_adddup2(&file_actions, opipe[1],
+                                         STDOUT_FILENO);
+        posix_spawn_file_actions_adddup2(&file_actions, opipe[1],
+                                         STDERR_FILENO);
+        posix_spawn_file_actions_addclosefrom_np(&file_actions,
+                                                 STDERR_FILENO + 1);
+        rc = posix_spawn(&child, argv[0], &file_actions, NULL, argv, environ);
+        posix_spawn_file_actions_destroy(&file_actions);
+        if (rc != 0) {
+            snmp_log(LOG_ERR, "%s: %s\n", argv[0], strerror(rc));
+            pid = -1;
+        } else
+            pid = child;
+    }
+#else
     if ((pid = fork()) == 0) {
         /*
          * Child process
@@ -254,22 +310,55 @@ run_exec_command(const char *command, const char *input,
 
         netsnmp_close_fds(2);
 
-        /*
-         * Set up the argv array and execute it
-         * This is being run in the child process,
-         *   so will release resources when it terminates.
-         */
-        argv = tokenize_exec_command(command, &argc);
-        if (!argv)
-            exit(1);
         execv(argv[0], argv);
         snmp_log_perror(argv[0]);
-        for (i = 0; i < argc; i++)
-            free(argv[i]);
-        free(argv);
         exit(1);        /* End of child */
+    } else if (pid < 0)
+        snmp_log_perror("fork");
+#endif /* NETSNMP_EXEC_USE_SPAWN */
+
+    free_exec_command(argv, argc);
+    close(ipipe[0]);
+    close(opipe[1]);
+    if (pid < 0) {
+        close(ipipe[1]);
+        close(opipe[0]);
+        return -1;
+    }
+    *in_fd  = ipipe[1];
+    *out_fd = opipe[0];
+    return pid;
+}
+#endif
 
-    } else if (pid > 0) {
+/**
+ * Run a command by calling execv().
+ *
+ * @command: Shell command to run.
+ * @input:   Data to send to stdin. May be NULL.
+ * @output:  Buffer in which to store the output written to stdout. May be NULL.
+ * @out_len: Size of the output buffer. The actual number of bytes written is
+ *           stored in *@out_len.
+ *
+ * @return >= 0 if the command has been executed; -1 if the command could not
+ *           be executed.
+ */
+int
+run_exec_command(const char *command, const char *input,
+                 char *output, int *out_len)
+{
+#ifdef HAVE_EXECV
+    int in_fd;
+    int out_fd;
+    int i;
+    int pid;
+    int result;
+
+    DEBUGMSGTL(("run:exec", "running '%s'\n", command));
+    pid = spawn_exec_command(command, 0, &in_fd, &out_fd);
+    if (pid < 0) {
+        return -1;
+    } else {
         char            cache[NETSNMP_MAXCACHESIZE];
         char           *cache_ptr;
         ssize_t         count, cache_size, offset = 0;
@@ -286,11 +375,9 @@ run_exec_command(const char *command, const char *input,
          * wait for the child to finish executing, and read
          *    any output into the output buffer (if provided)
          */
-        close(ipipe[0]);
-        close(opipe[1]);
-        if (input && write(ipipe[1], input, strlen(input)) < 0)
+        if (input && write(in_fd, input, strlen(input)) < 0)
             snmp_log_perror("write() to input pipe");
-        close(ipipe[1]);
+        close(in_fd);
 
         /*
          * child will block if it writes a lot of data and
@@ -316,14 +403,14 @@ run_exec_command(const char *command, const char *input,
          * routine for both to use.
          */
         DEBUGMSGTL(("verbose:run:exec","  waiting for child %d...\n", pid));
-        numfds = opipe[0] + 1;
+        numfds = out_fd + 1;
         i = NETSNMP_MAXREADCOUNT;
         for (; i; --i) {
             /*
              * set up data for select
              */
             FD_ZERO(&readfds);
-            FD_SET(opipe[0], &readfds);
+            FD_SET(out_fd, &readfds);
             timeout.tv_sec = 1;
             timeout.tv_usec = 0;
 
@@ -343,7 +430,7 @@ run_exec_command(const char *command, const char *input,
                 continue;
             }
 
-            if (!FD_ISSET(opipe[0], &readfds)) {
+            if (!FD_ISSET(out_fd, &readfds)) {
                 DEBUGMSGTL(("verbose:run:exec", "    fd not ready!\n"));
                 continue;
             }
@@ -351,7 +438,7 @@ run_exec_command(const char *command, const char *input,
             /*
              * read data from the pipe, optionally saving to output buffer
              */
-            count = read(opipe[0], &cache_ptr[offset], cache_size);
+            count = read(out_fd, &cache_ptr[offset], cache_size);
             DEBUGMSGTL(("verbose:run:exec",
                         "    read %d bytes\n", (int)count));
             if (0 == count) {
@@ -406,7 +493,7 @@ run_exec_command(const char *command, const char *input,
         /*
          * close pipe to signal that we aren't listening any more.
          */
-        close(opipe[0]);
+        close(out_fd);
 
         /*
          * if we didn't wait successfully above, wait now.
@@ -430,19 +517,8 @@ run_exec_command(const char *command, const char *input,
                     pid,result));
 
         return WEXITSTATUS(result);
-
-    } else {
-        /*
-         * Parent process - fork failed
-         */
-        snmp_log_perror("fork");
-        close(ipipe[0]);
-        close(ipipe[1]);
-        close(opipe[0]);
-        close(opipe[1]);
-        return -1;
     }
-    
+
 #else
     /*
      * If necessary, fall back to using 'system'
@@ -451,3 +527,48 @@ run_exec_command(const char *command, const char *input,
     return run_shell_command( command, input, output, out_len );
 #endif
 }
+
+/**
+ * Start a command without waiting for it to finish.
+ *
+ * @command: Command to run.
+ * @input:   Data to send to stdin. May be NULL.
+ * @shell:   Non-zero to run the command via /bin/sh, rather than execv().
+ * @out_fd:  Set to the (non-blocking) read end of a pipe connected to the
+ *           command's stdout and stderr.
+ *
+ * @return the process ID of the command, or -1 if it could not be started.
+ *           The caller must read and close @out_fd, and reap the process
+ *           using waitpid().
+ */
+int
+run_command_async(const char *command, const char *input, int shell,
+                  int *out_fd)
+{
+#ifdef HAVE_EXECV
+    int in_fd;
+    int pid;
+
+    if (!command || !out_fd)
+        return -1;
+
+    DEBUGMSGTL(("run:async", "starting '%s'\n", command));
+    pid = spawn_exec_command(command, shell, &in_fd, out_fd);
+    if (pid < 0)
+        return -1;
+
+    /*
+     * The input is a single DisplayString, so fits in the pipe buffer
+     */
+    fcntl(in_fd, F_SETFL, fcntl(in_fd, F_GETFL) | O_NONBLOCK);
+    if (input && write(in_fd, input, strlen(input)) < 0)
+        snmp_log_perror("write() to input pipe");
+    close(in_fd);
+    fcntl(*out_fd, F_SETFL, fcntl(*out_fd, F_GETFL) | O_NONBLOCK);
+
+    DEBUGMSGTL(("run:async", "  started child %d\n", pid));
+    return pid;
+#else
+    return -1;
+#endif
+}
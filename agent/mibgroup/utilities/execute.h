@@ -7,5 +7,7 @@ int run_shell_command(const char *command, const char *input,
                       char *output, int *out_len);
 int run_exec_command(const char *command, const char *input,
                      char *output, int *out_len);
+int run_command_async(const char *command, const char *input, int shell,
+                      int *out_fd);
 
 #endif /* _MIBGROUP_EXECUTE_H */
@@ -198,6 +198,9 @@ const char     *app_name = "snmpd";
 #ifdef USING_SMUX_MODULE
 #include <mibgroup/smux/smux.h>
 #endif /* USING_SMUX_MODULE */
+#ifdef USING_AGENTX_MASTER_MODULE
+#include <mibgroup/agentx/master.h>
+#endif /* USING_AGENTX_MASTER_MODULE */
 
 /*
  * Prototypes.
@@ -330,6 +333,10 @@ RETSIGTYPE
 SnmpdDump(int a)
 {
     dump_registry();
+#ifdef USING_AGENTX_MASTER_MODULE
+    agentx_master_dump_stats();
+#endif
+    netsnmp_latency_stats_dump();
     signal(SIGUSR1, SnmpdDump);
 }
 #endif
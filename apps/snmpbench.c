@@ -0,0 +1,767 @@
+/*
+ * snmpbench.c - measure the throughput and latency of an SNMP agent.
+ *
+ * A number of worker processes each keep a window of asynchronous
+ * requests outstanding against the agent for a fixed time (or a fixed
+ * number of requests), once for each of the requested PDU types.  The
+ * request rate and the latency distribution of each PDU type are
+ * printed as a JSON object, for testing/RUNBENCH to collect.
+ *
+ * Workers are processes rather than threads: a session, and most of
+ * the library state behind it, must not be shared between threads.
+ */
+#include <net-snmp/net-snmp-config.h>
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#include <strings.h>
+#endif
+#include <sys/types.h>
+#ifdef HAVE_NETINET_IN_H
+#include <netinet/in.h>
+#endif
+#ifdef TIME_WITH_SYS_TIME
+# include <sys/time.h>
+# include <time.h>
+#else
+# ifdef HAVE_SYS_TIME_H
+#  include <sys/time.h>
+# else
+#  include <time.h>
+# endif
+#endif
+#ifdef HAVE_SYS_SELECT_H
+#include <sys/select.h>
+#endif
+#ifdef HAVE_SYS_WAIT_H
+#include <sys/wait.h>
+#endif
+#include <stdio.h>
+#include <errno.h>
+
+#include <net-snmp/net-snmp-includes.h>
+
+#define BENCH_MAX_TYPES 4
+
+/*
+ * Latencies (in microseconds) are counted in a log-linear histogram:
+ * exact below BENCH_SUB_BUCKETS, then BENCH_SUB_BUCKETS buckets for
+ * every power of two above that, which keeps the error of a percentile
+ * below about 3%.
+ */
+#define BENCH_SUB_BITS    5
+#define BENCH_SUB_BUCKETS (1 << BENCH_SUB_BITS)
+#define BENCH_HIST_SIZE   (BENCH_SUB_BUCKETS * (32 - BENCH_SUB_BITS + 1))
+
+typedef struct bench_result_s {
+    u_long          requests;
+    u_long          responses;
+    u_long          errors;
+    u_long          timeouts;
+    double          seconds;
+    double          total_usec;
+    u_long          min_usec;
+    u_long          max_usec;
+    u_long          hist[BENCH_HIST_SIZE];
+} bench_result;
+
+typedef struct bench_slot_s {
+    struct timeval  sent;
+    oid             cursor[SNMP_MAX_CMDLINE_OIDS][MAX_OID_LEN];
+    size_t          cursor_len[SNMP_MAX_CMDLINE_OIDS];
+} bench_slot;
+
+static const struct {
+    const char     *name;
+    int             command;
+} pdu_types[] = {
+    { "get",     SNMP_MSG_GET },
+    { "getnext", SNMP_MSG_GETNEXT },
+    { "getbulk", SNMP_MSG_GETBULK },
+#ifndef NETSNMP_NO_WRITE_SUPPORT
+    { "set",     SNMP_MSG_SET },
+#endif
+};
+
+static oid      names[SNMP_MAX_CMDLINE_OIDS][MAX_OID_LEN];
+static size_t   name_lengths[SNMP_MAX_CMDLINE_OIDS];
+/* walks stay below names[i] cut to root_lengths[i] */
+static size_t   root_lengths[SNMP_MAX_CMDLINE_OIDS];
+static int      nnames;
+
+static int      types[BENCH_MAX_TYPES];
+static int      ntypes;
+static int      duration = 5, duration_set;
+static long     total_requests;
+static int      workers = 1, outstanding = 1, repetitions = 10;
+static const char *label = "";
+
+/*
+ * the state of the phase being run by this process
+ */
+static struct {
+    int             command;
+    long            remaining;  /* requests still to send, -1: no limit */
+    int             active;     /* requests outstanding */
+    int             stop;
+    long            set_value;
+    struct timeval  start, deadline, last;
+    bench_result   *result;
+} phase;
+
+void
+usage(void)
+{
+    fprintf(stderr, "USAGE: snmpbench ");
+    snmp_parse_args_usage(stderr);
+    fprintf(stderr, " OID [OID]...\n\n");
+    snmp_parse_args_descriptions(stderr);
+    fprintf(stderr,
+            "  -C APPOPTS\t\tSet various application specific behaviours:\n");
+    fprintf(stderr,
+            "\t\t\t  t<TYPES>: comma separated PDU types to measure, of\n"
+            "\t\t\t\t    get,getnext,getbulk,set (default get)\n");
+    fprintf(stderr,
+            "\t\t\t  d<SECS>:  measure each PDU type for <SECS> seconds\n"
+            "\t\t\t\t    (default 5)\n");
+    fprintf(stderr,
+            "\t\t\t  n<NUM>:   send <NUM> requests of each PDU type\n");
+    fprintf(stderr,
+            "\t\t\t  w<NUM>:   number of worker processes (default 1)\n");
+    fprintf(stderr,
+            "\t\t\t  c<NUM>:   requests outstanding per worker (default 1)\n");
+    fprintf(stderr,
+            "\t\t\t  r<NUM>:   max-repetitions of getbulk (default 10)\n");
+    fprintf(stderr,
+            "\t\t\t  l<LABEL>: label to include in the output\n");
+}
+
+static int
+get_number(char **arg, const char *what)
+{
+    char           *end;
+    long            value = strtol(*arg, &end, 10);
+
+    if (end == *arg || value < 0) {
+        fprintf(stderr, "Bad %s value after -C: %s\n", what, *arg);
+        exit(1);
+    }
+    *arg = end;
+    return (int) value;
+}
+
+static void
+parse_types(char *arg)
+{
+    char           *type, *st;
+    int             i;
+
+    ntypes = 0;
+    for (type = strtok_r(arg, ",", &st); type;
+         type = strtok_r(NULL, ",", &st)) {
+        for (i = 0; i < (int) (sizeof(pdu_types) / sizeof(pdu_types[0]));
+             i++)
+            if (!strcmp(type, pdu_types[i].name))
+                break;
+        if (i == (int) (sizeof(pdu_types) / sizeof(pdu_types[0]))) {
+            fprintf(stderr, "Unknown PDU type passed to -Ct: %s\n", type);
+            exit(1);
+        }
+        if (ntypes == BENCH_MAX_TYPES) {
+            fprintf(stderr, "Too many PDU types passed to -Ct\n");
+            exit(1);
+        }
+        types[ntypes++] = i;
+    }
+}
+
+static void
+optProc(int argc, char *const *argv, int opt)
+{
+    char           *arg;
+
+    switch (opt) {
+    case 'C':
+        arg = optarg;
+        while (*arg) {
+            switch (*arg++) {
+            case 't':
+                /* the types are the rest of the argument */
+                parse_types(arg);
+                arg += strlen(arg);
+                break;
+            case 'd':
+                duration = get_number(&arg, "duration");
+                duration_set = 1;
+                break;
+            case 'n':
+                total_requests = get_number(&arg, "request count");
+                break;
+            case 'w':
+                workers = get_number(&arg, "worker count");
+                break;
+            case 'c':
+                outstanding = get_number(&arg, "outstanding requests");
+                break;
+            case 'r':
+                repetitions = get_number(&arg, "max-repetitions");
+                break;
+            case 'l':
+                /* the label is the rest of the argument */
+                label = arg;
+                arg += strlen(arg);
+                break;
+            default:
+                fprintf(stderr, "Unknown flag passed to -C: %c\n", arg[-1]);
+                exit(1);
+            }
+        }
+        break;
+    }
+}
+
+static int
+hist_bucket(u_long usec)
+{
+    int             bits = 0;
+
+    if (usec < BENCH_SUB_BUCKETS)
+        return (int) usec;
+    if (usec > 0xffffffffUL)
+        usec = 0xffffffffUL;
+    while ((usec >> bits) >= 2 * BENCH_SUB_BUCKETS)
+        bits++;
+    return BENCH_SUB_BUCKETS * (bits + 1) +
+        (int) ((usec >> bits) - BENCH_SUB_BUCKETS);
+}
+
+/*
+ * the middle of the range of latencies counted by a bucket
+ */
+static double
+hist_value(int bucket)
+{
+    int             bits;
+
+    if (bucket < BENCH_SUB_BUCKETS)
+        return bucket;
+    bits = bucket / BENCH_SUB_BUCKETS - 1;
+    return (double) ((u_long) (BENCH_SUB_BUCKETS +
+                               bucket % BENCH_SUB_BUCKETS) << bits) +
+        ((1UL << bits) - 1) / 2.0;
+}
+
+static double
+hist_percentile(const bench_result *result, double percent)
+{
+    u_long          count = 0, want;
+    double          value;
+    int             i;
+
+    want = (u_long) (result->responses * percent / 100.0 + 0.5);
+    if (want == 0)
+        want = 1;
+    for (i = 0; i < BENCH_HIST_SIZE; i++) {
+        count += result->hist[i];
+        if (count >= want)
+            break;
+    }
+    if (i == BENCH_HIST_SIZE)
+        return result->max_usec;
+    value = hist_value(i);
+    if (value > result->max_usec)
+        value = result->max_usec;
+    if (value < result->min_usec)
+        value = result->min_usec;
+    return value;
+}
+
+static void
+record_latency(bench_result *result, const struct timeval *sent,
+               const struct timeval *now)
+{
+    struct timeval  diff;
+    u_long          usec;
+
+    NETSNMP_TIMERSUB(now, sent, &diff);
+    usec = diff.tv_sec * 1000000UL + diff.tv_usec;
+    if (result->responses == 1 || usec < result->min_usec)
+        result->min_usec = usec;
+    if (usec > result->max_usec)
+        result->max_usec = usec;
+    result->total_usec += usec;
+    result->hist[hist_bucket(usec)]++;
+}
+
+static int      bench_response(int op, netsnmp_session *ss, int reqid,
+                               netsnmp_pdu *pdu, void *magic);
+
+static void
+send_slot(netsnmp_session *ss, bench_slot *slot)
+{
+    netsnmp_pdu    *pdu;
+    int             i;
+
+    if (phase.stop || phase.remaining == 0)
+        return;
+
+    pdu = snmp_pdu_create(phase.command);
+    switch (phase.command) {
+    case SNMP_MSG_GET:
+        for (i = 0; i < nnames; i++)
+            snmp_add_null_var(pdu, names[i], name_lengths[i]);
+        break;
+    case SNMP_MSG_GETBULK:
+        pdu->non_repeaters = 0;
+        pdu->max_repetitions = repetitions;
+        /* FALL THROUGH */
+    case SNMP_MSG_GETNEXT:
+        for (i = 0; i < nnames; i++)
+            snmp_add_null_var(pdu, slot->cursor[i], slot->cursor_len[i]);
+        break;
+    case SNMP_MSG_SET:
+        phase.set_value++;
+        for (i = 0; i < nnames; i++)
+            snmp_pdu_add_variable(pdu, names[i], name_lengths[i],
+                                  ASN_INTEGER, &phase.set_value,
+                                  sizeof(phase.set_value));
+        break;
+    }
+
+    netsnmp_get_monotonic_clock(&slot->sent);
+    if (snmp_async_send(ss, pdu, bench_response, slot) == 0) {
+        snmp_perror("snmpbench");
+        snmp_free_pdu(pdu);
+        phase.result->errors++;
+        /* give up on this slot rather than spin on a broken session */
+        return;
+    }
+    if (phase.remaining > 0)
+        phase.remaining--;
+    phase.active++;
+    phase.result->requests++;
+}
+
+/*
+ * Walks continue from the last object returned, and start over at the
+ * beginning of the subtree they walk (the column of a table instance)
+ * once they leave it or the MIB view.
+ */
+static void
+advance_cursor(bench_slot *slot, netsnmp_pdu *pdu)
+{
+    netsnmp_variable_list *vars;
+    char            restart[SNMP_MAX_CMDLINE_OIDS];
+    int             i = 0;
+
+    memset(restart, 0, sizeof(restart));
+    for (vars = pdu->variables; vars; vars = vars->next_variable) {
+        if (vars->type == SNMP_ENDOFMIBVIEW ||
+            vars->type == SNMP_NOSUCHOBJECT ||
+            vars->type == SNMP_NOSUCHINSTANCE ||
+            vars->name_length > MAX_OID_LEN ||
+            snmp_oidsubtree_compare(names[i], root_lengths[i],
+                                 vars->name, vars->name_length) != 0)
+            restart[i] = 1;
+        else {
+            memcpy(slot->cursor[i], vars->name,
+                   vars->name_length * sizeof(oid));
+            slot->cursor_len[i] = vars->name_length;
+        }
+        if (++i == nnames)
+            i = 0;
+    }
+    for (i = 0; i < nnames; i++) {
+        if (!restart[i])
+            continue;
+        memcpy(slot->cursor[i], names[i], root_lengths[i] * sizeof(oid));
+        slot->cursor_len[i] = root_lengths[i];
+    }
+}
+
+static int
+bench_response(int op, netsnmp_session *ss, int reqid, netsnmp_pdu *pdu,
+               void *magic)
+{
+    bench_slot     *slot = magic;
+    bench_result   *result = phase.result;
+
+    phase.active--;
+    netsnmp_get_monotonic_clock(&phase.last);
+
+    switch (op) {
+    case NETSNMP_CALLBACK_OP_RECEIVED_MESSAGE:
+        if (pdu->errstat != SNMP_ERR_NOERROR)
+            result->errors++;
+        else
+            result->responses++;
+        if (pdu->errstat == SNMP_ERR_NOERROR)
+            record_latency(result, &slot->sent, &phase.last);
+        if (phase.command == SNMP_MSG_GETNEXT ||
+            phase.command == SNMP_MSG_GETBULK)
+            advance_cursor(slot, pdu);
+        break;
+    case NETSNMP_CALLBACK_OP_TIMED_OUT:
+        result->timeouts++;
+        break;
+    default:
+        result->errors++;
+        return 1;
+    }
+
+    if (duration && timercmp(&phase.last, &phase.deadline, >=))
+        phase.stop = 1;
+    send_slot(ss, slot);
+    return 1;
+}
+
+static void
+run_phase(netsnmp_session *ss, int command, long count,
+          bench_result *result)
+{
+    bench_slot     *slots;
+    struct timeval  timeout, diff;
+    fd_set          fdset;
+    int             numfds, block, n, i, j;
+
+    slots = calloc(outstanding, sizeof(bench_slot));
+    if (NULL == slots) {
+        fprintf(stderr, "snmpbench: out of memory\n");
+        return;
+    }
+    for (i = 0; i < outstanding; i++)
+        for (j = 0; j < nnames; j++) {
+            memcpy(slots[i].cursor[j], names[j],
+                   name_lengths[j] * sizeof(oid));
+            slots[i].cursor_len[j] = name_lengths[j];
+        }
+
+    memset(&phase, 0, sizeof(phase));
+    phase.command = command;
+    phase.remaining = count ? count : -1;
+    phase.result = result;
+    netsnmp_get_monotonic_clock(&phase.start);
+    phase.last = phase.start;
+    phase.deadline = phase.start;
+    phase.deadline.tv_sec += duration;
+
+    for (i = 0; i < outstanding; i++)
+        send_slot(ss, &slots[i]);
+
+    while (phase.active > 0) {
+        numfds = 0;
+        block = 1;
+        FD_ZERO(&fdset);
+        snmp_select_info(&numfds, &fdset, &timeout, &block);
+        n = select(numfds, &fdset, NULL, NULL, block ? NULL : &timeout);
+        if (n > 0)
+            snmp_read(&fdset);
+        else if (n == 0)
+            snmp_timeout();
+        else if (errno != EINTR) {
+            perror("select");
+            break;
+        }
+    }
+
+    NETSNMP_TIMERSUB(&phase.last, &phase.start, &diff);
+    result->seconds = diff.tv_sec + diff.tv_usec / 1000000.0;
+    free(slots);
+}
+
+/*
+ * run every phase in this process, with a session of its own
+ */
+static int
+run_worker(netsnmp_session *session, long count, bench_result *results)
+{
+    netsnmp_session *ss;
+    int             i;
+
+    ss = snmp_open(session);
+    if (NULL == ss) {
+        snmp_sess_perror("snmpbench", session);
+        return -1;
+    }
+    for (i = 0; i < ntypes; i++)
+        run_phase(ss, pdu_types[types[i]].command, count, &results[i]);
+    snmp_close(ss);
+    return 0;
+}
+
+static void
+merge_result(bench_result *into, const bench_result *from)
+{
+    int             i;
+
+    if (from->responses &&
+        (into->responses == 0 || from->min_usec < into->min_usec))
+        into->min_usec = from->min_usec;
+    if (from->max_usec > into->max_usec)
+        into->max_usec = from->max_usec;
+    if (from->seconds > into->seconds)
+        into->seconds = from->seconds;
+    into->requests += from->requests;
+    into->responses += from->responses;
+    into->errors += from->errors;
+    into->timeouts += from->timeouts;
+    into->total_usec += from->total_usec;
+    for (i = 0; i < BENCH_HIST_SIZE; i++)
+        into->hist[i] += from->hist[i];
+}
+
+static void
+print_string(const char *str)
+{
+    const char     *cp;
+
+    putchar('"');
+    for (cp = str; *cp; cp++) {
+        if (*cp == '"' || *cp == '\\')
+            printf("\\%c", *cp);
+        else if ((unsigned char)*cp < 0x20)
+            printf("\\u%04x", (unsigned char)*cp);
+        else
+            putchar(*cp);
+    }
+    putchar('"');
+}
+
+static void
+print_results(netsnmp_session *session, const bench_result *results,
+              const double *rates)
+{
+    const bench_result *r;
+    const char     *version, *level;
+    int             i;
+
+    switch (session->version) {
+    case SNMP_VERSION_1:
+        version = "1";
+        break;
+    case SNMP_VERSION_2c:
+        version = "2c";
+        break;
+    default:
+        version = "3";
+        break;
+    }
+    if (session->version == SNMP_VERSION_3 &&
+        session->securityLevel == SNMP_SEC_LEVEL_AUTHPRIV)
+        level = "authPriv";
+    else if (session->version == SNMP_VERSION_3 &&
+             session->securityLevel == SNMP_SEC_LEVEL_AUTHNOPRIV)
+        level = "authNoPriv";
+    else
+        level = "noAuthNoPriv";
+
+    printf("{\"agent\":");
+    print_string(session->peername ? session->peername : "");
+    printf(",\"version\":\"%s\",\"securityLevel\":\"%s\"", version, level);
+    printf(",\"workers\":%d,\"outstanding\":%d,\"label\":",
+           workers, outstanding);
+    print_string(label);
+    printf(",\"results\":[");
+    for (i = 0; i < ntypes; i++) {
+        r = &results[i];
+        printf("%s\n {\"pdu\":\"%s\",\"requests\":%lu,\"responses\":%lu"
+               ",\"errors\":%lu,\"timeouts\":%lu,\"seconds\":%.3f"
+               ",\"requestsPerSecond\":%.1f",
+               i ? "," : "", pdu_types[types[i]].name, r->requests,
+               r->responses, r->errors, r->timeouts, r->seconds,
+               rates[i]);
+        if (r->responses)
+            printf(",\"latencyUsec\":{\"min\":%lu,\"mean\":%.1f"
+                   ",\"p50\":%.0f,\"p90\":%.0f,\"p99\":%.0f,\"max\":%lu}",
+                   r->min_usec, r->total_usec / r->responses,
+                   hist_percentile(r, 50), hist_percentile(r, 90),
+                   hist_percentile(r, 99), r->max_usec);
+        printf("}");
+    }
+    printf("\n]}\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+    netsnmp_session session;
+    bench_result   *results = NULL, *worker_results = NULL;
+    double          rates[BENCH_MAX_TYPES];
+    long            count;
+    int             arg, i, w;
+    int             exitval = 1;
+#ifdef HAVE_FORK
+    int            *fds = NULL;
+    pid_t          *pids = NULL;
+    int             pipefd[2], status;
+    size_t          size;
+    ssize_t         got;
+#endif
+
+    SOCK_STARTUP;
+
+    switch (arg = snmp_parse_args(argc, argv, &session, "C:", optProc)) {
+    case NETSNMP_PARSE_ARGS_ERROR:
+        goto out;
+    case NETSNMP_PARSE_ARGS_SUCCESS_EXIT:
+        exitval = 0;
+        goto out;
+    case NETSNMP_PARSE_ARGS_ERROR_USAGE:
+        usage();
+        goto out;
+    default:
+        break;
+    }
+
+    if (arg >= argc) {
+        fprintf(stderr, "Missing object name\n");
+        usage();
+        goto out;
+    }
+    if ((argc - arg) > SNMP_MAX_CMDLINE_OIDS) {
+        fprintf(stderr, "Too many object identifiers specified. ");
+        fprintf(stderr, "Only %d allowed in one request.\n",
+                SNMP_MAX_CMDLINE_OIDS);
+        usage();
+        goto out;
+    }
+    for (; arg < argc; arg++) {
+        name_lengths[nnames] = MAX_OID_LEN;
+        if (!snmp_parse_oid(argv[arg], names[nnames],
+                            &name_lengths[nnames])) {
+            snmp_perror(argv[arg]);
+            goto out;
+        }
+        root_lengths[nnames] = name_lengths[nnames] > 1 ?
+            name_lengths[nnames] - 1 : name_lengths[nnames];
+        nnames++;
+    }
+    if (ntypes == 0)
+        types[ntypes++] = 0;
+    for (i = 0; i < ntypes; i++)
+        if (pdu_types[types[i]].command == SNMP_MSG_GETBULK &&
+            session.version == SNMP_VERSION_1) {
+            fprintf(stderr, "snmpbench: getbulk needs SNMPv2c or SNMPv3\n");
+            goto out;
+        }
+    /* a request count alone means no time limit */
+    if (total_requests && !duration_set)
+        duration = 0;
+    if (!total_requests && !duration) {
+        fprintf(stderr, "snmpbench: need a duration or a request count\n");
+        goto out;
+    }
+    if (workers < 1)
+        workers = 1;
+    if (outstanding < 1)
+        outstanding = 1;
+#ifndef HAVE_FORK
+    workers = 1;
+#endif
+
+    results = calloc(ntypes, sizeof(bench_result));
+    worker_results = calloc(ntypes, sizeof(bench_result));
+    if (NULL == results || NULL == worker_results) {
+        fprintf(stderr, "snmpbench: out of memory\n");
+        goto out;
+    }
+    memset(rates, 0, sizeof(rates));
+
+#ifdef HAVE_FORK
+    fds = calloc(workers, sizeof(int));
+    pids = calloc(workers, sizeof(pid_t));
+    if (NULL == fds || NULL == pids) {
+        fprintf(stderr, "snmpbench: out of memory\n");
+        goto out;
+    }
+    fflush(stdout);
+    fflush(stderr);
+    for (w = 0; w < workers; w++) {
+        count = total_requests / workers +
+            (w < total_requests % workers ? 1 : 0);
+        if (pipe(pipefd) < 0) {
+            perror("pipe");
+            break;
+        }
+        pids[w] = fork();
+        if (pids[w] < 0) {
+            perror("fork");
+            close(pipefd[0]);
+            close(pipefd[1]);
+            break;
+        }
+        if (pids[w] == 0) {
+            close(pipefd[0]);
+            if (total_requests && count == 0)
+                _exit(0);
+            if (run_worker(&session, count, worker_results) < 0)
+                _exit(1);
+            size = ntypes * sizeof(bench_result);
+            if (write(pipefd[1], worker_results, size) != (ssize_t) size)
+                _exit(1);
+            _exit(0);
+        }
+        close(pipefd[1]);
+        fds[w] = pipefd[0];
+    }
+    exitval = 0;
+    for (i = 0; i < w; i++) {
+        size = 0;
+        while (size < ntypes * sizeof(bench_result)) {
+            got = read(fds[i], (char *) worker_results + size,
+                       ntypes * sizeof(bench_result) - size);
+            if (got < 0 && errno == EINTR)
+                continue;
+            if (got <= 0)
+                break;
+            size += got;
+        }
+        close(fds[i]);
+        waitpid(pids[i], &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            exitval = 1;
+        if (size != ntypes * sizeof(bench_result))
+            continue;
+        for (arg = 0; arg < ntypes; arg++) {
+            merge_result(&results[arg], &worker_results[arg]);
+            if (worker_results[arg].seconds > 0)
+                rates[arg] += worker_results[arg].responses /
+                    worker_results[arg].seconds;
+        }
+    }
+    if (w < workers)
+        exitval = 1;
+#else
+    (void) w;
+    count = total_requests;
+    if (run_worker(&session, count, results) < 0)
+        goto out;
+    for (i = 0; i < ntypes; i++)
+        if (results[i].seconds > 0)
+            rates[i] = results[i].responses / results[i].seconds;
+    exitval = 0;
+#endif
+
+    print_results(&session, results, rates);
+    for (i = 0; i < ntypes; i++)
+        if (results[i].responses == 0)
+            exitval = exitval ? exitval : 2;
+
+  out:
+#ifdef HAVE_FORK
+    free(fds);
+    free(pids);
+#endif
+    free(results);
+    free(worker_results);
+    netsnmp_cleanup_session(&session);
+    SOCK_CLEANUP;
+    return exitval;
+}
@@ -55,6 +55,7 @@ SOFTWARE.
 #include <sys/select.h>
 #endif
 #include <stdio.h>
+#include <errno.h>
 #include <ctype.h>
 #ifdef HAVE_NETDB_H
 #include <netdb.h>
@@ -72,6 +73,7 @@ SOFTWARE.
 oid             objid_mib[] = { 1, 3, 6, 1, 2, 1 };
 int             numprinted = 0;
 int             reps = 10, non_reps = 0;
+int             max_outstanding = 0, adaptive = 0;
 
 void
 usage(void)
@@ -84,11 +86,16 @@ usage(void)
             "  -C APPOPTS\t\tSet various application specific behaviours:\n");
     fprintf(stderr,
             "\t\t\t  c:       do not check returned OIDs are increasing\n");
+    fprintf(stderr,
+            "\t\t\t  a:       adapt max-repeaters to the agent's responses\n");
     fprintf(stderr,
             "\t\t\t  i:       include given OIDs in the search range\n");
     fprintf(stderr, "\t\t\t  n<NUM>:  set non-repeaters to <NUM>\n");
     fprintf(stderr,
             "\t\t\t  p:       print the number of variables found\n");
+    fprintf(stderr,
+            "\t\t\t  P<NUM>:  walk parts of the subtree in parallel, with\n"
+            "\t\t\t\t   up to <NUM> requests outstanding\n");
     fprintf(stderr, "\t\t\t  r<NUM>:  set max-repeaters to <NUM>\n");
 }
 
@@ -114,6 +121,428 @@ snmp_get_and_print(netsnmp_session * ss, oid * theoid, size_t theoid_len)
     }
 }
 
+/*
+ * Pipelined walk.  The subtree is split into ranges at the MIB objects
+ * below it (the columns of a table, say), and the ranges are walked at
+ * the same time with up to max_outstanding requests in flight.  Each
+ * range covers the OIDs after its start, up to and including its end.
+ * Results are buffered per range and printed in order, so the output
+ * is the same as for a plain walk.
+ */
+#define WALK_MAX_RANGES         256
+#define WALK_ADAPTIVE_MAX_REPS  1000
+
+typedef struct walk_range_s {
+    oid             last[MAX_OID_LEN];  /* last OID retrieved */
+    size_t          last_len;
+    oid             end[MAX_OID_LEN];   /* inclusive upper bound */
+    size_t          end_len;            /* 0: up to the end of the subtree */
+    int             requested;          /* max-repetitions of request */
+    int             outstanding;
+    int             done;
+    netsnmp_variable_list *results, *tail;
+} walk_range;
+
+static walk_range *ranges;
+static int      nranges, next_to_print, outstanding;
+static int      walk_running, walk_check, walk_exitval, walk_end_of_mib;
+static int      walk_status, reps_ceiling;
+static oid     *walk_root;
+static size_t   walk_rootlen;
+
+#ifndef NETSNMP_DISABLE_MIB_LOADING
+typedef struct walk_boundary_s {
+    oid             name[MAX_OID_LEN];
+    size_t          len;
+    struct tree    *tp;
+} walk_boundary;
+
+static struct tree *
+find_mib_node(const oid *name, size_t len)
+{
+    struct tree    *tp = get_tree_head();
+    size_t          i = 0;
+
+    while (tp) {
+        if (tp->subid != name[i]) {
+            tp = tp->next_peer;
+            continue;
+        }
+        if (++i == len)
+            return tp;
+        tp = tp->child_list;
+    }
+    return NULL;
+}
+
+static int
+boundary_compare(const void *p, const void *q)
+{
+    const walk_boundary *lhs = p, *rhs = q;
+
+    return snmp_oid_compare(lhs->name, lhs->len, rhs->name, rhs->len);
+}
+
+/*
+ * Find up to max MIB objects below root to split the walk at, going
+ * down the tree until there are at least want of them.
+ */
+static int
+find_boundaries(const oid *root, size_t rootlen, walk_boundary *b,
+                int max, int want)
+{
+    walk_boundary  *next;
+    struct tree    *tp, *child;
+    int             n = 1, count, expanded, i;
+
+    tp = find_mib_node(root, rootlen);
+    if (NULL == tp || NULL == tp->child_list)
+        return 0;
+
+    next = calloc(max, sizeof(*next));
+    if (NULL == next)
+        return 0;
+    memcpy(b[0].name, root, rootlen * sizeof(oid));
+    b[0].len = rootlen;
+    b[0].tp = tp;
+
+    /*
+     * replace each object by its children for as long as that fits
+     */
+    do {
+        expanded = 0;
+        count = 0;
+        for (i = 0; i < n; i++) {
+            int             children = 0;
+
+            for (child = b[i].tp->child_list; child; child = child->next_peer)
+                children++;
+            if (children == 0 || b[i].len >= MAX_OID_LEN ||
+                count + children + (n - i - 1) > max) {
+                next[count++] = b[i];
+                continue;
+            }
+            for (child = b[i].tp->child_list; child; child = child->next_peer) {
+                next[count] = b[i];
+                next[count].name[next[count].len++] = child->subid;
+                next[count].tp = child;
+                count++;
+            }
+            expanded = 1;
+        }
+        memcpy(b, next, count * sizeof(*b));
+        n = count;
+    } while (expanded && n < want);
+    free(next);
+
+    qsort(b, n, sizeof(*b), boundary_compare);
+    return n;
+}
+#endif /* NETSNMP_DISABLE_MIB_LOADING */
+
+static void
+walk_stop(int exitval)
+{
+    walk_running = 0;
+    if (exitval)
+        walk_exitval = exitval;
+}
+
+static void
+walk_print_ready(void)
+{
+    static oid      printed[MAX_OID_LEN];
+    static size_t   printed_len;
+    walk_range     *r;
+    netsnmp_variable_list *vars, *next;
+
+    while (next_to_print < nranges) {
+        r = &ranges[next_to_print];
+        for (vars = r->results; vars; vars = next) {
+            next = vars->next_variable;
+            if ((vars->type == SNMP_ENDOFMIBVIEW ||
+                 vars->type == SNMP_NOSUCHOBJECT ||
+                 vars->type == SNMP_NOSUCHINSTANCE) && printed_len)
+                /*
+                 * report it where a plain walk would have
+                 */
+                snmp_set_var_objid(vars, printed, printed_len);
+            else if (vars->name_length <= MAX_OID_LEN) {
+                memmove(printed, vars->name, vars->name_length * sizeof(oid));
+                printed_len = vars->name_length;
+            }
+            numprinted++;
+            print_variable(vars->name, vars->name_length, vars);
+            snmp_free_var(vars);
+        }
+        r->results = r->tail = NULL;
+        if (!r->done)
+            break;
+        next_to_print++;
+    }
+}
+
+static int
+walk_response(int operation, netsnmp_session *ss, int reqid,
+              netsnmp_pdu *response, void *magic)
+{
+    walk_range     *r = magic;
+    netsnmp_variable_list *vars, *next;
+    int             count = 0, last_range, exception;
+
+    /* once stopped, the ranges may already have been freed */
+    if (!walk_running)
+        return 1;
+    r->outstanding = 0;
+    outstanding--;
+
+    if (operation == NETSNMP_CALLBACK_OP_TIMED_OUT) {
+        fprintf(stderr, "Timeout: No Response from %s\n", ss->peername);
+        walk_status = STAT_TIMEOUT;
+        walk_stop(1);
+        return 1;
+    }
+    if (operation != NETSNMP_CALLBACK_OP_RECEIVED_MESSAGE) {
+        snmp_sess_perror("snmpbulkwalk", ss);
+        walk_status = STAT_ERROR;
+        walk_stop(1);
+        return 1;
+    }
+
+    last_range = (r == &ranges[nranges - 1]);
+    if (response->errstat == SNMP_ERR_TOOBIG && adaptive && reps > 1) {
+        /* the range is sent again with fewer repetitions */
+        reps /= 2;
+        reps_ceiling = reps;
+        return 1;
+    }
+    if (response->errstat == SNMP_ERR_NOSUCHNAME) {
+        r->done = 1;
+        if (last_range)
+            walk_end_of_mib = 1;
+        return 1;
+    }
+    if (response->errstat != SNMP_ERR_NOERROR) {
+        fprintf(stderr, "Error in packet.\nReason: %s\n",
+                snmp_errstring(response->errstat));
+        if (response->errindex != 0) {
+            fprintf(stderr, "Failed object: ");
+            for (count = 1, vars = response->variables;
+                 vars && count != response->errindex;
+                 vars = vars->next_variable, count++)
+                /*EMPTY*/;
+            if (vars)
+                fprint_objid(stderr, vars->name, vars->name_length);
+            fprintf(stderr, "\n");
+        }
+        walk_stop(2);
+        return 1;
+    }
+
+    /*
+     * keep the variables in range; the pdu is freed by the library
+     */
+    vars = response->variables;
+    response->variables = NULL;
+    for (; vars; vars = next) {
+        next = vars->next_variable;
+        vars->next_variable = NULL;
+        count++;
+        if (r->done || (vars->name_length < walk_rootlen) ||
+            (memcmp(walk_root, vars->name, walk_rootlen * sizeof(oid)) != 0) ||
+            (r->end_len && snmp_oid_compare(vars->name, vars->name_length,
+                                            r->end, r->end_len) > 0)) {
+            /*
+             * not part of this range
+             */
+            r->done = 1;
+            snmp_free_var(vars);
+            continue;
+        }
+        exception = (vars->type == SNMP_ENDOFMIBVIEW) ||
+            (vars->type == SNMP_NOSUCHOBJECT) ||
+            (vars->type == SNMP_NOSUCHINSTANCE);
+        if (exception) {
+            /*
+             * later ranges will see the same, so only print it once
+             */
+            r->done = 1;
+            if (!last_range) {
+                snmp_free_var(vars);
+                continue;
+            }
+        } else if (walk_check &&
+                   snmp_oid_compare(r->last, r->last_len, vars->name,
+                                    vars->name_length) >= 0) {
+            fflush(stdout);
+            fprintf(stderr, "Error: OID not increasing: ");
+            fprint_objid(stderr, r->last, r->last_len);
+            fprintf(stderr, " >= ");
+            fprint_objid(stderr, vars->name, vars->name_length);
+            fprintf(stderr, "\n");
+            snmp_free_var(vars);
+            walk_stop(1);
+            break;
+        } else {
+            memmove(r->last, vars->name, vars->name_length * sizeof(oid));
+            r->last_len = vars->name_length;
+            if (r->end_len && snmp_oid_compare(r->last, r->last_len,
+                                               r->end, r->end_len) == 0)
+                r->done = 1;
+        }
+        if (r->tail)
+            r->tail->next_variable = vars;
+        else
+            r->results = vars;
+        r->tail = vars;
+    }
+    for (; vars; vars = next) {
+        next = vars->next_variable;
+        snmp_free_var(vars);
+    }
+    if (0 == count)
+        r->done = 1;
+
+    /*
+     * A short response that doesn't reach the end of the range was cut
+     * down by the agent to fit; a full one leaves room to grow.
+     */
+    if (adaptive && !r->done && walk_running) {
+        if (count < r->requested)
+            reps = reps_ceiling = count;
+        else if (reps < reps_ceiling)
+            reps = (reps * 2 < reps_ceiling) ? reps * 2 : reps_ceiling;
+    }
+    return 1;
+}
+
+static void
+walk_send(netsnmp_session *ss, walk_range *r)
+{
+    netsnmp_pdu    *pdu;
+
+    pdu = snmp_pdu_create(SNMP_MSG_GETBULK);
+    pdu->non_repeaters = non_reps;
+    pdu->max_repetitions = r->requested = reps;
+    snmp_add_null_var(pdu, r->last, r->last_len);
+
+    if (snmp_async_send(ss, pdu, walk_response, r) == 0) {
+        snmp_sess_perror("snmpbulkwalk", ss);
+        snmp_free_pdu(pdu);
+        walk_status = STAT_ERROR;
+        walk_stop(1);
+        return;
+    }
+    r->outstanding = 1;
+    outstanding++;
+}
+
+static int
+pipelined_walk(netsnmp_session *ss, oid *root, size_t rootlen, int check,
+               int *status)
+{
+    walk_range     *r;
+    fd_set          fdset;
+    struct timeval  timeout;
+    int             nbounds = 0, numfds, block, count, i;
+#ifndef NETSNMP_DISABLE_MIB_LOADING
+    walk_boundary  *bounds;
+#endif
+
+    if (max_outstanding < 1)
+        max_outstanding = 1;
+    if (reps < 1)
+        reps = 1;
+    reps_ceiling = (reps > WALK_ADAPTIVE_MAX_REPS) ? reps :
+        WALK_ADAPTIVE_MAX_REPS;
+
+    ranges = calloc(WALK_MAX_RANGES, sizeof(*ranges));
+    if (NULL == ranges) {
+        fprintf(stderr, "snmpbulkwalk: out of memory\n");
+        return 1;
+    }
+
+#ifndef NETSNMP_DISABLE_MIB_LOADING
+    bounds = NULL;
+    if (max_outstanding > 1)
+        bounds = calloc(WALK_MAX_RANGES - 1, sizeof(*bounds));
+    if (bounds)
+        nbounds = find_boundaries(root, rootlen, bounds, WALK_MAX_RANGES - 1,
+                                  4 * max_outstanding);
+#endif
+
+    /*
+     * ranges: (root, b0], (b0, b1], ... (bn, end of subtree)
+     */
+    nranges = nbounds + 1;
+    for (i = 0; i < nranges; i++) {
+        r = &ranges[i];
+        if (i == 0) {
+            memmove(r->last, root, rootlen * sizeof(oid));
+            r->last_len = rootlen;
+        }
+#ifndef NETSNMP_DISABLE_MIB_LOADING
+        else {
+            memmove(r->last, bounds[i - 1].name,
+                    bounds[i - 1].len * sizeof(oid));
+            r->last_len = bounds[i - 1].len;
+        }
+        if (i < nbounds) {
+            memmove(r->end, bounds[i].name, bounds[i].len * sizeof(oid));
+            r->end_len = bounds[i].len;
+        }
+#endif
+    }
+#ifndef NETSNMP_DISABLE_MIB_LOADING
+    free(bounds);
+#endif
+
+    walk_root = root;
+    walk_rootlen = rootlen;
+    walk_check = check;
+    walk_running = 1;
+    walk_status = STAT_SUCCESS;
+    walk_exitval = 0;
+
+    while (walk_running) {
+        for (i = next_to_print; i < nranges && outstanding < max_outstanding &&
+                 walk_running; i++) {
+            r = &ranges[i];
+            if (!r->done && !r->outstanding)
+                walk_send(ss, r);
+        }
+        if (0 == outstanding)
+            break;
+
+        numfds = 0;
+        block = 1;
+        FD_ZERO(&fdset);
+        snmp_select_info(&numfds, &fdset, &timeout, &block);
+        count = select(numfds, &fdset, NULL, NULL, block ? NULL : &timeout);
+        if (count > 0)
+            snmp_read(&fdset);
+        else if (count == 0)
+            snmp_timeout();
+        else if (errno != EINTR) {
+            perror("select");
+            walk_status = STAT_ERROR;
+            walk_stop(1);
+        }
+        walk_print_ready();
+    }
+    walk_print_ready();
+
+    if (walk_end_of_mib && walk_exitval == 0)
+        printf("End of MIB\n");
+
+    for (i = 0; i < nranges; i++)
+        snmp_free_varbind(ranges[i].results);
+    SNMP_FREE(ranges);
+
+    *status = walk_status;
+    return walk_exitval;
+}
+
 static
     void
 optProc(int argc, char *const *argv, int opt)
@@ -134,10 +563,17 @@ optProc(int argc, char *const *argv, int opt)
 					  NETSNMP_DS_WALK_INCLUDE_REQUESTED);
                 break;
 
+            case 'a':
+                adaptive = !adaptive;
+                break;
+
             case 'n':
+            case 'P':
             case 'r':
                 if (*(optarg - 1) == 'r') {
                     reps = strtol(optarg, &endptr, 0);
+                } else if (*(optarg - 1) == 'P') {
+                    max_outstanding = strtol(optarg, &endptr, 0);
                 } else {
                     non_reps = strtol(optarg, &endptr, 0);
                 }
@@ -265,6 +701,11 @@ main(int argc, char *argv[])
 
     exitval = 0;
 
+    if (max_outstanding > 0 || adaptive) {
+        exitval = pipelined_walk(ss, root, rootlen, check, &status);
+        running = 0;
+    }
+
     while (running) {
         /*
          * create PDU for GETBULK request and add object name to request 
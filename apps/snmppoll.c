@@ -0,0 +1,478 @@
+/*
+ * snmppoll.c - poll many SNMP agents at once over a single socket.
+ *
+ * A demonstration of the netsnmp_poller API: the given objects are
+ * retrieved from each of the agents listed on the command line or in a
+ * file, with limits on the number of outstanding requests and on the
+ * request rate.
+ */
+#include <net-snmp/net-snmp-config.h>
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#include <strings.h>
+#endif
+#include <sys/types.h>
+#ifdef HAVE_NETINET_IN_H
+#include <netinet/in.h>
+#endif
+#ifdef TIME_WITH_SYS_TIME
+# include <sys/time.h>
+# include <time.h>
+#else
+# ifdef HAVE_SYS_TIME_H
+#  include <sys/time.h>
+# else
+#  include <time.h>
+# endif
+#endif
+#ifdef HAVE_SYS_SELECT_H
+#include <sys/select.h>
+#endif
+#ifdef HAVE_SYS_WAIT_H
+#include <sys/wait.h>
+#endif
+#include <stdio.h>
+#include <ctype.h>
+#include <signal.h>
+
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/library/snmp_poller.h>
+
+typedef struct poll_target_s {
+    netsnmp_poller_target *target;
+    int             remaining;      /* requests still to be sent */
+} poll_target;
+
+static netsnmp_poller *poller;
+static oid      names[SNMP_MAX_CMDLINE_OIDS][MAX_OID_LEN];
+static size_t   name_lengths[SNMP_MAX_CMDLINE_OIDS];
+static int      nnames;
+
+static char    *target_file;
+static int      rounds = 1, per_target = 1, total = 1000, rate = 0;
+static int      quiet, print_stats, simulate;
+static int      failures;
+
+void
+usage(void)
+{
+    fprintf(stderr, "USAGE: snmppoll ");
+    snmp_parse_args_usage(stderr);
+    fprintf(stderr, " OID [OID]...\n\n");
+    fprintf(stderr, "  AGENT may be a comma separated list of agents.\n\n");
+    snmp_parse_args_descriptions(stderr);
+    fprintf(stderr,
+            "  -C APPOPTS\t\tSet various application specific behaviours:\n");
+    fprintf(stderr,
+            "\t\t\t  f<FILE>: also poll the agents listed in <FILE>\n");
+    fprintf(stderr,
+            "\t\t\t  n<NUM>:  poll each agent <NUM> times (default 1)\n");
+    fprintf(stderr,
+            "\t\t\t  o<NUM>:  requests outstanding per agent (default 1)\n");
+    fprintf(stderr,
+            "\t\t\t  O<NUM>:  requests outstanding in total (default 1000)\n");
+    fprintf(stderr,
+            "\t\t\t  r<NUM>:  send at most <NUM> requests per second\n");
+    fprintf(stderr, "\t\t\t  q:       do not print the results\n");
+    fprintf(stderr, "\t\t\t  s:       print statistics when done\n");
+#ifdef HAVE_FORK
+    fprintf(stderr,
+            "\t\t\t  S:       answer the requests with a simulated agent\n"
+            "\t\t\t\t   on the (first) agent address, for benchmarks\n");
+#endif
+}
+
+static int
+get_number(char **arg, const char *what)
+{
+    char           *end;
+    long            value = strtol(*arg, &end, 10);
+
+    if (end == *arg || value < 0) {
+        fprintf(stderr, "Bad %s value after -C: %s\n", what, *arg);
+        exit(1);
+    }
+    *arg = end;
+    return (int) value;
+}
+
+static void
+optProc(int argc, char *const *argv, int opt)
+{
+    char           *arg;
+
+    switch (opt) {
+    case 'C':
+        arg = optarg;
+        while (*arg) {
+            switch (*arg++) {
+            case 'f':
+                /* the file name is the rest of the argument */
+                target_file = arg;
+                arg += strlen(arg);
+                break;
+            case 'n':
+                rounds = get_number(&arg, "poll count");
+                break;
+            case 'o':
+                per_target = get_number(&arg, "outstanding requests");
+                break;
+            case 'O':
+                total = get_number(&arg, "outstanding requests");
+                break;
+            case 'r':
+                rate = get_number(&arg, "request rate");
+                break;
+            case 'q':
+                quiet = 1;
+                break;
+            case 's':
+                print_stats = 1;
+                break;
+#ifdef HAVE_FORK
+            case 'S':
+                simulate = 1;
+                break;
+#endif
+            default:
+                fprintf(stderr, "Unknown flag passed to -C: %c\n", arg[-1]);
+                exit(1);
+            }
+        }
+        break;
+    }
+}
+
+static int      send_request(poll_target *pt);
+
+static void
+poll_response(int op, netsnmp_poller_target *target, int reqid,
+              netsnmp_pdu *pdu, void *magic)
+{
+    poll_target    *pt = magic;
+    netsnmp_variable_list *vars;
+    const char     *name = netsnmp_poller_target_name(target);
+
+    switch (op) {
+    case NETSNMP_CALLBACK_OP_RECEIVED_MESSAGE:
+        if (pdu->errstat != SNMP_ERR_NOERROR) {
+            failures++;
+            if (!quiet)
+                printf("%s: Error: %s\n", name,
+                       snmp_errstring(pdu->errstat));
+            break;
+        }
+        if (quiet)
+            break;
+        for (vars = pdu->variables; vars; vars = vars->next_variable) {
+            printf("%s: ", name);
+            print_variable(vars->name, vars->name_length, vars);
+        }
+        break;
+    case NETSNMP_CALLBACK_OP_TIMED_OUT:
+        failures++;
+        if (!quiet)
+            printf("%s: Timeout\n", name);
+        break;
+    default:
+        failures++;
+        if (!quiet)
+            printf("%s: Send failed\n", name);
+        /* don't keep trying an agent that can't be reached */
+        pt->remaining = 0;
+        break;
+    }
+
+    if (pt->remaining > 0)
+        send_request(pt);
+}
+
+static int
+send_request(poll_target *pt)
+{
+    netsnmp_pdu    *pdu;
+    int             i;
+
+    pdu = snmp_pdu_create(SNMP_MSG_GET);
+    for (i = 0; i < nnames; i++)
+        snmp_add_null_var(pdu, names[i], name_lengths[i]);
+    pt->remaining--;
+    if (netsnmp_poller_send(poller, pt->target, pdu, poll_response,
+                            pt) == 0) {
+        snmp_free_pdu(pdu);
+        failures++;
+        return -1;
+    }
+    return 0;
+}
+
+static poll_target *
+add_target(netsnmp_session *session, const char *peername,
+           poll_target *targets, int *ntargets, int *size)
+{
+    poll_target    *pt;
+
+    if (*ntargets == *size) {
+        *size = *size ? 2 * *size : 64;
+        targets = realloc(targets, *size * sizeof(*targets));
+        if (NULL == targets) {
+            fprintf(stderr, "snmppoll: out of memory\n");
+            exit(1);
+        }
+    }
+    pt = &targets[*ntargets];
+    pt->target = netsnmp_poller_add_target(poller, peername,
+                                           session->version,
+                                           session->community,
+                                           session->community_len);
+    if (NULL == pt->target) {
+        fprintf(stderr, "snmppoll: can't poll %s\n", peername);
+        failures++;
+        return targets;
+    }
+    netsnmp_poller_target_set_limits(pt->target, per_target, 0);
+    pt->remaining = rounds;
+    (*ntargets)++;
+    return targets;
+}
+
+#ifdef HAVE_FORK
+/*
+ * A trivial agent answering every request with an integer for each
+ * variable, so the throughput of the poller itself can be measured.
+ */
+static pid_t
+start_simulator(const char *peername)
+{
+    netsnmp_transport *transport;
+    netsnmp_session session;
+    netsnmp_variable_list *vars;
+    netsnmp_pdu    *pdu;
+    u_char          packet[65536], *obuf, *out;
+    size_t          obuf_size = sizeof(packet), offset, out_len;
+    void           *opaque;
+    int             olength, length;
+    long            value = 0;
+    pid_t           pid;
+
+    transport = netsnmp_transport_open_server("snmp", peername);
+    if (NULL == transport) {
+        fprintf(stderr, "snmppoll: can't listen on %s\n", peername);
+        return -1;
+    }
+    pid = fork();
+    if (pid != 0) {
+        netsnmp_transport_free(transport);
+        return pid;
+    }
+
+    snmp_sess_init(&session);
+    obuf = malloc(obuf_size);
+    for (;;) {
+        opaque = NULL;
+        olength = 0;
+        length = transport->f_recv(transport, packet, sizeof(packet),
+                                   &opaque, &olength);
+        if (length <= 0) {
+            SNMP_FREE(opaque);
+            continue;
+        }
+        pdu = calloc(1, sizeof(netsnmp_pdu));
+        if (NULL == pdu || NULL == obuf) {
+            SNMP_FREE(opaque);
+            _exit(1);
+        }
+        pdu->transport_data = opaque;
+        pdu->transport_data_length = olength;
+        session.version = SNMP_DEFAULT_VERSION;
+        if (snmp_parse(NULL, &session, pdu, packet, length) != 0 ||
+            pdu->command != SNMP_MSG_GET) {
+            snmp_free_pdu(pdu);
+            continue;
+        }
+        pdu->command = SNMP_MSG_RESPONSE;
+        pdu->flags &= ~UCD_MSG_FLAG_EXPECT_RESPONSE;
+        pdu->flags |= UCD_MSG_FLAG_RESPONSE_PDU;
+        value++;
+        for (vars = pdu->variables; vars; vars = vars->next_variable)
+            snmp_set_var_typed_value(vars, ASN_INTEGER, &value,
+                                     sizeof(value));
+        offset = 0;
+#ifdef NETSNMP_USE_REVERSE_ASNENCODING
+        if (snmp_build(&obuf, &obuf_size, &offset, &session, pdu) == 0) {
+            out = obuf + obuf_size - offset;
+            out_len = offset;
+#else
+        out_len = obuf_size;
+        if (snmp_build(&obuf, &out_len, &offset, &session, pdu) == 0) {
+            out = obuf;
+#endif
+            netsnmp_transport_send(transport, out, out_len,
+                                   &pdu->transport_data,
+                                   &pdu->transport_data_length);
+        }
+        snmp_free_pdu(pdu);
+    }
+    /* NOTREACHED */
+}
+#endif /* HAVE_FORK */
+
+int
+main(int argc, char *argv[])
+{
+    netsnmp_session session;
+    const netsnmp_poller_stats *stats;
+    poll_target    *targets = NULL;
+    int             ntargets = 0, size = 0;
+    struct timeval  start, end;
+    double          elapsed;
+    char           *peers, *peer, *st;
+    char            line[1024];
+    FILE           *fp;
+    int             arg, i;
+    int             exitval = 1;
+#ifdef HAVE_FORK
+    pid_t           simulator = 0;
+#endif
+
+    SOCK_STARTUP;
+
+    switch (arg = snmp_parse_args(argc, argv, &session, "C:", optProc)) {
+    case NETSNMP_PARSE_ARGS_ERROR:
+        goto out;
+    case NETSNMP_PARSE_ARGS_SUCCESS_EXIT:
+        exitval = 0;
+        goto out;
+    case NETSNMP_PARSE_ARGS_ERROR_USAGE:
+        usage();
+        goto out;
+    default:
+        break;
+    }
+
+    if (session.version != SNMP_VERSION_1 &&
+        session.version != SNMP_VERSION_2c) {
+        fprintf(stderr, "snmppoll: only SNMPv1 and SNMPv2c are supported\n");
+        goto out;
+    }
+    if (arg >= argc) {
+        fprintf(stderr, "Missing object name\n");
+        usage();
+        goto out;
+    }
+    if ((argc - arg) > SNMP_MAX_CMDLINE_OIDS) {
+        fprintf(stderr, "Too many object identifiers specified. ");
+        fprintf(stderr, "Only %d allowed in one request.\n",
+                SNMP_MAX_CMDLINE_OIDS);
+        usage();
+        goto out;
+    }
+    for (; arg < argc; arg++) {
+        name_lengths[nnames] = MAX_OID_LEN;
+        if (!snmp_parse_oid(argv[arg], names[nnames],
+                            &name_lengths[nnames])) {
+            snmp_perror(argv[arg]);
+            goto out;
+        }
+        nnames++;
+    }
+
+#ifdef HAVE_FORK
+    if (simulate) {
+        peers = strdup(session.peername);
+        peer = strtok_r(peers, ",", &st);
+        simulator = start_simulator(peer ? peer : session.peername);
+        free(peers);
+        if (simulator < 0)
+            goto out;
+    }
+#endif
+
+    poller = netsnmp_poller_create(NULL);
+    if (NULL == poller)
+        goto out;
+    netsnmp_poller_set_timeout(poller, session.timeout, session.retries,
+                               0, 0);
+    netsnmp_poller_set_limits(poller, total, rate);
+
+    /*
+     * the agents to poll
+     */
+    peers = strdup(session.peername);
+    for (peer = strtok_r(peers, ",", &st); peer;
+         peer = strtok_r(NULL, ",", &st))
+        targets = add_target(&session, peer, targets, &ntargets, &size);
+    free(peers);
+    if (target_file) {
+        fp = fopen(target_file, "r");
+        if (NULL == fp) {
+            perror(target_file);
+            goto out;
+        }
+        while (fgets(line, sizeof(line), fp)) {
+            peer = line;
+            while (isspace((unsigned char) *peer))
+                peer++;
+            for (i = strlen(peer); i > 0 &&
+                 isspace((unsigned char) peer[i - 1]); i--)
+                peer[i - 1] = '\0';
+            if (*peer == '\0' || *peer == '#')
+                continue;
+            targets = add_target(&session, peer, targets, &ntargets, &size);
+        }
+        fclose(fp);
+    }
+
+    /*
+     * start as many requests per agent as may be outstanding; each
+     * response then triggers the next request to the same agent
+     */
+    netsnmp_get_monotonic_clock(&start);
+    for (i = 0; i < ntargets; i++) {
+        int             n;
+
+        for (n = 0; n < per_target && targets[i].remaining > 0; n++)
+            send_request(&targets[i]);
+    }
+    if (netsnmp_poller_run(poller) == 0)
+        exitval = failures ? 2 : 0;
+    netsnmp_get_monotonic_clock(&end);
+
+    if (print_stats) {
+        stats = netsnmp_poller_get_stats(poller);
+        elapsed = (end.tv_sec - start.tv_sec) +
+            (end.tv_usec - start.tv_usec) / 1000000.0;
+        printf("Agents: %d\n", ntargets);
+        printf("Requests: %lu\n", stats->sent);
+        printf("Retries: %lu\n", stats->retries);
+        printf("Responses: %lu\n", stats->responses);
+        printf("Timeouts: %lu\n", stats->timeouts);
+        printf("Send failures: %lu\n", stats->send_failures);
+        printf("Dropped packets: %lu\n", stats->dropped);
+        printf("Elapsed: %.3f s\n", elapsed);
+        if (elapsed > 0)
+            printf("Responses per second: %.0f\n",
+                   stats->responses / elapsed);
+    }
+
+  out:
+#ifdef HAVE_FORK
+    if (simulator > 0) {
+        kill(simulator, SIGTERM);
+        waitpid(simulator, NULL, 0);
+    }
+#endif
+    netsnmp_poller_free(poller);
+    free(targets);
+    netsnmp_cleanup_session(&session);
+    SOCK_CLEANUP;
+    return exitval;
+}
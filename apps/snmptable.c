@@ -56,6 +56,7 @@ SOFTWARE.
 #include <sys/select.h>
 #endif
 #include <stdio.h>
+#include <errno.h>
 #ifdef HAVE_NETDB_H
 #include <netdb.h>
 #endif
@@ -97,12 +98,19 @@ static int      exitval = 1;
 static int      use_getbulk = 1;
 static int      max_getbulk = 10;
 static int      extra_columns = 0;
+static int      stream = 0;
+
+#define OUTPUT_TEXT     0
+#define OUTPUT_CSV      1
+#define OUTPUT_JSON     2
+static int      output_format = OUTPUT_TEXT;
 
 void            usage(void);
 void            get_field_names(void);
 void            get_table_entries(netsnmp_session * ss);
 void            getbulk_table_entries(netsnmp_session * ss);
 void            print_table(void);
+int             stream_table_entries(netsnmp_session * ss);
 
 static void
 optProc(int argc, char *const *argv, int opt)
@@ -180,6 +188,32 @@ optProc(int argc, char *const *argv, int opt)
             case 'i':
                 show_index = 1;
                 break;
+            case 's':
+                stream = 1;
+                break;
+            case 'o':
+		if (optind < argc) {
+                    if (strcmp(argv[optind], "text") == 0)
+                        output_format = OUTPUT_TEXT;
+                    else if (strcmp(argv[optind], "csv") == 0)
+                        output_format = OUTPUT_CSV;
+                    else if (strcmp(argv[optind], "json") == 0)
+                        output_format = OUTPUT_JSON;
+                    else {
+                        usage();
+                        fprintf(stderr, "Bad -Co option: %s\n",
+                                argv[optind]);
+                        exit(1);
+                    }
+                    if (output_format != OUTPUT_TEXT)
+                        stream = 1;
+		} else {
+		    usage();
+                    fprintf(stderr, "Bad -Co option: no argument given\n");
+		    exit(1);
+		}
+		optind++;
+                break;
             case 'r':
 		if (optind < argc) {
 		    if (argv[optind]) {
@@ -225,8 +259,10 @@ usage(void)
     fprintf(stderr, "\t\t\t  H:       print no column headers\n");
     fprintf(stderr, "\t\t\t  i:       print index values\n");
     fprintf(stderr, "\t\t\t  l:       left justify output\n");
+    fprintf(stderr, "\t\t\t  o<FMT>:  print the table as text, csv or json (implies s)\n");
     fprintf(stderr, "\t\t\t  r<NUM>:  for GETBULK: set max-repeaters to <NUM>\n");
     fprintf(stderr, "\t\t\t           for GETNEXT: retrieve <NUM> entries at a time\n");
+    fprintf(stderr, "\t\t\t  s:       fetch the columns in parallel and print rows as they complete\n");
     fprintf(stderr, "\t\t\t  w<NUM>:  print table in parts of <NUM> chars width\n");
 }
 
@@ -315,6 +351,16 @@ main(int argc, char *argv[])
 
     exitval = 0;
 
+    if (stream) {
+        total_entries = stream_table_entries(ss);
+        if (exitval)
+            goto close_session;
+        if (total_entries == 0 && output_format == OUTPUT_TEXT &&
+            !headers_only)
+            printf("%s: No entries\n", table_name);
+        goto close_session;
+    }
+
     do {
         entries = 0;
         allocated = 0;
@@ -1061,3 +1107,523 @@ getbulk_table_entries(netsnmp_session * ss)
             snmp_free_pdu(response);
     }
 }
+
+/*
+ * Streaming mode: each column is walked on its own, with one request
+ * outstanding per column, and a row is printed as soon as every column
+ * has either returned a value for its index or moved past it.  Only the
+ * values between the slowest and the fastest column are kept in memory.
+ */
+struct stream_cell {
+    struct stream_cell *next;
+    oid            *index;
+    size_t          index_len;
+    char           *value;
+};
+
+struct stream_column {
+    oid             last[MAX_OID_LEN];  /* where the walk continues */
+    size_t          last_len;
+    struct stream_cell *head, *tail;
+    int             queued;
+    int             outstanding;
+    int             done;
+};
+
+static struct stream_column *stream_columns;
+static int      stream_outstanding;
+static int      stream_running;
+static int      stream_rows;
+
+static void
+stream_stop(int status)
+{
+    stream_running = 0;
+    exitval = status;
+}
+
+static void
+stream_print_string(const char *str)
+{
+    const char     *cp;
+
+    if (output_format == OUTPUT_CSV) {
+        if (strpbrk(str, ",\"\r\n") == NULL) {
+            fputs(str, stdout);
+            return;
+        }
+        putchar('"');
+        for (cp = str; *cp; cp++) {
+            if (*cp == '"')
+                putchar('"');
+            putchar(*cp);
+        }
+        putchar('"');
+        return;
+    }
+
+    /* OUTPUT_JSON */
+    putchar('"');
+    for (cp = str; *cp; cp++) {
+        if (*cp == '"' || *cp == '\\')
+            printf("\\%c", *cp);
+        else if ((unsigned char)*cp < 0x20)
+            printf("\\u%04x", (unsigned char)*cp);
+        else
+            putchar(*cp);
+    }
+    putchar('"');
+}
+
+static void
+stream_print_header(void)
+{
+    int             field;
+
+    if (no_headers)
+        return;
+
+    switch (output_format) {
+    case OUTPUT_CSV:
+        if (show_index)
+            printf("index%s", fields ? "," : "");
+        for (field = 0; field < fields; field++) {
+            if (field)
+                putchar(',');
+            stream_print_string(column[field].label);
+        }
+        printf("\n");
+        break;
+    case OUTPUT_JSON:
+        /* every row is a self-describing object */
+        break;
+    default:
+        if (!headers_only)
+            printf("SNMP table: %s\n\n", table_name);
+        if (show_index && !column_width && field_separator == NULL)
+            printf("%*s", index_width, "index");
+        else if (show_index && field_separator)
+            printf("index%s", field_separator);
+        for (field = 0; field < fields; field++) {
+            if (column_width)
+                printf(*left_justify_flag ? "%-*.*s" : "%*.*s",
+                       column_width + 1, column_width, column[field].label);
+            else if (field_separator)
+                printf("%s%s", field ? field_separator : "",
+                       column[field].label);
+            else
+                printf(*left_justify_flag ? " %-*s" : " %*s",
+                       column[field].width, column[field].label);
+        }
+        printf("\n");
+        break;
+    }
+}
+
+/*
+ * Return the index part of the printed name of a table object, as
+ * getbulk_table_entries() does.
+ */
+static char    *
+stream_index_string(char *buf)
+{
+    char           *name_p;
+
+    if (netsnmp_ds_get_boolean(NETSNMP_DS_LIBRARY_ID,
+                               NETSNMP_DS_LIB_EXTENDED_INDEX))
+        return strchr(buf, '[');
+
+    switch (netsnmp_ds_get_int(NETSNMP_DS_LIBRARY_ID,
+                               NETSNMP_DS_LIB_OID_OUTPUT_FORMAT)) {
+    case NETSNMP_OID_OUTPUT_MODULE:
+    case 0:
+        name_p = strchr(buf, ':');
+        if (name_p == NULL)
+            return NULL;
+        name_p++;
+        break;
+    case NETSNMP_OID_OUTPUT_SUFFIX:
+        name_p = buf;
+        break;
+    case NETSNMP_OID_OUTPUT_FULL:
+    case NETSNMP_OID_OUTPUT_NUMERIC:
+    case NETSNMP_OID_OUTPUT_FULL_AND_NUMERIC:
+    case NETSNMP_OID_OUTPUT_UCD:
+        if (strlen(buf) <= strlen(table_name) + 1)
+            return NULL;
+        name_p = strchr(buf + strlen(table_name) + 1, '.');
+        if (name_p == NULL)
+            return NULL;
+        name_p++;
+        break;
+    default:
+        return NULL;
+    }
+    name_p = strchr(name_p, '.');
+    return name_p ? name_p + 1 : NULL;
+}
+
+static void
+stream_print_row(int col, struct stream_cell **cells)
+{
+    oid             full[MAX_OID_LEN];
+    char           *buf = NULL;
+    const char     *index = NULL;
+    size_t          buf_len = 0, out_len = 0;
+    int             field, first = 1;
+
+    if (show_index) {
+        memmove(full, root, rootlen * sizeof(oid));
+        full[rootlen] = column[col].subid;
+        memmove(full + rootlen + 1, cells[col]->index,
+                cells[col]->index_len * sizeof(oid));
+        if (sprint_realloc_objid((u_char **)&buf, &buf_len, &out_len, 1,
+                                 full,
+                                 rootlen + 1 + cells[col]->index_len))
+            index = stream_index_string(buf);
+        if (index == NULL)
+            index = "?";
+    }
+
+    switch (output_format) {
+    case OUTPUT_CSV:
+        if (show_index) {
+            stream_print_string(index);
+            if (fields)
+                putchar(',');
+        }
+        for (field = 0; field < fields; field++) {
+            if (field)
+                putchar(',');
+            if (cells[field])
+                stream_print_string(cells[field]->value);
+        }
+        break;
+    case OUTPUT_JSON:
+        putchar('{');
+        if (show_index) {
+            printf("\"index\":");
+            stream_print_string(index);
+            first = 0;
+        }
+        for (field = 0; field < fields; field++) {
+            if (cells[field] == NULL)
+                continue;
+            if (!first)
+                putchar(',');
+            first = 0;
+            stream_print_string(column[field].label);
+            putchar(':');
+            stream_print_string(cells[field]->value);
+        }
+        putchar('}');
+        break;
+    default:
+        if (show_index) {
+            if (column_width)
+                printf("\nindex: %s\n", index);
+            else if (field_separator)
+                printf("%s%s", index, field_separator);
+            else
+                printf("%*s", index_width, index);
+        }
+        for (field = 0; field < fields; field++) {
+            const char     *value = cells[field] ? cells[field]->value : "?";
+
+            if (column_width)
+                printf(*left_justify_flag ? "%-*.*s" : "%*.*s",
+                       column_width + 1, column_width, value);
+            else if (field_separator)
+                printf("%s%s", field ? field_separator : "", value);
+            else
+                printf(*left_justify_flag ? " %-*s" : " %*s",
+                       column[field].width, value);
+        }
+        break;
+    }
+    printf("\n");
+    free(buf);
+}
+
+/*
+ * Print the rows which every column has moved past.
+ */
+static void
+stream_print_ready(void)
+{
+    struct stream_column *sc;
+    struct stream_cell **cells, *low;
+    int             field, low_field;
+
+    cells = calloc(fields, sizeof(*cells));
+    if (cells == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        stream_stop(1);
+        return;
+    }
+
+    for (;;) {
+        low = NULL;
+        low_field = -1;
+        for (field = 0; field < fields; field++) {
+            sc = &stream_columns[field];
+            if (sc->head == NULL) {
+                if (!sc->done)
+                    goto out;   /* this column may still return the row */
+                continue;
+            }
+            if (low == NULL ||
+                snmp_oid_compare(sc->head->index, sc->head->index_len,
+                                 low->index, low->index_len) < 0) {
+                low = sc->head;
+                low_field = field;
+            }
+        }
+        if (low == NULL)
+            break;
+
+        for (field = 0; field < fields; field++) {
+            sc = &stream_columns[field];
+            cells[field] = NULL;
+            if (sc->head && (sc->head == low ||
+                             snmp_oid_compare(sc->head->index,
+                                              sc->head->index_len,
+                                              low->index,
+                                              low->index_len) == 0)) {
+                cells[field] = sc->head;
+                sc->head = sc->head->next;
+                if (sc->head == NULL)
+                    sc->tail = NULL;
+                sc->queued--;
+            }
+        }
+        stream_print_row(low_field, cells);
+        stream_rows++;
+        for (field = 0; field < fields; field++) {
+            if (cells[field]) {
+                free(cells[field]->value);
+                free(cells[field]);
+            }
+        }
+    }
+  out:
+    free(cells);
+}
+
+static int
+stream_response(int operation, netsnmp_session * ss, int reqid,
+                netsnmp_pdu *response, void *magic)
+{
+    struct stream_column *sc = magic;
+    int             col;
+    netsnmp_variable_list *vars;
+    struct stream_cell *cell;
+    char           *buf = NULL, *cp;
+    size_t          buf_len = 0, out_len = 0;
+    int             count;
+
+    /* once stopped, the columns may already have been freed */
+    if (!stream_running)
+        return 1;
+    col = sc - stream_columns;
+    sc->outstanding = 0;
+    stream_outstanding--;
+
+    if (operation == NETSNMP_CALLBACK_OP_TIMED_OUT) {
+        fprintf(stderr, "Timeout: No Response from %s\n", ss->peername);
+        stream_stop(1);
+        return 1;
+    }
+    if (operation != NETSNMP_CALLBACK_OP_RECEIVED_MESSAGE) {
+        snmp_sess_perror("snmptable", ss);
+        stream_stop(1);
+        return 1;
+    }
+
+    if (response->errstat == SNMP_ERR_NOSUCHNAME) {
+        sc->done = 1;
+        return 1;
+    }
+    if (response->errstat != SNMP_ERR_NOERROR) {
+        fprintf(stderr, "Error in packet.\nReason: %s\n",
+                snmp_errstring(response->errstat));
+        if (response->errindex != 0) {
+            fprintf(stderr, "Failed object: ");
+            for (count = 1, vars = response->variables;
+                 vars && count != response->errindex;
+                 vars = vars->next_variable, count++)
+                /*EMPTY*/;
+            if (vars)
+                fprint_objid(stderr, vars->name, vars->name_length);
+            fprintf(stderr, "\n");
+        }
+        stream_stop(2);
+        return 1;
+    }
+
+    if (response->variables == NULL)
+        sc->done = 1;
+    for (vars = response->variables; vars; vars = vars->next_variable) {
+        if (vars->type == SNMP_ENDOFMIBVIEW ||
+            vars->name_length <= rootlen + 1 ||
+            memcmp(vars->name, root, rootlen * sizeof(oid)) != 0 ||
+            vars->name[rootlen] != column[col].subid) {
+            if (localdebug) {
+                fprint_variable(stderr, vars->name, vars->name_length, vars);
+                fprintf(stderr, " => end of column %s\n", column[col].label);
+            }
+            sc->done = 1;
+            break;
+        }
+        if (snmp_oid_compare(vars->name, vars->name_length,
+                             sc->last, sc->last_len) <= 0) {
+            out_len = 0;
+            sprint_realloc_objid((u_char **)&buf, &buf_len, &out_len, 1,
+                                 vars->name, vars->name_length);
+            fprintf(stderr, "OID not increasing: %s\n", buf);
+            free(buf);
+            stream_stop(2);
+            return 1;
+        }
+        memmove(sc->last, vars->name, vars->name_length * sizeof(oid));
+        sc->last_len = vars->name_length;
+
+        cell = malloc(sizeof(*cell) +
+                      (vars->name_length - rootlen - 1) * sizeof(oid));
+        if (cell == NULL) {
+            fprintf(stderr, "Out of memory\n");
+            stream_stop(1);
+            return 1;
+        }
+        cell->next = NULL;
+        cell->index = (oid *)(cell + 1);
+        cell->index_len = vars->name_length - rootlen - 1;
+        memmove(cell->index, vars->name + rootlen + 1,
+                cell->index_len * sizeof(oid));
+
+        buf = NULL;
+        buf_len = out_len = 0;
+        sprint_realloc_value((u_char **)&buf, &buf_len, &out_len, 1,
+                             vars->name, vars->name_length, vars);
+        if (buf == NULL)
+            buf = strdup("");
+        for (cp = buf; cp && *cp; cp++)
+            if (*cp == '\n')
+                *cp = ' ';
+        cell->value = buf;
+        buf = NULL;
+        buf_len = 0;
+
+        if (sc->tail)
+            sc->tail->next = cell;
+        else
+            sc->head = cell;
+        sc->tail = cell;
+        sc->queued++;
+    }
+    return 1;
+}
+
+static void
+stream_send(netsnmp_session * ss, struct stream_column *sc)
+{
+    netsnmp_pdu    *pdu;
+
+    if (use_getbulk) {
+        pdu = snmp_pdu_create(SNMP_MSG_GETBULK);
+        pdu->non_repeaters = 0;
+        pdu->max_repetitions = max_getbulk;
+    } else
+        pdu = snmp_pdu_create(SNMP_MSG_GETNEXT);
+    snmp_add_null_var(pdu, sc->last, sc->last_len);
+
+    if (snmp_async_send(ss, pdu, stream_response, sc) == 0) {
+        snmp_sess_perror("snmptable", ss);
+        snmp_free_pdu(pdu);
+        stream_stop(1);
+        return;
+    }
+    sc->outstanding = 1;
+    stream_outstanding++;
+}
+
+/*
+ * Walk all columns of the table at once, printing rows as they complete.
+ * Returns the number of rows printed.
+ */
+int
+stream_table_entries(netsnmp_session * ss)
+{
+    struct stream_column *sc;
+    struct stream_cell *cell;
+    fd_set          fdset;
+    struct timeval  timeout;
+    int             numfds, block, count, field, queue_limit;
+
+    stream_print_header();
+    if (headers_only)
+        return 0;
+
+    stream_columns = calloc(fields, sizeof(*stream_columns));
+    if (stream_columns == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        exitval = 1;
+        return 0;
+    }
+    for (field = 0; field < fields; field++) {
+        sc = &stream_columns[field];
+        memmove(sc->last, root, rootlen * sizeof(oid));
+        sc->last[rootlen] = column[field].subid;
+        sc->last_len = rootlen + 1;
+    }
+
+    /*
+     * A column which is far ahead of the others is not fetched further
+     * until the rows it holds have been printed.
+     */
+    queue_limit = 4 * (use_getbulk ? max_getbulk : 1);
+    if (queue_limit < 64)
+        queue_limit = 64;
+
+    stream_running = 1;
+    stream_rows = 0;
+    while (stream_running) {
+        for (field = 0; field < fields && stream_running; field++) {
+            sc = &stream_columns[field];
+            if (!sc->done && !sc->outstanding && sc->queued < queue_limit)
+                stream_send(ss, sc);
+        }
+        if (stream_outstanding == 0)
+            break;
+
+        numfds = 0;
+        block = 1;
+        FD_ZERO(&fdset);
+        snmp_select_info(&numfds, &fdset, &timeout, &block);
+        count = select(numfds, &fdset, NULL, NULL, block ? NULL : &timeout);
+        if (count > 0)
+            snmp_read(&fdset);
+        else if (count == 0)
+            snmp_timeout();
+        else if (errno != EINTR) {
+            perror("select");
+            stream_stop(1);
+        }
+        if (stream_running)
+            stream_print_ready();
+    }
+    if (exitval == 0)
+        stream_print_ready();
+
+    for (field = 0; field < fields; field++) {
+        sc = &stream_columns[field];
+        while ((cell = sc->head) != NULL) {
+            sc->head = cell->next;
+            free(cell->value);
+            free(cell);
+        }
+    }
+    SNMP_FREE(stream_columns);
+
+    return stream_rows;
+}
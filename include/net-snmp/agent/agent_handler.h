@@ -94,6 +94,34 @@ typedef struct netsnmp_mib_handler_s {
 #define HANDLER_CAN_SET_ONLY (HANDLER_CAN_SET | HANDLER_CAN_NOT_CREATE)
 #define HANDLER_CAN_DEFAULT (HANDLER_CAN_RONLY | HANDLER_CAN_NOT_CREATE)
 
+/*
+ * Latency statistics, kept while the latencyStats setting is on for
+ * every registration called, every cache loaded and every AgentX
+ * subagent round trip.
+ */
+#define NETSNMP_LATENCY_HANDLER     1
+#define NETSNMP_LATENCY_CACHE       2
+#define NETSNMP_LATENCY_AGENTX      3
+
+/* <= 10us, 100us, 1ms, 10ms, 100ms, 1s and over 1s */
+#define NETSNMP_LATENCY_BUCKETS     7
+
+typedef struct netsnmp_latency_stats_s {
+        int             index;
+        int             type;
+        char           *name;
+        char           *context;
+        oid            *rootoid;
+        size_t          rootoid_len;
+
+        u_long          count;
+        struct counter64 total;         /* usec */
+        u_long          max;            /* usec */
+        u_long          buckets[NETSNMP_LATENCY_BUCKETS];
+
+        struct netsnmp_latency_stats_s *next;
+} netsnmp_latency_stats;
+
 /** @typedef struct netsnmp_handler_registration_s netsnmp_handler_registration
  * Typedefs the netsnmp_handler_registration_s struct into netsnmp_handler_registration  */
 
@@ -136,6 +164,11 @@ typedef struct netsnmp_handler_registration_s {
          */
         void *          my_reg_void;
 
+        /**
+         * latency statistics, looked up on first use
+         */
+        netsnmp_latency_stats *latency;
+
 } netsnmp_handler_registration;
 
 /*
@@ -245,6 +278,16 @@ typedef int (Netsnmp_Node_Handler) (netsnmp_mib_handler *handler,
 
     void            netsnmp_clear_handler_list(void);
 
+    netsnmp_latency_stats *
+        netsnmp_latency_stats_get(int type, const char *name,
+                                  const char *context,
+                                  const oid *rootoid, size_t rootoid_len);
+    void            netsnmp_latency_stats_record(netsnmp_latency_stats *,
+                                                 const struct timeval *start);
+    netsnmp_latency_stats *netsnmp_latency_stats_first(void);
+    void            netsnmp_latency_stats_reset(void);
+    void            netsnmp_latency_stats_dump(void);
+
     void
         netsnmp_request_add_list_data(netsnmp_request_info *request,
                                       netsnmp_data_list *node);
@@ -41,6 +41,7 @@
 #define NETSNMP_DS_AGENT_DISKIO_NO_LOOP 19      /* 1 = don't report /dev/loop* entries in diskIOTable */
 #define NETSNMP_DS_AGENT_DISKIO_NO_RAM  20      /* 1 = don't report /dev/ram*  entries in diskIOTable */
 #define NETSNMP_DS_AGENT_DISKIO_NO_MD   21      /* 1 = don't report /dev/md*   entries in diskIOTable */
+#define NETSNMP_DS_AGENT_LATENCY_STATS  22      /* 1 = keep handler latency statistics */
 
 /* WARNING: The trap receiver also uses DS flags and must not conflict with these!
  * If you define additional boolean entries, check in "apps/snmptrapd_ds.h" first */
@@ -78,4 +79,7 @@
 #define NETSNMP_DS_AGENT_AVG_BULKVARBINDSIZE 15 /* avg varbind size estimate */
 #define NETSNMP_DS_AGENT_PDU_STATS_MAX       16 /* size of top N array*/
 #define NETSNMP_DS_AGENT_PDU_STATS_THRESHOLD 17 /* minimum threshold time */
+#define NETSNMP_DS_AGENT_AGENTX_MAX_OUTSTANDING 18 /* AgentX window per subagent */
+#define NETSNMP_DS_AGENT_INFORM_MAX_INFLIGHT  19 /* unacknowledged informs per sink */
+#define NETSNMP_DS_AGENT_INFORM_QUEUE_LENGTH  20 /* informs queued per sink */
 #endif
@@ -107,6 +107,21 @@ SOFTWARE.
         u_long          low;
     };
 
+    /*
+     * The last OID encoded by asn_realloc_rbuild_objid_cached(), together
+     * with its BER encoding.  Consecutive varbinds of a walk usually share
+     * a long prefix (the column), whose encoding is copied from here
+     * instead of being built again.  Set name_len to 0 before first use.
+     */
+    typedef struct netsnmp_oid_cache_s {
+        oid             name[MAX_OID_LEN];
+        size_t          name_len;
+        u_char          enc[MAX_OID_LEN * 5];
+        size_t          enc_len;
+        /** enc[0 .. end[j]) encodes name[0 .. j + 2) */
+        unsigned short  end[MAX_OID_LEN];
+    } netsnmp_oid_cache;
+
 #ifdef NETSNMP_WITH_OPAQUE_SPECIAL_TYPES
     typedef struct counter64 integer64;
     typedef struct counter64 unsigned64;
@@ -450,6 +465,14 @@ SOFTWARE.
                                              int allow_realloc,
                                              u_char type, const oid *,
                                              size_t);
+    NETSNMP_IMPORT
+    int             asn_realloc_rbuild_objid_cached(u_char ** pkt,
+                                                    size_t * pkt_len,
+                                                    size_t * offset,
+                                                    int allow_realloc,
+                                                    u_char type,
+                                                    const oid *, size_t,
+                                                    netsnmp_oid_cache *);
 
     NETSNMP_IMPORT
     int             asn_realloc_rbuild_null(u_char ** pkt,
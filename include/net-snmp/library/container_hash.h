@@ -0,0 +1,62 @@
+/*
+ * container_hash.h
+ *
+ * An unordered container using an open addressing hash table, for
+ * indexes which are only ever searched by exact key.
+ */
+#ifndef NETSNMP_CONTAINER_HASH_H
+#define NETSNMP_CONTAINER_HASH_H
+
+
+#include <net-snmp/library/container.h>
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+    /*
+     * function returning the hash of the key of a stored object. Objects
+     * which compare equal must have the same hash.
+     */
+    typedef u_int (netsnmp_container_hash)(const void *data);
+
+    /*
+     * initialize hash container. call at startup.
+     */
+    void netsnmp_container_hash_init(void);
+
+    /*
+     * get a container which uses a hash table for storage
+     */
+    NETSNMP_IMPORT
+    netsnmp_container *netsnmp_container_get_hash(void);
+
+    /*
+     * get a factory for producing hash container objects
+     */
+    struct netsnmp_factory_s *netsnmp_container_get_hash_factory(void);
+
+    /*
+     * set the hash function for a hash container. If none is set, one
+     * is chosen from the container's compare function when the first
+     * object is inserted (netsnmp_index, direct cstring and the
+     * long/int32 compares are recognized).
+     */
+    NETSNMP_IMPORT
+    int netsnmp_container_hash_set_func(netsnmp_container *c,
+                                        netsnmp_container_hash *hash);
+
+    /*
+     * hash functions for common key types
+     */
+    NETSNMP_IMPORT
+    u_int netsnmp_hash_netsnmp_index(const void *data);
+    NETSNMP_IMPORT
+    u_int netsnmp_hash_direct_cstring(const void *data);
+
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /** NETSNMP_CONTAINER_HASH_H */
@@ -0,0 +1,38 @@
+/*
+ * container_skiplist.h
+ *
+ * A sorted container with O(log n) insert, remove, find and find_next,
+ * suitable for large tables which are reloaded or updated out of order.
+ */
+#ifndef NETSNMP_CONTAINER_SKIPLIST_H
+#define NETSNMP_CONTAINER_SKIPLIST_H
+
+
+#include <net-snmp/library/container.h>
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+    /*
+     * initialize skiplist container. call at startup.
+     */
+    void netsnmp_container_skiplist_init(void);
+
+    /*
+     * get a container which uses a skiplist for storage
+     */
+    NETSNMP_IMPORT
+    netsnmp_container *netsnmp_container_get_skiplist(void);
+
+    /*
+     * get a factory for producing skiplist objects
+     */
+    struct netsnmp_factory_s *netsnmp_container_get_skiplist_factory(void);
+
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /** NETSNMP_CONTAINER_SKIPLIST_H */
@@ -106,6 +106,8 @@ extern          "C" {
 #define NETSNMP_DS_LIB_FILTER_SOURCE       46 /* filter pkt by source IP */
 #define NETSNMP_DS_LIB_ADD_FORWARDER_INFO  47 /* add info about forwarder to SNMP packets */
 #define NETSNMP_DS_LIB_SSH_AGENT           48 /* enable ssh agent forwarding */
+#define NETSNMP_DS_LIB_TLS_NO_RESUMPTION   49 /* no (D)TLS session resumption */
+#define NETSNMP_DS_LIB_LOG_ASYNC_BLOCK    50 /* wait, don't drop, when the async log queue is full */
 #define NETSNMP_DS_LIB_MAX_BOOL_ID         64 /* match NETSNMP_DS_MAX_SUBIDS */
 
     /*
@@ -131,6 +133,11 @@ extern          "C" {
 #define NETSNMP_DS_LIB_RETRIES             15
 #define NETSNMP_DS_LIB_MSG_SEND_MAX        16 /* global max response size */
 #define NETSNMP_DS_LIB_FILTER_TYPE         17 /* 0=NONE, 1=whitelist, -1=blacklist */
+#define NETSNMP_DS_LIB_TLS_SESSION_CACHE_SIZE 18 /* resumable (D)TLS sessions */
+#define NETSNMP_DS_LIB_TLS_SESSION_TIMEOUT 19 /* (D)TLS session lifetime */
+#define NETSNMP_DS_LIB_DTLS_MAX_HANDSHAKES 20 /* concurrent DTLS handshakes */
+#define NETSNMP_DS_LIB_DTLS_HANDSHAKE_TIMEOUT 21 /* stalled handshake limit */
+#define NETSNMP_DS_LIB_LOG_ASYNC_QUEUE    22 /* records in the async log queue */
 #define NETSNMP_DS_LIB_MAX_INT_ID          64 /* match NETSNMP_DS_MAX_SUBIDS */
     
     /*
@@ -66,6 +66,10 @@ extern          "C" {
     NETSNMP_IMPORT
     void            netsnmp_config_warn(const char *, ...)
 	NETSNMP_ATTRIBUTE_FORMAT(printf, 1, 2);
+    void            netsnmp_config_get_location(const char **filename,
+                                                unsigned int *lineno);
+    void            netsnmp_config_set_location(const char *filename,
+                                                unsigned int lineno);
 
     NETSNMP_IMPORT
     char           *skip_white(char *);
@@ -162,6 +162,53 @@ typedef struct netsnmp_priv_alg_info_s {
                                u_char * ciphertext, u_int ctlen,
                                u_char * plaintext, size_t * ptlen);
 
+    /*
+     * Keyed HMAC and cipher state, cached by the caller (e.g. per user)
+     * and passed to the _ctx variants below.  The state is rebuilt
+     * automatically when the key changes, and may be shared by threads.
+     */
+    typedef struct netsnmp_sc_ctx_s netsnmp_sc_ctx;
+
+    NETSNMP_IMPORT
+    int             sc_generate_keyed_hash_ctx(netsnmp_sc_ctx **ctx,
+                                               const oid * authtype,
+                                               size_t authtypelen,
+                                               const u_char * key,
+                                               u_int keylen,
+                                               const u_char * message,
+                                               u_int msglen,
+                                               u_char * MAC, size_t * maclen);
+
+    NETSNMP_IMPORT
+    int             sc_check_keyed_hash_ctx(netsnmp_sc_ctx **ctx,
+                                            const oid * authtype,
+                                            size_t authtypelen,
+                                            const u_char * key, u_int keylen,
+                                            const u_char * message,
+                                            u_int msglen, const u_char * MAC,
+                                            u_int maclen);
+
+    NETSNMP_IMPORT
+    int             sc_encrypt_ctx(netsnmp_sc_ctx **ctx,
+                                   const oid * privtype, size_t privtypelen,
+                                   u_char * key, u_int keylen,
+                                   u_char * iv, u_int ivlen,
+                                   const u_char * plaintext, u_int ptlen,
+                                   u_char * ciphertext, size_t * ctlen);
+
+    NETSNMP_IMPORT
+    int             sc_decrypt_ctx(netsnmp_sc_ctx **ctx,
+                                   const oid * privtype, size_t privtypelen,
+                                   u_char * key, u_int keylen,
+                                   u_char * iv, u_int ivlen,
+                                   u_char * ciphertext, u_int ctlen,
+                                   u_char * plaintext, size_t * ptlen);
+
+    NETSNMP_IMPORT
+    netsnmp_sc_ctx *sc_ctx_ref(netsnmp_sc_ctx **ctx);
+    NETSNMP_IMPORT
+    void            sc_ctx_free(netsnmp_sc_ctx **ctx);
+
     NETSNMP_IMPORT
     int             sc_hash_type(int auth_type, const u_char * buf,
                                  size_t buf_len, u_char * MAC,
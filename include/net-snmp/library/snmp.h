@@ -364,6 +364,18 @@ SOFTWARE.
                                                u_char value_type,
                                                u_char * value,
                                                size_t value_length);
+    struct netsnmp_oid_cache_s;     /* see asn1.h */
+    int             snmp_realloc_rbuild_var_op_cached(u_char ** pkt,
+                                                      size_t * pkt_len,
+                                                      size_t * offset,
+                                                      int allow_realloc,
+                                                      const oid * name,
+                                                      size_t * name_len,
+                                                      u_char value_type,
+                                                      u_char * value,
+                                                      size_t value_length,
+                                                      struct
+                                                      netsnmp_oid_cache_s *);
 #endif
 
 #ifdef __cplusplus
@@ -75,6 +75,10 @@ extern          "C" {
     int netsnmp_tlsbase_session_init(struct netsnmp_transport_s *,
                                      struct snmp_session *sess);
     int tls_get_verify_info_index(void);
+    void netsnmp_tlsbase_resume_session(SSL *ssl,
+                                        _netsnmpTLSBaseData *tlsdata,
+                                        const char *peer);
+    void netsnmp_tlsbase_count_handshake(SSL *ssl);
 
     void netsnmp_tlsbase_free_tlsdata(_netsnmpTLSBaseData *tlsbase);
 #ifdef __cplusplus
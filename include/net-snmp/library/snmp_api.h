@@ -90,7 +90,7 @@ SOFTWARE.
  */
 #ifdef SNMP_NEED_REQUEST_LIST
 typedef struct request_list {
-    struct request_list *next_request;
+    struct request_list *next_request;  /* unused; requests are indexed */
     long            request_id;     /* request id */
     long            message_id;     /* message id */
     netsnmp_callback callback;      /* user callback per request (NULL if unused) */
@@ -102,6 +102,7 @@ typedef struct request_list {
     struct snmp_session *session;
     netsnmp_pdu    *pdu;    /* The pdu for this request
 			     * (saved so it can be retransmitted */
+    int             expire_index;   /* position in the session's expiry heap */
 } netsnmp_request_list;
 #endif                          /* SNMP_NEED_REQUEST_LIST */
 
@@ -398,6 +399,8 @@ typedef struct request_list {
     int             netsnmp_oid_find_prefix(const oid * in_name1, size_t len1,
                                             const oid * in_name2, size_t len2);
     NETSNMP_IMPORT
+    const char     *netsnmp_oid_compare_impl(const char *name);
+    NETSNMP_IMPORT
     void            init_snmp(const char *);
 
     NETSNMP_IMPORT
@@ -412,6 +415,21 @@ typedef struct request_list {
 
     NETSNMP_IMPORT
     u_char         *snmp_pdu_build(const netsnmp_pdu *, u_char *, size_t *);
+
+    /*
+     * The variable-bindings of a PDU, encoded once so that sending the
+     * same variables to several sessions only encodes them once.
+     */
+    typedef struct netsnmp_encoded_varbinds_s netsnmp_encoded_varbinds;
+
+    NETSNMP_IMPORT
+    netsnmp_encoded_varbinds *snmp_pdu_encode_variables(const netsnmp_pdu *);
+    NETSNMP_IMPORT
+    void            snmp_free_encoded_variables(netsnmp_encoded_varbinds *);
+    NETSNMP_IMPORT
+    int             snmp_async_send_encoded(netsnmp_session *, netsnmp_pdu *,
+                                            const netsnmp_encoded_varbinds *,
+                                            snmp_callback, void *);
 #ifdef NETSNMP_USE_REVERSE_ASNENCODING
     NETSNMP_IMPORT
     u_char         *snmp_pdu_rbuild(const netsnmp_pdu *, u_char *, size_t *);
@@ -738,9 +756,20 @@ struct netsnmp_transport_s;
 #define  STAT_TLSTM_STATS_START                 STAT_TLSTM_SNMPTLSTMSESSIONOPENS
 #define  STAT_TLSTM_STATS_END          STAT_TLSTM_SNMPTLSTMSESSIONINVALIDCACHES
 
+    /*
+     * Net-SNMP specific (D)TLS counters
+     */
+#define  STAT_NSTLSTM_FULLHANDSHAKES                           57
+#define  STAT_NSTLSTM_RESUMEDHANDSHAKES                        58
+#define  STAT_NSTLSTM_HANDSHAKESDROPPED                        59
+#define  STAT_NSTLSTM_HANDSHAKESEXPIRED                        60
+
+#define  STAT_NSTLSTM_STATS_START          STAT_NSTLSTM_FULLHANDSHAKES
+#define  STAT_NSTLSTM_STATS_END            STAT_NSTLSTM_HANDSHAKESEXPIRED
+
     /* this previously was end+1; don't know why the +1 is needed;
        XXX: check the code */
-#define  NETSNMP_STAT_MAX_STATS              (STAT_TLSTM_STATS_END+1)
+#define  NETSNMP_STAT_MAX_STATS              (STAT_NSTLSTM_STATS_END+1)
 /** backwards compatability */
 #define MAX_STATS NETSNMP_STAT_MAX_STATS
 
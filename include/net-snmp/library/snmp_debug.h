@@ -144,6 +144,42 @@ extern          "C" {
 #define _DBG_IF_            snmp_get_do_debugging()
 #define DEBUGIF(x)         if (_DBG_IF_ && debug_is_token_registered(x) == SNMPERR_SUCCESS)
 
+    /*
+     * Each call site of the DEBUGMSG*() macros remembers whether its token
+     * is enabled, and only asks debug_is_token_registered() again when the
+     * token set has changed since (debug_token_generation) or the site is
+     * passed a different token pointer.  A site whose token is not enabled
+     * then costs a couple of comparisons, however many tokens are set.
+     * Only string literals are cached: a token held in a buffer (such as
+     * the one passed to config handlers) keeps its address while its
+     * contents change, so it is looked up every time.
+     */
+typedef struct netsnmp_debug_site_s {
+    const char     *token;
+    unsigned int    generation;
+    int             enabled;
+} netsnmp_debug_site;
+
+NETSNMP_IMPORT unsigned int debug_token_generation;
+NETSNMP_IMPORT
+int             debug_site_check(netsnmp_debug_site *site,
+                                 const char *token);
+
+#if defined(__GNUC__)
+#define __DBGTOKEN_IS_LITERAL(tok) __builtin_constant_p(tok)
+#else
+#define __DBGTOKEN_IS_LITERAL(tok) 0
+#endif
+#define __DBGTOKEN(tok, ...) tok
+#define __DBGSITE_IF(tok) \
+        static netsnmp_debug_site __dbg_site; \
+        if (_DBG_IF_ && \
+            (!__DBGTOKEN_IS_LITERAL(tok) ? \
+             debug_is_token_registered(tok) == SNMPERR_SUCCESS : \
+             (__dbg_site.generation == debug_token_generation && \
+              __dbg_site.token == (tok)) ? __dbg_site.enabled : \
+             debug_site_check(&__dbg_site, (tok))))
+
 #define __DBGMSGT(x)     debugmsgtoken x,  debugmsg x
 #define __DBGMSG_NC(x)   debugmsg x
 #define __DBGMSGT_NC(x)  debug_combo_nc x
@@ -123,6 +123,17 @@ void netsnmp_disable_this_loghandler( netsnmp_log_handler *logh );
 NETSNMP_IMPORT
 void netsnmp_logging_restart(void);
 
+/*
+ * Asynchronous logging: messages for a handler made asynchronous are
+ * queued and written by a separate thread (see the -La logging option).
+ */
+NETSNMP_IMPORT
+int netsnmp_loghandler_set_async( netsnmp_log_handler *logh );
+NETSNMP_IMPORT
+void netsnmp_async_log_flush(void);
+NETSNMP_IMPORT
+u_long netsnmp_async_log_dropped(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,138 @@
+/*
+ * snmp_poller.h
+ *
+ * An engine for polling many agents at once over a single UDP socket.
+ */
+#ifndef NETSNMP_SNMP_POLLER_H
+#define NETSNMP_SNMP_POLLER_H
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+    typedef struct netsnmp_poller_s netsnmp_poller;
+    typedef struct netsnmp_poller_target_s netsnmp_poller_target;
+
+    /*
+     * Called once for every request passed to netsnmp_poller_send(), with
+     * op set to NETSNMP_CALLBACK_OP_RECEIVED_MESSAGE and pdu set to the
+     * response, or NETSNMP_CALLBACK_OP_TIMED_OUT /
+     * NETSNMP_CALLBACK_OP_SEND_FAILED and pdu set to the request.  The
+     * pdu is freed by the poller when the callback returns.
+     */
+    typedef void (netsnmp_poller_callback) (int op,
+                                            netsnmp_poller_target *target,
+                                            int reqid, netsnmp_pdu *pdu,
+                                            void *magic);
+
+    typedef struct netsnmp_poller_stats_s {
+        u_long          sent;           /* requests, not counting retries */
+        u_long          retries;
+        u_long          responses;
+        u_long          timeouts;
+        u_long          send_failures;
+        u_long          dropped;        /* unexpected or unparsable packets */
+    } netsnmp_poller_stats;
+
+    /*
+     * Create a poller sending from the local UDP endpoint local (e.g.
+     * "udp:0.0.0.0:0"; NULL picks any free port).
+     */
+    NETSNMP_IMPORT
+    netsnmp_poller *netsnmp_poller_create(const char *local);
+    /*
+     * Free the poller and its targets.  Outstanding and queued requests
+     * are dropped without calling their callbacks.
+     */
+    NETSNMP_IMPORT
+    void            netsnmp_poller_free(netsnmp_poller *poller);
+
+    /*
+     * Set the initial timeout (microseconds) and the number of retries
+     * of new targets.  The timeout of each target then follows the round
+     * trip times measured for it, between min_timeout and max_timeout.
+     */
+    NETSNMP_IMPORT
+    void            netsnmp_poller_set_timeout(netsnmp_poller *poller,
+                                               long timeout, int retries,
+                                               long min_timeout,
+                                               long max_timeout);
+    /*
+     * Limit the number of requests outstanding in total (0: no limit)
+     * and the number of requests sent per second (0: no limit).
+     */
+    NETSNMP_IMPORT
+    void            netsnmp_poller_set_limits(netsnmp_poller *poller,
+                                              int max_outstanding,
+                                              int max_rate);
+
+    /*
+     * Add an SNMPv1 or SNMPv2c agent, given as host[:port].
+     */
+    NETSNMP_IMPORT
+    netsnmp_poller_target *netsnmp_poller_add_target(netsnmp_poller *poller,
+                                                     const char *peername,
+                                                     long version,
+                                                     const u_char *community,
+                                                     size_t community_len);
+    /*
+     * Limit the requests outstanding to a target (default 1) and set the
+     * minimum time between two requests to it, in microseconds.
+     */
+    NETSNMP_IMPORT
+    void            netsnmp_poller_target_set_limits(netsnmp_poller_target *
+                                                     target,
+                                                     int max_outstanding,
+                                                     long min_interval);
+    NETSNMP_IMPORT
+    const char     *netsnmp_poller_target_name(netsnmp_poller_target *target);
+    NETSNMP_IMPORT
+    void           *netsnmp_poller_target_get_data(netsnmp_poller_target *
+                                                   target);
+    NETSNMP_IMPORT
+    void            netsnmp_poller_target_set_data(netsnmp_poller_target *
+                                                   target, void *data);
+
+    /*
+     * Queue a request to a target.  Returns the request id, or 0 if the
+     * request could not be queued, in which case the caller still owns
+     * the pdu.
+     */
+    NETSNMP_IMPORT
+    int             netsnmp_poller_send(netsnmp_poller *poller,
+                                        netsnmp_poller_target *target,
+                                        netsnmp_pdu *pdu,
+                                        netsnmp_poller_callback *callback,
+                                        void *magic);
+
+    /*
+     * Event loop integration, as snmp_select_info(), snmp_read() and
+     * snmp_timeout().  netsnmp_poller_select_info() returns the number of
+     * requests that are queued or outstanding.
+     */
+    NETSNMP_IMPORT
+    int             netsnmp_poller_select_info(netsnmp_poller *poller,
+                                               int *numfds, fd_set *fdset,
+                                               struct timeval *timeout,
+                                               int *block);
+    NETSNMP_IMPORT
+    void            netsnmp_poller_read(netsnmp_poller *poller,
+                                        fd_set *fdset);
+    NETSNMP_IMPORT
+    void            netsnmp_poller_timeout(netsnmp_poller *poller);
+
+    /*
+     * Run until all queued and outstanding requests have completed.
+     */
+    NETSNMP_IMPORT
+    int             netsnmp_poller_run(netsnmp_poller *poller);
+
+    NETSNMP_IMPORT
+    const netsnmp_poller_stats *netsnmp_poller_get_stats(netsnmp_poller *
+                                                         poller);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /* NETSNMP_SNMP_POLLER_H */
@@ -80,6 +80,9 @@ extern          "C" {
        /* these are actually DH * pointers but only if openssl is avail. */
         void           *usmDHUserAuthKeyChange;
         void           *usmDHUserPrivKeyChange;
+       /* keyed HMAC and cipher state, see sc_generate_keyed_hash_ctx() */
+        struct netsnmp_sc_ctx_s *authCtx;
+        struct netsnmp_sc_ctx_s *privCtx;
         struct usmUser *next;
         struct usmUser *prev;
     };
@@ -193,6 +196,8 @@ extern          "C" {
     void            usm_parse_create_usmUser(const char *token,
                                              char *line);
     NETSNMP_IMPORT
+    void            usm_set_create_user_workers(int workers);
+    NETSNMP_IMPORT
     const oid      *get_default_authtype(size_t *);
     NETSNMP_IMPORT
     const oid      *get_default_privtype(size_t *);
@@ -58,27 +58,30 @@ extern "C" {
     /* Debug messages */
 #ifndef NETSNMP_NO_DEBUGGING
 #include <net-snmp/library/snmp_debug.h>	/* for internal macros */
-#define DEBUGMSG(x)        do {if (_DBG_IF_) {debugmsg x;} }while(0)
-#define DEBUGMSGT(x)       do {if (_DBG_IF_) {__DBGMSGT(x);} }while(0)
-#define DEBUGTRACE         do {if (_DBG_IF_) {__DBGTRACE;} }while(0)
-#define DEBUGTRACETOK(x)   do {if (_DBG_IF_) {__DBGTRACETOK(x);} }while(0)
-#define DEBUGMSGL(x)       do {if (_DBG_IF_) {__DBGMSGL(x);} }while(0)
-#define DEBUGMSGTL(x)      do {if (_DBG_IF_) {__DBGMSGTL(x);} }while(0)
-#define DEBUGMSGOID(x)     do {if (_DBG_IF_) {__DBGMSGOID(x);} }while(0)
-#define DEBUGMSGSUBOID(x)  do {if (_DBG_IF_) {__DBGMSGSUBOID(x);} }while(0)
-#define DEBUGMSGVAR(x)     do {if (_DBG_IF_) {__DBGMSGVAR(x);} }while(0)
-#define DEBUGMSGOIDRANGE(x) do {if (_DBG_IF_) {__DBGMSGOIDRANGE(x);} }while(0)
-#define DEBUGMSGHEX(x)     do {if (_DBG_IF_) {__DBGMSGHEX(x);} }while(0)
+#define DEBUGMSG(x)        do {__DBGSITE_IF(__DBGTOKEN x) {debugmsg x;} }while(0)
+#define DEBUGMSGT(x)       do {__DBGSITE_IF(__DBGTOKEN x) {__DBGMSGT(x);} }while(0)
+#define DEBUGTRACE         do {__DBGSITE_IF("trace") {__DBGTRACE;} }while(0)
+#define DEBUGTRACETOK(x)   do {__DBGSITE_IF(x) {__DBGTRACETOK(x);} }while(0)
+#define DEBUGMSGL(x)       do {__DBGSITE_IF(__DBGTOKEN x) {__DBGMSGL(x);} }while(0)
+#define DEBUGMSGTL(x)      do {__DBGSITE_IF(__DBGTOKEN x) {__DBGMSGTL(x);} }while(0)
+#define DEBUGMSGOID(x)     do {__DBGSITE_IF(__DBGTOKEN x) {__DBGMSGOID(x);} }while(0)
+#define DEBUGMSGSUBOID(x)  do {__DBGSITE_IF(__DBGTOKEN x) {__DBGMSGSUBOID(x);} }while(0)
+#define DEBUGMSGVAR(x)     do {__DBGSITE_IF(__DBGTOKEN x) {__DBGMSGVAR(x);} }while(0)
+#define DEBUGMSGOIDRANGE(x) do {__DBGSITE_IF(__DBGTOKEN x) {__DBGMSGOIDRANGE(x);} }while(0)
+#define DEBUGMSGHEX(x)     do {__DBGSITE_IF(__DBGTOKEN x) {__DBGMSGHEX(x);} }while(0)
 #define DEBUGMSGHEXTLI(x)  do {if (_DBG_IF_) {__DBGMSGHEXTLI(x);} }while(0)
 #define DEBUGINDENTADD(x)  do {if (_DBG_IF_) {__DBGINDENTADD(x);} }while(0)
 #define DEBUGINDENTMORE()  do {if (_DBG_IF_) {__DBGINDENTMORE();} }while(0)
 #define DEBUGINDENTLESS()  do {if (_DBG_IF_) {__DBGINDENTLESS();} }while(0)
 #define DEBUGPRINTINDENT(token) \
-	do {if (_DBG_IF_) {__DBGPRINTINDENT(token);} }while(0)
+	do {__DBGSITE_IF(token) {__DBGPRINTINDENT(token);} }while(0)
+/* the indentation must follow the header, printed or not */
 #define DEBUGDUMPHEADER(token,x) \
-	do {if (_DBG_IF_) {__DBGDUMPHEADER(token,x);} }while(0)
+	do {__DBGSITE_IF("dumph_" token) {__DBGDUMPHEADER(token,x);} \
+	    else if (_DBG_IF_) {__DBGINDENTMORE();} }while(0)
 #define DEBUGDUMPSECTION(token,x) \
-	do {if (_DBG_IF_) {__DBGDUMPSECTION(token,x);} }while(0)
+	do {__DBGSITE_IF("dumph_" token) {__DBGDUMPSECTION(token,x);} \
+	    else if (_DBG_IF_) {__DBGINDENTMORE();} }while(0)
 #define DEBUGDUMPSETUP(token,buf,len) \
 	do {if (_DBG_IF_) {__DBGDUMPSETUP(token,buf,len);} }while(0)
 #define DEBUGMSG_NC(x)  do { __DBGMSG_NC(x); }while(0)
@@ -1498,6 +1498,15 @@ asn_parse_objid(u_char * data,
     (*objidlength)--;           /* account for expansion of first byte */
 
     while (length > 0 && (*objidlength)-- > 0) {
+        /*
+         * most sub-identifiers (e.g. all those of the mib-2 prefix) are
+         * below 128 and take a single byte
+         */
+        if (!(*bufp & ASN_BIT8)) {
+            *oidp++ = *bufp++;
+            length--;
+            continue;
+        }
         subidentifier = 0;
         do {                    /* shift and add in low order 7 bits */
             subidentifier =
@@ -3280,6 +3289,80 @@ asn_realloc_rbuild_objid(u_char ** pkt, size_t * pkt_len,
                          size_t * offset, int r,
                          u_char type,
                          const oid * objid, size_t objidlength)
+{
+    return asn_realloc_rbuild_objid_cached(pkt, pkt_len, offset, r, type,
+                                           objid, objidlength, NULL);
+}
+
+/**
+ * @internal
+ * Encode objid into cache, reusing the encoding of the sub-identifiers it
+ * shares with the object identifier encoded before it.  objidlength must
+ * be between 2 and MAX_OID_LEN and the first two sub-identifiers valid.
+ */
+static void
+_asn_oid_cache_encode(netsnmp_oid_cache * cache,
+                      const oid * objid, size_t objidlength)
+{
+    size_t          shared = 0, pos = 0, j;
+    uint32_t        subid;
+    oid             tmpint;
+    int             n, k;
+
+    if (cache->name_len >= 2) {
+        j = SNMP_MIN(cache->name_len, objidlength);
+        shared = netsnmp_oid_find_prefix(cache->name, j, objid, j);
+        if (shared >= 2)
+            pos = cache->end[shared - 2];
+        else
+            shared = 0;
+    }
+
+    /*
+     * encoded sub-identifier j holds objid[j + 1], except for the first
+     * one, which combines the first two values
+     */
+    for (j = shared ? shared - 1 : 0; j < objidlength - 1; j++) {
+        if (j == 0)
+            subid = objid[0] * 40 + objid[1];
+        else {
+            tmpint = objid[j + 1];
+            CHECK_OVERFLOW_U(tmpint, 12);
+            subid = tmpint;
+        }
+        n = encoded_oid_len(subid);
+        for (k = n - 1; k >= 0; k--) {
+            cache->enc[pos + k] = (subid & 0x7f) | (k == n - 1 ? 0 : 0x80);
+            subid >>= 7;
+        }
+        pos += n;
+        cache->end[j] = pos;
+    }
+
+    memcpy(cache->name + shared, objid + shared,
+           (objidlength - shared) * sizeof(oid));
+    cache->name_len = objidlength;
+    cache->enc_len = pos;
+}
+
+/**
+ * @internal
+ * builds an ASN object containing an objid, copying the encoding of the
+ * sub-identifiers it shares with the previous one built with the same
+ * cache.
+ *
+ * @see asn_realloc_rbuild_objid
+ *
+ * @param cache   IN/OUT the previous object identifier, or NULL
+ *
+ * @return 1 on success, 0 on error
+ */
+int
+asn_realloc_rbuild_objid_cached(u_char ** pkt, size_t * pkt_len,
+                                size_t * offset, int r,
+                                u_char type,
+                                const oid * objid, size_t objidlength,
+                                netsnmp_oid_cache * cache)
 {
     /*
      * ASN.1 objid ::= 0x06 asnlength subidentifier {subidentifier}*
@@ -3311,6 +3394,18 @@ asn_realloc_rbuild_objid(u_char ** pkt, size_t * pkt_len,
          */
         if (!store_byte(pkt, pkt_len, offset, r, 40 * objid[0]))
             return 0;
+    } else if (cache && objidlength <= MAX_OID_LEN) {
+        if (objid[1] > 40 && objid[0] < 2) {
+            ERROR_MSG("build objid: bad second subidentifier");
+            return 0;
+        }
+        _asn_oid_cache_encode(cache, objid, objidlength);
+        while ((*pkt_len - *offset) < cache->enc_len) {
+            if (!(r && asn_realloc(pkt, pkt_len)))
+                return 0;
+        }
+        *offset += cache->enc_len;
+        memcpy(*pkt + *pkt_len - *offset, cache->enc, cache->enc_len);
     } else {
         for (i = objidlength - 1; i >= 2; i--) {
             tmpint = objid[i];
@@ -90,7 +90,7 @@ netsnmp_feature_child_of(tls_fingerprint_build, cert_util_all);
  * bump this value whenever cert index format changes, so indexes
  * will be regenerated with new format.
  */
-#define CERT_INDEX_FORMAT  2
+#define CERT_INDEX_FORMAT  3
 
 static netsnmp_container *_certs = NULL;
 static netsnmp_container *_keys = NULL;
@@ -1058,6 +1058,25 @@ netsnmp_ocert_get(netsnmp_cert *cert)
         return NULL;
     }
 
+    /*
+     * the cert was looked up by the fingerprint in the index; if the
+     * file has been replaced since, don't use what is there now.
+     */
+    if (cert->fingerprint) {
+        char *fingerprint =
+            netsnmp_openssl_cert_get_fingerprint(ocert, cert->hash_type);
+        int   same = fingerprint &&
+            strcmp(fingerprint, cert->fingerprint) == 0;
+
+        free(fingerprint);
+        if (!same) {
+            snmp_log(LOG_ERR, "certificate file %s has changed since it "
+                     "was indexed, ignoring\n", cert->info.filename);
+            X509_free(ocert);
+            return NULL;
+        }
+    }
+
     netsnmp_ocert_parse(cert, ocert);
 
     return ocert;
@@ -1264,6 +1283,79 @@ _find_partner(netsnmp_cert *cert, netsnmp_key *key)
     }
 }
 
+/*
+ * write the index line for a cert or key
+ */
+static void
+_cert_index_write(FILE *index, netsnmp_cert_common *entry)
+{
+    netsnmp_cert *cert;
+
+    if ((NULL == index) || (NULL == entry))
+        return;
+
+    if (NS_CERT_TYPE_KEY == entry->type) {
+        fprintf(index, "k:%s\n", entry->filename);
+        return;
+    }
+
+    /** filename = NAME_MAX = 255 */
+    /** fingerprint max = 64*3=192 for sha512 */
+    /** common name / CN  = 64 */
+    cert = (netsnmp_cert *)entry;
+    fprintf(index, "c:%s %d %d %d %d %s '%s' '%s'\n", entry->filename,
+            entry->type, cert->offset, entry->allowed_uses, cert->hash_type,
+            cert->fingerprint, cert->common_name, cert->subject);
+}
+
+static int
+_cert_file_stat(const char *dirname, const char *filename, struct stat *st)
+{
+    char            file[SNMP_MAXPATH];
+
+    snprintf(file, sizeof(file), "%s/%s", dirname, filename);
+    return stat(file, st);
+}
+
+/*
+ * write the index line for a file, ahead of its certs and keys. Time
+ * stamps alone can't be trusted to tell whether a file changed, since
+ * a file replaced by cp -p, tar, rsync -t or a rename may well keep an
+ * older mtime; the size and inode are recorded as well.
+ */
+static void
+_cert_index_write_file(FILE *index, const char *filename,
+                       const struct stat *st)
+{
+    if (NULL == index)
+        return;
+
+    fprintf(index, "f:%s %lu %lu %ld %ld\n", filename,
+            (unsigned long)st->st_size, (unsigned long)st->st_ino,
+            (long)st->st_mtime, (long)st->st_ctime);
+}
+
+/*
+ * check the index line for a file against the file as it is now
+ */
+static int
+_cert_index_file_unchanged(const char *dirname, const char *filename,
+                           const char *line)
+{
+    struct stat     st;
+    unsigned long   size, ino;
+    long            mtime, ctime;
+
+    if (sscanf(line, "%lu %lu %ld %ld", &size, &ino, &mtime, &ctime) != 4)
+        return 0;
+    if (_cert_file_stat(dirname, filename, &st) != 0)
+        return 0;
+
+    return size == (unsigned long)st.st_size &&
+        ino == (unsigned long)st.st_ino &&
+        mtime == (long)st.st_mtime && ctime == (long)st.st_ctime;
+}
+
 static netsnmp_key *
 _add_key(EVP_PKEY *okey, const char* dirname, const char* filename, FILE *index)
 {
@@ -1282,9 +1374,8 @@ _add_key(EVP_PKEY *okey, const char* dirname, const char* filename, FILE *index)
         netsnmp_key_free(key);
         key = NULL;
     }
-    if (index) {
-        fprintf(index, "k:%s\n", filename);
-    }
+    else
+        _cert_index_write(index, &key->info);
 
     return key;
 }
@@ -1305,20 +1396,19 @@ _add_cert(X509 *ocert, const char* dirname, const char* filename, int type, int
     if (-1 == CONTAINER_INSERT(_certs, cert)) {
         DEBUGMSGT(("cert:file:add:err",
                    "error inserting cert into container\n"));
+        cert->ocert = NULL; /* caller frees ocert */
         netsnmp_cert_free(cert);
         return NULL;
     }
 
-    if (index) {
-        /** filename = NAME_MAX = 255 */
-        /** fingerprint max = 64*3=192 for sha512 */
-        /** common name / CN  = 64 */
-        if (cert)
-            fprintf(index, "c:%s %d %d %d %d %s '%s' '%s'\n", filename,
-                    cert->info.type, cert->offset, cert->info.allowed_uses,
-                    cert->hash_type, cert->fingerprint,
-                    cert->common_name, cert->subject);
-    }
+    _cert_index_write(index, &cert->info);
+
+    /*
+     * everything needed for lookups is indexed now, so don't hold on
+     * to the parsed certificate; it is read again on first use.
+     */
+    X509_free(cert->ocert);
+    cert->ocert = NULL;
 
     return cert;
 }
@@ -1454,8 +1544,83 @@ _add_certfile(const char* dirname, const char* filename, FILE *index)
     return 0;
 }
 
+static void
+_cert_index_entry_free(void *entry, void *context)
+{
+    if (NS_CERT_TYPE_KEY == ((netsnmp_cert_common *)entry)->type)
+        netsnmp_key_free(entry);
+    else
+        netsnmp_cert_free(entry);
+}
+
+/*
+ * container for the certs and keys read from an index, by file name
+ */
+static netsnmp_container *
+_cert_index_container(const char *use)
+{
+    netsnmp_container *c;
+    int                rc;
+
+    c = netsnmp_container_find("cert_index:binary_array");
+    if (NULL == c) {
+        snmp_log(LOG_ERR, "could not create container for %s\n", use);
+        return NULL;
+    }
+    c->container_name = strdup(use);
+    c->free_item = _cert_index_entry_free;
+    c->compare = _cert_fn_compare;
+    c->ncompare = _cert_fn_ncompare;
+
+    CONTAINER_SET_OPTIONS(c, CONTAINER_KEY_ALLOW_DUPLICATES, rc);
+
+    return c;
+}
+
+/*
+ * remove and return all index entries for the given file
+ */
+static netsnmp_void_array *
+_cert_index_take(netsnmp_container *entries, const char *dirname,
+                 const char *filename)
+{
+    netsnmp_cert_common   search, *entry;
+    netsnmp_void_array   *matching;
+    size_t                i, n;
+
+    memset(&search, 0x00, sizeof(search));
+    search.dir = NETSNMP_REMOVE_CONST(char*,dirname);
+    search.filename = NETSNMP_REMOVE_CONST(char*,filename);
+
+    matching = CONTAINER_GET_SUBSET(entries, &search);
+    if (NULL == matching)
+        return NULL;
+
+    /** subset is a prefix match; keep only this file */
+    for (i = n = 0; i < matching->size; ++i) {
+        entry = (netsnmp_cert_common *)matching->array[i];
+        if (strcmp(entry->filename, filename) != 0)
+            continue;
+        CONTAINER_REMOVE(entries, entry);
+        matching->array[n++] = entry;
+    }
+    matching->size = n;
+    if (0 == n) {
+        free(matching->array);
+        SNMP_FREE(matching);
+    }
+    return matching;
+}
+
+/*
+ * read an index. If it is current, its certs and keys are added and the
+ * number of entries is returned. If some files changed since it was
+ * written, -1 is returned and *reusable is set to the entries for the
+ * unchanged files, so only the changed ones need to be parsed again.
+ */
 static int
-_cert_read_index(const char *dirname, struct stat *dirstat)
+_cert_read_index(const char *dirname, struct stat *dirstat,
+                 netsnmp_container **reusable)
 {
     FILE           *index;
     char           *idxname, *pos;
@@ -1463,14 +1628,23 @@ _cert_read_index(const char *dirname, struct stat *dirstat)
     char            tmpstr[SNMP_MAXPATH + 5], filename[NAME_MAX];
     char            fingerprint[EVP_MAX_MD_SIZE*3], common_name[64+1], type_str[15];
     char            subject[SNMP_MAXBUF_SMALL], hash_str[15], offset_str[15];
-    char            allowed_uses_str[15];
+    char            allowed_uses_str[15], curfile[NAME_MAX];
     ssize_t         offset;
-    int             count = 0, type, allowed_uses, hash, version;
+    int             count = 0, type, allowed_uses, hash, version, stale = 0;
+    int             curfile_ok = 0;
     netsnmp_cert    *cert;
     netsnmp_key     *key;
+    netsnmp_cert_common *entry;
     netsnmp_container *newer, *found;
+    netsnmp_iterator  *itr;
+    netsnmp_void_array *changed;
+    netsnmp_file      *file;
+    size_t             i;
 
     netsnmp_assert(NULL != dirname);
+    netsnmp_assert(NULL != reusable);
+
+    *reusable = NULL;
 
     idxname = _certindex_lookup( dirname );
     if (NULL == idxname) {
@@ -1494,8 +1668,7 @@ _cert_read_index(const char *dirname, struct stat *dirstat)
 #else
     if (dirstat->st_mtime >= idx_stat.st_mtime) {
         DEBUGMSGT(("cert:index:parse", "Index outdated; dir modified\n"));
-        SNMP_FREE(idxname);
-        return -1;
+        stale = 1;
     }
 #endif
 
@@ -1511,23 +1684,29 @@ _cert_read_index(const char *dirname, struct stat *dirstat)
                                               NETSNMP_DIR_ALLOW_DUPLICATES);
     if (newer) {
         DEBUGMSGT(("cert:index:parse", "Index outdated; files modified\n"));
-        CONTAINER_FREE_ALL(newer, NULL);
-        CONTAINER_FREE(newer);
-        SNMP_FREE(idxname);
-        return -1;
+        stale = 1;
     }
 
-    DEBUGMSGT(("cert:index:parse", "The index for %s looks good\n", dirname));
+    if (!stale)
+        DEBUGMSGT(("cert:index:parse", "The index for %s looks good\n",
+                   dirname));
 
     index = fopen(idxname, "r");
     if (NULL == index) {
         snmp_log(LOG_ERR, "cert:index:parse can't open index for %s\n",
             dirname);
         SNMP_FREE(idxname);
-        return -1;
+        count = -1;
+        goto free_newer;
     }
 
-    found = _get_cert_container(idxname);
+    found = _cert_index_container(idxname);
+    if (NULL == found) {
+        fclose(index);
+        SNMP_FREE(idxname);
+        count = -1;
+        goto free_newer;
+    }
 
     /*
      * check index format version
@@ -1545,10 +1724,23 @@ _cert_read_index(const char *dirname, struct stat *dirstat)
         count = -1;
         goto free_cert_container;
     }
+    curfile[0] = '\0';
     while (1) {
         if (NULL == fgets(tmpstr, sizeof(tmpstr), index))
             break;
 
+        if ('f' == tmpstr[0]) {
+            pos = copy_nword(&tmpstr[2], curfile, sizeof(curfile));
+            curfile_ok = pos &&
+                _cert_index_file_unchanged(dirname, curfile, pos);
+            if (!curfile_ok) {
+                DEBUGMSGT(("cert:index:parse", "Index outdated; %s replaced\n",
+                           curfile));
+                stale = 1;
+            }
+            continue;
+        }
+
         if ('c' == tmpstr[0]) {
             pos = &tmpstr[2];
             if ((NULL == (pos=copy_nword(pos, filename, sizeof(filename)))) ||
@@ -1566,6 +1758,9 @@ _cert_read_index(const char *dirname, struct stat *dirstat)
                 count = -1;
                 break;
             }
+            /** entries for changed files are parsed again */
+            if (!curfile_ok || strcmp(filename, curfile) != 0)
+                continue;
             type = atoi(type_str);
             offset = atoi(offset_str);
             allowed_uses = atoi(allowed_uses_str);
@@ -1587,8 +1782,10 @@ _cert_read_index(const char *dirname, struct stat *dirstat)
                     tmpstr);
                 continue;
             }
+            if (!curfile_ok || strcmp(filename, curfile) != 0)
+                continue;
             key = _new_key(dirname, filename);
-            if (key && 0 == CONTAINER_INSERT(_keys, key))
+            if (key && 0 == CONTAINER_INSERT(found, key))
                 ++count;
             else {
                 DEBUGMSGT(("cert:index:add:key",
@@ -1604,16 +1801,54 @@ _cert_read_index(const char *dirname, struct stat *dirstat)
     fclose(index);
     SNMP_FREE(idxname);
 
+    if (count < 0)
+        goto free_cert_container;
+
+    if (stale) {
+        /*
+         * drop the entries for modified files; the rest can be reused
+         * when the directory is rescanned.
+         */
+        itr = newer ? CONTAINER_ITERATOR(newer) : NULL;
+        if (newer && NULL == itr) {
+            snmp_log(LOG_ERR, "could not get iterator for modified files\n");
+            count = -1;
+            goto free_cert_container;
+        }
+        for (file = itr ? ITERATOR_FIRST(itr) : NULL; file;
+             file = ITERATOR_NEXT(itr)) {
+            changed = _cert_index_take(found, dirname, file->name);
+            if (NULL == changed)
+                continue;
+            DEBUGMSGT(("cert:index:parse", "%s changed; %" NETSNMP_PRIz
+                       "d entries dropped\n", file->name, changed->size));
+            for (i = 0; i < changed->size; ++i)
+                _cert_index_entry_free(changed->array[i], NULL);
+            free(changed->array);
+            free(changed);
+        }
+        if (itr)
+            ITERATOR_RELEASE(itr);
+        *reusable = found;
+        found = NULL;
+        count = -1;
+        goto free_newer;
+    }
+
     if (count > 0) {
-        netsnmp_iterator  *itr = CONTAINER_ITERATOR(found);
+        itr = CONTAINER_ITERATOR(found);
         if (NULL == itr) {
             snmp_log(LOG_ERR, "could not get iterator for found certs\n");
             count = -1;
         }
         else {
-            cert = ITERATOR_FIRST(itr);
-            for( ; cert; cert = ITERATOR_NEXT(itr))
-                CONTAINER_INSERT(_certs, cert);
+            entry = ITERATOR_FIRST(itr);
+            for( ; entry; entry = ITERATOR_NEXT(itr)) {
+                if (NS_CERT_TYPE_KEY == entry->type)
+                    CONTAINER_INSERT(_keys, entry);
+                else
+                    CONTAINER_INSERT(_certs, entry);
+            }
             ITERATOR_RELEASE(itr);
             DEBUGMSGT(("cert:index:parse","added %d certs from index\n",
                        count));
@@ -1625,6 +1860,49 @@ free_cert_container:
         CONTAINER_FREE_ALL(found, NULL);
     CONTAINER_FREE(found);
 
+free_newer:
+    if (newer) {
+        CONTAINER_FREE_ALL(newer, NULL);
+        CONTAINER_FREE(newer);
+    }
+
+    return count;
+}
+
+/*
+ * add the certs and keys of an unchanged file from the old index
+ */
+static int
+_cert_index_reuse(netsnmp_container *reusable, const char *dirname,
+                  const char *filename, FILE *index)
+{
+    netsnmp_void_array  *matching;
+    netsnmp_cert_common *entry;
+    size_t               i;
+    int                  count = 0, rc;
+
+    matching = _cert_index_take(reusable, dirname, filename);
+    if (NULL == matching)
+        return 0;
+
+    for (i = 0; i < matching->size; ++i) {
+        entry = (netsnmp_cert_common *)matching->array[i];
+        if (NS_CERT_TYPE_KEY == entry->type)
+            rc = CONTAINER_INSERT(_keys, entry);
+        else
+            rc = CONTAINER_INSERT(_certs, entry);
+        if (rc != 0) {
+            DEBUGMSGT(("cert:index:add",
+                       "error inserting %s into container\n", filename));
+            _cert_index_entry_free(entry, NULL);
+            continue;
+        }
+        _cert_index_write(index, entry);
+        ++count;
+    }
+    free(matching->array);
+    free(matching);
+
     return count;
 }
 
@@ -1634,9 +1912,9 @@ _add_certdir(const char *dirname)
     FILE           *index;
     char           *file;
     int             count = 0;
-    netsnmp_container *cert_container;
+    netsnmp_container *cert_container, *reusable;
     netsnmp_iterator  *it;
-    struct stat     statbuf;
+    struct stat     statbuf, filestat;
 
     netsnmp_assert(NULL != dirname);
 
@@ -1659,9 +1937,10 @@ _add_certdir(const char *dirname)
     /*
      * look for existing index
      */
-    count = _cert_read_index(dirname, &statbuf);
+    count = _cert_read_index(dirname, &statbuf, &reusable);
     if (count >= 0)
         return count;
+    count = 0;
 
     index = _certindex_new( dirname );
     if (NULL == index) {
@@ -1671,7 +1950,8 @@ _add_certdir(const char *dirname)
     }
 
     /*
-     * index was missing, out of date or bad. rescan directory.
+     * index was missing, out of date or bad. rescan directory, reusing
+     * the old entries for files that haven't changed.
      */
     cert_container =
         netsnmp_directory_container_read_some(NULL, dirname,
@@ -1696,6 +1976,14 @@ _add_certdir(const char *dirname)
     }
 
     for (file = ITERATOR_FIRST(it); file; file = ITERATOR_NEXT(it)) {
+        /** without its file line, a file's entries are never reused */
+        if (_cert_file_stat(dirname, file, &filestat) == 0)
+            _cert_index_write_file(index, file, &filestat);
+        if (reusable && _cert_index_reuse(reusable, dirname, file, index) > 0) {
+            DEBUGMSGT(("9:cert:index:dir", "kept %s in index\n", file));
+            count++;
+            continue;
+        }
         DEBUGMSGT(("cert:index:dir", "adding %s to index\n", file));
         if ( 0 == _add_certfile( dirname, file, index ))
             count++;
@@ -1715,6 +2003,11 @@ _add_certdir(const char *dirname)
   err_index:
     if (index)
         fclose(index);
+    if (reusable) {
+        /** entries for files that have gone away */
+        CONTAINER_FREE_ALL(reusable, NULL);
+        CONTAINER_FREE(reusable);
+    }
 
     return count;
 }
@@ -0,0 +1,728 @@
+/*
+ * container_hash.c
+ *
+ * An unordered container based on an open addressing (linear probing)
+ * hash table.  find, insert and remove cost O(1) on average, which suits
+ * secondary indexes that are only ever searched by exact key, such as
+ * ifIndex -> entry.  Entries are not kept in any order, so find_next
+ * and get_subset with a key are refused, and the container always has
+ * the CONTAINER_KEY_UNSORTED flag set.
+ */
+#include <net-snmp/net-snmp-config.h>
+#include <net-snmp/net-snmp-features.h>
+
+#include <stdio.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_MALLOC_H
+#include <malloc.h>
+#endif
+#include <sys/types.h>
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#include <strings.h>
+#endif
+
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/types.h>
+#include <net-snmp/library/snmp_api.h>
+#include <net-snmp/library/container.h>
+#include <net-snmp/library/tools.h>
+#include <net-snmp/library/snmp_assert.h>
+
+#include <net-snmp/library/container_hash.h>
+#include "factory.h"
+
+netsnmp_feature_child_of(container_hash, container_types);
+
+#ifndef NETSNMP_FEATURE_REMOVE_CONTAINER_HASH
+
+#define HASH_MIN_SLOTS 16
+
+/*
+ * a removed entry. Lookups must probe past it, inserts may reuse it.
+ */
+static char     _hash_deleted;
+#define HASH_DELETED ((void *)&_hash_deleted)
+
+typedef struct hash_slot_s {
+    void           *data;     /* NULL = empty */
+    u_int           hash;
+} hash_slot;
+
+typedef struct hash_container_s {
+    netsnmp_container          c;
+
+    netsnmp_container_hash    *hash;
+    hash_slot                 *slots;
+    size_t                     mask;      /* number of slots - 1 */
+    size_t                     count;     /* live entries */
+    size_t                     deleted;   /* HASH_DELETED slots */
+} hash_container;
+
+typedef struct hash_iterator_s {
+    netsnmp_iterator base;
+
+    size_t           pos;
+} hash_iterator;
+
+static netsnmp_iterator *_hash_iterator_get(netsnmp_container *c);
+
+/**********************************************************************
+ *
+ * hash functions
+ *
+ */
+#define FNV_OFFSET 2166136261U
+#define FNV_PRIME  16777619U
+
+u_int
+netsnmp_hash_netsnmp_index(const void *data)
+{
+    const netsnmp_index *idx = data;
+    u_int           h = FNV_OFFSET;
+    size_t          i;
+
+    /* sub-identifiers are 32 bit values, even where oid is wider */
+    for (i = 0; i < idx->len; ++i)
+        h = (h ^ (u_int)idx->oids[i]) * FNV_PRIME;
+    return h;
+}
+
+u_int
+netsnmp_hash_direct_cstring(const void *data)
+{
+    const u_char   *s = data;
+    u_int           h = FNV_OFFSET;
+
+    for (; *s; ++s)
+        h = (h ^ *s) * FNV_PRIME;
+    return h;
+}
+
+#if !defined(NETSNMP_FEATURE_REMOVE_CONTAINER_COMPARE_LONG) || \
+    !defined(NETSNMP_FEATURE_REMOVE_CONTAINER_COMPARE_ULONG)
+static u_int
+_hash_long(const void *data)
+{
+    u_long          v = *(const u_long *)data;
+
+    /* spread sequential indexes over the table */
+    v ^= (v >> 16) >> 16;
+    return (u_int)v * 2654435761U;
+}
+#endif
+
+#if !defined(NETSNMP_FEATURE_REMOVE_CONTAINER_COMPARE_INT32) || \
+    !defined(NETSNMP_FEATURE_REMOVE_CONTAINER_COMPARE_UINT32)
+static u_int
+_hash_int32(const void *data)
+{
+    return *(const uint32_t *)data * 2654435761U;
+}
+#endif
+
+/*
+ * pick a hash function which matches the compare function
+ */
+static netsnmp_container_hash *
+_hash_for_compare(netsnmp_container_compare *compare)
+{
+    if (compare == netsnmp_compare_netsnmp_index)
+        return netsnmp_hash_netsnmp_index;
+    if (compare == netsnmp_compare_direct_cstring)
+        return netsnmp_hash_direct_cstring;
+#ifndef NETSNMP_FEATURE_REMOVE_CONTAINER_COMPARE_LONG
+    if (compare == netsnmp_compare_long)
+        return _hash_long;
+#endif
+#ifndef NETSNMP_FEATURE_REMOVE_CONTAINER_COMPARE_ULONG
+    if (compare == netsnmp_compare_ulong)
+        return _hash_long;
+#endif
+#ifndef NETSNMP_FEATURE_REMOVE_CONTAINER_COMPARE_INT32
+    if (compare == netsnmp_compare_int32)
+        return _hash_int32;
+#endif
+#ifndef NETSNMP_FEATURE_REMOVE_CONTAINER_COMPARE_UINT32
+    if (compare == netsnmp_compare_uint32)
+        return _hash_int32;
+#endif
+    return NULL;
+}
+
+static netsnmp_container_hash *
+_hash_func(hash_container *h)
+{
+    if (NULL == h->hash) {
+        h->hash = _hash_for_compare(h->c.compare);
+        if (NULL == h->hash)
+            snmp_log(LOG_ERR, "no hash function for container %s\n",
+                     h->c.container_name ? h->c.container_name : "");
+    }
+    return h->hash;
+}
+
+int
+netsnmp_container_hash_set_func(netsnmp_container *c,
+                                netsnmp_container_hash *hash)
+{
+    hash_container *h = (hash_container *)c;
+
+    if ((NULL == c) || (NULL == hash))
+        return -1;
+    if (h->count) {
+        snmp_log(LOG_ERR, "can't change the hash of a non-empty container\n");
+        return -1;
+    }
+    h->hash = hash;
+    return 0;
+}
+
+/**********************************************************************
+ *
+ * table
+ *
+ */
+
+/*
+ * return the slot holding key (or, if data is set, preferably the slot
+ * holding that exact object), or -1.
+ */
+static ssize_t
+_hash_lookup(hash_container *h, const void *key, u_int hv, const void *data)
+{
+    netsnmp_container *c = &h->c;
+    ssize_t            found = -1;
+    size_t             i;
+
+    for (i = hv & h->mask; h->slots[i].data; i = (i + 1) & h->mask) {
+        if (h->slots[i].data == HASH_DELETED || h->slots[i].hash != hv ||
+            c->compare(h->slots[i].data, key) != 0)
+            continue;
+        if (NULL == data || h->slots[i].data == data)
+            return i;
+        if (found < 0)
+            found = i;
+    }
+    return found;
+}
+
+static int
+_hash_resize(hash_container *h, size_t slots)
+{
+    hash_slot      *old = h->slots;
+    size_t          old_slots = h->slots ? h->mask + 1 : 0;
+    size_t          i, j;
+
+    h->slots = calloc(slots, sizeof(hash_slot));
+    if (NULL == h->slots) {
+        h->slots = old;
+        return -1;
+    }
+    h->mask = slots - 1;
+    h->deleted = 0;
+
+    for (i = 0; i < old_slots; ++i) {
+        if (NULL == old[i].data || HASH_DELETED == old[i].data)
+            continue;
+        for (j = old[i].hash & h->mask; h->slots[j].data;
+             j = (j + 1) & h->mask)
+            ;
+        h->slots[j] = old[i];
+    }
+    free(old);
+
+    return 0;
+}
+
+static void *
+_hash_find(netsnmp_container *c, const void *key)
+{
+    hash_container *h = (hash_container *)c;
+    netsnmp_container_hash *hf;
+    ssize_t         i;
+
+    if ((NULL == c) || (NULL == key) || (0 == h->count))
+        return NULL;
+    if (NULL == (hf = _hash_func(h)))
+        return NULL;
+
+    i = _hash_lookup(h, key, hf(key), NULL);
+    return (i < 0) ? NULL : h->slots[i].data;
+}
+
+static size_t
+_hash_first_slot(hash_container *h, size_t pos)
+{
+    if (NULL == h->slots)
+        return 0;
+    for (; pos <= h->mask; ++pos)
+        if (h->slots[pos].data && h->slots[pos].data != HASH_DELETED)
+            break;
+    return pos;
+}
+
+static void *
+_hash_find_next(netsnmp_container *c, const void *key)
+{
+    hash_container *h = (hash_container *)c;
+    size_t          pos;
+
+    if (NULL == c)
+        return NULL;
+
+    if (NULL != key) {
+        snmp_log(LOG_ERR, "non-exact search on unsorted container %s?!?\n",
+                 c->container_name ? c->container_name : "");
+        return NULL;
+    }
+
+    /* If the key is NULL, return an (arbitrary) item in the container. */
+    if (0 == h->count)
+        return NULL;
+    pos = _hash_first_slot(h, 0);
+    return (pos <= h->mask) ? h->slots[pos].data : NULL;
+}
+
+static int
+_hash_insert(netsnmp_container *c, const void *data)
+{
+    hash_container *h = (hash_container *)c;
+    netsnmp_container_hash *hf;
+    u_int           hv;
+    size_t          i, slots;
+
+    if ((NULL == c) || (NULL == data))
+        return -1;
+    if (NULL == (hf = _hash_func(h)))
+        return -1;
+
+    hv = hf(data);
+    if (!(c->flags & CONTAINER_KEY_ALLOW_DUPLICATES) && h->count &&
+        _hash_lookup(h, data, hv, NULL) >= 0) {
+        DEBUGMSGTL(("container","not inserting duplicate key\n"));
+        return -1;
+    }
+
+    /*
+     * keep at least a quarter of the slots empty, so that probe
+     * sequences stay short. Tables with many removed entries are
+     * rebuilt at the same size.
+     */
+    slots = h->slots ? h->mask + 1 : 0;
+    if ((h->count + h->deleted + 1) * 4 > slots * 3) {
+        if ((h->count + 1) * 2 > slots)
+            slots = slots ? slots * 2 : HASH_MIN_SLOTS;
+        if (_hash_resize(h, slots) != 0) {
+            snmp_log(LOG_ERR, "couldn't allocate memory\n");
+            return -1;
+        }
+    }
+
+    for (i = hv & h->mask; h->slots[i].data && h->slots[i].data != HASH_DELETED;
+         i = (i + 1) & h->mask)
+        ;
+    if (h->slots[i].data == HASH_DELETED)
+        --h->deleted;
+    h->slots[i].data = NETSNMP_REMOVE_CONST(void *, data);
+    h->slots[i].hash = hv;
+
+    ++h->count;
+    ++c->sync;
+
+    return 0;
+}
+
+static void
+_hash_remove_slot(hash_container *h, size_t i)
+{
+    /*
+     * if the following slot is empty, no probe sequence runs through
+     * this one, and any removed entries just before it can be emptied too.
+     */
+    if (NULL == h->slots[(i + 1) & h->mask].data) {
+        h->slots[i].data = NULL;
+        for (i = (i - 1) & h->mask; h->slots[i].data == HASH_DELETED;
+             i = (i - 1) & h->mask) {
+            h->slots[i].data = NULL;
+            --h->deleted;
+        }
+    } else {
+        h->slots[i].data = HASH_DELETED;
+        ++h->deleted;
+    }
+    --h->count;
+    ++h->c.sync;
+}
+
+static int
+_hash_remove(netsnmp_container *c, const void *data)
+{
+    hash_container *h = (hash_container *)c;
+    netsnmp_container_hash *hf;
+    ssize_t         i;
+
+    if ((NULL == c) || (NULL == data) || (0 == h->count))
+        return -1;
+    if (NULL == (hf = _hash_func(h)))
+        return -1;
+
+    i = _hash_lookup(h, data, hf(data), data);
+    if (i < 0)
+        return -1;
+    _hash_remove_slot(h, i);
+
+    return 0;
+}
+
+static size_t
+_hash_size(netsnmp_container *c)
+{
+    hash_container *h = (hash_container *)c;
+
+    if (NULL == c)
+        return 0;
+
+    return h->count;
+}
+
+static void
+_hash_for_each(netsnmp_container *c, netsnmp_container_obj_func *f,
+               void *context)
+{
+    hash_container *h = (hash_container *)c;
+    size_t          i;
+
+    if ((NULL == c) || (NULL == h->slots))
+        return;
+
+    for (i = 0; i <= h->mask; ++i)
+        if (h->slots[i].data && h->slots[i].data != HASH_DELETED)
+            (*f) (h->slots[i].data, context);
+}
+
+static void
+_hash_clear(netsnmp_container *c, netsnmp_container_obj_func *f,
+            void *context)
+{
+    hash_container *h = (hash_container *)c;
+
+    if (NULL == c)
+        return;
+
+    if (NULL != f)
+        _hash_for_each(c, f, context);
+
+    /*
+     * free our table, but not the data
+     */
+    SNMP_FREE(h->slots);
+    h->mask = 0;
+    h->count = 0;
+    h->deleted = 0;
+    ++c->sync;
+}
+
+static int
+_hash_free(netsnmp_container *c)
+{
+    if (NULL == c)
+        return 0;
+
+    _hash_clear(c, NULL, NULL);
+    free(c);
+    return 0;
+}
+
+static netsnmp_void_array *
+_hash_get_subset(netsnmp_container *c, void *key)
+{
+    snmp_log(LOG_ERR, "partial key search on unsorted container %s?!?\n",
+             (c && c->container_name) ? c->container_name : "");
+    return NULL;
+}
+
+#define HASH_FLAGS (CONTAINER_KEY_ALLOW_DUPLICATES|CONTAINER_KEY_UNSORTED)
+
+static int
+_hash_options(netsnmp_container *c, int set, u_int flags)
+{
+    if (set) {
+        if ((flags & HASH_FLAGS) != flags)
+            return -1; /* unsupported flag */
+        /* never ordered */
+        c->flags = flags | CONTAINER_KEY_UNSORTED;
+        return flags;
+    }
+    return ((c->flags & flags) == flags);
+}
+
+static netsnmp_container *
+_hash_duplicate(netsnmp_container *c, void *ctx, u_int flags)
+{
+    hash_container *h = (hash_container *)c, *dup;
+
+    if (flags) {
+        snmp_log(LOG_ERR, "hash duplicate does not support flags yet\n");
+        return NULL;
+    }
+
+    dup = (hash_container *)netsnmp_container_get_hash();
+    if (NULL == dup) {
+        snmp_log(LOG_ERR, "no memory for hash duplicate\n");
+        return NULL;
+    }
+    if (netsnmp_container_data_dup(&dup->c, c) != 0) {
+        _hash_free(&dup->c);
+        return NULL;
+    }
+    dup->hash = h->hash;
+
+    /*
+     * shallow copy of the table, removed entries and all
+     */
+    if (h->slots) {
+        dup->slots = netsnmp_memdup(h->slots, (h->mask + 1) * sizeof(hash_slot));
+        if (NULL == dup->slots) {
+            snmp_log(LOG_ERR, "no memory for hash duplicate\n");
+            _hash_free(&dup->c);
+            return NULL;
+        }
+    }
+    dup->mask = h->mask;
+    dup->count = h->count;
+    dup->deleted = h->deleted;
+
+    return &dup->c;
+}
+
+/**********************************************************************
+ *
+ *
+ *
+ **********************************************************************/
+netsnmp_container *
+netsnmp_container_get_hash(void)
+{
+    /*
+     * allocate memory
+     */
+    hash_container *h = SNMP_MALLOC_TYPEDEF(hash_container);
+    if (NULL == h) {
+        snmp_log(LOG_ERR, "couldn't allocate memory\n");
+        return NULL;
+    }
+
+    netsnmp_init_container((netsnmp_container *)h, NULL, _hash_free,
+                           _hash_size, NULL, _hash_insert,
+                           _hash_remove, _hash_find);
+    h->c.find_next = _hash_find_next;
+    h->c.get_subset = _hash_get_subset;
+    h->c.get_iterator = _hash_iterator_get;
+    h->c.for_each = _hash_for_each;
+    h->c.clear = _hash_clear;
+    h->c.options = _hash_options;
+    h->c.duplicate = _hash_duplicate;
+    h->c.flags = CONTAINER_KEY_UNSORTED;
+
+    return &h->c;
+}
+
+netsnmp_factory *
+netsnmp_container_get_hash_factory(void)
+{
+    static netsnmp_factory f = { "hash", netsnmp_container_get_hash };
+
+    return &f;
+}
+
+void
+netsnmp_container_hash_init(void)
+{
+    netsnmp_container_register("hash", netsnmp_container_get_hash_factory());
+}
+
+
+/**********************************************************************
+ *
+ * iterator (in table order, which is arbitrary)
+ *
+ */
+NETSNMP_STATIC_INLINE hash_container *
+_hash_it2cont(hash_iterator *it)
+{
+    if(NULL == it) {
+        netsnmp_assert(NULL != it);
+        return NULL;
+    }
+
+    if(NULL == it->base.container) {
+        netsnmp_assert(NULL != it->base.container);
+        return NULL;
+    }
+
+    if(it->base.container->sync != it->base.sync) {
+        DEBUGMSGTL(("container:iterator", "out of sync\n"));
+        return NULL;
+    }
+
+    return (hash_container *)it->base.container;
+}
+
+static void *
+_hash_iterator_position(hash_iterator *it, size_t pos)
+{
+    hash_container *t = _hash_it2cont(it);
+
+    if ((NULL == t) || (NULL == t->slots) || (pos > t->mask) ||
+        (NULL == t->slots[pos].data) || (HASH_DELETED == t->slots[pos].data))
+        return NULL;
+
+    return t->slots[pos].data;
+}
+
+static void *
+_hash_iterator_curr(netsnmp_iterator *p)
+{
+    hash_iterator *it = (void *)p;
+
+    if(NULL == it) {
+        netsnmp_assert(NULL != it);
+        return NULL;
+    }
+
+    return _hash_iterator_position(it, it->pos);
+}
+
+static void *
+_hash_iterator_first(netsnmp_iterator *p)
+{
+    hash_iterator  *it = (void *)p;
+    hash_container *t = _hash_it2cont(it);
+
+    if (NULL == t)
+        return NULL;
+
+    return _hash_iterator_position(it, _hash_first_slot(t, 0));
+}
+
+static void *
+_hash_iterator_next(netsnmp_iterator *p)
+{
+    hash_iterator  *it = (void *)p;
+    hash_container *t = _hash_it2cont(it);
+
+    if (NULL == t)
+        return NULL;
+
+    it->pos = _hash_first_slot(t, it->pos + 1);
+
+    return _hash_iterator_position(it, it->pos);
+}
+
+static void *
+_hash_iterator_last(netsnmp_iterator *p)
+{
+    hash_iterator  *it = (void *)p;
+    hash_container *t = _hash_it2cont(it);
+    size_t          pos;
+
+    if ((NULL == t) || (0 == t->count))
+        return NULL;
+
+    for (pos = t->mask; ; --pos)
+        if (t->slots[pos].data && t->slots[pos].data != HASH_DELETED)
+            break;
+
+    return _hash_iterator_position(it, pos);
+}
+
+static int
+_hash_iterator_remove(netsnmp_iterator *p)
+{
+    hash_iterator  *it = (void *)p;
+    hash_container *t = _hash_it2cont(it);
+
+    if ((NULL == t) || (NULL == _hash_iterator_position(it, it->pos)))
+        return -1;
+
+    /*
+     * removing never moves other entries, so next will continue with
+     * the slot after this one. Keep the iterator in sync with the
+     * container.
+     */
+    _hash_remove_slot(t, it->pos);
+    ++it->base.sync;
+
+    return 0;
+}
+
+static int
+_hash_iterator_reset(netsnmp_iterator *p)
+{
+    hash_iterator  *it = (void *)p;
+    hash_container *t;
+
+    /** can't use it2cont cuz we might be out of sync */
+    if(NULL == it) {
+        netsnmp_assert(NULL != it);
+        return -1;
+    }
+
+    if(NULL == it->base.container) {
+        netsnmp_assert(NULL != it->base.container);
+        return -1;
+    }
+    t = (hash_container *)it->base.container;
+
+    it->pos = _hash_first_slot(t, 0);
+
+    /*
+     * save sync count, to make sure container doesn't change while
+     * iterator is in use.
+     */
+    it->base.sync = it->base.container->sync;
+
+    return 0;
+}
+
+static int
+_hash_iterator_release(netsnmp_iterator *it)
+{
+    free(it);
+
+    return 0;
+}
+
+static netsnmp_iterator *
+_hash_iterator_get(netsnmp_container *c)
+{
+    hash_iterator *it;
+
+    if(NULL == c)
+        return NULL;
+
+    it = SNMP_MALLOC_TYPEDEF(hash_iterator);
+    if(NULL == it)
+        return NULL;
+
+    it->base.container = c;
+
+    it->base.first = _hash_iterator_first;
+    it->base.next = _hash_iterator_next;
+    it->base.curr = _hash_iterator_curr;
+    it->base.last = _hash_iterator_last;
+    it->base.remove = _hash_iterator_remove;
+    it->base.reset = _hash_iterator_reset;
+    it->base.release = _hash_iterator_release;
+
+    (void)_hash_iterator_reset(&it->base);
+
+    return &it->base;
+}
+#else /* NETSNMP_FEATURE_REMOVE_CONTAINER_HASH */
+netsnmp_feature_unused(container_hash);
+#endif /* NETSNMP_FEATURE_REMOVE_CONTAINER_HASH */
@@ -0,0 +1,647 @@
+/*
+ * container_skiplist.c
+ *
+ * A sorted container based on a skiplist.  Unlike the binary array,
+ * inserts and removes never move other entries, so loading a large
+ * table out of order, or updating it incrementally, costs O(log n) per
+ * entry rather than O(n).  Ordered iteration just follows the bottom
+ * level of the list.
+ */
+#include <net-snmp/net-snmp-config.h>
+#include <net-snmp/net-snmp-features.h>
+
+#include <stdio.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_MALLOC_H
+#include <malloc.h>
+#endif
+#include <sys/types.h>
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#include <strings.h>
+#endif
+
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/types.h>
+#include <net-snmp/library/snmp_api.h>
+#include <net-snmp/library/container.h>
+#include <net-snmp/library/tools.h>
+#include <net-snmp/library/snmp_assert.h>
+
+#include <net-snmp/library/container_skiplist.h>
+#include "factory.h"
+
+netsnmp_feature_child_of(container_skiplist, container_types);
+
+#ifndef NETSNMP_FEATURE_REMOVE_CONTAINER_SKIPLIST
+
+/*
+ * Each level holds (on average) a quarter of the nodes of the level
+ * below, which is plenty for any table that fits in memory.
+ */
+#define SKIPLIST_MAX_LEVEL 16
+
+typedef struct skiplist_node_s {
+    void                    *data;
+    int                      level;
+    struct skiplist_node_s  *next[1];   /* 'level' forward pointers */
+} skiplist_node;
+
+typedef struct skiplist_container_s {
+    netsnmp_container          c;
+
+    size_t                     count;
+    int                        level;     /* highest level in use */
+    u_int                      seed;      /* for choosing node levels */
+    skiplist_node             *head;      /* sentinel, SKIPLIST_MAX_LEVEL */
+} skiplist_container;
+
+typedef struct skiplist_iterator_s {
+    netsnmp_iterator base;
+
+    skiplist_node   *pos;                 /* head = before the first node */
+} skiplist_iterator;
+
+static netsnmp_iterator *_skiplist_iterator_get(netsnmp_container *c);
+
+static skiplist_node *
+_skiplist_node_alloc(int level)
+{
+    skiplist_node *n;
+
+    n = calloc(1, sizeof(skiplist_node) +
+                  (level - 1) * sizeof(skiplist_node *));
+    if (n)
+        n->level = level;
+    return n;
+}
+
+static int
+_skiplist_random_level(skiplist_container *sl)
+{
+    int level = 1;
+    u_int r;
+
+    /* xorshift: cheap, and good enough to keep the list balanced */
+    r = sl->seed;
+    r ^= r << 13;
+    r ^= r >> 17;
+    r ^= r << 5;
+    sl->seed = r;
+
+    while ((r & 3) == 0 && level < SKIPLIST_MAX_LEVEL) {
+        ++level;
+        r >>= 2;
+    }
+    return level;
+}
+
+/*
+ * Find the last node at each level which sorts before the key (or, if
+ * 'after' is set, the last node which does not sort after the key).
+ * Returns the bottom-level predecessor.
+ */
+static skiplist_node *
+_skiplist_search(skiplist_container *sl, const void *key,
+                 netsnmp_container_compare *cmp, int after,
+                 skiplist_node **update)
+{
+    skiplist_node *x = sl->head;
+    int            i, rc;
+
+    for (i = sl->level - 1; i >= 0; --i) {
+        while (x->next[i]) {
+            rc = cmp(x->next[i]->data, key);
+            if (rc > 0 || (rc == 0 && !after))
+                break;
+            x = x->next[i];
+        }
+        if (update)
+            update[i] = x;
+    }
+    return x;
+}
+
+static void *
+_skiplist_find(netsnmp_container *c, const void *key)
+{
+    skiplist_container *sl = (skiplist_container *)c;
+    skiplist_node      *x;
+
+    if ((NULL == c) || (NULL == key))
+        return NULL;
+
+    x = _skiplist_search(sl, key, c->compare, 0, NULL)->next[0];
+    if (x && c->compare(x->data, key) == 0)
+        return x->data;
+    return NULL;
+}
+
+static void *
+_skiplist_find_next(netsnmp_container *c, const void *key)
+{
+    skiplist_container *sl = (skiplist_container *)c;
+    skiplist_node      *x;
+
+    if (NULL == c)
+        return NULL;
+
+    /* If the key is NULL, return the first item in the container. */
+    if (NULL == key)
+        x = sl->head->next[0];
+    else
+        x = _skiplist_search(sl, key, c->compare, 1, NULL)->next[0];
+
+    return x ? x->data : NULL;
+}
+
+static int
+_skiplist_insert(netsnmp_container *c, const void *data)
+{
+    skiplist_container *sl = (skiplist_container *)c;
+    skiplist_node      *update[SKIPLIST_MAX_LEVEL];
+    skiplist_node      *x, *n;
+    int                 i, level;
+
+    if ((NULL == c) || (NULL == data))
+        return -1;
+
+    /*
+     * duplicates go after any existing entries with the same key
+     */
+    x = _skiplist_search(sl, data, c->compare, 1, update);
+    if (x != sl->head && c->compare(x->data, data) == 0 &&
+        !(c->flags & CONTAINER_KEY_ALLOW_DUPLICATES)) {
+        DEBUGMSGTL(("container","not inserting duplicate key\n"));
+        return -1;
+    }
+
+    level = _skiplist_random_level(sl);
+    n = _skiplist_node_alloc(level);
+    if (NULL == n)
+        return -1;
+    n->data = NETSNMP_REMOVE_CONST(void *, data);
+
+    for (i = sl->level; i < level; ++i)
+        update[i] = sl->head;
+    if (level > sl->level)
+        sl->level = level;
+
+    for (i = 0; i < level; ++i) {
+        n->next[i] = update[i]->next[i];
+        update[i]->next[i] = n;
+    }
+
+    ++sl->count;
+    ++c->sync;
+
+    return 0;
+}
+
+/*
+ * Unlink the node holding 'data' (matched by pointer, if there are
+ * several entries with the same key) and return its predecessor.
+ */
+static int
+_skiplist_unlink(skiplist_container *sl, const void *data,
+                 skiplist_node **prev)
+{
+    netsnmp_container  *c = &sl->c;
+    skiplist_node      *update[SKIPLIST_MAX_LEVEL];
+    skiplist_node      *x, *p;
+    int                 i;
+
+    _skiplist_search(sl, data, c->compare, 0, update);
+
+    x = update[0]->next[0];
+    if (NULL == x || c->compare(x->data, data) != 0)
+        return -1;
+    while (x->data != data) {
+        if (NULL == x->next[0] || c->compare(x->next[0]->data, data) != 0) {
+            /* no exact match - remove the first entry with this key */
+            x = update[0]->next[0];
+            break;
+        }
+        x = x->next[0];
+    }
+
+    for (i = 0; i < x->level; ++i) {
+        for (p = update[i]; p->next[i] != x; p = p->next[i])
+            netsnmp_assert(p->next[i]);
+        if (0 == i && prev)
+            *prev = p;
+        p->next[i] = x->next[i];
+    }
+    free(x);
+
+    while (sl->level > 1 && NULL == sl->head->next[sl->level - 1])
+        --sl->level;
+    --sl->count;
+    ++c->sync;
+
+    return 0;
+}
+
+static int
+_skiplist_remove(netsnmp_container *c, const void *data)
+{
+    if ((NULL == c) || (NULL == data))
+        return -1;
+
+    return _skiplist_unlink((skiplist_container *)c, data, NULL);
+}
+
+static size_t
+_skiplist_size(netsnmp_container *c)
+{
+    skiplist_container *sl = (skiplist_container *)c;
+
+    if (NULL == c)
+        return 0;
+
+    return sl->count;
+}
+
+static void
+_skiplist_for_each(netsnmp_container *c, netsnmp_container_obj_func *f,
+                   void *context)
+{
+    skiplist_container *sl = (skiplist_container *)c;
+    skiplist_node      *x, *next;
+
+    if (NULL == c)
+        return;
+
+    for (x = sl->head->next[0]; x; x = next) {
+        next = x->next[0];
+        (*f) (x->data, context);
+    }
+}
+
+static void
+_skiplist_clear(netsnmp_container *c, netsnmp_container_obj_func *f,
+                void *context)
+{
+    skiplist_container *sl = (skiplist_container *)c;
+    skiplist_node      *x, *next;
+    int                 i;
+
+    if (NULL == c)
+        return;
+
+    for (x = sl->head->next[0]; x; x = next) {
+        next = x->next[0];
+        if (NULL != f)
+            (*f) (x->data, context);
+        /*
+         * free our node structure, but not the data
+         */
+        free(x);
+    }
+    for (i = 0; i < SKIPLIST_MAX_LEVEL; ++i)
+        sl->head->next[i] = NULL;
+    sl->level = 1;
+    sl->count = 0;
+    ++c->sync;
+}
+
+static int
+_skiplist_free(netsnmp_container *c)
+{
+    skiplist_container *sl = (skiplist_container *)c;
+
+    if (NULL == c)
+        return 0;
+
+    _skiplist_clear(c, NULL, NULL);
+    free(sl->head);
+    free(sl);
+    return 0;
+}
+
+static netsnmp_void_array *
+_skiplist_get_subset(netsnmp_container *c, void *key)
+{
+    skiplist_container *sl = (skiplist_container *)c;
+    netsnmp_void_array *va;
+    skiplist_node      *first, *x;
+    size_t              len = 0, i;
+
+    if ((NULL == c) || (NULL == key))
+        return NULL;
+    netsnmp_assert(c->ncompare);
+    if (NULL == c->ncompare)
+        return NULL;
+
+    first = _skiplist_search(sl, key, c->ncompare, 0, NULL)->next[0];
+    for (x = first; x && c->ncompare(x->data, key) == 0; x = x->next[0])
+        ++len;
+    if (0 == len || len > INT_MAX / sizeof(void *))
+        return NULL;
+
+    va = SNMP_MALLOC_TYPEDEF(netsnmp_void_array);
+    if (NULL == va)
+        return NULL;
+    va->array = malloc(len * sizeof(void *));
+    if (NULL == va->array) {
+        free(va);
+        return NULL;
+    }
+    for (i = 0, x = first; i < len; ++i, x = x->next[0])
+        va->array[i] = x->data;
+    va->size = len;
+
+    return va;
+}
+
+static int
+_skiplist_options(netsnmp_container *c, int set, u_int flags)
+{
+    if (set) {
+        if ((flags & CONTAINER_KEY_ALLOW_DUPLICATES) != flags)
+            return -1; /* unsupported flag */
+        c->flags = flags;
+        return flags;
+    }
+    return ((c->flags & flags) == flags);
+}
+
+static netsnmp_container *
+_skiplist_duplicate(netsnmp_container *c, void *ctx, u_int flags)
+{
+    skiplist_container *sl = (skiplist_container *)c, *dup;
+    skiplist_node      *tail[SKIPLIST_MAX_LEVEL];
+    skiplist_node      *x, *n;
+    int                 i;
+
+    if (flags) {
+        snmp_log(LOG_ERR, "skiplist duplicate does not support flags yet\n");
+        return NULL;
+    }
+
+    dup = (skiplist_container *)netsnmp_container_get_skiplist();
+    if (NULL == dup) {
+        snmp_log(LOG_ERR, "no memory for skiplist duplicate\n");
+        return NULL;
+    }
+    if (netsnmp_container_data_dup(&dup->c, c) != 0) {
+        _skiplist_free(&dup->c);
+        return NULL;
+    }
+
+    /*
+     * shallow copy, appending in order
+     */
+    for (i = 0; i < SKIPLIST_MAX_LEVEL; ++i)
+        tail[i] = dup->head;
+    for (x = sl->head->next[0]; x; x = x->next[0]) {
+        n = _skiplist_node_alloc(x->level);
+        if (NULL == n) {
+            snmp_log(LOG_ERR, "no memory for skiplist duplicate\n");
+            _skiplist_free(&dup->c);
+            return NULL;
+        }
+        n->data = x->data;
+        for (i = 0; i < n->level; ++i) {
+            tail[i]->next[i] = n;
+            tail[i] = n;
+        }
+        ++dup->count;
+    }
+    dup->level = sl->level;
+
+    return &dup->c;
+}
+
+/**********************************************************************
+ *
+ *
+ *
+ **********************************************************************/
+netsnmp_container *
+netsnmp_container_get_skiplist(void)
+{
+    /*
+     * allocate memory
+     */
+    skiplist_container *sl = SNMP_MALLOC_TYPEDEF(skiplist_container);
+    if (NULL == sl) {
+        snmp_log(LOG_ERR, "couldn't allocate memory\n");
+        return NULL;
+    }
+    sl->head = _skiplist_node_alloc(SKIPLIST_MAX_LEVEL);
+    if (NULL == sl->head) {
+        free(sl);
+        snmp_log(LOG_ERR, "couldn't allocate memory\n");
+        return NULL;
+    }
+    sl->level = 1;
+    sl->seed = 0x9e3779b9;
+
+    netsnmp_init_container((netsnmp_container *)sl, NULL, _skiplist_free,
+                           _skiplist_size, NULL, _skiplist_insert,
+                           _skiplist_remove, _skiplist_find);
+    sl->c.find_next = _skiplist_find_next;
+    sl->c.get_subset = _skiplist_get_subset;
+    sl->c.get_iterator = _skiplist_iterator_get;
+    sl->c.for_each = _skiplist_for_each;
+    sl->c.clear = _skiplist_clear;
+    sl->c.options = _skiplist_options;
+    sl->c.duplicate = _skiplist_duplicate;
+
+    return &sl->c;
+}
+
+netsnmp_factory *
+netsnmp_container_get_skiplist_factory(void)
+{
+    static netsnmp_factory f = { "skiplist",
+                                 netsnmp_container_get_skiplist };
+
+    return &f;
+}
+
+void
+netsnmp_container_skiplist_init(void)
+{
+    netsnmp_container_register("skiplist",
+                               netsnmp_container_get_skiplist_factory());
+}
+
+
+/**********************************************************************
+ *
+ * iterator
+ *
+ */
+NETSNMP_STATIC_INLINE skiplist_container *
+_skiplist_it2cont(skiplist_iterator *it)
+{
+    if(NULL == it) {
+        netsnmp_assert(NULL != it);
+        return NULL;
+    }
+
+    if(NULL == it->base.container) {
+        netsnmp_assert(NULL != it->base.container);
+        return NULL;
+    }
+
+    if(it->base.container->sync != it->base.sync) {
+        DEBUGMSGTL(("container:iterator", "out of sync\n"));
+        return NULL;
+    }
+
+    return (skiplist_container *)it->base.container;
+}
+
+static void *
+_skiplist_iterator_curr(netsnmp_iterator *p)
+{
+    skiplist_iterator  *it = (void *)p;
+    skiplist_container *t = _skiplist_it2cont(it);
+    if ((NULL == t) || (NULL == it->pos) || (t->head == it->pos))
+        return NULL;
+
+    return it->pos->data;
+}
+
+static void *
+_skiplist_iterator_first(netsnmp_iterator *p)
+{
+    skiplist_iterator  *it = (void *)p;
+    skiplist_container *t = _skiplist_it2cont(it);
+    if ((NULL == t) || (NULL == t->head->next[0]))
+        return NULL;
+
+    return t->head->next[0]->data;
+}
+
+static void *
+_skiplist_iterator_next(netsnmp_iterator *p)
+{
+    skiplist_iterator  *it = (void *)p;
+    skiplist_container *t = _skiplist_it2cont(it);
+    if ((NULL == t) || (NULL == it->pos))
+        return NULL;
+
+    it->pos = it->pos->next[0];
+    if (NULL == it->pos)
+        return NULL;
+
+    return it->pos->data;
+}
+
+static void *
+_skiplist_iterator_last(netsnmp_iterator *p)
+{
+    skiplist_iterator  *it = (void *)p;
+    skiplist_container *t = _skiplist_it2cont(it);
+    skiplist_node      *x;
+    int                 i;
+
+    if(NULL == t)
+        return NULL;
+
+    x = t->head;
+    for (i = t->level - 1; i >= 0; --i)
+        while (x->next[i])
+            x = x->next[i];
+    if (x == t->head)
+        return NULL;
+
+    return x->data;
+}
+
+static int
+_skiplist_iterator_remove(netsnmp_iterator *p)
+{
+    skiplist_iterator  *it = (void *)p;
+    skiplist_container *t = _skiplist_it2cont(it);
+    skiplist_node      *prev = NULL;
+
+    if ((NULL == t) || (NULL == it->pos) || (t->head == it->pos))
+        return -1;
+
+    /*
+     * since this iterator was used for the remove, keep it in sync with
+     * the container. Also, back up one so that next will be the item
+     * after the one that was just removed.
+     */
+    if (_skiplist_unlink(t, it->pos->data, &prev) != 0)
+        return -1;
+    ++it->base.sync;
+    it->pos = prev;
+
+    return 0;
+}
+
+static int
+_skiplist_iterator_reset(netsnmp_iterator *p)
+{
+    skiplist_iterator  *it = (void *)p;
+    skiplist_container *t;
+
+    /** can't use it2cont cuz we might be out of sync */
+    if(NULL == it) {
+        netsnmp_assert(NULL != it);
+        return -1;
+    }
+
+    if(NULL == it->base.container) {
+        netsnmp_assert(NULL != it->base.container);
+        return -1;
+    }
+    t = (skiplist_container *)it->base.container;
+
+    it->pos = t->head->next[0];
+
+    /*
+     * save sync count, to make sure container doesn't change while
+     * iterator is in use.
+     */
+    it->base.sync = it->base.container->sync;
+
+    return 0;
+}
+
+static int
+_skiplist_iterator_release(netsnmp_iterator *it)
+{
+    free(it);
+
+    return 0;
+}
+
+static netsnmp_iterator *
+_skiplist_iterator_get(netsnmp_container *c)
+{
+    skiplist_iterator *it;
+
+    if(NULL == c)
+        return NULL;
+
+    it = SNMP_MALLOC_TYPEDEF(skiplist_iterator);
+    if(NULL == it)
+        return NULL;
+
+    it->base.container = c;
+
+    it->base.first = _skiplist_iterator_first;
+    it->base.next = _skiplist_iterator_next;
+    it->base.curr = _skiplist_iterator_curr;
+    it->base.last = _skiplist_iterator_last;
+    it->base.remove = _skiplist_iterator_remove;
+    it->base.reset = _skiplist_iterator_reset;
+    it->base.release = _skiplist_iterator_release;
+
+    (void)_skiplist_iterator_reset(&it->base);
+
+    return &it->base;
+}
+#else /* NETSNMP_FEATURE_REMOVE_CONTAINER_SKIPLIST */
+netsnmp_feature_unused(container_skiplist);
+#endif /* NETSNMP_FEATURE_REMOVE_CONTAINER_SKIPLIST */
@@ -120,13 +120,20 @@ generate_Ku(const oid * hashtype, u_int hashtype_len,
     int             ret;
 #endif
 
-    u_int           i, pindex = 0;
+    u_int           i;
+#ifndef NETSNMP_USE_OPENSSL
+    u_int           pindex = 0;
+    u_char         *bufp;
+#endif
 
-    u_char          buf[USM_LENGTH_KU_HASHBLOCK], *bufp;
+    u_char          buf[USM_LENGTH_KU_HASHBLOCK];
 
 #ifdef NETSNMP_USE_OPENSSL
     EVP_MD_CTX     *ctx = NULL;
     const EVP_MD   *hashfn = NULL;
+    u_char          pbuf[4096];
+    const u_char   *chunk;
+    size_t          chunklen;
 #elif defined(NETSNMP_USE_INTERNAL_CRYPTO)
     SHA_CTX csha1;
     MD5_CTX cmd5;
@@ -215,14 +222,36 @@ generate_Ku(const oid * hashtype, u_int hashtype_len,
     MDbegin(&MD);
 #endif                          /* NETSNMP_USE_OPENSSL */
 
+#ifdef NETSNMP_USE_OPENSSL
+    /*
+     * The digest doesn't care how its input is split up, so rather than
+     * copying the expanded pass phrase a byte at a time, hash a buffer
+     * holding as many whole copies of P as fit (or P itself, if it is
+     * long) until the expanded length has been covered.
+     */
+    chunk = P;
+    chunklen = pplen;
+    if (pplen <= sizeof(pbuf) / 2) {
+        for (chunklen = 0; chunklen + pplen <= sizeof(pbuf);
+             chunklen += pplen)
+            memcpy(pbuf + chunklen, P, pplen);
+        chunk = pbuf;
+    }
+    while (nbytes > 0) {
+        i = (size_t) nbytes < chunklen ? nbytes : chunklen;
+        if (!EVP_DigestUpdate(ctx, chunk, i)) {
+            rval = SNMPERR_GENERR;
+            goto generate_Ku_quit;
+        }
+        nbytes -= i;
+    }
+#else
     while (nbytes > 0) {
         bufp = buf;
         for (i = 0; i < USM_LENGTH_KU_HASHBLOCK; i++) {
             *bufp++ = P[pindex++ % pplen];
         }
-#ifdef NETSNMP_USE_OPENSSL
-        EVP_DigestUpdate(ctx, buf, USM_LENGTH_KU_HASHBLOCK);
-#elif defined(NETSNMP_USE_INTERNAL_CRYPTO)
+#if defined(NETSNMP_USE_INTERNAL_CRYPTO)
         if (TYPE_SHA1 == cryptotype) {
             rval = !SHA1_Update(&csha1, buf, USM_LENGTH_KU_HASHBLOCK);
         } else {
@@ -236,9 +265,10 @@ generate_Ku(const oid * hashtype, u_int hashtype_len,
             rval = SNMPERR_USM_ENCRYPTIONERROR;
             goto md5_fin;
         }
-#endif                          /* NETSNMP_USE_OPENSSL */
+#endif                          /* NETSNMP_USE_INTERNAL_MD5 */
         nbytes -= USM_LENGTH_KU_HASHBLOCK;
     }
+#endif                          /* NETSNMP_USE_OPENSSL */
 
 #ifdef NETSNMP_USE_OPENSSL
     {
@@ -288,6 +318,7 @@ generate_Ku(const oid * hashtype, u_int hashtype_len,
   generate_Ku_quit:
     memset(buf, 0, sizeof(buf));
 #ifdef NETSNMP_USE_OPENSSL
+    memset(pbuf, 0, sizeof(pbuf));
     if (ctx) {
 #if defined(HAVE_EVP_MD_CTX_FREE)
         EVP_MD_CTX_free(ctx);
@@ -1786,6 +1786,24 @@ config_pwarn(const char *str)
     netsnmp_config_warn("%s", str);
 }
 
+/*
+ * get or set the file name and line number used in error messages, for
+ * handlers which postpone processing a line until all files are read
+ */
+void
+netsnmp_config_get_location(const char **filename, unsigned int *lineno)
+{
+    *filename = curfilename;
+    *lineno = linecount;
+}
+
+void
+netsnmp_config_set_location(const char *filename, unsigned int lineno)
+{
+    curfilename = filename;
+    linecount = lineno;
+}
+
 /*
  * skip all white spaces and return 1 if found something either end of
  * line or a comment character 
@@ -90,6 +90,9 @@ netsnmp_feature_child_of(usm_scapi, usm_support);
 #ifdef HAVE_AES
 #include <openssl/aes.h>
 #endif
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#endif
 
 #ifndef NETSNMP_DISABLE_DES
 #ifdef HAVE_STRUCT_DES_KS_STRUCT_WEAK_KEY
@@ -122,6 +125,36 @@ netsnmp_feature_child_of(usm_scapi, usm_support);
     } while (0)
 #endif
 
+/*
+ * Pre-keyed transform state (see sc_generate_keyed_hash_ctx()).  Only
+ * OpenSSL 1.1 and later can re-use a keyed HMAC or cipher context; with
+ * anything else the _ctx functions simply call the uncached ones.
+ */
+#if defined(NETSNMP_USE_OPENSSL) && OPENSSL_VERSION_NUMBER >= 0x10100000L
+#define NETSNMP_SC_CACHE_CTX 1
+#endif
+
+#define SC_CTX_AUTH 1
+#define SC_CTX_PRIV 2
+#define SC_CTX_MAX_KEY 64
+
+struct netsnmp_sc_ctx_s {
+    int             refcnt;
+    int             kind;           /* SC_CTX_AUTH or SC_CTX_PRIV */
+    int             type;           /* auth type or priv type */
+    u_char          key[SC_CTX_MAX_KEY];  /* the key the state is for */
+    size_t          keylen;
+#ifdef NETSNMP_SC_CACHE_CTX
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    EVP_MAC_CTX    *mac;
+#else
+    HMAC_CTX       *mac;
+#endif
+    EVP_CIPHER_CTX *enc;
+    EVP_CIPHER_CTX *dec;
+#endif
+};
+
 #ifdef NETSNMP_USE_INTERNAL_CRYPTO
 static
 int SHA1_hmac(const u_char * data, size_t len, u_char * mac, size_t maclen,
@@ -1077,6 +1110,22 @@ sc_check_keyed_hash(const oid * authtypeOID, size_t authtypeOIDlen,
                     const u_char * key, u_int keylen,
                     const u_char * message, u_int msglen,
                     const u_char * MAC, u_int maclen)
+{
+    return sc_check_keyed_hash_ctx(NULL, authtypeOID, authtypeOIDlen,
+                                   key, keylen, message, msglen,
+                                   MAC, maclen);
+}
+
+/*
+ * As sc_check_keyed_hash(), using (and updating) the cached state in *ctx
+ * if ctx is not NULL.
+ */
+int
+sc_check_keyed_hash_ctx(netsnmp_sc_ctx **ctx,
+                        const oid * authtypeOID, size_t authtypeOIDlen,
+                        const u_char * key, u_int keylen,
+                        const u_char * message, u_int msglen,
+                        const u_char * MAC, u_int maclen)
 #if defined(NETSNMP_USE_INTERNAL_MD5) || defined(NETSNMP_USE_OPENSSL) || defined(NETSNMP_USE_PKCS11) || defined(NETSNMP_USE_INTERNAL_CRYPTO)
 {
     int             rval = SNMPERR_SUCCESS, auth_type, auth_size;
@@ -1118,8 +1167,9 @@ sc_check_keyed_hash(const oid * authtypeOID, size_t authtypeOIDlen,
      * the result with the given MAC which may be shorter than
      * the full hash length.
      */
-    rval = sc_generate_keyed_hash(authtypeOID, authtypeOIDlen, key, keylen,
-                                  message, msglen, buf, &buf_len);
+    rval = sc_generate_keyed_hash_ctx(ctx, authtypeOID, authtypeOIDlen,
+                                      key, keylen, message, msglen,
+                                      buf, &buf_len);
     QUITFUN(rval, sc_check_keyed_hash_quit);
 
     if (maclen > msglen) {
@@ -1632,6 +1682,383 @@ sc_decrypt(const oid * privtype, size_t privtypelen,
 }
 #endif                          /* NETSNMP_USE_OPENSSL */
 
+/*******************************************************************-o-******
+ * Cached transform state
+ *
+ * Keying an HMAC computes its inner and outer pads, and keying a cipher
+ * runs its key schedule.  The _ctx variants of sc_generate_keyed_hash(),
+ * sc_check_keyed_hash(), sc_encrypt() and sc_decrypt() keep that keyed
+ * state in *ctx, which the caller stores next to the key (e.g. in its
+ * struct usmUser), so that only the per-message work is left.  The state
+ * remembers the key and transform it was set up for and is rebuilt when
+ * either changes, so callers don't need to track key changes.  If ctx is
+ * NULL, or the state can't be cached, the uncached function is used.
+ *
+ * Several sessions may use the same user, and so the same state, from
+ * different threads.  The keyed contexts are therefore never changed
+ * once they are set up: each message works on a copy of them.  Replacing
+ * *ctx and the reference counts are protected by MT_LIB_SC_CTX.
+ */
+#ifdef NETSNMP_SC_CACHE_CTX
+static void
+_sc_ctx_destroy(netsnmp_sc_ctx *ctx)
+{
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    EVP_MAC_CTX_free(ctx->mac);
+#else
+    HMAC_CTX_free(ctx->mac);
+#endif
+    EVP_CIPHER_CTX_free(ctx->enc);
+    EVP_CIPHER_CTX_free(ctx->dec);
+    SNMP_ZERO(ctx, sizeof(*ctx));
+    free(ctx);
+}
+#else
+#define _sc_ctx_destroy(ctx) free(ctx)
+#endif /* NETSNMP_SC_CACHE_CTX */
+
+static void
+_sc_ctx_release(netsnmp_sc_ctx *ctx)
+{
+    int             refcnt;
+
+    snmp_res_lock(MT_LIBRARY_ID, MT_LIB_SC_CTX);
+    refcnt = --ctx->refcnt;
+    snmp_res_unlock(MT_LIBRARY_ID, MT_LIB_SC_CTX);
+    if (refcnt == 0)
+        _sc_ctx_destroy(ctx);
+}
+
+/*
+ * Take another reference to the state in *ctxp, e.g. to keep it with a
+ * request after the user it belongs to has gone.
+ */
+netsnmp_sc_ctx *
+sc_ctx_ref(netsnmp_sc_ctx **ctxp)
+{
+    netsnmp_sc_ctx *ctx;
+
+    snmp_res_lock(MT_LIBRARY_ID, MT_LIB_SC_CTX);
+    ctx = *ctxp;
+    if (ctx)
+        ++ctx->refcnt;
+    snmp_res_unlock(MT_LIBRARY_ID, MT_LIB_SC_CTX);
+    return ctx;
+}
+
+void
+sc_ctx_free(netsnmp_sc_ctx **ctxp)
+{
+    netsnmp_sc_ctx *ctx;
+
+    if (NULL == ctxp)
+        return;
+
+    snmp_res_lock(MT_LIBRARY_ID, MT_LIB_SC_CTX);
+    ctx = *ctxp;
+    *ctxp = NULL;
+    snmp_res_unlock(MT_LIBRARY_ID, MT_LIB_SC_CTX);
+    if (ctx)
+        _sc_ctx_release(ctx);
+}
+
+#ifdef NETSNMP_SC_CACHE_CTX
+static int
+_sc_ctx_matches(const netsnmp_sc_ctx *ctx, int kind, int type,
+                const u_char *key, size_t keylen)
+{
+    return ctx && ctx->kind == kind && ctx->type == type &&
+        ctx->keylen == keylen && memcmp(ctx->key, key, keylen) == 0;
+}
+
+/*
+ * Set up the keyed contexts for a transform and key: an HMAC for
+ * SC_CTX_AUTH, an encrypting and a decrypting cipher for SC_CTX_PRIV.
+ */
+static netsnmp_sc_ctx *
+_sc_ctx_new(int kind, int type, const u_char *key, size_t keylen,
+            const EVP_MD *hashfn, const EVP_CIPHER *cipher)
+{
+    netsnmp_sc_ctx *ctx;
+
+    if (keylen > SC_CTX_MAX_KEY)
+        return NULL;
+    ctx = calloc(1, sizeof(*ctx));
+    if (NULL == ctx)
+        return NULL;
+    ctx->refcnt = 1;
+    ctx->kind = kind;
+    ctx->type = type;
+    memcpy(ctx->key, key, keylen);
+    ctx->keylen = keylen;
+
+    if (kind == SC_CTX_AUTH) {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+        EVP_MAC        *mac = EVP_MAC_fetch(NULL, "HMAC", NULL);
+        OSSL_PARAM      params[2];
+
+        if (NULL == mac)
+            goto fail;
+        ctx->mac = EVP_MAC_CTX_new(mac);
+        EVP_MAC_free(mac);
+        if (NULL == ctx->mac)
+            goto fail;
+        params[0] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST,
+                                   NETSNMP_REMOVE_CONST(char *,
+                                                   EVP_MD_get0_name(hashfn)),
+                                   0);
+        params[1] = OSSL_PARAM_construct_end();
+        if (!EVP_MAC_init(ctx->mac, ctx->key, ctx->keylen, params))
+            goto fail;
+#else
+        ctx->mac = HMAC_CTX_new();
+        if (NULL == ctx->mac ||
+            !HMAC_Init_ex(ctx->mac, ctx->key, ctx->keylen, hashfn, NULL))
+            goto fail;
+#endif
+    } else {
+        ctx->enc = EVP_CIPHER_CTX_new();
+        ctx->dec = EVP_CIPHER_CTX_new();
+        if (NULL == ctx->enc || NULL == ctx->dec ||
+            !EVP_CipherInit_ex(ctx->enc, cipher, NULL, ctx->key, NULL, 1) ||
+            !EVP_CipherInit_ex(ctx->dec, cipher, NULL, ctx->key, NULL, 0))
+            goto fail;
+    }
+    return ctx;
+
+  fail:
+    _sc_ctx_destroy(ctx);
+    return NULL;
+}
+
+/*
+ * Return a reference to the state for the given transform and key,
+ * replacing *ctxp if it was set up for something else.  The caller drops
+ * the reference with _sc_ctx_release().  Returns NULL if the state can't
+ * be set up.
+ */
+static netsnmp_sc_ctx *
+_sc_ctx_get(netsnmp_sc_ctx **ctxp, int kind, int type,
+            const u_char *key, size_t keylen,
+            const EVP_MD *hashfn, const EVP_CIPHER *cipher)
+{
+    netsnmp_sc_ctx *ctx, *old = NULL;
+
+    snmp_res_lock(MT_LIBRARY_ID, MT_LIB_SC_CTX);
+    ctx = *ctxp;
+    if (_sc_ctx_matches(ctx, kind, type, key, keylen)) {
+        ++ctx->refcnt;
+        snmp_res_unlock(MT_LIBRARY_ID, MT_LIB_SC_CTX);
+        return ctx;
+    }
+    snmp_res_unlock(MT_LIBRARY_ID, MT_LIB_SC_CTX);
+
+    /* key outside the lock; it is the expensive part */
+    if (ctx)
+        DEBUGMSGTL(("scapi:ctx", "key changed; rebuilding context\n"));
+    ctx = _sc_ctx_new(kind, type, key, keylen, hashfn, cipher);
+    if (NULL == ctx)
+        return NULL;
+
+    snmp_res_lock(MT_LIBRARY_ID, MT_LIB_SC_CTX);
+    if (_sc_ctx_matches(*ctxp, kind, type, key, keylen)) {
+        /* another thread got there first */
+        old = ctx;
+        ctx = *ctxp;
+    } else {
+        old = *ctxp;
+        *ctxp = ctx;
+    }
+    ++ctx->refcnt;
+    snmp_res_unlock(MT_LIBRARY_ID, MT_LIB_SC_CTX);
+    if (old)
+        _sc_ctx_release(old);
+    return ctx;
+}
+
+/*
+ * HMAC the message with a copy of the keyed state.  Returns the length of
+ * the MAC, or 0 on failure.
+ */
+static size_t
+_sc_ctx_hmac(netsnmp_sc_ctx *ctx, const u_char *message, u_int msglen,
+             u_char *buf, size_t buflen)
+{
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    EVP_MAC_CTX    *mac = EVP_MAC_CTX_dup(ctx->mac);
+    size_t          len = 0;
+
+    if (NULL == mac)
+        return 0;
+    if (!EVP_MAC_update(mac, message, msglen) ||
+        !EVP_MAC_final(mac, buf, &len, buflen))
+        len = 0;
+    EVP_MAC_CTX_free(mac);
+    return len;
+#else
+    HMAC_CTX       *mac = HMAC_CTX_new();
+    unsigned int    len = 0;
+
+    if (NULL == mac)
+        return 0;
+    if (!HMAC_CTX_copy(mac, ctx->mac) ||
+        !HMAC_Update(mac, message, msglen) ||
+        !HMAC_Final(mac, buf, &len))
+        len = 0;
+    HMAC_CTX_free(mac);
+    return len;
+#endif
+}
+
+#ifdef HAVE_AES
+/*
+ * En/decrypt with a copy of the keyed cipher state.  Only the IV is set
+ * per message.  Returns the output length, or -1 on failure.
+ */
+static int
+_sc_ctx_aes(netsnmp_sc_ctx **ctxp, const netsnmp_priv_alg_info *pai,
+            const u_char *key, u_int keylen, const u_char *iv, int enc,
+            const u_char *in, u_int inlen, u_char *out)
+{
+    const EVP_CIPHER *cipher = sc_get_openssl_privfn(pai->type);
+    netsnmp_sc_ctx *ctx;
+    EVP_CIPHER_CTX *cctx;
+    int             len, total = -1;
+
+    if (NULL == cipher)
+        return -1;
+    ctx = _sc_ctx_get(ctxp, SC_CTX_PRIV, pai->type, key, keylen, NULL,
+                      cipher);
+    if (NULL == ctx)
+        return -1;
+
+    cctx = EVP_CIPHER_CTX_new();
+    if (cctx &&
+        EVP_CIPHER_CTX_copy(cctx, enc ? ctx->enc : ctx->dec) &&
+        EVP_CipherInit_ex(cctx, NULL, NULL, NULL, iv, enc) &&
+        EVP_CipherUpdate(cctx, out, &len, in, inlen)) {
+        total = len;
+        if (EVP_CipherFinal_ex(cctx, out + total, &len))
+            total += len;
+        else
+            total = -1;
+    }
+    EVP_CIPHER_CTX_free(cctx);
+    _sc_ctx_release(ctx);
+    return total;
+}
+#endif /* HAVE_AES */
+#endif /* NETSNMP_SC_CACHE_CTX */
+
+/*
+ * As sc_generate_keyed_hash(), using (and updating) the cached state in
+ * *ctx if ctx is not NULL.
+ */
+int
+sc_generate_keyed_hash_ctx(netsnmp_sc_ctx **ctx,
+                           const oid * authtypeOID, size_t authtypeOIDlen,
+                           const u_char * key, u_int keylen,
+                           const u_char * message, u_int msglen,
+                           u_char * MAC, size_t * maclen)
+{
+#ifdef NETSNMP_SC_CACHE_CTX
+    if (ctx && authtypeOID && key && message && MAC && maclen &&
+        keylen > 0 && msglen > 0 && *maclen > 0) {
+        int             auth_type = sc_get_authtype(authtypeOID,
+                                                    authtypeOIDlen);
+        int             properlength = sc_get_auth_maclen(auth_type);
+        const EVP_MD   *hashfn = sc_get_openssl_hashfn(auth_type);
+        netsnmp_sc_ctx *c = NULL;
+        u_char          buf[EVP_MAX_MD_SIZE];
+        size_t          len = 0;
+
+        if (properlength > 0 && keylen >= (u_int)properlength && hashfn)
+            c = _sc_ctx_get(ctx, SC_CTX_AUTH, auth_type, key, keylen,
+                            hashfn, NULL);
+        if (c) {
+            len = _sc_ctx_hmac(c, message, msglen, buf, sizeof(buf));
+            _sc_ctx_release(c);
+        }
+        if (len > 0) {
+            if (*maclen > len)
+                *maclen = len;
+            memcpy(MAC, buf, *maclen);
+            memset(buf, 0, sizeof(buf));
+            return SNMPERR_SUCCESS;
+        }
+    }
+#endif /* NETSNMP_SC_CACHE_CTX */
+
+    return sc_generate_keyed_hash(authtypeOID, authtypeOIDlen, key, keylen,
+                                  message, msglen, MAC, maclen);
+}
+
+/*
+ * As sc_encrypt(), using (and updating) the cached state in *ctx if ctx
+ * is not NULL.  Only AES state is cached.
+ */
+int
+sc_encrypt_ctx(netsnmp_sc_ctx **ctx,
+               const oid * privtype, size_t privtypelen,
+               u_char * key, u_int keylen,
+               u_char * iv, u_int ivlen,
+               const u_char * plaintext, u_int ptlen,
+               u_char * ciphertext, size_t * ctlen)
+{
+#if defined(NETSNMP_SC_CACHE_CTX) && defined(HAVE_AES) && \
+    defined(NETSNMP_ENABLE_SCAPI_AUTHPRIV)
+    const netsnmp_priv_alg_info *pai;
+    int             len;
+
+    if (ctx && privtype && key && iv && plaintext && ciphertext && ctlen &&
+        keylen > 0 && ivlen > 0 && ptlen > 0 && ptlen <= *ctlen &&
+        (pai = sc_get_priv_alg_byoid(privtype, privtypelen)) != NULL &&
+        USM_CREATE_USER_PRIV_AES == (pai->type & USM_PRIV_MASK_ALG) &&
+        keylen >= pai->proper_length && ivlen >= pai->iv_length) {
+        len = _sc_ctx_aes(ctx, pai, key, keylen, iv, 1,
+                          plaintext, ptlen, ciphertext);
+        if (len >= 0) {
+            *ctlen = len;
+            return SNMPERR_SUCCESS;
+        }
+    }
+#endif
+
+    return sc_encrypt(privtype, privtypelen, key, keylen, iv, ivlen,
+                      plaintext, ptlen, ciphertext, ctlen);
+}
+
+/*
+ * As sc_decrypt(), using (and updating) the cached state in *ctx if ctx
+ * is not NULL.  Only AES state is cached.
+ */
+int
+sc_decrypt_ctx(netsnmp_sc_ctx **ctx,
+               const oid * privtype, size_t privtypelen,
+               u_char * key, u_int keylen,
+               u_char * iv, u_int ivlen,
+               u_char * ciphertext, u_int ctlen,
+               u_char * plaintext, size_t * ptlen)
+{
+#if defined(NETSNMP_SC_CACHE_CTX) && defined(HAVE_AES)
+    const netsnmp_priv_alg_info *pai;
+
+    if (ctx && privtype && key && iv && plaintext && ciphertext && ptlen &&
+        ctlen > 0 && *ptlen >= ctlen &&
+        (pai = sc_get_priv_alg_byoid(privtype, privtypelen)) != NULL &&
+        USM_CREATE_USER_PRIV_AES == (pai->type & USM_PRIV_MASK_ALG) &&
+        keylen >= pai->proper_length && ivlen >= pai->iv_length &&
+        _sc_ctx_aes(ctx, pai, key, keylen, iv, 0,
+                    ciphertext, ctlen, plaintext) >= 0) {
+        *ptlen = ctlen;
+        return SNMPERR_SUCCESS;
+    }
+#endif
+
+    return sc_decrypt(privtype, privtypelen, key, keylen, iv, ivlen,
+                      ciphertext, ctlen, plaintext, ptlen);
+}
+
 #ifdef NETSNMP_USE_INTERNAL_CRYPTO
 
 /* These functions are basically copies of the MDSign() routine in
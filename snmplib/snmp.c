@@ -304,9 +304,9 @@ snmp_build_var_op(u_char * data,
         return NULL;
     }
 
-    sequenceLen = (data - dataPtr) - headerLen;
+    sequenceLen = headerLen;
     asn_build_sequence(dataPtr, &sequenceLen, ASN_SEQUENCE | ASN_CONSTRUCTOR,
-                       headerLen);
+                       (data - dataPtr) - headerLen);
     return data;
 }
 
@@ -317,6 +317,24 @@ snmp_realloc_rbuild_var_op(u_char ** pkt, size_t * pkt_len,
                            const oid * var_name, size_t * var_name_len,
                            u_char var_val_type,
                            u_char * var_val, size_t var_val_len)
+{
+    return snmp_realloc_rbuild_var_op_cached(pkt, pkt_len, offset,
+                                             allow_realloc, var_name,
+                                             var_name_len, var_val_type,
+                                             var_val, var_val_len, NULL);
+}
+
+/*
+ * Like snmp_realloc_rbuild_var_op(), but encodes the name with
+ * asn_realloc_rbuild_objid_cached().
+ */
+int
+snmp_realloc_rbuild_var_op_cached(u_char ** pkt, size_t * pkt_len,
+                                  size_t * offset, int allow_realloc,
+                                  const oid * var_name, size_t * var_name_len,
+                                  u_char var_val_type,
+                                  u_char * var_val, size_t var_val_len,
+                                  netsnmp_oid_cache * cache)
 {
     size_t          start_offset = *offset;
     int             rc = 0;
@@ -426,10 +444,12 @@ snmp_realloc_rbuild_var_op(u_char ** pkt, size_t * pkt_len,
      */
 
     DEBUGDUMPHEADER("send", "Name");
-    rc = asn_realloc_rbuild_objid(pkt, pkt_len, offset, allow_realloc,
-                                  (u_char) (ASN_UNIVERSAL | ASN_PRIMITIVE |
-                                            ASN_OBJECT_ID), var_name,
-                                  *var_name_len);
+    rc = asn_realloc_rbuild_objid_cached(pkt, pkt_len, offset,
+                                         allow_realloc,
+                                         (u_char) (ASN_UNIVERSAL |
+                                                   ASN_PRIMITIVE |
+                                                   ASN_OBJECT_ID), var_name,
+                                         *var_name_len, cache);
     DEBUGINDENTLESS();
     if (rc == 0) {
         ERROR_MSG("Can't build OID for variable");
@@ -105,6 +105,17 @@ SOFTWARE.
 #ifdef HAVE_LOCALE_H
 #include <locale.h>
 #endif
+/*
+ * vectorized OID comparisons need the target attribute and
+ * __builtin_cpu_supports() (gcc 4.9, clang)
+ */
+#if (defined(__x86_64__) || defined(__i386__)) &&                      \
+    (defined(__clang__) ||                                              \
+     (defined(__GNUC__) &&                                              \
+      (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define NETSNMP_OID_COMPARE_X86 1
+#include <immintrin.h>
+#endif
 
 #define SNMP_NEED_REQUEST_LIST
 #include <net-snmp/types.h>
@@ -123,6 +134,7 @@ SOFTWARE.
 #include <net-snmp/library/snmpv3.h>
 #include <net-snmp/library/callback.h>
 #include <net-snmp/library/container.h>
+#include <net-snmp/library/container_hash.h>
 #include <net-snmp/library/snmp_secmod.h>
 #include <net-snmp/library/large_fd_set.h>
 #ifdef NETSNMP_SECMOD_USM
@@ -142,6 +154,8 @@ SOFTWARE.
 #include <net-snmp/library/cert_util.h>
 #endif
 
+netsnmp_feature_require(container_hash);
+
 netsnmp_feature_child_of(statistics, libnetsnmp);
 netsnmp_feature_child_of(snmp_api, libnetsnmp);
 netsnmp_feature_child_of(oid_is_subtree, snmp_api);
@@ -192,8 +206,15 @@ static const oid default_enterprise[] = { 1, 3, 6, 1, 4, 1, 3, 1, 1 };
  * Internal information about the state of the snmp session.
  */
 struct snmp_internal_session {
-    netsnmp_request_list *requests;     /* Info about outstanding requests */
-    netsnmp_request_list *requestsEnd;  /* ptr to end of list */
+    /*
+     * Outstanding requests, indexed by request id and message id, and
+     * kept in a binary min-heap on their expiry time.
+     */
+    netsnmp_container    *requests_by_reqid;
+    netsnmp_container    *requests_by_msgid;
+    netsnmp_request_list **expiry;      /* heap, earliest expiry first */
+    size_t                expiry_count;
+    size_t                expiry_size;
     int             (*hook_pre) (netsnmp_session *, netsnmp_transport *,
                                  void *, int);
     int             (*hook_parse) (netsnmp_session *, netsnmp_pdu *,
@@ -216,6 +237,9 @@ struct snmp_internal_session {
     size_t        obuf_size;    /* size of buffer for packet data */
     u_char       *opacket;      /* send packet data (within obuf) */
     size_t        opacket_len;  /* length of data */
+
+    u_char       *spare_obuf;   /* send buffer kept for the next packet */
+    size_t        spare_obuf_size;
 };
 
 /*
@@ -346,7 +370,6 @@ static int      snmpv3_build(u_char ** pkt, size_t * pkt_len,
                              netsnmp_pdu *pdu);
 static int      snmp_parse_version(u_char *, size_t);
 static int      snmp_resend_request(struct session_list *slp,
-                                    netsnmp_request_list *orp,
                                     netsnmp_request_list *rp,
                                     int incr_retries);
 static void     register_default_handlers(void);
@@ -2039,25 +2062,31 @@ snmp_sess_close(struct session_list *slp)
     slp->internal = NULL;
 
     if (isp) {
-        netsnmp_request_list *rp, *orp;
+        netsnmp_request_list *rp;
+        size_t          i;
 
         SNMP_FREE(isp->packet);
+        SNMP_FREE(isp->obuf);
+        SNMP_FREE(isp->spare_obuf);
 
         /*
-         * Free each element in the input request list.  
+         * Free each outstanding request.  
          */
-        rp = isp->requests;
-        while (rp) {
-            orp = rp;
-            rp = rp->next_request;
-            if (orp->callback) {
-                orp->callback(NETSNMP_CALLBACK_OP_TIMED_OUT,
-                              slp->session, orp->pdu->reqid,
-                              orp->pdu, orp->cb_data);
+        for (i = 0; i < isp->expiry_count; i++) {
+            rp = isp->expiry[i];
+            if (rp->callback) {
+                rp->callback(NETSNMP_CALLBACK_OP_TIMED_OUT,
+                             slp->session, rp->pdu->reqid,
+                             rp->pdu, rp->cb_data);
             }
-            snmp_free_pdu(orp->pdu);
-            free(orp);
+            snmp_free_pdu(rp->pdu);
+            free(rp);
         }
+        SNMP_FREE(isp->expiry);
+        if (isp->requests_by_reqid)
+            CONTAINER_FREE(isp->requests_by_reqid);
+        if (isp->requests_by_msgid)
+            CONTAINER_FREE(isp->requests_by_msgid);
 
         free(isp);
     }
@@ -3299,6 +3328,151 @@ snmp_build(u_char ** pkt, size_t * pkt_len, size_t * offset,
     return rc;
 }
 
+struct netsnmp_encoded_varbinds_s {
+    size_t          len;
+    u_char         *data;
+};
+
+/*
+ * The PDU being sent by snmp_async_send_encoded(), and the encoding of
+ * its variables.  Only that PDU, and only while it is being sent, is
+ * built from the encoding: retransmissions and any other PDU (such as
+ * a copy whose variables were changed since) encode their variables.
+ */
+static const netsnmp_pdu *encoded_pdu;
+static const netsnmp_encoded_varbinds *encoded_pdu_variables;
+
+static const netsnmp_encoded_varbinds *
+_pdu_encoded_variables(const netsnmp_pdu *pdu)
+{
+    return pdu == encoded_pdu ? encoded_pdu_variables : NULL;
+}
+
+/*
+ * Encode the variable-bindings of a PDU, so that the same variables can
+ * be sent to several sessions with snmp_async_send_encoded() while only
+ * encoding the message header and PDU fields for each of them.  Returns
+ * NULL on failure; free the result with snmp_free_encoded_variables().
+ */
+netsnmp_encoded_varbinds *
+snmp_pdu_encode_variables(const netsnmp_pdu *pdu)
+{
+    netsnmp_encoded_varbinds *ev;
+    netsnmp_variable_list *vp;
+    u_char         *buf = NULL;
+#ifdef NETSNMP_USE_REVERSE_ASNENCODING
+    netsnmp_variable_list **vps;
+    size_t          size = 512, offset = 0;
+    int             i, count = 0;
+#else
+    size_t          size = 512, left;
+    u_char         *cp;
+#endif
+
+    if (pdu == NULL)
+        return NULL;
+
+#ifdef NETSNMP_USE_REVERSE_ASNENCODING
+    /*
+     * Encode as snmp_pdu_realloc_rbuild() would: last variable first.
+     */
+    for (vp = pdu->variables; vp && vp->type != ASN_PRIV_STOP;
+         vp = vp->next_variable)
+        count++;
+    vps = malloc((count ? count : 1) * sizeof(*vps));
+    buf = malloc(size);
+    if (vps == NULL || buf == NULL) {
+        free(vps);
+        free(buf);
+        return NULL;
+    }
+    for (i = 0, vp = pdu->variables; i < count; i++, vp = vp->next_variable)
+        vps[i] = vp;
+    for (i = count - 1; i >= 0; i--) {
+        vp = vps[i];
+        if (!snmp_realloc_rbuild_var_op(&buf, &size, &offset, 1, vp->name,
+                                        &vp->name_length, vp->type,
+                                        (u_char *) vp->val.string,
+                                        vp->val_len)) {
+            free(vps);
+            free(buf);
+            return NULL;
+        }
+    }
+    free(vps);
+    memmove(buf, buf + size - offset, offset);
+#else
+    for (;;) {
+        cp = realloc(buf, size);
+        if (cp == NULL) {
+            free(buf);
+            return NULL;
+        }
+        buf = cp;
+        left = size;
+        for (vp = pdu->variables; vp && cp; vp = vp->next_variable) {
+            if (ASN_PRIV_STOP == vp->type)
+                break;
+            cp = snmp_build_var_op(cp, vp->name, &vp->name_length, vp->type,
+                                   vp->val_len, vp->val.string, &left);
+        }
+        if (cp)
+            break;
+        if (size >= SNMP_MAX_PACKET_LEN / 2) {
+            free(buf);
+            return NULL;
+        }
+        size *= 2;
+    }
+#endif
+
+    ev = calloc(1, sizeof(*ev));
+    if (ev == NULL) {
+        free(buf);
+        return NULL;
+    }
+#ifdef NETSNMP_USE_REVERSE_ASNENCODING
+    ev->len = offset;
+#else
+    ev->len = size - left;
+#endif
+    ev->data = buf;
+    DEBUGMSGTL(("snmp_pdu_encode_variables", "%" NETSNMP_PRIz "u bytes\n",
+                ev->len));
+    return ev;
+}
+
+void
+snmp_free_encoded_variables(netsnmp_encoded_varbinds *ev)
+{
+    if (ev == NULL)
+        return;
+    free(ev->data);
+    free(ev);
+}
+
+/*
+ * snmp_async_send(), building the variable-bindings of @pdu from @ev,
+ * which must be the snmp_pdu_encode_variables() encoding of the
+ * variables of @pdu (or of a PDU they were copied from unchanged).
+ */
+int
+snmp_async_send_encoded(netsnmp_session *session, netsnmp_pdu *pdu,
+                        const netsnmp_encoded_varbinds *ev,
+                        snmp_callback callback, void *cb_data)
+{
+    const netsnmp_pdu *saved_pdu = encoded_pdu;
+    const netsnmp_encoded_varbinds *saved_ev = encoded_pdu_variables;
+    int             rc;
+
+    encoded_pdu = pdu;
+    encoded_pdu_variables = ev;
+    rc = snmp_async_send(session, pdu, callback, cb_data);
+    encoded_pdu = saved_pdu;
+    encoded_pdu_variables = saved_ev;
+    return rc;
+}
+
 /*
  * on error, returns NULL (likely an encoding problem). 
  */
@@ -3307,6 +3481,7 @@ snmp_pdu_build(const netsnmp_pdu *pdu, u_char * cp, size_t * out_length)
 {
     u_char         *h1, *h1e, *h2, *h2e, *save_ptr;
     netsnmp_variable_list *vp, *save_vp = NULL;
+    const netsnmp_encoded_varbinds *ev;
     size_t          length, save_length;
 
     length = *out_length;
@@ -3446,7 +3621,15 @@ snmp_pdu_build(const netsnmp_pdu *pdu, u_char * cp, size_t * out_length)
      * Store variable-bindings 
      */
     DEBUGDUMPSECTION("send", "VarBindList");
-    for (vp = pdu->variables; vp; vp = vp->next_variable) {
+    ev = _pdu_encoded_variables(pdu);
+    if (ev) {
+        if (*out_length < ev->len)
+            return NULL;
+        memcpy(cp, ev->data, ev->len);
+        cp += ev->len;
+        *out_length -= ev->len;
+    }
+    for (vp = ev ? NULL : pdu->variables; vp; vp = vp->next_variable) {
         /*
          * if estimated getbulk response size exceeded packet max size,
          * processing was stopped before bulk cache was filled and type
@@ -3522,10 +3705,22 @@ snmp_pdu_realloc_rbuild(u_char ** pkt, size_t * pkt_len, size_t * offset,
 #endif
     netsnmp_variable_list *vpcache[VPCACHE_SIZE];
     netsnmp_variable_list *vp, *tmpvp;
+    netsnmp_oid_cache name_cache;
+    const netsnmp_encoded_varbinds *ev;
     size_t          start_offset = *offset;
     int             i, wrapped = 0, notdone, final, rc = 0;
 
     DEBUGMSGTL(("snmp_pdu_realloc_rbuild", "starting\n"));
+    ev = _pdu_encoded_variables(pdu);
+    if (ev) {
+        while ((*pkt_len - *offset) < ev->len) {
+            if (!asn_realloc(pkt, pkt_len))
+                return 0;
+        }
+        *offset += ev->len;
+        memcpy(*pkt + *pkt_len - *offset, ev->data, ev->len);
+        goto wrap_varbinds;
+    }
     for (vp = pdu->variables, i = VPCACHE_SIZE - 1; vp;
          vp = vp->next_variable, i--) {
         /*
@@ -3545,15 +3740,21 @@ snmp_pdu_realloc_rbuild(u_char ** pkt, size_t * pkt_len, size_t * offset,
     }
     final = i + 1;
 
+    /*
+     * the names of neighbouring varbinds (e.g. in a GETBULK response)
+     * usually share a long prefix, encoded only once
+     */
+    name_cache.name_len = 0;
     do {
         for (i = final; i < VPCACHE_SIZE; i++) {
             vp = vpcache[i];
             DEBUGDUMPSECTION("send", "VarBind");
-            rc = snmp_realloc_rbuild_var_op(pkt, pkt_len, offset, 1,
-                                            vp->name, &vp->name_length,
-                                            vp->type,
-                                            (u_char *) vp->val.string,
-                                            vp->val_len);
+            rc = snmp_realloc_rbuild_var_op_cached(pkt, pkt_len, offset, 1,
+                                                   vp->name,
+                                                   &vp->name_length,
+                                                   vp->type,
+                                                   (u_char *) vp->val.string,
+                                                   vp->val_len, &name_cache);
             DEBUGINDENTLESS();
             if (rc == 0) {
                 return 0;
@@ -3566,11 +3767,14 @@ snmp_pdu_realloc_rbuild(u_char ** pkt, size_t * pkt_len, size_t * offset,
             for (i = 0; i < final; i++) {
                 vp = vpcache[i];
                 DEBUGDUMPSECTION("send", "VarBind");
-                rc = snmp_realloc_rbuild_var_op(pkt, pkt_len, offset, 1,
-                                                vp->name, &vp->name_length,
-                                                vp->type,
-                                                (u_char *) vp->val.string,
-                                                vp->val_len);
+                rc = snmp_realloc_rbuild_var_op_cached(pkt, pkt_len, offset,
+                                                       1, vp->name,
+                                                       &vp->name_length,
+                                                       vp->type,
+                                                       (u_char *)
+                                                       vp->val.string,
+                                                       vp->val_len,
+                                                       &name_cache);
                 DEBUGINDENTLESS();
                 if (rc == 0) {
                     return 0;
@@ -3599,6 +3803,7 @@ snmp_pdu_realloc_rbuild(u_char ** pkt, size_t * pkt_len, size_t * offset,
         }
     } while (notdone);
 
+  wrap_varbinds:
     /*
      * Save current location and build SEQUENCE tag and length placeholder for
      * variable-bindings sequence (actual length will be inserted later).  
@@ -5020,6 +5225,47 @@ snmpv3_scopedPDU_parse(netsnmp_pdu *pdu, u_char * cp, size_t * length)
 }
 
 
+/*
+ * Send buffers are kept per session and reused for the next packet, so
+ * a busy session (e.g. an AgentX connection) does not go through
+ * malloc/realloc/free for every PDU.  Buffers that grew beyond
+ * NETSNMP_SPARE_OBUF_MAX are released rather than kept around: the
+ * buffer stays allocated for as long as the session is open, and one
+ * unusually large packet (a big GETBULK response or trap) should not pin
+ * that much memory in every idle session.  64 kB holds any packet that
+ * fits in a UDP datagram, which covers the usual msgMaxSize values.
+ */
+#define NETSNMP_SPARE_OBUF_MAX  65536
+
+static u_char *
+_sess_get_obuf(struct snmp_internal_session *isp, size_t *size)
+{
+    u_char         *buf;
+
+    if (isp->spare_obuf && isp->spare_obuf_size >= *size) {
+        buf = isp->spare_obuf;
+        *size = isp->spare_obuf_size;
+        isp->spare_obuf = NULL;
+        isp->spare_obuf_size = 0;
+        return buf;
+    }
+    return (u_char *) malloc(*size);
+}
+
+static void
+_sess_put_obuf(struct snmp_internal_session *isp, u_char *buf, size_t size)
+{
+    if (buf == NULL)
+        return;
+    if (size > NETSNMP_SPARE_OBUF_MAX || size <= isp->spare_obuf_size) {
+        free(buf);
+        return;
+    }
+    free(isp->spare_obuf);
+    isp->spare_obuf = buf;
+    isp->spare_obuf_size = size;
+}
+
 /* ===========================================================================
  *
  * build pdu packet
@@ -5172,7 +5418,7 @@ _build_initial_pdu_packet(struct session_list *slp, netsnmp_pdu *pdu, int bulk)
      * while building the packet.
      */
     pktbuf_len = SNMP_MIN_MAX_LEN;
-    if ((pktbuf = (u_char *)malloc(pktbuf_len)) == NULL) {
+    if ((pktbuf = _sess_get_obuf(isp, &pktbuf_len)) == NULL) {
         DEBUGMSGTL(("sess_async_send",
                     "couldn't malloc initial packet buffer\n"));
         session->s_snmp_errno = SNMPERR_MALLOC;
@@ -5271,7 +5517,7 @@ _build_initial_pdu_packet(struct session_list *slp, netsnmp_pdu *pdu, int bulk)
 
     if ((SNMPERR_TOO_LONG == session->s_snmp_errno) || (result < 0)) {
         DEBUGMSGTL(("sess_async_send", "encoding failure\n"));
-        SNMP_FREE(pktbuf);
+        _sess_put_obuf(isp, pktbuf, pktbuf_len);
         return SNMPERR_GENERR;
     }
 
@@ -5283,6 +5529,172 @@ _build_initial_pdu_packet(struct session_list *slp, netsnmp_pdu *pdu, int bulk)
     return SNMPERR_SUCCESS;
 }
 
+/*
+ * Outstanding request bookkeeping.  Responses are matched through a hash
+ * on the request id (or, for SNMPv3, the message id) and timeouts are
+ * found through a heap on the expiry time, so that neither needs to walk
+ * every request of a session.
+ */
+static int
+_request_compare_reqid(const void *lhs, const void *rhs)
+{
+    long            l = ((const netsnmp_request_list *)lhs)->request_id;
+    long            r = ((const netsnmp_request_list *)rhs)->request_id;
+
+    return (l < r) ? -1 : (l > r);
+}
+
+static u_int
+_request_hash_reqid(const void *data)
+{
+    return (u_int)((const netsnmp_request_list *)data)->request_id *
+        2654435761U;
+}
+
+static int
+_request_compare_msgid(const void *lhs, const void *rhs)
+{
+    long            l = ((const netsnmp_request_list *)lhs)->message_id;
+    long            r = ((const netsnmp_request_list *)rhs)->message_id;
+
+    return (l < r) ? -1 : (l > r);
+}
+
+static u_int
+_request_hash_msgid(const void *data)
+{
+    return (u_int)((const netsnmp_request_list *)data)->message_id *
+        2654435761U;
+}
+
+static netsnmp_container *
+_request_index_create(const char *name, netsnmp_container_compare *compare,
+                      netsnmp_container_hash *hash)
+{
+    netsnmp_container *c = netsnmp_container_get_hash();
+
+    if (NULL == c)
+        return NULL;
+    c->container_name = strdup(name);
+    c->compare = compare;
+    c->flags |= CONTAINER_KEY_ALLOW_DUPLICATES;
+    netsnmp_container_hash_set_func(c, hash);
+    return c;
+}
+
+static void
+_expiry_swap(struct snmp_internal_session *isp, size_t i, size_t j)
+{
+    netsnmp_request_list *rp = isp->expiry[i];
+
+    isp->expiry[i] = isp->expiry[j];
+    isp->expiry[j] = rp;
+    isp->expiry[i]->expire_index = i;
+    isp->expiry[j]->expire_index = j;
+}
+
+/* Restore the heap order after the expiry time of entry i changed. */
+static void
+_expiry_fix(struct snmp_internal_session *isp, size_t i)
+{
+    size_t          parent, child;
+
+    while (i > 0) {
+        parent = (i - 1) / 2;
+        if (!timercmp(&isp->expiry[i]->expireM,
+                      &isp->expiry[parent]->expireM, <))
+            break;
+        _expiry_swap(isp, i, parent);
+        i = parent;
+    }
+    for (;;) {
+        child = 2 * i + 1;
+        if (child >= isp->expiry_count)
+            break;
+        if (child + 1 < isp->expiry_count &&
+            timercmp(&isp->expiry[child + 1]->expireM,
+                     &isp->expiry[child]->expireM, <))
+            ++child;
+        if (!timercmp(&isp->expiry[child]->expireM,
+                      &isp->expiry[i]->expireM, <))
+            break;
+        _expiry_swap(isp, i, child);
+        i = child;
+    }
+}
+
+/* Add request @rp to the indexes of session @isp. */
+static int
+_sess_add_request(struct snmp_internal_session *isp,
+                  netsnmp_request_list *rp)
+{
+    if (NULL == isp->requests_by_reqid)
+        isp->requests_by_reqid =
+            _request_index_create("snmp_requests_by_reqid",
+                                  _request_compare_reqid,
+                                  _request_hash_reqid);
+    if (NULL == isp->requests_by_msgid)
+        isp->requests_by_msgid =
+            _request_index_create("snmp_requests_by_msgid",
+                                  _request_compare_msgid,
+                                  _request_hash_msgid);
+    if (NULL == isp->requests_by_reqid || NULL == isp->requests_by_msgid)
+        return -1;
+
+    if (isp->expiry_count == isp->expiry_size) {
+        size_t          size = isp->expiry_size ? 2 * isp->expiry_size : 16;
+        netsnmp_request_list **expiry;
+
+        expiry = realloc(isp->expiry, size * sizeof(*expiry));
+        if (NULL == expiry)
+            return -1;
+        isp->expiry = expiry;
+        isp->expiry_size = size;
+    }
+
+    if (CONTAINER_INSERT(isp->requests_by_reqid, rp) != 0)
+        return -1;
+    if (CONTAINER_INSERT(isp->requests_by_msgid, rp) != 0) {
+        CONTAINER_REMOVE(isp->requests_by_reqid, rp);
+        return -1;
+    }
+
+    rp->expire_index = isp->expiry_count;
+    isp->expiry[isp->expiry_count++] = rp;
+    _expiry_fix(isp, rp->expire_index);
+    return 0;
+}
+
+/* Give request @rp the message id @msgid. */
+static void
+_sess_rekey_request(struct snmp_internal_session *isp,
+                    netsnmp_request_list *rp, long msgid)
+{
+    CONTAINER_REMOVE(isp->requests_by_msgid, rp);
+    rp->message_id = msgid;
+    CONTAINER_INSERT(isp->requests_by_msgid, rp);
+}
+
+/* Find the request a response PDU @pdu belongs to. */
+static netsnmp_request_list *
+_sess_find_request(struct snmp_internal_session *isp, netsnmp_pdu *pdu)
+{
+    netsnmp_request_list key;
+
+    if (0 == isp->expiry_count)
+        return NULL;
+
+    if (pdu->version == SNMP_VERSION_3) {
+        /*
+         * msgId must match for v3 messages.
+         */
+        key.message_id = pdu->msgid;
+        return CONTAINER_FIND(isp->requests_by_msgid, &key);
+    }
+    key.request_id = pdu->reqid;
+    return CONTAINER_FIND(isp->requests_by_reqid, &key);
+}
+
 /*
  * These functions send PDUs using an active session:
  * snmp_send             - traditional API, no callback
@@ -5411,7 +5823,9 @@ _sess_async_send(struct session_list *slp,
                                     &(pdu->transport_data),
                                     &(pdu->transport_data_length));
 
-    SNMP_FREE(isp->obuf);
+    _sess_put_obuf(isp, isp->obuf, isp->obuf_size);
+    isp->obuf = NULL;
+    isp->obuf_size = 0;
     isp->opacket = NULL; /* opacket was in obuf, so no free needed */
     isp->opacket_len = 0;
 
@@ -5473,14 +5887,12 @@ _sess_async_send(struct session_list *slp,
          * XX lock should be per session ! 
          */
         snmp_res_lock(MT_LIBRARY_ID, MT_LIB_SESSION);
-        if (isp->requestsEnd) {
-            rp->next_request = isp->requestsEnd->next_request;
-            isp->requestsEnd->next_request = rp;
-            isp->requestsEnd = rp;
-        } else {
-            rp->next_request = isp->requests;
-            isp->requests = rp;
-            isp->requestsEnd = rp;
+        if (_sess_add_request(isp, rp) != 0) {
+            snmp_res_unlock(MT_LIBRARY_ID, MT_LIB_SESSION);
+            snmp_log(LOG_ERR, "couldn't queue request %ld\n", rp->request_id);
+            free(rp);
+            session->s_snmp_errno = SNMPERR_GENERR;
+            return 0;
         }
         snmp_res_unlock(MT_LIBRARY_ID, MT_LIB_SESSION);
     } else {
@@ -5754,17 +6166,19 @@ _sess_process_packet_parse_pdu(struct session_list *slp, netsnmp_session * sp,
   return pdu;
 }
 
-/* Remove request @rp from session @isp. @orp is the request before @rp. */
+/* Remove request @rp from session @isp and free its PDU. */
 static void
-remove_request(struct snmp_internal_session *isp,
-               netsnmp_request_list *orp, netsnmp_request_list *rp)
+remove_request(struct snmp_internal_session *isp, netsnmp_request_list *rp)
 {
-    if (orp)
-        orp->next_request = rp->next_request;
-    else
-        isp->requests = rp->next_request;
-    if (isp->requestsEnd == rp)
-        isp->requestsEnd = orp;
+    size_t          i = rp->expire_index;
+
+    CONTAINER_REMOVE(isp->requests_by_reqid, rp);
+    CONTAINER_REMOVE(isp->requests_by_msgid, rp);
+    if (--isp->expiry_count != i) {
+        isp->expiry[i] = isp->expiry[isp->expiry_count];
+        isp->expiry[i]->expire_index = i;
+        _expiry_fix(isp, i);
+    }
     snmp_free_pdu(rp->pdu);
 }
 
@@ -5776,7 +6190,7 @@ _sess_process_packet_handle_pdu(struct session_list *slp, netsnmp_session * sp,
                                 struct snmp_internal_session *isp,
                                 netsnmp_transport *transport, netsnmp_pdu *pdu)
 {
-  netsnmp_request_list *rp, *orp = NULL;
+  netsnmp_request_list *rp;
   int             handled = 0;
 
   if (pdu->flags & UCD_MSG_FLAG_RESPONSE_PDU) {
@@ -5785,20 +6199,18 @@ _sess_process_packet_handle_pdu(struct session_list *slp, netsnmp_session * sp,
      */
     free_securityStateRef(pdu);
 
-    for (rp = isp->requests; rp; orp = rp, rp = rp->next_request) {
+    rp = _sess_find_request(isp, pdu);
+    do {
       snmp_callback   callback;
       void           *magic;
 
-      if (pdu->version == SNMP_VERSION_3) {
-	/*
-	 * msgId must match for v3 messages.  
-	 */
-	if (rp->message_id != pdu->msgid) {
-            DEBUGMSGTL(("sess_process_packet", "unmatched msg id: %ld != %ld\n",
-                        rp->message_id, pdu->msgid));
-	    continue;
-	}
+      if (rp == NULL) {
+        DEBUGMSGTL(("sess_process_packet", "unmatched msg id %ld reqid %ld\n",
+                    pdu->msgid, pdu->reqid));
+        break;
+      }
 
+      if (pdu->version == SNMP_VERSION_3) {
 	/*
 	 * Check that message fields match original, if not, no further
 	 * processing.  
@@ -5806,10 +6218,6 @@ _sess_process_packet_handle_pdu(struct session_list *slp, netsnmp_session * sp,
 	if (!snmpv3_verify_msg(rp, pdu)) {
 	  break;
 	}
-      } else {
-	if (rp->request_id != pdu->reqid) {
-	  continue;
-	}
       }
 
       if (rp->callback) {
@@ -5839,7 +6247,7 @@ _sess_process_packet_handle_pdu(struct session_list *slp, netsnmp_session * sp,
 	     * * inifinite resend                      
 	     */
 	    if (rp->retries <= sp->retries) {
-	      snmp_resend_request(slp, orp, rp, TRUE);
+	      snmp_resend_request(slp, rp, TRUE);
 	      break;
 	    } else {
 	      /* We're done with retries, so no longer waiting for a response */
@@ -5900,17 +6308,13 @@ _sess_process_packet_handle_pdu(struct session_list *slp, netsnmp_session * sp,
 	/*
 	 * Successful, so delete request.  
 	 */
-	remove_request(isp, orp, rp);
+	remove_request(isp, rp);
 	free(rp);
-	/*
-	 * There shouldn't be any more requests with the same reqid.  
-	 */
-	break;
       }
       /*
        * MTR snmp_res_unlock(MT_LIBRARY_ID, MT_LIB_SESSION);  ?* XX lock should be per session ! 
        */
-    }
+    } while (0);
   } else {
     if (sp->callback) {
       /*
@@ -6671,19 +7075,18 @@ snmp_sess_select_info2_flags(struct session_list *sessp, int *numfds,
         }
 
         NETSNMP_LARGE_FD_SET(slp->transport->sock, fdset);
-        if (slp->internal != NULL && slp->internal->requests) {
+        if (slp->internal != NULL && slp->internal->expiry_count) {
             /*
              * Found another session with outstanding requests.  
              */
             requests++;
-            for (rp = slp->internal->requests; rp; rp = rp->next_request) {
-                if (!timerisset(&earliest)
-                    || (timerisset(&rp->expireM)
-                        && timercmp(&rp->expireM, &earliest, <))) {
-                    earliest = rp->expireM;
-                    DEBUGMSG(("verbose:sess_select","(to in %d.%06d sec) ",
-                               (int)earliest.tv_sec, (int)earliest.tv_usec));
-                }
+            rp = slp->internal->expiry[0];
+            if (!timerisset(&earliest)
+                || (timerisset(&rp->expireM)
+                    && timercmp(&rp->expireM, &earliest, <))) {
+                earliest = rp->expireM;
+                DEBUGMSG(("verbose:sess_select","(to in %d.%06d sec) ",
+                           (int)earliest.tv_sec, (int)earliest.tv_usec));
             }
         }
 
@@ -6766,8 +7169,8 @@ snmp_timeout(void)
 }
 
 static int
-snmp_resend_request(struct session_list *slp, netsnmp_request_list *orp,
-                    netsnmp_request_list *rp, int incr_retries)
+snmp_resend_request(struct session_list *slp, netsnmp_request_list *rp,
+                    int incr_retries)
 {
     struct snmp_internal_session *isp;
     netsnmp_session *sp;
@@ -6785,12 +7188,11 @@ snmp_resend_request(struct session_list *slp, netsnmp_request_list *orp,
         return 0;
     }
 
-    if ((pktbuf = (u_char *)malloc(2048)) == NULL) {
+    pktbuf_len = 2048;
+    if ((pktbuf = _sess_get_obuf(isp, &pktbuf_len)) == NULL) {
         DEBUGMSGTL(("sess_resend",
                     "couldn't malloc initial packet buffer\n"));
         return 0;
-    } else {
-        pktbuf_len = 2048;
     }
 
     if (incr_retries) {
@@ -6800,7 +7202,8 @@ snmp_resend_request(struct session_list *slp, netsnmp_request_list *orp,
     /*
      * Always increment msgId for resent messages.  
      */
-    rp->pdu->msgid = rp->message_id = snmp_get_next_msgid();
+    rp->pdu->msgid = snmp_get_next_msgid();
+    _sess_rekey_request(isp, rp, rp->pdu->msgid);
 
     result = netsnmp_build_packet(isp, sp, rp->pdu, &pktbuf, &pktbuf_len,
                                   &packet, &length);
@@ -6809,7 +7212,7 @@ snmp_resend_request(struct session_list *slp, netsnmp_request_list *orp,
          * This should never happen.  
          */
         DEBUGMSGTL(("sess_resend", "encoding failure\n"));
-        SNMP_FREE(pktbuf);
+        _sess_put_obuf(isp, pktbuf, pktbuf_len);
         return -1;
     }
 
@@ -6826,7 +7229,7 @@ snmp_resend_request(struct session_list *slp, netsnmp_request_list *orp,
      */
 
     if (pktbuf != NULL) {
-        SNMP_FREE(pktbuf);
+        _sess_put_obuf(isp, pktbuf, pktbuf_len);
         packet = NULL;
     }
 
@@ -6837,7 +7240,8 @@ snmp_resend_request(struct session_list *slp, netsnmp_request_list *orp,
         if (rp->callback) {
             rp->callback(NETSNMP_CALLBACK_OP_SEND_FAILED, sp,
                          rp->pdu->reqid, rp->pdu, rp->cb_data);
-            remove_request(isp, orp, rp);
+            remove_request(isp, rp);
+            free(rp);
 	}
         return -1;
     } else {
@@ -6848,6 +7252,7 @@ snmp_resend_request(struct session_list *slp, netsnmp_request_list *orp,
         tv.tv_sec += tv.tv_usec / 1000000L;
         tv.tv_usec %= 1000000L;
         rp->expireM = tv;
+        _expiry_fix(isp, rp->expire_index);
         if (rp->callback)
             rp->callback(NETSNMP_CALLBACK_OP_RESEND, sp,
                          rp->pdu->reqid, rp->pdu, rp->cb_data);
@@ -6862,7 +7267,7 @@ snmp_sess_timeout(struct session_list *slp)
 {
     netsnmp_session *sp;
     struct snmp_internal_session *isp;
-    netsnmp_request_list *rp, *orp = NULL, *freeme = NULL;
+    netsnmp_request_list *rp;
     struct timeval  now;
     snmp_callback   callback;
     void           *magic;
@@ -6878,61 +7283,169 @@ snmp_sess_timeout(struct session_list *slp)
     netsnmp_get_monotonic_clock(&now);
 
     /*
-     * For each request outstanding, check to see if it has expired.
+     * Handle the outstanding requests which have expired, earliest first.
+     * Resent requests get a later expiry time and move down the heap.
      */
-    for (rp = isp->requests; rp; rp = rp->next_request) {
-        if (freeme != NULL) {
+    while (isp->expiry_count &&
+           timercmp(&isp->expiry[0]->expireM, &now, <)) {
+        rp = isp->expiry[0];
+
+        if ((sptr = find_sec_mod(rp->pdu->securityModel)) != NULL &&
+            sptr->pdu_timeout != NULL) {
             /*
-             * frees rp's after the for loop goes on to the next_request 
+             * call security model if it needs to know about this 
              */
-            free(freeme);
-            freeme = NULL;
+            (*sptr->pdu_timeout) (rp->pdu);
         }
 
-        if ((timercmp(&rp->expireM, &now, <))) {
-            if ((sptr = find_sec_mod(rp->pdu->securityModel)) != NULL &&
-                sptr->pdu_timeout != NULL) {
-                /*
-                 * call security model if it needs to know about this 
-                 */
-                (*sptr->pdu_timeout) (rp->pdu);
+        /*
+         * this timer has expired 
+         */
+        if (rp->retries >= sp->retries) {
+            if (rp->callback) {
+                callback = rp->callback;
+                magic = rp->cb_data;
+            } else {
+                callback = sp->callback;
+                magic = sp->callback_magic;
             }
 
             /*
-             * this timer has expired 
+             * No more chances, delete this entry 
              */
-            if (rp->retries >= sp->retries) {
-                if (rp->callback) {
-                    callback = rp->callback;
-                    magic = rp->cb_data;
-                } else {
-                    callback = sp->callback;
-                    magic = sp->callback_magic;
-                }
-
-                /*
-                 * No more chances, delete this entry 
-                 */
-                if (callback) {
-                    callback(NETSNMP_CALLBACK_OP_TIMED_OUT, sp,
-                             rp->pdu->reqid, rp->pdu, magic);
-                }
-                remove_request(isp, orp, rp);
-                freeme = rp;
-                continue;       /* don't update orp below */
-            } else {
-                if (snmp_resend_request(slp, orp, rp, TRUE)) {
-                    break;
-                }
+            if (callback) {
+                callback(NETSNMP_CALLBACK_OP_TIMED_OUT, sp,
+                         rp->pdu->reqid, rp->pdu, magic);
+            }
+            remove_request(isp, rp);
+            free(rp);
+        } else {
+            if (snmp_resend_request(slp, rp, TRUE)) {
+                break;
             }
+            /*
+             * A request that couldn't be resent (no transport, no
+             * buffer) keeps its expiry time and stays on top of the
+             * heap; leave it for the next pass instead of spinning.
+             */
+            if (timercmp(&rp->expireM, &now, <))
+                break;
         }
-        orp = rp;
     }
+}
+
+/*
+ * The OID comparisons below all start by looking for the first
+ * sub-identifier at which two OIDs differ.  On x86 that search compares
+ * 16 (SSE2) or 32 (AVX2) bytes at a time, picking the widest
+ * implementation the CPU supports the first time it is needed; elsewhere
+ * the sub-identifiers are compared one at a time.
+ */
+typedef size_t  (oid_mismatch_fn) (const oid *, const oid *, size_t);
+
+static size_t
+_oid_mismatch_scalar(const oid * name1, const oid * name2, size_t len)
+{
+    size_t          i;
+
+    for (i = 0; i < len; i++)
+        if (name1[i] != name2[i])
+            break;
+    return i;
+}
+
+#ifdef NETSNMP_OID_COMPARE_X86
+__attribute__((target("sse2")))
+static size_t
+_oid_mismatch_sse2(const oid * name1, const oid * name2, size_t len)
+{
+    const u_char   *p1 = (const u_char *) name1;
+    const u_char   *p2 = (const u_char *) name2;
+    size_t          bytes = len * sizeof(oid), i;
+    unsigned int    mask;
+
+    for (i = 0; i + 16 <= bytes; i += 16) {
+        mask = _mm_movemask_epi8(_mm_cmpeq_epi8(
+                   _mm_loadu_si128((const __m128i *) (p1 + i)),
+                   _mm_loadu_si128((const __m128i *) (p2 + i)))) ^ 0xffff;
+        if (mask)
+            return (i + __builtin_ctz(mask)) / sizeof(oid);
+    }
+    i /= sizeof(oid);
+    return i + _oid_mismatch_scalar(name1 + i, name2 + i, len - i);
+}
+
+__attribute__((target("avx2")))
+static size_t
+_oid_mismatch_avx2(const oid * name1, const oid * name2, size_t len)
+{
+    const u_char   *p1 = (const u_char *) name1;
+    const u_char   *p2 = (const u_char *) name2;
+    size_t          bytes = len * sizeof(oid), i;
+    unsigned int    mask;
+
+    for (i = 0; i + 32 <= bytes; i += 32) {
+        mask = ~(unsigned int) _mm256_movemask_epi8(_mm256_cmpeq_epi8(
+                   _mm256_loadu_si256((const __m256i *) (p1 + i)),
+                   _mm256_loadu_si256((const __m256i *) (p2 + i))));
+        if (mask)
+            return (i + __builtin_ctz(mask)) / sizeof(oid);
+    }
+    if (i + 16 <= bytes) {
+        mask = _mm_movemask_epi8(_mm_cmpeq_epi8(
+                   _mm_loadu_si128((const __m128i *) (p1 + i)),
+                   _mm_loadu_si128((const __m128i *) (p2 + i)))) ^ 0xffff;
+        if (mask)
+            return (i + __builtin_ctz(mask)) / sizeof(oid);
+        i += 16;
+    }
+    i /= sizeof(oid);
+    return i + _oid_mismatch_scalar(name1 + i, name2 + i, len - i);
+}
+#endif /* NETSNMP_OID_COMPARE_X86 */
+
+static oid_mismatch_fn _oid_mismatch_select;
+static oid_mismatch_fn *_oid_mismatch = _oid_mismatch_select;
 
-    if (freeme != NULL) {
-        free(freeme);
-        freeme = NULL;
+/**
+ * Select the implementation of the OID comparison functions.
+ *
+ * All implementations give the same results; this is meant for tests
+ * and benchmarks.
+ *
+ * @param name "scalar", "sse2" or "avx2", or NULL for the fastest one
+ *             supported by the CPU (the default).
+ *
+ * @return the name of the implementation selected, or NULL if the one
+ *         asked for is unknown or not supported, in which case the
+ *         implementation in use does not change.
+ */
+const char *
+netsnmp_oid_compare_impl(const char *name)
+{
+#ifdef NETSNMP_OID_COMPARE_X86
+    __builtin_cpu_init();
+    if ((!name || !strcmp(name, "avx2")) && __builtin_cpu_supports("avx2")) {
+        _oid_mismatch = _oid_mismatch_avx2;
+        return "avx2";
     }
+    if ((!name || !strcmp(name, "sse2")) && __builtin_cpu_supports("sse2")) {
+        _oid_mismatch = _oid_mismatch_sse2;
+        return "sse2";
+    }
+#endif
+    if (!name || !strcmp(name, "scalar")) {
+        _oid_mismatch = _oid_mismatch_scalar;
+        return "scalar";
+    }
+    return NULL;
+}
+
+static size_t
+_oid_mismatch_select(const oid * name1, const oid * name2, size_t len)
+{
+    netsnmp_oid_compare_impl(NULL);
+    return _oid_mismatch(name1, name2, len);
 }
 
 /*
@@ -6949,10 +7462,7 @@ snmp_oid_ncompare(const oid * in_name1,
                   size_t len1,
                   const oid * in_name2, size_t len2, size_t max_len)
 {
-    register int    len;
-    register const oid *name1 = in_name1;
-    register const oid *name2 = in_name2;
-    size_t          min_len;
+    size_t          min_len, i;
 
     /*
      * len = minimum of len1 and len2 
@@ -6965,25 +7475,14 @@ snmp_oid_ncompare(const oid * in_name1,
     if (min_len > max_len)
         min_len = max_len;
 
-    len = min_len;
-
     /*
-     * find first non-matching OID 
+     * find first non-matching OID; these must be done in separate
+     * comparisons, since subtracting them and using that result has
+     * problems with subids > 2^31.
      */
-    while (len-- > 0) {
-        /*
-         * these must be done in separate comparisons, since
-         * subtracting them and using that result has problems with
-         * subids > 2^31. 
-         */
-        if (*(name1) != *(name2)) {
-            if (*(name1) < *(name2))
-                return -1;
-            return 1;
-        }
-        name1++;
-        name2++;
-    }
+    i = _oid_mismatch(in_name1, in_name2, min_len);
+    if (i < min_len)
+        return in_name1[i] < in_name2[i] ? -1 : 1;
 
     if (min_len != max_len) {
         /*
@@ -7015,9 +7514,7 @@ int
 snmp_oid_compare(const oid * in_name1,
                  size_t len1, const oid * in_name2, size_t len2)
 {
-    register int    len;
-    register const oid *name1 = in_name1;
-    register const oid *name2 = in_name2;
+    size_t          len, i;
 
     /*
      * len = minimum of len1 and len2 
@@ -7029,20 +7526,9 @@ snmp_oid_compare(const oid * in_name1,
     /*
      * find first non-matching OID 
      */
-    while (len-- > 0) {
-        /*
-         * these must be done in separate comparisons, since
-         * subtracting them and using that result has problems with
-         * subids > 2^31. 
-         */
-        if (*(name1) != *(name2)) {
-            if (*(name1) < *(name2))
-                return -1;
-            return 1;
-        }
-        name1++;
-        name2++;
-    }
+    i = _oid_mismatch(in_name1, in_name2, len);
+    if (i < len)
+        return in_name1[i] < in_name2[i] ? -1 : 1;
     /*
      * both OIDs equal up to length of shorter OID 
      */
@@ -7072,40 +7558,26 @@ int
 netsnmp_oid_compare_ll(const oid * in_name1, size_t len1, const oid * in_name2,
                        size_t len2, size_t *offpt)
 {
-    register int    len;
-    register const oid *name1 = in_name1;
-    register const oid *name2 = in_name2;
-    int initlen;
+    size_t          len, i;
 
     /*
      * len = minimum of len1 and len2 
      */
     if (len1 < len2)
-        initlen = len = len1;
+        len = len1;
     else
-        initlen = len = len2;
+        len = len2;
     /*
-     * find first non-matching OID 
+     * find first non-matching OID; the offset is one past it, or one
+     * past the end of the shorter OID if there is none
      */
-    while (len-- > 0) {
-        /*
-         * these must be done in separate comparisons, since
-         * subtracting them and using that result has problems with
-         * subids > 2^31. 
-         */
-        if (*(name1) != *(name2)) {
-            *offpt = initlen - len;
-            if (*(name1) < *(name2))
-                return -1;
-            return 1;
-        }
-        name1++;
-        name2++;
-    }
+    i = _oid_mismatch(in_name1, in_name2, len);
+    *offpt = i + 1;
+    if (i < len)
+        return in_name1[i] < in_name2[i] ? -1 : 1;
     /*
      * both OIDs equal up to length of shorter OID 
      */
-    *offpt = initlen - len;
     if (len1 < len2)
         return -1;
     if (len2 < len1)
@@ -7152,10 +7624,6 @@ int
 netsnmp_oid_equals(const oid * in_name1,
                    size_t len1, const oid * in_name2, size_t len2)
 {
-    register const oid *name1 = in_name1;
-    register const oid *name2 = in_name2;
-    register int    len = len1;
-
     /*
      * len = minimum of len1 and len2 
      */
@@ -7166,21 +7634,10 @@ netsnmp_oid_equals(const oid * in_name1,
      */
     if (len1 == 0)
         return 0;   /* Two null OIDs are (trivially) the same */
-    if (!name1 || !name2)
+    if (!in_name1 || !in_name2)
         return 1;   /* Otherwise something's wrong, so report a non-match */
-    /*
-     * find first non-matching OID 
-     */
-    while (len-- > 0) {
-        /*
-         * these must be done in separate comparisons, since
-         * subtracting them and using that result has problems with
-         * subids > 2^31. 
-         */
-        if (*(name1++) != *(name2++))
-            return 1;
-    }
-    return 0;
+
+    return _oid_mismatch(in_name1, in_name2, len1) != len1;
 }
 
 #ifndef NETSNMP_FEATURE_REMOVE_OID_IS_SUBTREE
@@ -7218,23 +7675,14 @@ int
 netsnmp_oid_find_prefix(const oid * in_name1, size_t len1,
                         const oid * in_name2, size_t len2)
 {
-    int i;
-    size_t min_size;
-
     if (!in_name1 || !in_name2 || !len1 || !len2)
         return -1;
 
-    if (in_name1[0] != in_name2[0])
-        return 0;   /* No match */
-    min_size = SNMP_MIN(len1, len2);
-    for(i = 0; i < (int)min_size; i++) {
-        if (in_name1[i] != in_name2[i])
-            return i;    /* 'i' is the first differing subidentifier
-                            So the common prefix is 0..(i-1), of length i */
-    }
-    return min_size;	/* The shorter OID is a prefix of the longer, and
-                           hence is precisely the common prefix of the two.
-                           Return its length. */
+    /*
+     * the index of the first differing subidentifier is the length of
+     * the common prefix; if there is none, the shorter OID is the prefix
+     */
+    return _oid_mismatch(in_name1, in_name2, SNMP_MIN(len1, len2));
 }
 
 #ifndef NETSNMP_DISABLE_MIB_LOADING
@@ -67,6 +67,13 @@ static int      debug_log_level = LOG_DEBUG;
 
 netsnmp_token_descr dbg_tokens[MAX_DEBUG_TOKENS];
 
+/*
+ * Bumped whenever the token set changes, to make the call sites of the
+ * debug macros look their token up again (see debug_site_check()).
+ * Code changing dbg_tokens[] directly must bump it as well.
+ */
+unsigned int    debug_token_generation = 1;
+
 /*
  * Number of spaces to indent debug output. Valid range is [0,INT_MAX]
  */
@@ -197,6 +204,7 @@ debug_register_tokens(const char *tokens)
         if (strlen(cp) < MAX_DEBUG_TOKEN_LEN) {
             if (strcasecmp(cp, DEBUG_ALWAYS_TOKEN) == 0) {
                 debug_print_everything = 1;
+                debug_token_generation++;
             } else if (debug_num_tokens < MAX_DEBUG_TOKENS) {
                 if ('-' == *cp) {
                     ++cp;
@@ -206,6 +214,7 @@ debug_register_tokens(const char *tokens)
                     status = SNMP_DEBUG_ACTIVE;
                 dbg_tokens[debug_num_tokens].token_name = strdup(cp);
                 dbg_tokens[debug_num_tokens++].enabled  = status;
+                debug_token_generation++;
                 snmp_log(LOG_NOTICE, "registered debug token %s, %d\n", cp, status);
             } else {
                 snmp_log(LOG_NOTICE, "Unable to register debug token %s\n", cp);
@@ -253,6 +262,7 @@ debug_enable_token_logs (const char *token) {
                 strncmp(dbg_tokens[i].token_name, token,
                         strlen(dbg_tokens[i].token_name)) == 0) {
                 dbg_tokens[i].enabled = SNMP_DEBUG_ACTIVE;
+                debug_token_generation++;
                 return SNMPERR_SUCCESS;
             }
         }
@@ -279,6 +289,7 @@ debug_disable_token_logs (const char *token) {
             if (strncmp(dbg_tokens[i].token_name, token, 
                   strlen(dbg_tokens[i].token_name)) == 0) {
                 dbg_tokens[i].enabled = SNMP_DEBUG_DISABLED;
+                debug_token_generation++;
                 return SNMPERR_SUCCESS;
             }
         }
@@ -329,6 +340,19 @@ debug_is_token_registered(const char *token)
     return rc;
 }
 
+/*
+ * Look token up for the call site of a debug macro, and remember the
+ * answer there until the token set changes.
+ */
+int
+debug_site_check(netsnmp_debug_site *site, const char *token)
+{
+    site->enabled = debug_is_token_registered(token) == SNMPERR_SUCCESS;
+    site->token = token;
+    site->generation = debug_token_generation;
+    return site->enabled;
+}
+
 void
 debugmsg(const char *token, const char *format, ...)
 {
@@ -552,6 +576,7 @@ void
 snmp_set_do_debugoutputall(int val)
 {
     debug_print_everything = val;
+    debug_token_generation++;
 }
 
 int
@@ -567,6 +592,7 @@ snmp_debug_shutdown(void)
 
     for (i = 0; i < debug_num_tokens; i++)
        SNMP_FREE(dbg_tokens[i].token_name);
+    debug_token_generation++;
 }
 
 #else /* ! NETSNMP_NO_DEBUGGING */
@@ -77,6 +77,13 @@
 
 #include "snmp_syslog.h"
 
+#if defined(HAVE_PTHREAD_H) && defined(HAVE_PTHREAD_CREATE) && \
+    defined(__ATOMIC_ACQUIRE) && !defined(NETSNMP_FEATURE_REMOVE_LOGGING_ASYNC)
+#define NETSNMP_ASYNC_LOGGING 1
+#include <pthread.h>
+#include <signal.h>
+#endif
+
 #ifdef va_copy
 #define NEED_VA_END_AFTER_VA_COPY
 #else
@@ -98,6 +105,7 @@ netsnmp_feature_child_of(logging_file, logging_outputs);
 netsnmp_feature_child_of(logging_stdio, logging_outputs);
 netsnmp_feature_child_of(logging_syslog, logging_outputs);
 netsnmp_feature_child_of(logging_external, logging_all);
+netsnmp_feature_child_of(logging_async, logging_all);
 
 netsnmp_feature_child_of(enable_stderrlog, logging_all);
 
@@ -114,6 +122,7 @@ netsnmp_feature_want(logging_outputs);
 netsnmp_log_handler *logh_head = NULL;
 netsnmp_log_handler *logh_priorities[LOG_DEBUG+1];
 static int  logh_enabled = 0;
+static netsnmp_log_handler *logh_newest = NULL;  /* for -La */
 
 #ifndef NETSNMP_FEATURE_REMOVE_LOGGING_SYSLOG
 static char syslogname[64] = DEFAULT_LOG_ID;
@@ -154,6 +163,22 @@ void
 netsnmp_enable_filelog(netsnmp_log_handler *logh, int dont_zero_log);
 #endif /* NETSNMP_FEATURE_REMOVE_LOGGING_FILE */
 
+#ifdef NETSNMP_ASYNC_LOGGING
+static int  log_handler_async(netsnmp_log_handler *logh, int pri,
+                              const char *str);
+static void async_log_stop(void);
+/*
+ * Let the writer thread catch up with an asynchronous handler before
+ * its file or syslog connection is closed or the handler is freed.
+ */
+#define async_log_settle(logh) do {                     \
+        if ((logh)->handler == log_handler_async)       \
+            netsnmp_async_log_flush();                  \
+    } while (0)
+#else
+#define async_log_settle(logh)
+#endif /* NETSNMP_ASYNC_LOGGING */
+
 void
 parse_config_logOption(const char *token, char *cptr)
 {
@@ -170,7 +195,10 @@ init_snmp_logging(void)
 			 NETSNMP_DS_LIBRARY_ID, NETSNMP_DS_LIB_LOG_TIMESTAMP);
     register_prenetsnmp_mib_handler("snmp", "logOption",
                                     parse_config_logOption, NULL, "string");
-
+    netsnmp_ds_register_premib(ASN_INTEGER, "snmp", "logAsyncQueueLength",
+			 NETSNMP_DS_LIBRARY_ID, NETSNMP_DS_LIB_LOG_ASYNC_QUEUE);
+    netsnmp_ds_register_premib(ASN_BOOLEAN, "snmp", "logAsyncBlock",
+			 NETSNMP_DS_LIBRARY_ID, NETSNMP_DS_LIB_LOG_ASYNC_BLOCK);
 }
 
 void
@@ -179,6 +207,9 @@ shutdown_snmp_logging(void)
    snmp_disable_log();
    while(NULL != logh_head)
       netsnmp_remove_loghandler( logh_head );
+#ifdef NETSNMP_ASYNC_LOGGING
+   async_log_stop();
+#endif
 }
 
 /* Set line buffering mode for a stream. */
@@ -479,6 +510,18 @@ snmp_log_options(char *optarg, int argc, char *const *argv)
 	}
         break;
 
+    /*
+     * Log asynchronously: hand the messages to a writer thread
+     */
+    case 'a':
+        logh_newest = NULL;
+        if (snmp_log_options(cp + 1, argc, argv) < 0)
+            return -1;
+        if (logh_newest && !netsnmp_loghandler_set_async(logh_newest))
+            fprintf(stderr, "Asynchronous logging not available for -L%s, "
+                    "logging synchronously.\n", cp + 1);
+        break;
+
     default:
         fprintf(stderr, "Unknown logging option passed to -L: %c.\n", *cp);
         return -1;
@@ -520,6 +563,7 @@ snmp_log_options_usage(const char *lead, FILE * outf)
 #endif /* NETSNMP_FEATURE_REMOVE_LOGGING_FILE */
     fprintf(outf, "%s[FS] pri token:    log to file/syslog%s\n", lead, pri1_msg);
     fprintf(outf, "%s[FS] p1-p2 token:  log to file/syslog%s\n", lead, pri2_msg);
+    fprintf(outf, "%sa[eofsEOFS] ...:   as above, but write the messages from a separate thread\n", lead);
 }
 
 /**
@@ -561,6 +605,7 @@ snmp_disable_syslog_entry(netsnmp_log_handler *logh)
 {
     if (!logh || !logh->enabled || logh->type != NETSNMP_LOGHANDLER_SYSLOG)
         return;
+    async_log_settle(logh);
 
 #ifdef WIN32
     if (logh->magic) {
@@ -593,6 +638,7 @@ snmp_disable_filelog_entry(netsnmp_log_handler *logh)
 {
     if (!logh /* || !logh->enabled */ || logh->type != NETSNMP_LOGHANDLER_FILE)
         return;
+    async_log_settle(logh);
 
     if (logh->magic) {
         fputs("\n", (FILE*)logh->magic);	/* XXX - why? */
@@ -1033,6 +1079,7 @@ netsnmp_register_loghandler( int type, int priority )
     logh->priority = priority;
     netsnmp_enable_this_loghandler(logh);
     netsnmp_add_loghandler( logh );
+    logh_newest = logh;
     return logh;
 }
 
@@ -1070,6 +1117,9 @@ netsnmp_remove_loghandler( netsnmp_log_handler *logh )
     int i;
     if (!logh)
         return 0;
+    async_log_settle(logh);
+    if (logh == logh_newest)
+        logh_newest = NULL;
 
     if (logh->prev)
         logh->prev->next = logh->next;
@@ -1209,11 +1259,32 @@ log_handler_syslog(  netsnmp_log_handler* logh, int pri, const char *str)
 
 
 #ifndef NETSNMP_FEATURE_REMOVE_LOGGING_FILE
-int
-log_handler_file(    netsnmp_log_handler* logh, int pri, const char *str)
+/*
+ * If we haven't already opened the file, then do so.
+ * Save the filehandle pointer for next time.
+ *
+ * Note that this should still work, even if the file
+ * is closed in the meantime (e.g. a regular "cleanup" sweep)
+ */
+static FILE *
+log_file_handle(netsnmp_log_handler* logh)
+{
+    FILE           *fhandle = (FILE*)logh->magic;
+
+    if (!fhandle) {
+        fhandle = fopen(logh->token, "a+");
+        if (fhandle)
+            logh->magic = (void*)fhandle;
+    }
+    return fhandle;
+}
+
+/*
+ * Fill sbuf with the timestamp (if any) to write in front of str.
+ */
+static void
+log_file_stamp(netsnmp_log_handler* logh, const char *str, char *sbuf)
 {
-    FILE           *fhandle;
-    char            sbuf[40];
     int             len = strlen( str );
 
     /*
@@ -1226,28 +1297,25 @@ log_handler_file(    netsnmp_log_handler* logh, int pri, const char *str)
     } else {
         strcpy(sbuf, "");
     }
-
-    /*
-     * If we haven't already opened the file, then do so.
-     * Save the filehandle pointer for next time.
-     *
-     * Note that this should still work, even if the file
-     * is closed in the meantime (e.g. a regular "cleanup" sweep)
-     */
-    fhandle = (FILE*)logh->magic;
-    if (!logh->magic) {
-        fhandle = fopen(logh->token, "a+");
-        if (!fhandle)
-            return 0;
-        logh->magic = (void*)fhandle;
-    }
-    fprintf(fhandle, "%s%s", sbuf, str);
-    fflush(fhandle);
     if (len > 0) {
         logh->imagic = str[len - 1] == '\n';
     } else {
         logh->imagic = 0;
     }
+}
+
+int
+log_handler_file(    netsnmp_log_handler* logh, int pri, const char *str)
+{
+    FILE           *fhandle;
+    char            sbuf[40];
+
+    fhandle = log_file_handle(logh);
+    if (!fhandle)
+        return 0;
+    log_file_stamp(logh, str, sbuf);
+    fprintf(fhandle, "%s%s", sbuf, str);
+    fflush(fhandle);
     return 1;
 }
 #endif /* NETSNMP_FEATURE_REMOVE_LOGGING_FILE */
@@ -1282,6 +1350,455 @@ log_handler_null(    netsnmp_log_handler* logh, int pri, const char *str)
     return 1;
 }
 
+/* ==================================================== */
+
+#ifdef NETSNMP_ASYNC_LOGGING
+/*
+ * Asynchronous logging.
+ *
+ * log_handler_async() copies the message into a bounded ring of records
+ * and returns at once; a single writer thread takes the records off the
+ * ring and writes them to the destination of the handler's type.  The
+ * ring is Dmitry Vyukov's bounded MPMC queue with one consumer: each
+ * slot carries a sequence number saying whether it is free for the
+ * producer at a position or filled for the consumer, so neither side
+ * takes a lock.  async_lock only serves to put the writer to sleep when
+ * the ring is empty and to wait for it to make progress.
+ *
+ * When the ring is full the message is dropped and counted (the count
+ * is logged once the writer catches up), unless logAsyncBlock is set.
+ */
+struct async_log_record {
+    size_t               seq;
+    netsnmp_log_handler *logh;
+    int                  pri;
+    char                *msg;
+};
+
+#define ASYNC_LOG_QUEUE_LENGTH  1024    /* default ring size */
+#define ASYNC_LOG_BATCH         64      /* records written per round */
+
+static struct async_log_record *async_ring = NULL;
+static size_t   async_mask;
+static size_t   async_head;     /* next position to fill */
+static size_t   async_tail;     /* next position to write, writer only */
+static u_long   async_dropped;
+static u_long   async_reported; /* drops already logged, writer only */
+static int      async_running;
+static int      async_stop;
+static int      async_sleeping;
+static int      async_waiters;
+static int      async_hooked;
+static pthread_t       async_thread;
+static pthread_mutex_t async_lock     = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  async_wake     = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t  async_progress = PTHREAD_COND_INITIALIZER;
+
+/*
+ * Consecutive records for the same file are collected here and
+ * written with a single write and flush.
+ */
+static char    *async_batch = NULL;
+static size_t   async_batch_size, async_batch_len;
+static netsnmp_log_handler *async_batch_logh = NULL;
+
+static NetsnmpLogHandler *
+async_log_output_handler(int type)
+{
+    switch (type) {
+#ifndef NETSNMP_FEATURE_REMOVE_LOGGING_STDIO
+    case NETSNMP_LOGHANDLER_STDOUT:
+    case NETSNMP_LOGHANDLER_STDERR:
+        return log_handler_stdouterr;
+#endif /* NETSNMP_FEATURE_REMOVE_LOGGING_STDIO */
+#ifndef NETSNMP_FEATURE_REMOVE_LOGGING_FILE
+    case NETSNMP_LOGHANDLER_FILE:
+        return log_handler_file;
+#endif /* NETSNMP_FEATURE_REMOVE_LOGGING_FILE */
+#ifndef NETSNMP_FEATURE_REMOVE_LOGGING_SYSLOG
+    case NETSNMP_LOGHANDLER_SYSLOG:
+        return log_handler_syslog;
+#endif /* NETSNMP_FEATURE_REMOVE_LOGGING_SYSLOG */
+    default:
+        return NULL;
+    }
+}
+
+/* call with async_lock held */
+static void
+async_log_timedwait(pthread_cond_t *cond, long usec)
+{
+    struct timeval  now;
+    struct timespec ts;
+
+    gettimeofday(&now, NULL);
+    now.tv_usec += usec;
+    ts.tv_sec  = now.tv_sec + now.tv_usec / 1000000;
+    ts.tv_nsec = (now.tv_usec % 1000000) * 1000;
+    pthread_cond_timedwait(cond, &async_lock, &ts);
+}
+
+#ifndef NETSNMP_FEATURE_REMOVE_LOGGING_FILE
+static void
+async_log_write_batch(void)
+{
+    FILE           *fhandle;
+
+    if (async_batch_len) {
+        fhandle = log_file_handle(async_batch_logh);
+        if (fhandle) {
+            fwrite(async_batch, 1, async_batch_len, fhandle);
+            fflush(fhandle);
+        }
+    }
+    async_batch_len = 0;
+    async_batch_logh = NULL;
+}
+
+static void
+async_log_file(netsnmp_log_handler *logh, const char *str)
+{
+    char            sbuf[40];
+    size_t          len, size;
+    char           *buf;
+    FILE           *fhandle;
+
+    if (logh != async_batch_logh)
+        async_log_write_batch();
+    async_batch_logh = logh;
+
+    log_file_stamp(logh, str, sbuf);
+    len = strlen(sbuf) + strlen(str);
+    if (async_batch_len + len > async_batch_size) {
+        size = async_batch_size ? async_batch_size : 4096;
+        while (size < async_batch_len + len)
+            size *= 2;
+        buf = (char *)realloc(async_batch, size);
+        if (!buf) {
+            async_log_write_batch();
+            fhandle = log_file_handle(logh);
+            if (fhandle) {
+                fprintf(fhandle, "%s%s", sbuf, str);
+                fflush(fhandle);
+            }
+            return;
+        }
+        async_batch = buf;
+        async_batch_size = size;
+    }
+    strcpy(async_batch + async_batch_len, sbuf);
+    strcat(async_batch + async_batch_len, str);
+    async_batch_len += len;
+}
+#else
+#define async_log_write_batch()
+#endif /* NETSNMP_FEATURE_REMOVE_LOGGING_FILE */
+
+static void
+async_log_output(netsnmp_log_handler *logh, int pri, const char *str)
+{
+    NetsnmpLogHandler *output;
+
+#ifndef NETSNMP_FEATURE_REMOVE_LOGGING_FILE
+    if (logh->type == NETSNMP_LOGHANDLER_FILE) {
+        async_log_file(logh, str);
+        return;
+    }
+#endif /* NETSNMP_FEATURE_REMOVE_LOGGING_FILE */
+    output = async_log_output_handler(logh->type);
+    if (output)
+        output(logh, pri, str);
+}
+
+static int
+async_log_pending(void)
+{
+    struct async_log_record *rec = &async_ring[async_tail & async_mask];
+
+    return __atomic_load_n(&rec->seq, __ATOMIC_SEQ_CST) == async_tail + 1;
+}
+
+/*
+ * Write out up to ASYNC_LOG_BATCH records.  Returns the number written.
+ */
+static int
+async_log_drain(void)
+{
+    struct async_log_record *rec;
+    size_t          pos = async_tail;
+    u_long          dropped;
+    char            buf[96];
+    int             n;
+
+    for (n = 0; n < ASYNC_LOG_BATCH; n++, pos++) {
+        rec = &async_ring[pos & async_mask];
+        if (__atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE) != pos + 1)
+            break;
+        dropped = __atomic_load_n(&async_dropped, __ATOMIC_RELAXED);
+        if (dropped != async_reported) {
+            snprintf(buf, sizeof(buf),
+                     "%lu log messages dropped (asynchronous log queue full)\n",
+                     dropped - async_reported);
+            async_reported = dropped;
+            async_log_output(rec->logh, LOG_WARNING, buf);
+        }
+        async_log_output(rec->logh, rec->pri, rec->msg);
+        free(rec->msg);
+        __atomic_store_n(&rec->seq, pos + async_mask + 1, __ATOMIC_RELEASE);
+    }
+    async_log_write_batch();
+    __atomic_store_n(&async_tail, pos, __ATOMIC_SEQ_CST);
+    return n;
+}
+
+static void *
+async_log_writer(void *arg)
+{
+    for (;;) {
+        if (async_log_drain()) {
+            if (__atomic_load_n(&async_waiters, __ATOMIC_SEQ_CST)) {
+                pthread_mutex_lock(&async_lock);
+                pthread_cond_broadcast(&async_progress);
+                pthread_mutex_unlock(&async_lock);
+            }
+            continue;
+        }
+        pthread_mutex_lock(&async_lock);
+        if (async_stop) {
+            pthread_mutex_unlock(&async_lock);
+            break;
+        }
+        __atomic_store_n(&async_sleeping, 1, __ATOMIC_SEQ_CST);
+        if (!async_log_pending())
+            async_log_timedwait(&async_wake, 1000000);
+        __atomic_store_n(&async_sleeping, 0, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&async_lock);
+    }
+    return NULL;
+}
+
+/*
+ * Wait until the writer has got past position target.
+ */
+static void
+async_log_wait(size_t target)
+{
+    __atomic_add_fetch(&async_waiters, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_lock(&async_lock);
+    while (__atomic_load_n(&async_running, __ATOMIC_ACQUIRE) &&
+           (intptr_t)(__atomic_load_n(&async_tail, __ATOMIC_SEQ_CST) -
+                      target) < 0) {
+        if (__atomic_load_n(&async_sleeping, __ATOMIC_SEQ_CST))
+            pthread_cond_signal(&async_wake);
+        async_log_timedwait(&async_progress, 100000);
+    }
+    pthread_mutex_unlock(&async_lock);
+    __atomic_sub_fetch(&async_waiters, 1, __ATOMIC_SEQ_CST);
+}
+
+/*
+ * Only the forking thread survives a fork(): write out what is queued
+ * beforehand, and let the child start its own writer when it next logs.
+ */
+static void
+async_log_prepare(void)
+{
+    netsnmp_async_log_flush();
+}
+
+static void
+async_log_child(void)
+{
+    pthread_mutex_init(&async_lock, NULL);
+    pthread_cond_init(&async_wake, NULL);
+    pthread_cond_init(&async_progress, NULL);
+    async_running = 0;
+    async_sleeping = 0;
+    async_waiters = 0;
+}
+
+static void
+async_log_atexit(void)
+{
+    netsnmp_async_log_flush();
+}
+
+/*
+ * Create the ring and start the writer thread, if not done yet.
+ * Returns 1 when the writer is running.
+ */
+static int
+async_log_start(void)
+{
+    sigset_t        all, old;
+    size_t          size, i;
+    int             len;
+
+    pthread_mutex_lock(&async_lock);
+    if (!async_ring) {
+        len = netsnmp_ds_get_int(NETSNMP_DS_LIBRARY_ID,
+                                 NETSNMP_DS_LIB_LOG_ASYNC_QUEUE);
+        if (len <= 0)
+            len = ASYNC_LOG_QUEUE_LENGTH;
+        for (size = 2; size < (size_t)len; size <<= 1)
+            ;
+        async_ring = (struct async_log_record *)
+            calloc(size, sizeof(struct async_log_record));
+        if (async_ring) {
+            for (i = 0; i < size; i++)
+                async_ring[i].seq = i;
+            async_mask = size - 1;
+            async_head = async_tail = 0;
+        }
+    }
+    if (async_ring && !async_hooked) {
+        pthread_atfork(async_log_prepare, NULL, async_log_child);
+        atexit(async_log_atexit);
+        async_hooked = 1;
+    }
+    if (async_ring && !async_running) {
+        /*
+         * Signals are for the main thread: keep the writer out of the way.
+         */
+        sigfillset(&all);
+        pthread_sigmask(SIG_SETMASK, &all, &old);
+        async_stop = 0;
+        if (pthread_create(&async_thread, NULL, async_log_writer, NULL) == 0)
+            __atomic_store_n(&async_running, 1, __ATOMIC_RELEASE);
+        pthread_sigmask(SIG_SETMASK, &old, NULL);
+    }
+    pthread_mutex_unlock(&async_lock);
+    return async_running;
+}
+
+static void
+async_log_stop(void)
+{
+    if (!__atomic_load_n(&async_running, __ATOMIC_ACQUIRE))
+        return;
+    pthread_mutex_lock(&async_lock);
+    async_stop = 1;
+    pthread_cond_signal(&async_wake);
+    pthread_mutex_unlock(&async_lock);
+    pthread_join(async_thread, NULL);
+    __atomic_store_n(&async_running, 0, __ATOMIC_RELEASE);
+}
+
+static int
+async_log_enqueue(netsnmp_log_handler *logh, int pri, const char *str)
+{
+    struct async_log_record *rec;
+    size_t          pos, seq;
+    char           *msg;
+
+    msg = strdup(str);
+    if (!msg)
+        return 0;
+
+    pos = __atomic_load_n(&async_head, __ATOMIC_RELAXED);
+    for (;;) {
+        rec = &async_ring[pos & async_mask];
+        seq = __atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE);
+        if (seq == pos) {
+            if (__atomic_compare_exchange_n(&async_head, &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED))
+                break;
+        } else if ((intptr_t)(seq - pos) < 0) {
+            /*
+             * Full: the slot still holds the record from one lap ago.
+             */
+            if (!netsnmp_ds_get_boolean(NETSNMP_DS_LIBRARY_ID,
+                                        NETSNMP_DS_LIB_LOG_ASYNC_BLOCK) ||
+                !__atomic_load_n(&async_running, __ATOMIC_ACQUIRE)) {
+                __atomic_add_fetch(&async_dropped, 1, __ATOMIC_RELAXED);
+                free(msg);
+                return 1;
+            }
+            async_log_wait(pos - async_mask);
+            pos = __atomic_load_n(&async_head, __ATOMIC_RELAXED);
+        } else {
+            pos = __atomic_load_n(&async_head, __ATOMIC_RELAXED);
+        }
+    }
+    rec->logh = logh;
+    rec->pri = pri;
+    rec->msg = msg;
+    __atomic_store_n(&rec->seq, pos + 1, __ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(&async_sleeping, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&async_lock);
+        pthread_cond_signal(&async_wake);
+        pthread_mutex_unlock(&async_lock);
+    }
+    return 1;
+}
+
+static int
+log_handler_async(netsnmp_log_handler *logh, int pri, const char *str)
+{
+    NetsnmpLogHandler *output;
+
+    if (__atomic_load_n(&async_running, __ATOMIC_ACQUIRE) ||
+        async_log_start())
+        return async_log_enqueue(logh, pri, str);
+
+    /*
+     * No writer thread: log synchronously instead.
+     */
+    output = async_log_output_handler(logh->type);
+    return output ? output(logh, pri, str) : 0;
+}
+#endif /* NETSNMP_ASYNC_LOGGING */
+
+/**
+ * Make a (stdio, file or syslog) log handler asynchronous: its messages
+ * are queued and written by a separate thread, so that the caller of
+ * snmp_log() does not wait for the output.
+ *
+ * @return 1 on success, 0 when the handler type or the platform does
+ *         not support asynchronous logging.
+ */
+int
+netsnmp_loghandler_set_async(netsnmp_log_handler *logh)
+{
+#ifdef NETSNMP_ASYNC_LOGGING
+    if (!logh || !async_log_output_handler(logh->type))
+        return 0;
+    logh->handler = log_handler_async;
+    return 1;
+#else
+    return 0;
+#endif /* NETSNMP_ASYNC_LOGGING */
+}
+
+/**
+ * Wait until the messages queued for asynchronous log handlers so far
+ * have been written.
+ */
+void
+netsnmp_async_log_flush(void)
+{
+#ifdef NETSNMP_ASYNC_LOGGING
+    if (__atomic_load_n(&async_running, __ATOMIC_ACQUIRE))
+        async_log_wait(__atomic_load_n(&async_head, __ATOMIC_SEQ_CST));
+#endif /* NETSNMP_ASYNC_LOGGING */
+}
+
+/**
+ * @return the number of messages dropped because the asynchronous log
+ *         queue was full.
+ */
+u_long
+netsnmp_async_log_dropped(void)
+{
+#ifdef NETSNMP_ASYNC_LOGGING
+    return __atomic_load_n(&async_dropped, __ATOMIC_RELAXED);
+#else
+    return 0;
+#endif /* NETSNMP_ASYNC_LOGGING */
+}
+
 void
 snmp_log_string(int priority, const char *str)
 {
@@ -0,0 +1,999 @@
+/*
+ * snmp_poller.c
+ *
+ * An engine for polling many SNMPv1/SNMPv2c agents at once.  All targets
+ * share one UDP socket; responses are matched to requests by request id
+ * (and checked against the address the request was sent to), so a
+ * target costs a small structure instead of a session, a socket and a
+ * slot in select().
+ *
+ * Requests are queued per target and sent as the limits allow: a
+ * maximum number of requests outstanding per target and in total, a
+ * minimum interval between requests to a target and a maximum rate
+ * overall.  Each target has its own retransmission timeout, computed
+ * from the round trip times of its responses as TCP does (RFC 6298).
+ */
+#include <net-snmp/net-snmp-config.h>
+#include <net-snmp/net-snmp-features.h>
+
+#include <stdio.h>
+#include <stddef.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#include <strings.h>
+#endif
+#include <errno.h>
+#include <sys/types.h>
+#ifdef HAVE_NETINET_IN_H
+#include <netinet/in.h>
+#endif
+#ifdef TIME_WITH_SYS_TIME
+# include <sys/time.h>
+# include <time.h>
+#else
+# ifdef HAVE_SYS_TIME_H
+#  include <sys/time.h>
+# else
+#  include <time.h>
+# endif
+#endif
+#ifdef HAVE_SYS_SELECT_H
+#include <sys/select.h>
+#endif
+
+#include <net-snmp/types.h>
+#include <net-snmp/output_api.h>
+#include <net-snmp/utilities.h>
+#include <net-snmp/library/snmp_api.h>
+#include <net-snmp/library/snmp_transport.h>
+#include <net-snmp/library/snmpSocketBaseDomain.h>
+#include <net-snmp/library/snmpUDPBaseDomain.h>
+#include <net-snmp/library/snmpIPv4BaseDomain.h>
+#include <net-snmp/library/container.h>
+#include <net-snmp/library/container_hash.h>
+#include <net-snmp/library/snmp_poller.h>
+
+netsnmp_feature_child_of(snmp_poller, libnetsnmp);
+netsnmp_feature_require(container_hash);
+
+#ifndef NETSNMP_FEATURE_REMOVE_SNMP_POLLER
+
+#define POLLER_DEFAULT_TIMEOUT          1000000L
+#define POLLER_DEFAULT_RETRIES          3
+#define POLLER_DEFAULT_MIN_TIMEOUT      10000L
+#define POLLER_DEFAULT_MAX_TIMEOUT      10000000L
+#define POLLER_DEFAULT_MAX_OUTSTANDING  1000
+#define POLLER_READ_BATCH               64
+#define POLLER_PACKET_SIZE              65536
+
+/*
+ * an entry of a timer heap, embedded in requests and targets
+ */
+typedef struct poller_timer_s {
+    struct timeval  when;
+    int             index;          /* in the heap, -1 when not in it */
+} poller_timer;
+
+typedef struct poller_heap_s {
+    poller_timer  **entries;
+    int             count, size;
+} poller_heap;
+
+typedef struct poller_request_s {
+    long            reqid;          /* hash key; must be first */
+    poller_timer    timer;          /* expiry */
+    netsnmp_poller_target *target;
+    netsnmp_pdu    *pdu;
+    netsnmp_poller_callback *callback;
+    void           *magic;
+    struct timeval  sent;
+    int             retries;
+    struct poller_request_s *next;  /* target queue */
+} poller_request;
+
+#define REQUEST_OF_TIMER(t) \
+    ((poller_request *) ((char *) (t) - offsetof(poller_request, timer)))
+#define TARGET_OF_TIMER(t) \
+    ((netsnmp_poller_target *) \
+     ((char *) (t) - offsetof(struct netsnmp_poller_target_s, timer)))
+
+struct netsnmp_poller_target_s {
+    poller_timer    timer;          /* next send allowed */
+    netsnmp_poller *poller;
+    char           *name;
+    netsnmp_indexed_addr_pair addr;
+    long            version;
+    u_char         *community;
+    size_t          community_len;
+    void           *data;
+
+    int             max_outstanding, outstanding;
+    long            min_interval;
+    struct timeval  next_send;
+
+    long            srtt, rttvar, rto;  /* microseconds, srtt 0: unknown */
+
+    poller_request *queue, *queue_tail;
+    int             runnable;           /* on the run queue */
+    netsnmp_poller_target *next_run;
+    netsnmp_poller_target *next;        /* all targets */
+};
+
+struct netsnmp_poller_s {
+    netsnmp_transport *transport;
+    netsnmp_session session;            /* for building and parsing */
+    u_char         *obuf, *ibuf;
+    size_t          obuf_size;
+
+    long            timeout, min_timeout, max_timeout;
+    int             retries;
+    int             max_outstanding, outstanding, queued;
+    int             max_rate;
+    double          tokens;
+    struct timeval  last_refill;
+
+    netsnmp_container *requests;        /* outstanding, by reqid */
+    poller_heap     expiries;           /* outstanding, by expiry */
+    poller_heap     wakeups;            /* targets waiting to send */
+    netsnmp_poller_target *run, *run_tail;
+    netsnmp_poller_target *targets;
+
+    netsnmp_poller_stats stats;
+};
+
+/*
+ * ---------------------------------------------------------------------
+ * timer heap
+ */
+static void
+_heap_set(poller_heap *heap, int i, poller_timer *t)
+{
+    heap->entries[i] = t;
+    t->index = i;
+}
+
+static void
+_heap_up(poller_heap *heap, int i)
+{
+    poller_timer   *t = heap->entries[i];
+
+    while (i > 0) {
+        int             parent = (i - 1) / 2;
+
+        if (!timercmp(&t->when, &heap->entries[parent]->when, <))
+            break;
+        _heap_set(heap, i, heap->entries[parent]);
+        i = parent;
+    }
+    _heap_set(heap, i, t);
+}
+
+static void
+_heap_down(poller_heap *heap, int i)
+{
+    poller_timer   *t = heap->entries[i];
+
+    for (;;) {
+        int             child = 2 * i + 1;
+
+        if (child >= heap->count)
+            break;
+        if (child + 1 < heap->count &&
+            timercmp(&heap->entries[child + 1]->when,
+                     &heap->entries[child]->when, <))
+            child++;
+        if (!timercmp(&heap->entries[child]->when, &t->when, <))
+            break;
+        _heap_set(heap, i, heap->entries[child]);
+        i = child;
+    }
+    _heap_set(heap, i, t);
+}
+
+static int
+_heap_insert(poller_heap *heap, poller_timer *t)
+{
+    if (heap->count == heap->size) {
+        int             size = heap->size ? 2 * heap->size : 64;
+        poller_timer  **entries;
+
+        entries = realloc(heap->entries, size * sizeof(*entries));
+        if (NULL == entries)
+            return -1;
+        heap->entries = entries;
+        heap->size = size;
+    }
+    heap->entries[heap->count] = t;
+    t->index = heap->count++;
+    _heap_up(heap, t->index);
+    return 0;
+}
+
+static void
+_heap_remove(poller_heap *heap, poller_timer *t)
+{
+    poller_timer   *moved;
+    int             i = t->index;
+
+    if (i < 0)
+        return;
+    t->index = -1;
+    if (i == --heap->count)
+        return;
+    moved = heap->entries[heap->count];
+    _heap_set(heap, i, moved);
+    _heap_down(heap, i);
+    _heap_up(heap, moved->index);
+}
+
+static poller_timer *
+_heap_top(poller_heap *heap)
+{
+    return heap->count ? heap->entries[0] : NULL;
+}
+
+/*
+ * ---------------------------------------------------------------------
+ * helpers
+ */
+static void
+_tv_add(struct timeval *res, const struct timeval *tv, long usec)
+{
+    struct timeval  delta;
+
+    delta.tv_sec = usec / 1000000L;
+    delta.tv_usec = usec % 1000000L;
+    NETSNMP_TIMERADD(tv, &delta, res);
+}
+
+static long
+_tv_usec_since(const struct timeval *now, const struct timeval *then)
+{
+    struct timeval  diff;
+
+    NETSNMP_TIMERSUB(now, then, &diff);
+    return diff.tv_sec * 1000000L + diff.tv_usec;
+}
+
+/*
+ * put a target with queued requests and room to send on the run queue,
+ * or on the wakeup heap if it has to wait before sending
+ */
+static void
+_target_schedule(netsnmp_poller_target *target, const struct timeval *now)
+{
+    netsnmp_poller *poller = target->poller;
+
+    if (target->runnable || target->timer.index >= 0 ||
+        NULL == target->queue ||
+        target->outstanding >= target->max_outstanding)
+        return;
+
+    if (timercmp(now, &target->next_send, <)) {
+        target->timer.when = target->next_send;
+        if (_heap_insert(&poller->wakeups, &target->timer) == 0)
+            return;
+        /* fall back to polling the run queue */
+    }
+    target->runnable = 1;
+    target->next_run = NULL;
+    if (poller->run_tail)
+        poller->run_tail->next_run = target;
+    else
+        poller->run = target;
+    poller->run_tail = target;
+}
+
+static void
+_request_free(poller_request *request)
+{
+    snmp_free_pdu(request->pdu);
+    free(request);
+}
+
+/*
+ * a request got its answer or gave up: make room for the next one
+ */
+static void
+_request_done(poller_request *request, const struct timeval *now)
+{
+    netsnmp_poller_target *target = request->target;
+    netsnmp_poller *poller = target->poller;
+
+    _heap_remove(&poller->expiries, &request->timer);
+    CONTAINER_REMOVE(poller->requests, request);
+    target->outstanding--;
+    poller->outstanding--;
+    _request_free(request);
+    _target_schedule(target, now);
+}
+
+/*
+ * encode and send a request; returns 0 on success
+ */
+static int
+_request_transmit(netsnmp_poller *poller, poller_request *request)
+{
+    netsnmp_poller_target *target = request->target;
+    void           *opaque = &target->addr;
+    int             olength = sizeof(target->addr);
+    size_t          offset = 0, length;
+    u_char         *packet;
+    int             rc;
+
+#ifdef NETSNMP_USE_REVERSE_ASNENCODING
+    rc = snmp_build(&poller->obuf, &poller->obuf_size, &offset,
+                    &poller->session, request->pdu);
+    packet = poller->obuf + poller->obuf_size - offset;
+    length = offset;
+#else
+    length = poller->obuf_size;
+    rc = snmp_build(&poller->obuf, &length, &offset, &poller->session,
+                    request->pdu);
+    packet = poller->obuf;
+#endif
+    if (rc < 0) {
+        DEBUGMSGTL(("snmp_poller", "encoding reqid %ld for %s failed\n",
+                    request->reqid, target->name));
+        return -1;
+    }
+
+    rc = netsnmp_transport_send(poller->transport, packet, length,
+                                &opaque, &olength);
+    if (rc < 0 && errno == EAGAIN) {
+        /*
+         * the socket buffer is full: treat it as a lost packet, the
+         * request will be sent again when it times out
+         */
+        DEBUGMSGTL(("snmp_poller", "no buffer space for reqid %ld\n",
+                    request->reqid));
+        return 0;
+    }
+    if (rc < 0) {
+        DEBUGMSGTL(("snmp_poller", "sending reqid %ld to %s failed: %s\n",
+                    request->reqid, target->name, strerror(errno)));
+        return -1;
+    }
+    return 0;
+}
+
+static void
+_request_send(netsnmp_poller *poller, poller_request *request,
+              const struct timeval *now)
+{
+    netsnmp_poller_target *target = request->target;
+
+    target->outstanding++;
+    poller->outstanding++;
+    request->sent = *now;
+    _tv_add(&request->timer.when, now, target->rto);
+
+    if (CONTAINER_INSERT(poller->requests, request) != 0 ||
+        _heap_insert(&poller->expiries, &request->timer) != 0 ||
+        _request_transmit(poller, request) != 0) {
+        poller->stats.send_failures++;
+        if (request->callback)
+            request->callback(NETSNMP_CALLBACK_OP_SEND_FAILED, target,
+                              request->reqid, request->pdu, request->magic);
+        _request_done(request, now);
+        return;
+    }
+    poller->stats.sent++;
+}
+
+static void
+_refill_tokens(netsnmp_poller *poller, const struct timeval *now)
+{
+    if (poller->max_rate <= 0)
+        return;
+    poller->tokens += (double) _tv_usec_since(now, &poller->last_refill) *
+        poller->max_rate / 1000000.0;
+    /* allow bursts of up to a tenth of a second */
+    if (poller->tokens > poller->max_rate / 10.0 + 1)
+        poller->tokens = poller->max_rate / 10.0 + 1;
+    poller->last_refill = *now;
+}
+
+/*
+ * send as many queued requests as the limits allow
+ */
+static void
+_dispatch(netsnmp_poller *poller)
+{
+    netsnmp_poller_target *target;
+    poller_request *request;
+    poller_timer   *t;
+    struct timeval  now;
+
+    netsnmp_get_monotonic_clock(&now);
+
+    while ((t = _heap_top(&poller->wakeups)) &&
+           !timercmp(&now, &t->when, <)) {
+        target = TARGET_OF_TIMER(t);
+        _heap_remove(&poller->wakeups, t);
+        _target_schedule(target, &now);
+    }
+
+    _refill_tokens(poller, &now);
+    while ((target = poller->run) != NULL) {
+        if (poller->max_outstanding &&
+            poller->outstanding >= poller->max_outstanding)
+            break;
+        if (poller->max_rate > 0 && poller->tokens < 1)
+            break;
+
+        poller->run = target->next_run;
+        if (NULL == poller->run)
+            poller->run_tail = NULL;
+        target->runnable = 0;
+
+        request = target->queue;
+        target->queue = request->next;
+        if (NULL == target->queue)
+            target->queue_tail = NULL;
+        poller->queued--;
+
+        if (poller->max_rate > 0)
+            poller->tokens -= 1;
+        _tv_add(&target->next_send, &now, target->min_interval);
+        _request_send(poller, request, &now);
+        _target_schedule(target, &now);
+    }
+}
+
+/*
+ * update the round trip time estimates of a target (RFC 6298)
+ */
+static void
+_target_rtt_sample(netsnmp_poller_target *target, long rtt)
+{
+    netsnmp_poller *poller = target->poller;
+    long            rto;
+
+    if (target->srtt == 0) {
+        target->srtt = rtt ? rtt : 1;
+        target->rttvar = rtt / 2;
+    } else {
+        long            err = target->srtt - rtt;
+
+        if (err < 0)
+            err = -err;
+        target->rttvar = (3 * target->rttvar + err) / 4;
+        target->srtt = (7 * target->srtt + rtt) / 8;
+        if (target->srtt == 0)
+            target->srtt = 1;
+    }
+    rto = target->srtt + 4 * target->rttvar;
+    if (rto < poller->min_timeout)
+        rto = poller->min_timeout;
+    if (rto > poller->max_timeout)
+        rto = poller->max_timeout;
+    target->rto = rto;
+}
+
+/*
+ * the version of a message, without parsing the rest of it
+ */
+static long
+_packet_version(u_char *data, size_t length)
+{
+    u_char          type;
+    long            version = -1;
+
+    data = asn_parse_sequence(data, &length, &type,
+                              (ASN_SEQUENCE | ASN_CONSTRUCTOR), "version");
+    if (data)
+        data = asn_parse_int(data, &length, &type, &version, sizeof(version));
+    if (NULL == data || type != ASN_INTEGER)
+        return -1;
+    return version;
+}
+
+static void
+_process_packet(netsnmp_poller *poller, u_char *packet, int length,
+                void *opaque, int olength, const struct timeval *now)
+{
+    netsnmp_indexed_addr_pair *from = opaque;
+    poller_request *request, key;
+    netsnmp_poller_target *target;
+    netsnmp_pdu    *pdu;
+    long            version;
+
+    version = _packet_version(packet, length);
+    if (version != SNMP_VERSION_1 && version != SNMP_VERSION_2c) {
+        DEBUGMSGTL(("snmp_poller", "dropping packet of version %ld\n",
+                    version));
+        poller->stats.dropped++;
+        SNMP_FREE(opaque);
+        return;
+    }
+
+    pdu = calloc(1, sizeof(netsnmp_pdu));
+    if (NULL == pdu) {
+        SNMP_FREE(opaque);
+        return;
+    }
+    pdu->transport_data = opaque;
+    pdu->transport_data_length = olength;
+    pdu->tDomain = poller->transport->domain;
+    pdu->tDomainLen = poller->transport->domain_length;
+
+    poller->session.version = SNMP_DEFAULT_VERSION;
+    if (snmp_parse(NULL, &poller->session, pdu, packet, length) != 0 ||
+        pdu->command != SNMP_MSG_RESPONSE) {
+        DEBUGMSGTL(("snmp_poller", "dropping unparsable packet\n"));
+        poller->stats.dropped++;
+        snmp_free_pdu(pdu);
+        return;
+    }
+
+    key.reqid = pdu->reqid;
+    request = CONTAINER_FIND(poller->requests, &key);
+    if (NULL == request) {
+        DEBUGMSGTL(("snmp_poller", "dropping response to unknown reqid %ld\n",
+                    pdu->reqid));
+        poller->stats.dropped++;
+        snmp_free_pdu(pdu);
+        return;
+    }
+    target = request->target;
+
+    /*
+     * request ids are only unique per socket, so the source has to match
+     * too or one agent could answer for another
+     */
+    if (NULL == from || olength != sizeof(*from) ||
+        from->remote_addr.sin.sin_addr.s_addr !=
+        target->addr.remote_addr.sin.sin_addr.s_addr ||
+        from->remote_addr.sin.sin_port != target->addr.remote_addr.sin.sin_port ||
+        pdu->version != target->version) {
+        DEBUGMSGTL(("snmp_poller", "dropping response to reqid %ld from "
+                    "wrong source\n", pdu->reqid));
+        poller->stats.dropped++;
+        snmp_free_pdu(pdu);
+        return;
+    }
+
+    /*
+     * the round trip time of a retransmitted request is ambiguous
+     */
+    if (0 == request->retries)
+        _target_rtt_sample(target, _tv_usec_since(now, &request->sent));
+
+    poller->stats.responses++;
+    if (request->callback)
+        request->callback(NETSNMP_CALLBACK_OP_RECEIVED_MESSAGE, target,
+                          request->reqid, pdu, request->magic);
+    snmp_free_pdu(pdu);
+    _request_done(request, now);
+}
+
+/*
+ * ---------------------------------------------------------------------
+ * API
+ */
+netsnmp_poller *
+netsnmp_poller_create(const char *local)
+{
+    netsnmp_poller *poller;
+
+    poller = calloc(1, sizeof(*poller));
+    if (NULL == poller)
+        return NULL;
+
+    poller->transport = netsnmp_transport_open_server("snmp_poller",
+                                                      local ? local :
+                                                      "udp:0.0.0.0:0");
+    if (NULL == poller->transport) {
+        snmp_log(LOG_ERR, "snmp_poller: can't open %s\n",
+                 local ? local : "a UDP socket");
+        free(poller);
+        return NULL;
+    }
+    if (snmp_oid_compare(poller->transport->domain,
+                         poller->transport->domain_length,
+                         netsnmpUDPDomain, netsnmpUDPDomain_len) != 0) {
+        snmp_log(LOG_ERR, "snmp_poller: %s is not a UDP/IPv4 endpoint\n",
+                 local);
+        netsnmp_transport_free(poller->transport);
+        free(poller);
+        return NULL;
+    }
+    netsnmp_set_non_blocking_mode(poller->transport->sock, TRUE);
+
+    snmp_sess_init(&poller->session);
+    poller->obuf_size = 2048;
+    poller->obuf = malloc(poller->obuf_size);
+    poller->ibuf = malloc(POLLER_PACKET_SIZE);
+    poller->requests = netsnmp_container_get_hash();
+    if (NULL == poller->obuf || NULL == poller->ibuf ||
+        NULL == poller->requests) {
+        netsnmp_poller_free(poller);
+        return NULL;
+    }
+    poller->requests->compare = netsnmp_compare_long;
+    poller->requests->container_name = strdup("snmp_poller requests");
+
+    poller->timeout = POLLER_DEFAULT_TIMEOUT;
+    poller->retries = POLLER_DEFAULT_RETRIES;
+    poller->min_timeout = POLLER_DEFAULT_MIN_TIMEOUT;
+    poller->max_timeout = POLLER_DEFAULT_MAX_TIMEOUT;
+    poller->max_outstanding = POLLER_DEFAULT_MAX_OUTSTANDING;
+    netsnmp_get_monotonic_clock(&poller->last_refill);
+
+    return poller;
+}
+
+void
+netsnmp_poller_free(netsnmp_poller *poller)
+{
+    netsnmp_poller_target *target;
+    poller_request *request;
+    int             i;
+
+    if (NULL == poller)
+        return;
+
+    for (i = 0; i < poller->expiries.count; i++)
+        _request_free(REQUEST_OF_TIMER(poller->expiries.entries[i]));
+    while ((target = poller->targets) != NULL) {
+        poller->targets = target->next;
+        while ((request = target->queue) != NULL) {
+            target->queue = request->next;
+            _request_free(request);
+        }
+        free(target->name);
+        free(target->community);
+        free(target);
+    }
+    if (poller->requests) {
+        CONTAINER_CLEAR(poller->requests, NULL, NULL);
+        CONTAINER_FREE(poller->requests);
+    }
+    free(poller->expiries.entries);
+    free(poller->wakeups.entries);
+    free(poller->obuf);
+    free(poller->ibuf);
+    if (poller->transport) {
+        netsnmp_transport_free(poller->transport);
+    }
+    free(poller);
+}
+
+void
+netsnmp_poller_set_timeout(netsnmp_poller *poller, long timeout,
+                           int retries, long min_timeout, long max_timeout)
+{
+    if (timeout > 0)
+        poller->timeout = timeout;
+    if (retries >= 0)
+        poller->retries = retries;
+    if (min_timeout > 0)
+        poller->min_timeout = min_timeout;
+    if (max_timeout > 0)
+        poller->max_timeout = max_timeout;
+    if (poller->max_timeout < poller->min_timeout)
+        poller->max_timeout = poller->min_timeout;
+}
+
+void
+netsnmp_poller_set_limits(netsnmp_poller *poller, int max_outstanding,
+                          int max_rate)
+{
+    poller->max_outstanding = max_outstanding > 0 ? max_outstanding : 0;
+    poller->max_rate = max_rate > 0 ? max_rate : 0;
+    poller->tokens = 1;
+    netsnmp_get_monotonic_clock(&poller->last_refill);
+}
+
+netsnmp_poller_target *
+netsnmp_poller_add_target(netsnmp_poller *poller, const char *peername,
+                          long version, const u_char *community,
+                          size_t community_len)
+{
+    netsnmp_poller_target *target;
+
+    if (version != SNMP_VERSION_1 && version != SNMP_VERSION_2c) {
+        snmp_log(LOG_ERR, "snmp_poller: %s: only SNMPv1 and SNMPv2c are "
+                 "supported\n", peername);
+        return NULL;
+    }
+
+    if (strncmp(peername, "udp:", 4) == 0)
+        peername += 4;
+
+    target = calloc(1, sizeof(*target));
+    if (NULL == target)
+        return NULL;
+    if (!netsnmp_sockaddr_in2(&target->addr.remote_addr.sin, peername,
+                              NULL)) {
+        snmp_log(LOG_ERR, "snmp_poller: can't resolve %s\n", peername);
+        free(target);
+        return NULL;
+    }
+    target->name = strdup(peername);
+    if (community_len)
+        target->community = netsnmp_memdup(community, community_len);
+    if (NULL == target->name ||
+        (community_len && NULL == target->community)) {
+        free(target->name);
+        free(target);
+        return NULL;
+    }
+    target->community_len = community_len;
+    target->poller = poller;
+    target->version = version;
+    target->max_outstanding = 1;
+    target->rto = poller->timeout;
+    target->timer.index = -1;
+
+    target->next = poller->targets;
+    poller->targets = target;
+    return target;
+}
+
+void
+netsnmp_poller_target_set_limits(netsnmp_poller_target *target,
+                                 int max_outstanding, long min_interval)
+{
+    target->max_outstanding = max_outstanding > 0 ? max_outstanding : 1;
+    target->min_interval = min_interval > 0 ? min_interval : 0;
+}
+
+const char *
+netsnmp_poller_target_name(netsnmp_poller_target *target)
+{
+    return target->name;
+}
+
+void *
+netsnmp_poller_target_get_data(netsnmp_poller_target *target)
+{
+    return target->data;
+}
+
+void
+netsnmp_poller_target_set_data(netsnmp_poller_target *target, void *data)
+{
+    target->data = data;
+}
+
+int
+netsnmp_poller_send(netsnmp_poller *poller, netsnmp_poller_target *target,
+                    netsnmp_pdu *pdu, netsnmp_poller_callback *callback,
+                    void *magic)
+{
+    poller_request *request, key;
+    struct timeval  now;
+    long            reqid;
+
+    if (NULL == poller || NULL == target || NULL == pdu)
+        return 0;
+
+    /*
+     * a request id still in use would make the responses ambiguous
+     */
+    key.reqid = pdu->reqid;
+    if (CONTAINER_FIND(poller->requests, &key)) {
+        DEBUGMSGTL(("snmp_poller", "reqid %ld is already outstanding\n",
+                    pdu->reqid));
+        return 0;
+    }
+
+    request = calloc(1, sizeof(*request));
+    if (NULL == request)
+        return 0;
+
+    pdu->version = target->version;
+    if (target->community_len && 0 == pdu->community_len) {
+        pdu->community = netsnmp_memdup(target->community,
+                                        target->community_len);
+        if (NULL == pdu->community) {
+            free(request);
+            return 0;
+        }
+        pdu->community_len = target->community_len;
+    }
+    pdu->flags |= UCD_MSG_FLAG_EXPECT_RESPONSE;
+
+    request->timer.index = -1;
+    request->reqid = pdu->reqid;
+    request->target = target;
+    request->pdu = pdu;
+    request->callback = callback;
+    request->magic = magic;
+
+    if (target->queue_tail)
+        target->queue_tail->next = request;
+    else
+        target->queue = request;
+    target->queue_tail = request;
+    poller->queued++;
+
+    /* the request may be gone once dispatched */
+    reqid = request->reqid;
+    netsnmp_get_monotonic_clock(&now);
+    _target_schedule(target, &now);
+    _dispatch(poller);
+
+    /* see snmp_async_send(); 0 is reserved for errors */
+    return reqid ? reqid : 1;
+}
+
+int
+netsnmp_poller_select_info(netsnmp_poller *poller, int *numfds,
+                           fd_set *fdset, struct timeval *timeout,
+                           int *block)
+{
+    struct timeval  now, next = { 0, 0 }, delta;
+    poller_timer   *t;
+    int             have_next = 0;
+
+    if (0 == poller->outstanding && 0 == poller->queued)
+        return 0;
+
+    if (poller->outstanding) {
+        FD_SET(poller->transport->sock, fdset);
+        if (poller->transport->sock >= *numfds)
+            *numfds = poller->transport->sock + 1;
+    }
+
+    /*
+     * wake up for the first expiry, a target allowed to send again or,
+     * when requests wait for rate tokens, the next token
+     */
+    if ((t = _heap_top(&poller->expiries)) != NULL) {
+        next = t->when;
+        have_next = 1;
+    }
+    if ((t = _heap_top(&poller->wakeups)) != NULL &&
+        (!have_next || timercmp(&t->when, &next, <))) {
+        next = t->when;
+        have_next = 1;
+    }
+    netsnmp_get_monotonic_clock(&now);
+    if (poller->run) {
+        struct timeval  token = now;
+
+        if (poller->max_rate > 0 && poller->tokens < 1 &&
+            !(poller->max_outstanding &&
+              poller->outstanding >= poller->max_outstanding))
+            _tv_add(&token, &now, 1000000L / poller->max_rate + 1);
+        if (!poller->max_outstanding ||
+            poller->outstanding < poller->max_outstanding) {
+            if (!have_next || timercmp(&token, &next, <))
+                next = token;
+            have_next = 1;
+        }
+    }
+    if (!have_next)
+        return poller->outstanding + poller->queued;
+
+    if (timercmp(&next, &now, <))
+        next = now;
+    NETSNMP_TIMERSUB(&next, &now, &delta);
+    if (*block || timercmp(&delta, timeout, <)) {
+        *timeout = delta;
+        *block = 0;
+    }
+    return poller->outstanding + poller->queued;
+}
+
+void
+netsnmp_poller_read(netsnmp_poller *poller, fd_set *fdset)
+{
+    netsnmp_transport *transport = poller->transport;
+    struct timeval  now;
+    void           *opaque;
+    int             olength, length, i;
+
+    if (!FD_ISSET(transport->sock, fdset))
+        return;
+
+    for (i = 0; i < POLLER_READ_BATCH; i++) {
+        opaque = NULL;
+        olength = 0;
+        length = transport->f_recv(transport, poller->ibuf,
+                                   POLLER_PACKET_SIZE, &opaque, &olength);
+        if (length <= 0) {
+            SNMP_FREE(opaque);
+            break;
+        }
+        netsnmp_get_monotonic_clock(&now);
+        _process_packet(poller, poller->ibuf, length, opaque, olength, &now);
+    }
+    _dispatch(poller);
+}
+
+void
+netsnmp_poller_timeout(netsnmp_poller *poller)
+{
+    poller_request *request;
+    netsnmp_poller_target *target;
+    poller_timer   *t;
+    struct timeval  now;
+
+    netsnmp_get_monotonic_clock(&now);
+    while ((t = _heap_top(&poller->expiries)) &&
+           !timercmp(&now, &t->when, <)) {
+        request = REQUEST_OF_TIMER(t);
+        target = request->target;
+
+        /*
+         * back off, as the estimate was clearly too short
+         */
+        target->rto *= 2;
+        if (target->rto > poller->max_timeout)
+            target->rto = poller->max_timeout;
+
+        if (request->retries < poller->retries) {
+            request->retries++;
+            poller->stats.retries++;
+            _heap_remove(&poller->expiries, t);
+            request->sent = now;
+            _tv_add(&t->when, &now, target->rto);
+            _heap_insert(&poller->expiries, t);
+            if (_request_transmit(poller, request) == 0)
+                continue;
+            poller->stats.send_failures++;
+            if (request->callback)
+                request->callback(NETSNMP_CALLBACK_OP_SEND_FAILED, target,
+                                  request->reqid, request->pdu,
+                                  request->magic);
+        } else {
+            DEBUGMSGTL(("snmp_poller", "reqid %ld to %s timed out\n",
+                        request->reqid, target->name));
+            poller->stats.timeouts++;
+            if (request->callback)
+                request->callback(NETSNMP_CALLBACK_OP_TIMED_OUT, target,
+                                  request->reqid, request->pdu,
+                                  request->magic);
+        }
+        _request_done(request, &now);
+    }
+    _dispatch(poller);
+}
+
+int
+netsnmp_poller_run(netsnmp_poller *poller)
+{
+    fd_set          fdset;
+    struct timeval  timeout;
+    int             numfds, block, count;
+
+    for (;;) {
+        numfds = 0;
+        block = 1;
+        FD_ZERO(&fdset);
+        timerclear(&timeout);
+        if (netsnmp_poller_select_info(poller, &numfds, &fdset, &timeout,
+                                       &block) == 0)
+            break;
+        count = select(numfds, &fdset, NULL, NULL, block ? NULL : &timeout);
+        if (count > 0)
+            netsnmp_poller_read(poller, &fdset);
+        else if (count < 0 && errno != EINTR) {
+            snmp_log_perror("snmp_poller: select");
+            return -1;
+        }
+        /*
+         * a steady stream of responses must not hold up expiries
+         */
+        netsnmp_poller_timeout(poller);
+    }
+    return 0;
+}
+
+const netsnmp_poller_stats *
+netsnmp_poller_get_stats(netsnmp_poller *poller)
+{
+    return &poller->stats;
+}
+
+#else  /* !NETSNMP_FEATURE_REMOVE_SNMP_POLLER */
+netsnmp_feature_unused(snmp_poller);
+#endif /* !NETSNMP_FEATURE_REMOVE_SNMP_POLLER */
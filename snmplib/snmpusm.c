@@ -56,6 +56,13 @@
 #ifdef HAVE_UNISTD_H
 #include <unistd.h>
 #endif
+#ifdef HAVE_SYS_WAIT_H
+#include <sys/wait.h>
+#endif
+#ifdef HAVE_SYS_SELECT_H
+#include <sys/select.h>
+#endif
+#include <errno.h>
 
 #include <net-snmp/types.h>
 #include <net-snmp/output_api.h>
@@ -101,6 +108,8 @@ struct usmStateReference {
     u_char         *usr_priv_key;
     size_t          usr_priv_key_length;
     u_int           usr_sec_level;
+    netsnmp_sc_ctx *usr_auth_ctx;       /* shared with the usmUser */
+    netsnmp_sc_ctx *usr_priv_ctx;
 };
 
 const oid usmNoAuthProtocol[10] = { NETSNMP_USMAUTH_BASE_OID,
@@ -234,6 +243,8 @@ static struct usmUser *noNameUser = NULL;
  */
 static struct usmUser *userList = NULL;
 
+static void     usm_create_queued_users(void);
+
 /*
  * Set a given field of the secStateRef.
  *
@@ -337,6 +348,8 @@ usm_free_usmStateReference(void *old)
         SNMP_ZERO(ref->usr_priv_key, ref->usr_priv_key_length);
         SNMP_FREE(ref->usr_priv_key);
     }
+    sc_ctx_free(&ref->usr_auth_ctx);
+    sc_ctx_free(&ref->usr_priv_ctx);
 
     SNMP_FREE(ref);
 }                               /* end usm_free_usmStateReference() */
@@ -431,6 +444,8 @@ usm_clone_usmStateReference(struct usmStateReference *from,
         *to = NULL;
         return -1;
     }
+    cloned_usmStateRef->usr_auth_ctx = sc_ctx_ref(&from->usr_auth_ctx);
+    cloned_usmStateRef->usr_priv_ctx = sc_ctx_ref(&from->usr_priv_ctx);
 
     return 0;
 
@@ -775,6 +790,9 @@ usm_free_user(struct usmUser *user)
         SNMP_FREE(user->privKeyKu);
     }
 
+    sc_ctx_free(&user->authCtx);
+    sc_ctx_free(&user->privCtx);
+
 #ifdef NETSNMP_USE_OPENSSL
     if (user->usmDHUserAuthKeyChange)
     {
@@ -1503,6 +1521,8 @@ usm_generate_out_msg(int msgProcModel,  /* (UNUSED) */
     int             theSecLevel = 0;    /* No defined const for bad
                                          * value (other then err).
                                          */
+    netsnmp_sc_ctx **theAuthCtx = NULL;
+    netsnmp_sc_ctx **thePrivCtx = NULL;
 
     DEBUGMSGTL(("usm", "USM processing has begun.\n"));
 
@@ -1510,7 +1530,8 @@ usm_generate_out_msg(int msgProcModel,  /* (UNUSED) */
         /*
          * To hush the compiler for now.  XXX 
          */
-        const struct usmStateReference *ref = secStateRef;
+        struct usmStateReference *ref =
+            NETSNMP_REMOVE_CONST(struct usmStateReference *, secStateRef);
 
         theName = ref->usr_name;
         theNameLength = ref->usr_name_length;
@@ -1531,6 +1552,8 @@ usm_generate_out_msg(int msgProcModel,  /* (UNUSED) */
         thePrivKey = ref->usr_priv_key;
         thePrivKeyLength = ref->usr_priv_key_length;
         theSecLevel = ref->usr_sec_level;
+        theAuthCtx = &ref->usr_auth_ctx;
+        thePrivCtx = &ref->usr_priv_ctx;
     }
 
     /*
@@ -1567,6 +1590,8 @@ usm_generate_out_msg(int msgProcModel,  /* (UNUSED) */
             thePrivProtocolLength = user->privProtocolLen;
             thePrivKey = user->privKey;
             thePrivKeyLength = user->privKeyLen;
+            theAuthCtx = &user->authCtx;
+            thePrivCtx = &user->privCtx;
         } else {
             /*
              * unknown users can not do authentication (obviously) 
@@ -1696,11 +1721,12 @@ usm_generate_out_msg(int msgProcModel,  /* (UNUSED) */
         }
 #endif
 
-        if (sc_encrypt(thePrivProtocol, thePrivProtocolLength,
-                       thePrivKey, thePrivKeyLength,
-                       salt, salt_length,
-                       scopedPdu, scopedPduLen,
-                       &ptr[dataOffset], &encrypted_length)
+        if (sc_encrypt_ctx(thePrivCtx,
+                           thePrivProtocol, thePrivProtocolLength,
+                           thePrivKey, thePrivKeyLength,
+                           salt, salt_length,
+                           scopedPdu, scopedPduLen,
+                           &ptr[dataOffset], &encrypted_length)
             != SNMP_ERR_NOERROR) {
             DEBUGMSGTL(("usm", "encryption error.\n"));
             return SNMPERR_USM_ENCRYPTIONERROR;
@@ -1868,9 +1894,10 @@ usm_generate_out_msg(int msgProcModel,  /* (UNUSED) */
             return SNMPERR_USM_GENERICERROR;
         }
 
-        if (sc_generate_keyed_hash(theAuthProtocol, theAuthProtocolLength,
-                                   theAuthKey, theAuthKeyLength,
-                                   ptr, ptr_len, temp_sig, &temp_sig_len)
+        if (sc_generate_keyed_hash_ctx(theAuthCtx,
+                                       theAuthProtocol, theAuthProtocolLength,
+                                       theAuthKey, theAuthKeyLength,
+                                       ptr, ptr_len, temp_sig, &temp_sig_len)
             != SNMP_ERR_NOERROR) {
             /*
              * FIX temp_sig_len defined?!
@@ -2000,6 +2027,8 @@ usm_rgenerate_out_msg(int msgProcModel, /* (UNUSED) */
     u_int           thePrivProtocolLength = 0;
     int             theSecLevel = 0;    /* No defined const for bad
                                          * value (other then err). */
+    netsnmp_sc_ctx **theAuthCtx = NULL;
+    netsnmp_sc_ctx **thePrivCtx = NULL;
     size_t          salt_length = 0, save_salt_length = 0;
     u_char          salt[BYTESIZE(USM_MAX_SALT_LENGTH)];
     u_char          authParams[USM_MAX_AUTHSIZE];
@@ -2013,7 +2042,8 @@ usm_rgenerate_out_msg(int msgProcModel, /* (UNUSED) */
         /*
          * To hush the compiler for now.  XXX 
          */
-        const struct usmStateReference *ref = secStateRef;
+        struct usmStateReference *ref =
+            NETSNMP_REMOVE_CONST(struct usmStateReference *, secStateRef);
 
         theName = ref->usr_name;
         theNameLength = ref->usr_name_length;
@@ -2034,6 +2064,8 @@ usm_rgenerate_out_msg(int msgProcModel, /* (UNUSED) */
         thePrivKey = ref->usr_priv_key;
         thePrivKeyLength = ref->usr_priv_key_length;
         theSecLevel = ref->usr_sec_level;
+        theAuthCtx = &ref->usr_auth_ctx;
+        thePrivCtx = &ref->usr_priv_ctx;
     }
 
     /*
@@ -2070,6 +2102,8 @@ usm_rgenerate_out_msg(int msgProcModel, /* (UNUSED) */
             thePrivProtocolLength = user->privProtocolLen;
             thePrivKey = user->privKey;
             thePrivKeyLength = user->privKeyLen;
+            theAuthCtx = &user->authCtx;
+            thePrivCtx = &user->privCtx;
         } else {
             /*
              * unknown users can not do authentication (obviously) 
@@ -2180,11 +2214,12 @@ usm_rgenerate_out_msg(int msgProcModel, /* (UNUSED) */
         }
 #endif
 
-        if (sc_encrypt(thePrivProtocol, thePrivProtocolLength,
-                       thePrivKey, thePrivKeyLength,
-                       salt, salt_length,
-                       scopedPdu, scopedPduLen,
-                       ciphertext, &ciphertextlen) != SNMP_ERR_NOERROR) {
+        if (sc_encrypt_ctx(thePrivCtx,
+                           thePrivProtocol, thePrivProtocolLength,
+                           thePrivKey, thePrivKeyLength,
+                           salt, salt_length,
+                           scopedPdu, scopedPduLen,
+                           ciphertext, &ciphertextlen) != SNMP_ERR_NOERROR) {
             DEBUGMSGTL(("usm", "encryption error.\n"));
             SNMP_FREE(ciphertext);
             return SNMPERR_USM_ENCRYPTIONERROR;
@@ -2395,10 +2430,11 @@ usm_rgenerate_out_msg(int msgProcModel, /* (UNUSED) */
             return SNMPERR_USM_GENERICERROR;
         }
 
-        if (sc_generate_keyed_hash(theAuthProtocol, theAuthProtocolLength,
-                                   theAuthKey, theAuthKeyLength,
-                                   proto_msg, proto_msg_len,
-                                   temp_sig, &temp_sig_len)
+        if (sc_generate_keyed_hash_ctx(theAuthCtx,
+                                       theAuthProtocol, theAuthProtocolLength,
+                                       theAuthKey, theAuthKeyLength,
+                                       proto_msg, proto_msg_len,
+                                       temp_sig, &temp_sig_len)
             != SNMP_ERR_NOERROR) {
             SNMP_FREE(temp_sig);
             DEBUGMSGTL(("usm", "Signing failed.\n"));
@@ -3135,10 +3171,11 @@ usm_process_in_msg(int msgProcModel,    /* (UNUSED) */
      */
     if (secLevel == SNMP_SEC_LEVEL_AUTHNOPRIV
         || secLevel == SNMP_SEC_LEVEL_AUTHPRIV) {
-        if (sc_check_keyed_hash(user->authProtocol, user->authProtocolLen,
-                                user->authKey, user->authKeyLen,
-                                wholeMsg, wholeMsgLen,
-                                signature, signature_length)
+        if (sc_check_keyed_hash_ctx(&user->authCtx,
+                                    user->authProtocol, user->authProtocolLen,
+                                    user->authKey, user->authKeyLen,
+                                    wholeMsg, wholeMsgLen,
+                                    signature, signature_length)
             != SNMP_ERR_NOERROR) {
             DEBUGMSGTL(("usm", "Verification failed.\n"));
             snmp_increment_statistic(STAT_USMSTATSWRONGDIGESTS);
@@ -3303,10 +3340,11 @@ usm_process_in_msg(int msgProcModel,    /* (UNUSED) */
             dump_chunk("usm/dump", "IV + Encrypted form:", iv, iv_length);
         }
 #endif
-        if (sc_decrypt(user->privProtocol, user->privProtocolLen,
-                       user->privKey, user->privKeyLen,
-                       iv, iv_length,
-                       value_ptr, remaining, *scopedPdu, scopedPduLen)
+        if (sc_decrypt_ctx(&user->privCtx,
+                           user->privProtocol, user->privProtocolLen,
+                           user->privKey, user->privKeyLen,
+                           iv, iv_length,
+                           value_ptr, remaining, *scopedPdu, scopedPduLen)
             != SNMP_ERR_NOERROR) {
             DEBUGMSGTL(("usm", "%s\n", "Failed decryption."));
             snmp_increment_statistic(STAT_USMSTATSDECRYPTIONERRORS);
@@ -3338,6 +3376,13 @@ usm_process_in_msg(int msgProcModel,    /* (UNUSED) */
      */
     *maxSizeResponse = maxMsgSize - (end_of_overhead - wholeMsg);
 
+    /*
+     * Let the response re-use the user's keyed transforms.
+     */
+    sc_ctx_free(&(*secStateRef)->usr_auth_ctx);
+    sc_ctx_free(&(*secStateRef)->usr_priv_ctx);
+    (*secStateRef)->usr_auth_ctx = sc_ctx_ref(&user->authCtx);
+    (*secStateRef)->usr_priv_ctx = sc_ctx_ref(&user->privCtx);
 
     DEBUGMSGTL(("usm", "USM processing completed.\n"));
 
@@ -4419,6 +4464,7 @@ usm_parse_config_usmUser(const char *token, char *line)
 {
     struct usmUser *uptr;
 
+    usm_create_queued_users();
     uptr = usm_read_user(line);
     if ( uptr)
         usm_add_user(uptr);
@@ -4453,6 +4499,7 @@ usm_set_password(const char *token, char *line)
     size_t          engineIDLen = 0;
     struct usmUser *user;
 
+    usm_create_queued_users();
     cp = copy_nword(line, nameBuf, sizeof(nameBuf));
     if (cp == NULL) {
         config_perror("invalid name specifier");
@@ -4621,6 +4668,605 @@ usm_set_user_password(struct usmUser *user, const char *token, char *line)
     }
 }                               /* end usm_set_password() */
 
+/*
+ * Keys for createUser pass phrases.
+ *
+ * Turning a pass phrase into a key hashes a megabyte of data, which adds
+ * up when the configuration creates many users.  While the configuration
+ * files are being read, createUser lines are therefore only queued.
+ * Once they have all been read (or a line which refers to existing users
+ * turns up) the keys the queued users need are derived, each one once,
+ * and then the users are created in their original order.  The agent
+ * can ask for the keys to be derived by worker processes in parallel
+ * (see usm_set_create_user_workers()).
+ *
+ * Derived keys are kept in memory, indexed by a hash of the pass phrase,
+ * authentication type and engineID with a per-process salt, so that a
+ * pass phrase used for both authentication and privacy, or by several
+ * users, and users whose line hasn't changed when the configuration is
+ * read again, need no further derivation.  The cache is never saved: any
+ * index that can be checked without deriving the key would make guessing
+ * the pass phrase from the saved file far cheaper than the derivation.
+ */
+#define USM_KEY_CACHE_MAX   64          /* the longest (SHA-512) key */
+#define USM_KEY_CACHE_SALT  16
+#define USM_KEY_WORKERS_MAX 16
+
+typedef struct usm_queued_user_s {
+    char           *line;
+    char           *filename;
+    unsigned int    lineno;
+    u_char         *engineID;
+    size_t          engineIDLen;
+    struct usm_queued_user_s *next;
+} usm_queued_user;
+
+typedef struct usm_cached_key_s {
+    /*
+     * the hex fingerprint must come first: it is the container key
+     */
+    char            fingerprint[2 * USM_KEY_CACHE_MAX + 1];
+    u_char          kul[USM_KEY_CACHE_MAX];
+    size_t          kulLen;
+    int             used;
+    /*
+     * what the key is derived from, until it has been
+     */
+    int             authType;
+    u_char         *engineID;
+    size_t          engineIDLen;
+    char           *pass;
+} usm_cached_key;
+
+static struct usmUser *usm_create_usmUser_from_string(char *line,
+                                                      const u_char *engineID,
+                                                      size_t engineIDLen,
+                                                      const char **errorMsg);
+
+static usm_queued_user *usm_queued_users = NULL;
+static usm_queued_user **usm_queued_users_tail = &usm_queued_users;
+static int      usm_queue_create_user = 0;
+static int      usm_collecting_keys = 0;
+static int      usm_key_workers = 0;    /* 0 or 1: derive in-process */
+static netsnmp_container *usm_key_cache = NULL;
+static u_char   usm_key_cache_salt[USM_KEY_CACHE_SALT];
+static size_t   usm_key_cache_salt_len = 0;
+
+static netsnmp_container *
+usm_get_key_cache(void)
+{
+    if (NULL == usm_key_cache) {
+        usm_key_cache = netsnmp_container_find("usm_key_cache:hash:"
+                                               "binary_array");
+        if (NULL == usm_key_cache) {
+            snmp_log(LOG_ERR, "couldn't create the usm key cache\n");
+            return NULL;
+        }
+        usm_key_cache->compare = netsnmp_compare_direct_cstring;
+        usm_key_cache->container_name = strdup("usm_key_cache");
+    }
+    return usm_key_cache;
+}
+
+static void
+usm_forget_key_source(usm_cached_key *ck)
+{
+    if (ck->pass) {
+        memset(ck->pass, 0, strlen(ck->pass));
+        SNMP_FREE(ck->pass);
+    }
+    SNMP_FREE(ck->engineID);
+    ck->engineIDLen = 0;
+}
+
+static void
+usm_free_cached_key(void *data, void *context)
+{
+    usm_cached_key *ck = (usm_cached_key *) data;
+
+    usm_forget_key_source(ck);
+    memset(ck, 0, sizeof(*ck));
+    free(ck);
+}
+
+/*
+ * the hex encoded, salted hash identifying a pass phrase for an
+ * authentication type and engineID
+ */
+static int
+usm_key_fingerprint(int authType, const u_char *engineID,
+                    size_t engineIDLen, const char *pass, char *fingerprint)
+{
+    u_char          buf[SNMP_MAXBUF_SMALL], hash[USM_KEY_CACHE_MAX];
+    size_t          len = 0, hashLen = sizeof(hash), passLen = strlen(pass);
+    size_t          i;
+    int             rc;
+
+    if (0 == usm_key_cache_salt_len) {
+        usm_key_cache_salt_len = sizeof(usm_key_cache_salt);
+        if (sc_random(usm_key_cache_salt, &usm_key_cache_salt_len) !=
+            SNMPERR_SUCCESS) {
+            usm_key_cache_salt_len = 0;
+            return SNMPERR_GENERR;
+        }
+    }
+    if (usm_key_cache_salt_len + 2 + engineIDLen + passLen > sizeof(buf) ||
+        engineIDLen > 255)
+        return SNMPERR_GENERR;
+
+    memcpy(buf, usm_key_cache_salt, usm_key_cache_salt_len);
+    len = usm_key_cache_salt_len;
+    buf[len++] = (u_char) authType;
+    buf[len++] = (u_char) engineIDLen;
+    memcpy(buf + len, engineID, engineIDLen);
+    len += engineIDLen;
+    memcpy(buf + len, pass, passLen);
+    len += passLen;
+
+#ifdef HAVE_EVP_SHA384
+    rc = sc_hash_type(NETSNMP_USMAUTH_HMAC384SHA512, buf, len, hash, &hashLen);
+#else
+    rc = sc_hash_type(NETSNMP_USMAUTH_HMACSHA1, buf, len, hash, &hashLen);
+#endif
+    memset(buf, 0, len);
+    if (rc != SNMPERR_SUCCESS)
+        return rc;
+
+    for (i = 0; i < hashLen; i++)
+        sprintf(fingerprint + 2 * i, "%02x", hash[i]);
+    return SNMPERR_SUCCESS;
+}
+
+/*
+ * derive the localized key for a pass phrase.
+ */
+static int
+usm_derive_cached_key(usm_cached_key *ck)
+{
+    u_char          Ku[SNMP_MAXBUF_SMALL];
+    size_t          KuLen = sizeof(Ku), authProtocolLen;
+    const oid      *authProtocol;
+    int             rc;
+
+    authProtocol = sc_get_auth_oid(ck->authType, &authProtocolLen);
+    if (NULL == authProtocol)
+        return SNMPERR_GENERR;
+
+    rc = generate_Ku(authProtocol, authProtocolLen, (u_char *) ck->pass,
+                     strlen(ck->pass), Ku, &KuLen);
+    if (rc == SNMPERR_SUCCESS) {
+        ck->kulLen = sizeof(ck->kul);
+        rc = generate_kul(authProtocol, authProtocolLen, ck->engineID,
+                          ck->engineIDLen, Ku, KuLen, ck->kul, &ck->kulLen);
+        if (rc != SNMPERR_SUCCESS)
+            ck->kulLen = 0;
+    }
+    memset(Ku, 0, sizeof(Ku));
+    return rc;
+}
+
+/*
+ * turn a pass phrase for USER into a localized key, using the key cache.
+ *
+ * While collecting the keys queued users need, nothing is derived: the
+ * pass phrase is noted in the cache and a dummy key is returned.
+ */
+static int
+usm_password_to_kul(struct usmUser *user, const char *pass,
+                    u_char *kul, size_t *kulLen)
+{
+    netsnmp_container *cache = usm_get_key_cache();
+    usm_cached_key  key, *ck = NULL;
+    int             authType, len, rc;
+
+    authType = sc_get_authtype(user->authProtocol, user->authProtocolLen);
+    if (cache &&
+        usm_key_fingerprint(authType, user->engineID, user->engineIDLen,
+                            pass, key.fingerprint) == SNMPERR_SUCCESS) {
+        ck = CONTAINER_FIND(cache, &key);
+        if (ck && ck->kulLen) {
+            if (ck->kulLen > *kulLen)
+                return SNMPERR_GENERR;
+            memcpy(kul, ck->kul, ck->kulLen);
+            *kulLen = ck->kulLen;
+            ck->used = 1;
+            if (!usm_collecting_keys)
+                DEBUGMSGTL(("usm:keycache", "using the cached key for %s\n",
+                            user->secName));
+            return SNMPERR_SUCCESS;
+        }
+        if (NULL == ck && strlen(pass) >= USM_LENGTH_P_MIN) {
+            ck = SNMP_MALLOC_TYPEDEF(usm_cached_key);
+            if (ck) {
+                strcpy(ck->fingerprint, key.fingerprint);
+                if (CONTAINER_INSERT(cache, ck) != 0)
+                    SNMP_FREE(ck);
+            }
+        }
+    }
+
+    if (usm_collecting_keys) {
+        len = sc_get_proper_auth_length_bytype(authType);
+        if (len <= 0 || (size_t) len > *kulLen)
+            return SNMPERR_GENERR;
+        if (ck && NULL == ck->pass) {
+            ck->authType = authType;
+            ck->engineID = netsnmp_memdup(user->engineID, user->engineIDLen);
+            ck->engineIDLen = user->engineIDLen;
+            ck->pass = strdup(pass);
+        }
+        memset(kul, 0, len);
+        *kulLen = len;
+        return SNMPERR_SUCCESS;
+    }
+
+    {
+        u_char          Ku[SNMP_MAXBUF_SMALL];
+        size_t          KuLen = sizeof(Ku);
+
+        rc = generate_Ku(user->authProtocol, user->authProtocolLen,
+                         (const u_char *) pass, strlen(pass), Ku, &KuLen);
+        if (rc == SNMPERR_SUCCESS)
+            rc = generate_kul(user->authProtocol, user->authProtocolLen,
+                              user->engineID, user->engineIDLen,
+                              Ku, KuLen, kul, kulLen);
+        memset(Ku, 0, sizeof(Ku));
+    }
+    if (rc == SNMPERR_SUCCESS && ck && *kulLen <= sizeof(ck->kul)) {
+        memcpy(ck->kul, kul, *kulLen);
+        ck->kulLen = *kulLen;
+        ck->used = 1;
+    }
+    return rc;
+}
+
+#if defined(HAVE_FORK) && defined(HAVE_SYS_WAIT_H)
+/*
+ * derive the keys for JOBS in WORKERS child processes, which report
+ * back through pipes.  Jobs without a result are left for the caller.
+ */
+static void
+usm_derive_keys_in_workers(usm_cached_key **jobs, int njobs, int workers)
+{
+    struct usm_key_result {
+        u_int           job;
+        u_int           kulLen;
+        u_char          kul[USM_KEY_CACHE_MAX];
+    }               result;
+    struct usm_key_worker {
+        pid_t           pid;
+        int             fd;
+        size_t          have;
+        struct usm_key_result result;
+    }              *w;
+    int             i, j, running = 0, pfd[2], fdmax, status;
+    fd_set          readfds;
+    ssize_t         n;
+
+    w = calloc(workers, sizeof(*w));
+    if (NULL == w)
+        return;
+
+    for (i = 0; i < workers; i++) {
+        w[i].pid = -1;
+        w[i].fd = -1;
+        if (pipe(pfd) < 0) {
+            snmp_log_perror("usm key derivation: pipe");
+            break;
+        }
+        w[i].pid = fork();
+        if (w[i].pid == 0) {
+            close(pfd[0]);
+            for (j = 0; j < i; j++)
+                if (w[j].fd >= 0)
+                    close(w[j].fd);
+            for (j = i; j < njobs; j += workers) {
+                memset(&result, 0, sizeof(result));
+                result.job = j;
+                if (usm_derive_cached_key(jobs[j]) == SNMPERR_SUCCESS) {
+                    result.kulLen = jobs[j]->kulLen;
+                    memcpy(result.kul, jobs[j]->kul, jobs[j]->kulLen);
+                }
+                for (n = 0; n < (ssize_t) sizeof(result); ) {
+                    ssize_t rc = write(pfd[1], (char *) &result + n,
+                                       sizeof(result) - n);
+                    if (rc < 0 && errno == EINTR)
+                        continue;
+                    if (rc <= 0)
+                        _exit(1);
+                    n += rc;
+                }
+            }
+            memset(&result, 0, sizeof(result));
+            _exit(0);
+        }
+        close(pfd[1]);
+        if (w[i].pid < 0) {
+            snmp_log_perror("usm key derivation: fork");
+            close(pfd[0]);
+            break;
+        }
+        w[i].fd = pfd[0];
+        running++;
+    }
+    DEBUGMSGTL(("usm:keycache", "deriving %d keys in %d processes\n",
+                njobs, running));
+
+    while (running) {
+        FD_ZERO(&readfds);
+        fdmax = -1;
+        for (i = 0; i < workers; i++) {
+            if (w[i].fd < 0)
+                continue;
+            FD_SET(w[i].fd, &readfds);
+            if (w[i].fd > fdmax)
+                fdmax = w[i].fd;
+        }
+        if (select(fdmax + 1, &readfds, NULL, NULL, NULL) < 0) {
+            if (errno == EINTR)
+                continue;
+            snmp_log_perror("usm key derivation: select");
+            break;
+        }
+        for (i = 0; i < workers; i++) {
+            if (w[i].fd < 0 || !FD_ISSET(w[i].fd, &readfds))
+                continue;
+            n = read(w[i].fd, (char *) &w[i].result + w[i].have,
+                     sizeof(w[i].result) - w[i].have);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0) {
+                close(w[i].fd);
+                w[i].fd = -1;
+                running--;
+                continue;
+            }
+            w[i].have += n;
+            if (w[i].have < sizeof(w[i].result))
+                continue;
+            w[i].have = 0;
+            j = w[i].result.job;
+            if (j < njobs && j % workers == i && w[i].result.kulLen &&
+                w[i].result.kulLen <= sizeof(jobs[j]->kul)) {
+                memcpy(jobs[j]->kul, w[i].result.kul, w[i].result.kulLen);
+                jobs[j]->kulLen = w[i].result.kulLen;
+            }
+        }
+    }
+
+    for (i = 0; i < workers; i++) {
+        if (w[i].fd >= 0)
+            close(w[i].fd);
+        if (w[i].pid > 0)
+            while (waitpid(w[i].pid, &status, 0) < 0 && errno == EINTR)
+                ;
+    }
+    memset(w, 0, workers * sizeof(*w));
+    free(w);
+}
+#endif /* HAVE_FORK && HAVE_SYS_WAIT_H */
+
+static void
+usm_add_key_job(void *data, void *context)
+{
+    usm_cached_key *ck = (usm_cached_key *) data;
+    netsnmp_void_array *jobs = (netsnmp_void_array *) context;
+
+    if (ck->pass && 0 == ck->kulLen)
+        jobs->array[jobs->size++] = ck;
+}
+
+/*
+ * derive the keys noted while collecting
+ */
+static void
+usm_derive_pending_keys(void)
+{
+    netsnmp_void_array jobs;
+    int             i, workers = usm_key_workers;
+
+    if (NULL == usm_key_cache || 0 == CONTAINER_SIZE(usm_key_cache))
+        return;
+    jobs.size = 0;
+    jobs.array = calloc(CONTAINER_SIZE(usm_key_cache), sizeof(void *));
+    if (NULL == jobs.array)
+        return;
+    CONTAINER_FOR_EACH(usm_key_cache, usm_add_key_job, &jobs);
+
+    if (workers > USM_KEY_WORKERS_MAX)
+        workers = USM_KEY_WORKERS_MAX;
+    if (workers > (int) jobs.size)
+        workers = jobs.size;
+#if defined(HAVE_FORK) && defined(HAVE_SYS_WAIT_H)
+    if (workers > 1)
+        usm_derive_keys_in_workers((usm_cached_key **) jobs.array,
+                                   jobs.size, workers);
+#endif
+
+    /*
+     * keys the workers didn't derive (and errors, which are reported
+     * when the user is created) are left for the second pass
+     */
+    for (i = 0; i < (int) jobs.size; i++)
+        usm_forget_key_source((usm_cached_key *) jobs.array[i]);
+    free(jobs.array);
+}
+
+static void
+usm_queue_user(char *line)
+{
+    usm_queued_user *q = SNMP_MALLOC_TYPEDEF(usm_queued_user);
+    const char     *filename;
+    size_t          len;
+
+    if (NULL == q || NULL == (q->line = strdup(line))) {
+        SNMP_FREE(q);
+        config_perror("malloc failure queueing user");
+        return;
+    }
+    netsnmp_config_get_location(&filename, &q->lineno);
+    q->filename = strdup(filename ? filename : "");
+    /*
+     * the engineID in effect now, not when the user is finally created
+     */
+    q->engineID = snmpv3_generate_engineID(&len);
+    q->engineIDLen = len;
+    *usm_queued_users_tail = q;
+    usm_queued_users_tail = &q->next;
+}
+
+static void
+usm_free_queued_user(usm_queued_user *q)
+{
+    memset(q->line, 0, strlen(q->line));
+    free(q->line);
+    free(q->filename);
+    free(q->engineID);
+    free(q);
+}
+
+/*
+ * create the users queued while reading the configuration
+ */
+static void
+usm_create_queued_users(void)
+{
+    usm_queued_user *queue = usm_queued_users, *q;
+    const char     *error, *filename;
+    unsigned int    lineno;
+    char            buf[SNMP_MAXBUF_SMALL], *line;
+
+    if (NULL == queue)
+        return;
+    usm_queued_users = NULL;
+    usm_queued_users_tail = &usm_queued_users;
+
+    /*
+     * first pass: find the keys which aren't known yet, and derive them
+     * all in one go.  users keeping their master key (-M) derive it
+     * themselves later on.
+     */
+    usm_collecting_keys = 1;
+    for (q = queue; q; q = q->next) {
+        copy_nword(q->line, buf, sizeof(buf));
+        if (strcmp(buf, "-M") == 0 || NULL == (line = strdup(q->line)))
+            continue;
+        usm_create_usmUser_from_string(line, q->engineID, q->engineIDLen,
+                                       &error);
+        memset(line, 0, strlen(line));
+        free(line);
+    }
+    usm_collecting_keys = 0;
+    usm_derive_pending_keys();
+
+    /*
+     * second pass: create the users, with errors reported against the
+     * original lines
+     */
+    netsnmp_config_get_location(&filename, &lineno);
+    while ((q = queue)) {
+        queue = q->next;
+        netsnmp_config_set_location(q->filename, q->lineno);
+        usm_create_usmUser_from_string(q->line, q->engineID,
+                                       q->engineIDLen, &error);
+        if (error)
+            config_perror(error);
+        usm_free_queued_user(q);
+    }
+    netsnmp_config_set_location(filename, lineno);
+}
+
+static void
+usm_unuse_cached_key(void *data, void *context)
+{
+    ((usm_cached_key *) data)->used = 0;
+}
+
+static void
+usm_add_unused_key(void *data, void *context)
+{
+    usm_cached_key *ck = (usm_cached_key *) data;
+    netsnmp_void_array *unused = (netsnmp_void_array *) context;
+
+    if (!ck->used)
+        unused->array[unused->size++] = ck;
+}
+
+/*
+ * forget the keys the configuration no longer uses
+ */
+static void
+usm_prune_key_cache(void)
+{
+    netsnmp_void_array unused;
+    size_t          i;
+
+    if (NULL == usm_key_cache || 0 == CONTAINER_SIZE(usm_key_cache))
+        return;
+    unused.size = 0;
+    unused.array = calloc(CONTAINER_SIZE(usm_key_cache), sizeof(void *));
+    if (NULL == unused.array)
+        return;
+    CONTAINER_FOR_EACH(usm_key_cache, usm_add_unused_key, &unused);
+    for (i = 0; i < unused.size; i++) {
+        CONTAINER_REMOVE(usm_key_cache, unused.array[i]);
+        usm_free_cached_key(unused.array[i], NULL);
+    }
+    free(unused.array);
+}
+
+static int
+usm_start_queueing_users(int majorID, int minorID, void *serverarg,
+                         void *clientarg)
+{
+    usm_queue_create_user = 1;
+    if (usm_key_cache)
+        CONTAINER_FOR_EACH(usm_key_cache, usm_unuse_cached_key, NULL);
+    return SNMPERR_SUCCESS;
+}
+
+static int
+usm_stop_queueing_users(int majorID, int minorID, void *serverarg,
+                        void *clientarg)
+{
+    usm_create_queued_users();
+    usm_queue_create_user = 0;
+    usm_prune_key_cache();
+    return SNMPERR_SUCCESS;
+}
+
+/*
+ * Derive the keys for queued createUser lines in WORKERS processes in
+ * parallel; 0 or 1 (the default) derives them in-process.  Forking is
+ * left to applications which know it is safe, i.e. the agent.
+ */
+void
+usm_set_create_user_workers(int workers)
+{
+    usm_key_workers = workers;
+}
+
+static int
+usm_free_key_cache(int majorID, int minorID, void *serverarg,
+                   void *clientarg)
+{
+    usm_queued_user *q;
+
+    while ((q = usm_queued_users)) {
+        usm_queued_users = q->next;
+        usm_free_queued_user(q);
+    }
+    usm_queued_users_tail = &usm_queued_users;
+    if (usm_key_cache) {
+        CONTAINER_CLEAR(usm_key_cache, usm_free_cached_key, NULL);
+        CONTAINER_FREE(usm_key_cache);
+        usm_key_cache = NULL;
+    }
+    memset(usm_key_cache_salt, 0, sizeof(usm_key_cache_salt));
+    usm_key_cache_salt_len = 0;
+    return SNMPERR_SUCCESS;
+}
+
 /*
  * create a usm user from a string.
  *
@@ -4634,7 +5280,8 @@ usm_set_user_password(struct usmUser *user, const char *token, char *line)
  *    freed.
  */
 static struct usmUser *
-usm_create_usmUser_from_string(char *line, const char **errorMsg)
+usm_create_usmUser_from_string(char *line, const u_char *engineID,
+                               size_t engineIDLen, const char **errorMsg)
 {
     char           *cp;
     const char     *dummy;
@@ -4644,7 +5291,7 @@ usm_create_usmUser_from_string(char *line, const char **errorMsg)
     size_t          userKeyLen = SNMP_MAXBUF_SMALL;
     size_t          privKeySize;
     size_t          ret;
-    int             ret2, properLen, properPrivKeyLen;
+    int             ret2, properLen, properPrivKeyLen, localized = 0;
     const oid      *def_auth_prot, *def_priv_prot;
     size_t          def_auth_prot_len, def_priv_prot_len;
     const netsnmp_priv_alg_info *pai;
@@ -4708,6 +5355,13 @@ usm_create_usmUser_from_string(char *line, const char **errorMsg)
         newuser->engineID = ebuf;
         newuser->engineIDLen = eout_len;
         cp = copy_nword(cp, buf, sizeof(buf));
+    } else if (engineID) {
+        newuser->engineID = netsnmp_memdup(engineID, engineIDLen);
+        if (newuser->engineID == NULL) {
+            *errorMsg = "malloc failure copying the engineID";
+            goto fail;
+        }
+        newuser->engineIDLen = engineIDLen;
     } else {
         newuser->engineID = snmpv3_generate_engineID(&ret);
         if (ret == 0) {
@@ -4809,8 +5463,15 @@ usm_create_usmUser_from_string(char *line, const char **errorMsg)
     } else if (strcmp(buf,"-l") != 0) {
         /* a password is specified */
         userKeyLen = sizeof(userKey);
-        ret2 = generate_Ku(newuser->authProtocol, newuser->authProtocolLen,
-                          (u_char *) buf, strlen(buf), userKey, &userKeyLen);
+        if (newuser->flags & USMUSER_FLAG_KEEP_MASTER_KEY)
+            ret2 = generate_Ku(newuser->authProtocol,
+                               newuser->authProtocolLen, (u_char *) buf,
+                               strlen(buf), userKey, &userKeyLen);
+        else {
+            /* straight to the localized key, which may be cached */
+            ret2 = usm_password_to_kul(newuser, buf, userKey, &userKeyLen);
+            localized = 1;
+        }
         if (ret2 != SNMPERR_SUCCESS) {
             *errorMsg = "could not generate the authentication key from the supplied pass phrase.";
             goto fail;
@@ -4848,6 +5509,13 @@ usm_create_usmUser_from_string(char *line, const char **errorMsg)
             *errorMsg = "improper key length to -l";
             goto fail;
         }
+    } else if (localized) {
+        if (userKeyLen > newuser->authKeyLen) {
+            *errorMsg = "could not generate localized authentication key (Kul) from the master key (Ku).";
+            goto fail;
+        }
+        memcpy(newuser->authKey, userKey, userKeyLen);
+        newuser->authKeyLen = userKeyLen;
     } else {
         ret2 = generate_kul(newuser->authProtocol, newuser->authProtocolLen,
                            newuser->engineID, newuser->engineIDLen,
@@ -4948,7 +5616,8 @@ usm_create_usmUser_from_string(char *line, const char **errorMsg)
         }
     } else {
         cp = copy_nword(cp, buf, sizeof(buf));
-        
+        localized = 0;
+
         if (strcmp(buf,"-m") == 0) {
             /* a master key is specified */
             cp = copy_nword(cp, buf, sizeof(buf));
@@ -4967,8 +5636,15 @@ usm_create_usmUser_from_string(char *line, const char **errorMsg)
         } else if (strcmp(buf,"-l") != 0) {
             /* a password is specified */
             userKeyLen = sizeof(userKey);
-            ret2 = generate_Ku(newuser->authProtocol, newuser->authProtocolLen,
-                              (u_char*)buf, strlen(buf), userKey, &userKeyLen);
+            if (newuser->flags & USMUSER_FLAG_KEEP_MASTER_KEY)
+                ret2 = generate_Ku(newuser->authProtocol,
+                                   newuser->authProtocolLen, (u_char*)buf,
+                                   strlen(buf), userKey, &userKeyLen);
+            else {
+                ret2 = usm_password_to_kul(newuser, buf, userKey,
+                                           &userKeyLen);
+                localized = 1;
+            }
             if (ret2 != SNMPERR_SUCCESS) {
                 *errorMsg = "could not generate the privacy key from the supplied pass phrase.";
                 goto fail;
@@ -4998,6 +5674,13 @@ usm_create_usmUser_from_string(char *line, const char **errorMsg)
                 *errorMsg = "invalid key value argument to -l";
                 goto fail;
             }
+        } else if (localized) {
+            if (userKeyLen > newuser->privKeyLen) {
+                *errorMsg = "could not generate localized privacy key (Kul) from the master key (Ku).";
+                goto fail;
+            }
+            memcpy(newuser->privKey, userKey, userKeyLen);
+            newuser->privKeyLen = userKeyLen;
         } else {
             ret2 = generate_kul(newuser->authProtocol, newuser->authProtocolLen,
                                newuser->engineID, newuser->engineIDLen,
@@ -5032,6 +5715,11 @@ usm_create_usmUser_from_string(char *line, const char **errorMsg)
     }
 
   add:
+    if (usm_collecting_keys) {
+        /* only looking for the keys the user needs */
+        usm_free_user(newuser);
+        return NULL;
+    }
     usm_add_user(newuser);
     DEBUGMSGTL(("usmUser", "created a new user %s at ", newuser->secName));
     DEBUGMSGHEX(("usmUser", newuser->engineID, newuser->engineIDLen));
@@ -5048,7 +5736,12 @@ void
 usm_parse_create_usmUser(const char *token, char *line)
 {
     const char *error = NULL;
-    usm_create_usmUser_from_string(line, &error);
+
+    if (usm_queue_create_user) {
+        usm_queue_user(line);
+        return;
+    }
+    usm_create_usmUser_from_string(line, NULL, 0, &error);
     if (error)
         config_perror(error);
 }
@@ -5106,6 +5799,19 @@ init_usm_conf(const char *app)
                                   usm_parse_create_usmUser, NULL,
                                   "username [-e ENGINEID] (MD5|SHA|SHA-512|SHA-384|SHA-256|SHA-224|default) authpassphrase [(DES|AES|default) [privpassphrase]]");
 
+    /*
+     * createUser lines are queued until all configuration files are read
+     */
+    snmp_register_callback(SNMP_CALLBACK_LIBRARY,
+                           SNMP_CALLBACK_PRE_READ_CONFIG,
+                           usm_start_queueing_users, NULL);
+    netsnmp_register_callback(SNMP_CALLBACK_LIBRARY,
+                              SNMP_CALLBACK_POST_READ_CONFIG,
+                              usm_stop_queueing_users, NULL,
+                              NETSNMP_CALLBACK_HIGHEST_PRIORITY);
+    snmp_register_callback(SNMP_CALLBACK_LIBRARY, SNMP_CALLBACK_SHUTDOWN,
+                           usm_free_key_cache, NULL);
+
     /*
      * we need to be called back later
      */
@@ -22,6 +22,7 @@
 
 netsnmp_feature_require(cert_util);
 netsnmp_feature_require(sockaddr_size);
+netsnmp_feature_require(container_hash);
 
 #include "snmpIPBaseDomain.h"
 #include <net-snmp/library/snmpDTLSUDPDomain.h>
@@ -71,6 +72,7 @@ netsnmp_feature_require(sockaddr_size);
 #include <net-snmp/library/system.h>
 #include <net-snmp/library/tools.h>
 #include <net-snmp/library/callback.h>
+#include <net-snmp/library/container_hash.h>
 
 #include "openssl/bio.h"
 #include "openssl/ssl.h"
@@ -106,19 +108,33 @@ typedef struct bio_cache_s {
    BIO *write_bio; /* OpenSSL will write its outgoing SSL packets to here */
    netsnmp_sockaddr_storage sas;
    u_int flags;
-   struct bio_cache_s *next;
    int msgnum;
    char *write_cache;
    size_t write_cache_len;
    _netsnmpTLSBaseData *tlsdata;
+   /* list of server side handshakes in progress, oldest first */
+   struct bio_cache_s *hs_prev, *hs_next;
+   time_t hs_started;
 } bio_cache;
 
 /** bio_cache flags */
 #define NETSNMP_BIO_HAVE_COOKIE        0x0001 /* verified cookie */
 #define NETSNMP_BIO_CONNECTED          0x0002 /* received decoded data */
 #define NETSNMP_BIO_DISCONNECTED       0x0004 /* peer shutdown */
+#define NETSNMP_BIO_HANDSHAKING        0x0008 /* on the handshake list */
 
-static bio_cache *biocache = NULL;
+/* all connections, indexed by the remote address */
+static netsnmp_container *biocache = NULL;
+
+/* server side handshakes which haven't completed yet */
+static bio_cache *handshakes_head = NULL, *handshakes_tail = NULL;
+static int handshakes_count = 0;
+
+#define NETSNMP_DTLS_MAX_HANDSHAKES       128
+#define NETSNMP_DTLS_HANDSHAKE_TIMEOUT    10
+
+/* shared by all connections we accept; see _dtlsudp_server_ctx() */
+static SSL_CTX *dtls_server_ctx = NULL;
 
 static int openssl_addr_index = 0;
 
@@ -129,67 +145,152 @@ static int netsnmp_dtls_verify_cookie(SSL *ssl,
                                       unsigned int cookie_len);
 static int netsnmp_dtls_gen_cookie(SSL *ssl, unsigned char *cookie,
                                    unsigned int *cookie_len);
+static int _dtlsudp_hello_has_cookie(const netsnmp_sockaddr_storage *peer,
+                                     const u_char *buf, int len);
 #endif
 
-/* this stores remote connections in a list to search through */
-/* XXX: optimize for searching */
+static u_int
+_bio_cache_hash(const void *data)
+{
+    const netsnmp_sockaddr_storage *sas = &((const bio_cache *)data)->sas;
+    const u_char *cp;
+    size_t len;
+    u_int h = 2166136261U;
+
+    switch (sas->sa.sa_family) {
+    case AF_INET:
+        cp = (const u_char *)&sas->sin.sin_addr;
+        len = sizeof(sas->sin.sin_addr);
+        h = (h ^ sas->sin.sin_port) * 16777619U;
+        break;
+#ifdef NETSNMP_TRANSPORT_UDPIPV6_DOMAIN
+    case AF_INET6:
+        cp = (const u_char *)&sas->sin6.sin6_addr;
+        len = sizeof(sas->sin6.sin6_addr);
+        h = (h ^ sas->sin6.sin6_port) * 16777619U;
+        h = (h ^ sas->sin6.sin6_scope_id) * 16777619U;
+        break;
+#endif
+    default:
+        return 0;
+    }
+    while (len--)
+        h = (h ^ *cp++) * 16777619U;
+    return h;
+}
+
+static int
+_bio_cache_compare(const void *lhs, const void *rhs)
+{
+    const netsnmp_sockaddr_storage *l = &((const bio_cache *)lhs)->sas;
+    const netsnmp_sockaddr_storage *r = &((const bio_cache *)rhs)->sas;
+
+    if (l->sa.sa_family != r->sa.sa_family)
+        return l->sa.sa_family < r->sa.sa_family ? -1 : 1;
+
+    switch (l->sa.sa_family) {
+    case AF_INET:
+        if (l->sin.sin_port != r->sin.sin_port)
+            return l->sin.sin_port < r->sin.sin_port ? -1 : 1;
+        return memcmp(&l->sin.sin_addr, &r->sin.sin_addr,
+                      sizeof(l->sin.sin_addr));
+#ifdef NETSNMP_TRANSPORT_UDPIPV6_DOMAIN
+    case AF_INET6:
+        if (l->sin6.sin6_port != r->sin6.sin6_port)
+            return l->sin6.sin6_port < r->sin6.sin6_port ? -1 : 1;
+        if (l->sin6.sin6_scope_id != r->sin6.sin6_scope_id)
+            return l->sin6.sin6_scope_id < r->sin6.sin6_scope_id ? -1 : 1;
+        return memcmp(&l->sin6.sin6_addr, &r->sin6.sin6_addr,
+                      sizeof(l->sin6.sin6_addr));
+#endif
+    }
+    return 0;
+}
+
+static netsnmp_container *
+_bio_cache_container(void)
+{
+    if (NULL == biocache) {
+        biocache = netsnmp_container_get_hash();
+        if (NULL == biocache) {
+            snmp_log(LOG_ERR, "dtlsudp: failed to allocate the peer table\n");
+            return NULL;
+        }
+        biocache->compare = _bio_cache_compare;
+        biocache->container_name = strdup("dtlsudp_peers");
+        netsnmp_container_hash_set_func(biocache, _bio_cache_hash);
+    }
+    return biocache;
+}
+
 /* XXX: handle state issues for new connections to reduce DOS issues */
 /*      (TLS should do this, but openssl can't do more than one ctx per sock */
-/* XXX: put a timer on the cache for expirary purposes */
 static bio_cache *find_bio_cache(const netsnmp_sockaddr_storage *from_addr)
 {
-    bio_cache *cachep = NULL;
-    
-    for (cachep = biocache; cachep; cachep = cachep->next) {
+    bio_cache lookup;
 
-        if (cachep->sas.sa.sa_family != from_addr->sa.sa_family)
-            continue;
+    if (NULL == biocache)
+        return NULL;
 
-        if ((from_addr->sa.sa_family == AF_INET) &&
-            ((cachep->sas.sin.sin_addr.s_addr !=
-              from_addr->sin.sin_addr.s_addr) ||
-             (cachep->sas.sin.sin_port != from_addr->sin.sin_port)))
-                continue;
+    switch (from_addr->sa.sa_family) {
+    case AF_INET:
+        memcpy(&lookup.sas.sin, &from_addr->sin, sizeof(from_addr->sin));
+        break;
 #ifdef NETSNMP_TRANSPORT_UDPIPV6_DOMAIN
-        else if ((from_addr->sa.sa_family == AF_INET6) &&
-                 ((cachep->sas.sin6.sin6_port != from_addr->sin6.sin6_port) ||
-                  (cachep->sas.sin6.sin6_scope_id !=
-                   from_addr->sin6.sin6_scope_id) ||
-                  (memcmp(cachep->sas.sin6.sin6_addr.s6_addr,
-                          from_addr->sin6.sin6_addr.s6_addr,
-                          sizeof(from_addr->sin6.sin6_addr.s6_addr)) != 0)))
-            continue;
-#endif
-        /* found an existing connection */
+    case AF_INET6:
+        memcpy(&lookup.sas.sin6, &from_addr->sin6, sizeof(from_addr->sin6));
         break;
+#endif
+    default:
+        return NULL;
     }
-    return cachep;
+    return CONTAINER_FIND(biocache, &lookup);
+}
+
+static void _handshake_done(bio_cache *cachep)
+{
+    if (!(cachep->flags & NETSNMP_BIO_HANDSHAKING))
+        return;
+
+    if (cachep->hs_prev)
+        cachep->hs_prev->hs_next = cachep->hs_next;
+    else
+        handshakes_head = cachep->hs_next;
+    if (cachep->hs_next)
+        cachep->hs_next->hs_prev = cachep->hs_prev;
+    else
+        handshakes_tail = cachep->hs_prev;
+    cachep->hs_prev = cachep->hs_next = NULL;
+    cachep->flags &= ~NETSNMP_BIO_HANDSHAKING;
+    handshakes_count--;
+}
+
+static void _handshake_start(bio_cache *cachep)
+{
+    struct timeval now;
+
+    netsnmp_get_monotonic_clock(&now);
+    cachep->hs_started = now.tv_sec;
+    cachep->hs_prev = handshakes_tail;
+    cachep->hs_next = NULL;
+    if (handshakes_tail)
+        handshakes_tail->hs_next = cachep;
+    else
+        handshakes_head = cachep;
+    handshakes_tail = cachep;
+    cachep->flags |= NETSNMP_BIO_HANDSHAKING;
+    handshakes_count++;
 }
 
 /* removes a single cache entry and returns SUCCESS on finding and
    removing it. */
 static int remove_bio_cache(bio_cache *thiscache)
 {
-    bio_cache *cachep = NULL, *prevcache = NULL;
-
-    cachep = biocache;
-    while (cachep) {
-        if (cachep == thiscache) {
-
-            /* remove it from the list */
-            if (NULL == prevcache) {
-                /* at the first cache in the list */
-                biocache = thiscache->next;
-            } else {
-                prevcache->next = thiscache->next;
-            }
+    _handshake_done(thiscache);
 
-            return SNMPERR_SUCCESS;
-        }
-        prevcache = cachep;
-        cachep = cachep->next;
-    }
-    return SNMPERR_GENERR;
+    if (NULL == biocache || CONTAINER_REMOVE(biocache, thiscache) != 0)
+        return SNMPERR_GENERR;
+    return SNMPERR_SUCCESS;
 }
 
 /* frees the contents of a bio_cache */
@@ -203,6 +304,7 @@ static void free_bio_cache(bio_cache *cachep)
     DEBUGMSGTL(("9:dtlsudp:bio_cache", "releasing %p\n", cachep));
     SNMP_FREE(cachep->write_cache);
     netsnmp_tlsbase_free_tlsdata(cachep->tlsdata);
+    free(cachep);
 }
 
 static void remove_and_free_bio_cache(bio_cache *cachep)
@@ -212,6 +314,113 @@ static void remove_and_free_bio_cache(bio_cache *cachep)
     free_bio_cache(cachep);
 }
 
+/*
+ * Decide whether a new peer which has returned our cookie may go on
+ * with its handshake.  Handshakes are the expensive part of DTLS, and a
+ * flood of them (a reconnect storm, or peers which never complete them)
+ * would otherwise starve the sessions which are already established.
+ * So only a limited number may be in progress at once; handshakes which
+ * have stalled for too long are given up first, and after that new
+ * peers are dropped until a slot frees up.  The peers retransmit their
+ * ClientHello, so they are served once the storm has passed.  Peers
+ * which haven't returned a cookie don't count, as their addresses may
+ * be forged.
+ */
+static int _dtlsudp_admit_handshake(void)
+{
+    struct timeval now;
+    int max, timeout;
+
+    max = netsnmp_ds_get_int(NETSNMP_DS_LIBRARY_ID,
+                             NETSNMP_DS_LIB_DTLS_MAX_HANDSHAKES);
+    if (max <= 0)
+        max = NETSNMP_DTLS_MAX_HANDSHAKES;
+    timeout = netsnmp_ds_get_int(NETSNMP_DS_LIBRARY_ID,
+                                 NETSNMP_DS_LIB_DTLS_HANDSHAKE_TIMEOUT);
+    if (timeout <= 0)
+        timeout = NETSNMP_DTLS_HANDSHAKE_TIMEOUT;
+
+    netsnmp_get_monotonic_clock(&now);
+    while (handshakes_head &&
+           handshakes_head->hs_started + timeout <= now.tv_sec) {
+        DEBUGMSGTL(("dtlsudp:handshake", "giving up stalled handshake %p\n",
+                    handshakes_head));
+        snmp_increment_statistic(STAT_NSTLSTM_HANDSHAKESEXPIRED);
+        remove_and_free_bio_cache(handshakes_head);
+    }
+
+    if (handshakes_count >= max) {
+        DEBUGMSGTL(("dtlsudp:handshake",
+                    "%d handshakes in progress; dropping a new peer\n",
+                    handshakes_count));
+        snmp_increment_statistic(STAT_NSTLSTM_HANDSHAKESDROPPED);
+        return 0;
+    }
+    return 1;
+}
+
+/*
+ * The server context is set up once and shared by all the connections
+ * we accept, rather than loading the certificates again for every new
+ * peer.  Sharing it is also what lets clients resume their sessions,
+ * since the session cache and the ticket keys live in the context.
+ */
+static SSL_CTX *_dtlsudp_server_ctx(void)
+{
+    if (NULL != dtls_server_ctx)
+        return dtls_server_ctx;
+
+    dtls_server_ctx = sslctx_server_setup(DTLS_method());
+    if (NULL == dtls_server_ctx)
+        return NULL;
+
+#ifdef HAVE_SSL_CTX_SET_COOKIE_GENERATE_CB
+    /* turn on cookie exchange */
+    /* Set DTLS cookie generation and verification callbacks */
+    SSL_CTX_set_cookie_generate_cb(dtls_server_ctx, netsnmp_dtls_gen_cookie);
+    SSL_CTX_set_cookie_verify_cb(dtls_server_ctx, netsnmp_dtls_verify_cookie);
+#endif
+
+    return dtls_server_ctx;
+}
+
+/* new connections pick up changed certificates and settings after the
+   configuration has been (re)read; existing ones keep their reference */
+static int
+_dtlsudp_release_server_ctx(int majorID, int minorID, void *serverarg,
+                            void *clientarg)
+{
+    if (NULL != dtls_server_ctx) {
+        DEBUGMSGTL(("dtlsudp", "releasing the shared server context\n"));
+        SSL_CTX_free(dtls_server_ctx);
+        dtls_server_ctx = NULL;
+    }
+    return SNMPERR_SUCCESS;
+}
+
+static void
+_dtlsudp_peer_string(const netsnmp_sockaddr_storage *sas, char *buf,
+                     size_t buf_len)
+{
+    char addr[64];
+
+    addr[0] = '\0';
+    if (sas->sa.sa_family == AF_INET) {
+        inet_ntop(AF_INET, &sas->sin.sin_addr, addr, sizeof(addr));
+        snprintf(buf, buf_len, "udp:%s:%d", addr, ntohs(sas->sin.sin_port));
+    }
+#ifdef NETSNMP_TRANSPORT_UDPIPV6_DOMAIN
+    else if (sas->sa.sa_family == AF_INET6) {
+        inet_ntop(AF_INET6, &sas->sin6.sin6_addr, addr, sizeof(addr));
+        snprintf(buf, buf_len, "udp6:[%s%%%u]:%d", addr,
+                 (unsigned)sas->sin6.sin6_scope_id,
+                 ntohs(sas->sin6.sin6_port));
+    }
+#endif
+    else
+        snprintf(buf, buf_len, "udp:?");
+}
+
 
 /* XXX: lots of malloc/state cleanup needed */
 #define DIEHERE(msg) do { snmp_log(LOG_ERR, "%s\n", msg); return NULL; } while(0)
@@ -293,8 +502,6 @@ start_new_cached_connection(netsnmp_transport *t,
     }
     
     DEBUGMSGTL(("dtlsudp", "starting a new connection\n"));
-    cachep->next = biocache;
-    biocache = cachep;
 
     if (remote_addr->sa.sa_family == AF_INET)
         memcpy(&cachep->sas.sin, &remote_addr->sin, sizeof(remote_addr->sin));
@@ -302,19 +509,23 @@ start_new_cached_connection(netsnmp_transport *t,
     else if (remote_addr->sa.sa_family == AF_INET6)
         memcpy(&cachep->sas.sin6, &remote_addr->sin6, sizeof(remote_addr->sin6));
 #endif
-    else
+    else {
+        free_bio_cache(cachep);
         DIEHERE("unknown address family");
+    }
 
     /* create caching memory bios for OpenSSL to read and write to */
 
     cachep->read_bio = BIO_new(BIO_s_mem()); /* openssl reads from */
-    if (!cachep->read_bio)
+    if (!cachep->read_bio) {
+        free_bio_cache(cachep);
         DIEHERE("failed to create the openssl read_bio");
+    }
 
     cachep->write_bio = BIO_new(BIO_s_mem()); /* openssl writes to */
     if (!cachep->write_bio) {
         BIO_free(cachep->read_bio);
-        cachep->read_bio = NULL;
+        free_bio_cache(cachep);
         DIEHERE("failed to create the openssl write_bio");
     }
 
@@ -326,35 +537,32 @@ start_new_cached_connection(netsnmp_transport *t,
         DEBUGMSGTL(("dtlsudp",
                     "starting a new connection as a client to sock: %d\n",
                     t->sock));
-        tlsdata->ssl = SSL_new(sslctx_client_setup(DTLS_method(), tlsdata));
-
-        /* XXX: session setting 735 */
+        tlsdata->ssl_context = sslctx_client_setup(DTLS_method(), tlsdata);
+        if (tlsdata->ssl_context)
+            tlsdata->ssl = SSL_new(tlsdata->ssl_context);
+        if (tlsdata->ssl) {
+            char peer[128];
+
+            _dtlsudp_peer_string(&cachep->sas, peer, sizeof(peer));
+            netsnmp_tlsbase_resume_session(tlsdata->ssl, tlsdata, peer);
+        }
     } else {
         /* we're the server */
-        SSL_CTX *ctx = sslctx_server_setup(DTLS_method());
+        SSL_CTX *ctx = _dtlsudp_server_ctx();
         if (!ctx) {
             BIO_free(cachep->read_bio);
             BIO_free(cachep->write_bio);
-            cachep->read_bio = NULL;
-            cachep->write_bio = NULL;
+            free_bio_cache(cachep);
             DIEHERE("failed to create the SSL Context");
         }
 
-#ifdef HAVE_SSL_CTX_SET_COOKIE_GENERATE_CB
-        /* turn on cookie exchange */
-        /* Set DTLS cookie generation and verification callbacks */
-        SSL_CTX_set_cookie_generate_cb(ctx, netsnmp_dtls_gen_cookie);
-        SSL_CTX_set_cookie_verify_cb(ctx, netsnmp_dtls_verify_cookie);
-#endif
-
         tlsdata->ssl = SSL_new(ctx);
     }
 
     if (!tlsdata->ssl) {
         BIO_free(cachep->read_bio);
         BIO_free(cachep->write_bio);
-        cachep->read_bio = NULL;
-        cachep->write_bio = NULL;
+        free_bio_cache(cachep);
         DIEHERE("failed to create the SSL session structure");
     }
         
@@ -413,6 +621,11 @@ start_new_cached_connection(netsnmp_transport *t,
     /* Implementation notes:
        + our sessionID is stored as the transport's data pointer member
     */
+    if (NULL == _bio_cache_container() ||
+        CONTAINER_INSERT(biocache, cachep) != 0) {
+        free_bio_cache(cachep);
+        DIEHERE("failed to remember the new connection");
+    }
     DEBUGMSGT(("9:dtlsudp:bio_cache:created", "%p\n", cachep));
 
     return cachep;
@@ -487,6 +700,24 @@ _find_remote_sockaddr(netsnmp_transport *t, const void *opaque, int olen,
 }
 
 
+/*
+ * Sends a packet to the peer of a connection.  The base transport
+ * expects a whole address pair, so don't hand it the bare sockaddr of
+ * the connection.
+ */
+static int
+_dtlsudp_send_to_peer(netsnmp_transport *t, bio_cache *cachep,
+                      const void *buf, int size)
+{
+    netsnmp_indexed_addr_pair pair;
+    void *opaque = &pair;
+    int olen = sizeof(pair);
+
+    memset(&pair, 0, sizeof(pair));
+    memcpy(&pair.remote_addr, &cachep->sas, sizeof(cachep->sas));
+    return t->base_transport->f_send(t, buf, size, &opaque, &olen);
+}
+
 /*
  * Reads data from our internal openssl outgoing BIO and sends any
  * queued packets out the UDP port
@@ -516,9 +747,12 @@ _netsnmp_send_queued_dtls_pkts(netsnmp_transport *t, bio_cache *cachep)
         sa = NETSNMP_REMOVE_CONST(struct sockaddr *,
                                   _find_remote_sockaddr(t, NULL, 0, &socksize));
         if (NULL == sa)
-            sa = &cachep->sas.sa;
-        socksize = netsnmp_sockaddr_size(sa);
-        rc2 = t->base_transport->f_send(t, outbuf, outsize, &sa, &socksize);
+            rc2 = _dtlsudp_send_to_peer(t, cachep, outbuf, outsize);
+        else {
+            socksize = netsnmp_sockaddr_size(sa);
+            rc2 = t->base_transport->f_send(t, outbuf, outsize, &sa,
+                                            &socksize);
+        }
         if (rc2 == -1) {
             snmp_log(LOG_ERR, "failed to send a DTLS specific packet\n");
         }
@@ -641,6 +875,7 @@ netsnmp_dtlsudp_recv(netsnmp_transport *t, void *buf, int size,
     netsnmp_tmStateReference *tmStateRef = NULL;
     _netsnmpTLSBaseData *tlsdata;
     bio_cache *cachep;
+    int admit = 0;
 
     DEBUGTRACETOK("9:dtlsudp");
 
@@ -740,13 +975,34 @@ netsnmp_dtlsudp_recv(netsnmp_transport *t, void *buf, int size,
     /* if we don't have a cachep for this connection then
        we're receiving something new and are the server
        side */
-    cachep =
-        find_or_create_bio_cache(t, &addr_pair->remote_addr, WE_ARE_SERVER);
+    cachep = find_bio_cache(&addr_pair->remote_addr);
+    if (NULL == cachep ||
+        !(cachep->flags & (NETSNMP_BIO_HANDSHAKING | NETSNMP_BIO_CONNECTED))) {
+        /*
+         * Answering a ClientHello without a cookie is cheap, and the
+         * address it came from may well be forged, so only peers which
+         * return our cookie count against the handshake limit.
+         */
+#ifdef HAVE_SSL_CTX_SET_COOKIE_GENERATE_CB
+        admit = _dtlsudp_hello_has_cookie(&addr_pair->remote_addr, buf, rc);
+#else
+        admit = (NULL == cachep);
+#endif
+        if (admit && !_dtlsudp_admit_handshake()) {
+            SNMP_FREE(tmStateRef);
+            return -1;
+        }
+    }
+    if (NULL == cachep)
+        cachep = find_or_create_bio_cache(t, &addr_pair->remote_addr,
+                                          WE_ARE_SERVER);
     if (NULL == cachep) {
         snmp_increment_statistic(STAT_TLSTM_SNMPTLSTMSESSIONACCEPTS);
         SNMP_FREE(tmStateRef);
         return -1;
     }
+    if (admit)
+        _handshake_start(cachep);
     tlsdata = cachep->tlsdata;
     if (NULL == tlsdata->ssl) {
         /*
@@ -861,7 +1117,11 @@ netsnmp_dtlsudp_recv(netsnmp_transport *t, void *buf, int size,
         SNMP_FREE(tmStateRef);
         return rc;
     }
-    cachep->flags |= NETSNMP_BIO_CONNECTED;
+    if (!(cachep->flags & NETSNMP_BIO_CONNECTED)) {
+        cachep->flags |= NETSNMP_BIO_CONNECTED;
+        _handshake_done(cachep);
+        netsnmp_tlsbase_count_handshake(tlsdata->ssl);
+    }
 
     /* Until we've locally assured ourselves that all is well in
        certificate-verification-land we need to be prepared to stop
@@ -1064,8 +1324,6 @@ netsnmp_dtlsudp_send(netsnmp_transport *t, const void *buf, int size,
     const netsnmp_tmStateReference *tmStateRef = NULL;
     void *outbuf;
     _netsnmpTLSBaseData *tlsdata = NULL;
-    int socksize;
-    void *sa;
     
     DEBUGTRACETOK("9:dtlsudp");
     DEBUGMSGTL(("dtlsudp", "sending %d bytes\n", size));
@@ -1272,9 +1530,7 @@ netsnmp_dtlsudp_send(netsnmp_transport *t, const void *buf, int size,
         return -1;
     rc = BIO_read(cachep->write_bio, outbuf, rc);
     MAKE_MEM_DEFINED(outbuf, rc);
-    socksize = netsnmp_sockaddr_size(&cachep->sas.sa);
-    sa = &cachep->sas.sa;
-    rc = t->base_transport->f_send(t, outbuf, rc, &sa, &socksize);
+    rc = _dtlsudp_send_to_peer(t, cachep, outbuf, rc);
     free(outbuf);
 
     return rc;
@@ -1690,6 +1946,20 @@ netsnmp_dtlsudp_ctor(void)
             SSL_get_ex_new_index(0, NETSNMP_REMOVE_CONST(void *, indexname),
                                  NULL, NULL, NULL);
 
+    /* (D)TLS session settings */
+    netsnmp_ds_register_config(ASN_INTEGER, "snmp", "dtlsMaxHandshakes",
+                               NETSNMP_DS_LIBRARY_ID,
+                               NETSNMP_DS_LIB_DTLS_MAX_HANDSHAKES);
+    netsnmp_ds_register_config(ASN_INTEGER, "snmp", "dtlsHandshakeTimeout",
+                               NETSNMP_DS_LIBRARY_ID,
+                               NETSNMP_DS_LIB_DTLS_HANDSHAKE_TIMEOUT);
+
+    snmp_register_callback(SNMP_CALLBACK_LIBRARY,
+                           SNMP_CALLBACK_POST_READ_CONFIG,
+                           _dtlsudp_release_server_ctx, NULL);
+    snmp_register_callback(SNMP_CALLBACK_LIBRARY, SNMP_CALLBACK_SHUTDOWN,
+                           _dtlsudp_release_server_ctx, NULL);
+
     netsnmp_tdomain_register(&dtlsudpDomain);
 }
 
@@ -1702,57 +1972,13 @@ int cookie_initialized=0;
 unsigned char cookie_secret[NETSNMP_COOKIE_SECRET_LENGTH];
 
 #ifdef HAVE_SSL_CTX_SET_COOKIE_GENERATE_CB
-int netsnmp_dtls_gen_cookie(SSL *ssl, unsigned char *cookie,
-                            unsigned int *cookie_len)
+/* the cookie is an HMAC of the peer's address and port */
+static int _dtlsudp_cookie_hmac(const netsnmp_sockaddr_storage *peer,
+                                unsigned char *result,
+                                unsigned int *resultlength)
 {
-    unsigned char *buffer, result[EVP_MAX_MD_SIZE];
-    unsigned int length, resultlength;
-    bio_cache *cachep = NULL;
-    const netsnmp_sockaddr_storage *peer;
-
-    /* Initialize a random secret */
-    if (!cookie_initialized) {
-        if (!RAND_bytes(cookie_secret, NETSNMP_COOKIE_SECRET_LENGTH)) {
-            snmp_log(LOG_ERR, "dtls: error setting random cookie secret\n");
-            return 0;
-        }
-        MAKE_MEM_DEFINED(cookie_secret, NETSNMP_COOKIE_SECRET_LENGTH);
-        cookie_initialized = 1;
-    }
-
-    DEBUGMSGT(("dtlsudp:cookie", "generating cookie...\n"));
-
-    /* Read peer information */
-    cachep = SSL_get_ex_data(ssl, openssl_addr_index);
-    if (!cachep) {
-        snmp_log(LOG_ERR, "dtls: failed to get the peer address\n");
-        return 0;
-    }
-    peer = &cachep->sas;
-
-    /* Create buffer with peer's address and port */
-    length = 0;
-    switch (peer->sa.sa_family) {
-    case AF_INET:
-        length += sizeof(struct in_addr);
-        length += sizeof(peer->sin.sin_port);
-        break;
-#ifdef NETSNMP_TRANSPORT_UDPIPV6_DOMAIN
-    case AF_INET6:
-        length += sizeof(struct in6_addr);
-        length += sizeof(peer->sin6.sin6_port);
-        break;
-#endif
-    default:
-        snmp_log(LOG_ERR, "dtls generating cookie: unknown family: %d\n",
-                 peer->sa.sa_family);
-        return 0;
-    }
-    buffer = malloc(length);
-    if (buffer == NULL) {
-        snmp_log(LOG_ERR,"dtls: out of memory\n");
-        return 0;
-    }
+    unsigned char buffer[sizeof(struct in6_addr) + sizeof(u_short)];
+    unsigned int length;
 
     switch (peer->sa.sa_family) {
     case AF_INET:
@@ -1762,6 +1988,7 @@ int netsnmp_dtls_gen_cookie(SSL *ssl, unsigned char *cookie,
         memcpy(buffer + sizeof(peer->sin.sin_port),
                &peer->sin.sin_addr,
                sizeof(struct in_addr));
+        length = sizeof(peer->sin.sin_port) + sizeof(struct in_addr);
         break;
 #ifdef NETSNMP_TRANSPORT_UDPIPV6_DOMAIN
     case AF_INET6:
@@ -1771,18 +1998,49 @@ int netsnmp_dtls_gen_cookie(SSL *ssl, unsigned char *cookie,
         memcpy(buffer + sizeof(peer->sin6.sin6_port),
                &peer->sin6.sin6_addr,
                sizeof(struct in6_addr));
+        length = sizeof(peer->sin6.sin6_port) + sizeof(struct in6_addr);
         break;
 #endif
     default:
-        snmp_log(LOG_ERR, "dtls: unknown address family generating a cookie\n");
-        free(buffer);
+        snmp_log(LOG_ERR, "dtls: unknown address family %d for a cookie\n",
+                 peer->sa.sa_family);
         return 0;
     }
 
     /* Calculate HMAC of buffer using the secret */
     HMAC(EVP_sha1(), cookie_secret, NETSNMP_COOKIE_SECRET_LENGTH,
-         buffer, length, result, &resultlength);
-    free(buffer);
+         buffer, length, result, resultlength);
+    return 1;
+}
+
+int netsnmp_dtls_gen_cookie(SSL *ssl, unsigned char *cookie,
+                            unsigned int *cookie_len)
+{
+    unsigned char result[EVP_MAX_MD_SIZE];
+    unsigned int resultlength;
+    bio_cache *cachep = NULL;
+
+    /* Initialize a random secret */
+    if (!cookie_initialized) {
+        if (!RAND_bytes(cookie_secret, NETSNMP_COOKIE_SECRET_LENGTH)) {
+            snmp_log(LOG_ERR, "dtls: error setting random cookie secret\n");
+            return 0;
+        }
+        MAKE_MEM_DEFINED(cookie_secret, NETSNMP_COOKIE_SECRET_LENGTH);
+        cookie_initialized = 1;
+    }
+
+    DEBUGMSGT(("dtlsudp:cookie", "generating cookie...\n"));
+
+    /* Read peer information */
+    cachep = SSL_get_ex_data(ssl, openssl_addr_index);
+    if (!cachep) {
+        snmp_log(LOG_ERR, "dtls: failed to get the peer address\n");
+        return 0;
+    }
+
+    if (!_dtlsudp_cookie_hmac(&cachep->sas, result, &resultlength))
+        return 0;
 
     memcpy(cookie, result, resultlength);
     *cookie_len = resultlength;
@@ -1792,19 +2050,31 @@ int netsnmp_dtls_gen_cookie(SSL *ssl, unsigned char *cookie,
     return 1;
 }
 
+static int _dtlsudp_cookie_matches(const netsnmp_sockaddr_storage *peer,
+                                   const unsigned char *cookie,
+                                   unsigned int cookie_len)
+{
+    unsigned char result[EVP_MAX_MD_SIZE];
+    unsigned int resultlength;
+
+    /* If secret isn't initialized yet, the cookie can't be valid */
+    if (!cookie_initialized)
+        return 0;
+
+    if (!_dtlsudp_cookie_hmac(peer, result, &resultlength))
+        return 0;
+
+    return cookie_len == resultlength &&
+        memcmp(result, cookie, resultlength) == 0;
+}
+
 int netsnmp_dtls_verify_cookie(SSL *ssl,
                                SECOND_APPVERIFY_COOKIE_CB_ARG_QUALIFIER
                                unsigned char *cookie,
                                unsigned int cookie_len)
 {
-    unsigned char *buffer, result[EVP_MAX_MD_SIZE];
-    unsigned int length, resultlength, rc;
     bio_cache *cachep = NULL;
-    const netsnmp_sockaddr_storage *peer;
-
-    /* If secret isn't initialized yet, the cookie can't be valid */
-    if (!cookie_initialized)
-        return 0;
+    int rc;
 
     DEBUGMSGT(("9:dtlsudp:cookie", "verifying %d byte cookie\n", cookie_len));
 
@@ -1813,76 +2083,47 @@ int netsnmp_dtls_verify_cookie(SSL *ssl,
         snmp_log(LOG_ERR, "dtls: failed to get the peer address\n");
         return 0;
     }
-    peer = &cachep->sas;
 
-    /* Create buffer with peer's address and port */
-    length = 0;
-    switch (peer->sa.sa_family) {
-    case AF_INET:
-        length += sizeof(struct in_addr);
-        length += sizeof(peer->sin.sin_port);
-        break;
-#ifdef NETSNMP_TRANSPORT_UDPIPV6_DOMAIN
-    case AF_INET6:
-        length += sizeof(struct in6_addr);
-        length += sizeof(peer->sin6.sin6_port);
-        break;
-#endif
-    default:
-        snmp_log(LOG_ERR,
-                 "dtls: unknown address family %d generating a cookie\n",
-                 peer->sa.sa_family);
-        return 0;
-    }
-    buffer = malloc(length);
-    if (buffer == NULL) {
-        snmp_log(LOG_ERR, "dtls: unknown address family generating a cookie\n");
-        return 0;
-    }
-
-    switch (peer->sa.sa_family) {
-    case AF_INET:
-        memcpy(buffer,
-               &peer->sin.sin_port,
-               sizeof(peer->sin.sin_port));
-        memcpy(buffer + sizeof(peer->sin.sin_port),
-               &peer->sin.sin_addr,
-               sizeof(struct in_addr));
-        break;
-#ifdef NETSNMP_TRANSPORT_UDPIPV6_DOMAIN
-    case AF_INET6:
-        memcpy(buffer,
-               &peer->sin6.sin6_port,
-               sizeof(peer->sin6.sin6_port));
-        memcpy(buffer + sizeof(peer->sin6.sin6_port),
-               &peer->sin6.sin6_addr,
-               sizeof(struct in6_addr));
-        break;
-#endif
-    default:
-        snmp_log(LOG_ERR,
-                 "dtls: unknown address family %d generating a cookie\n",
-                 peer->sa.sa_family);
-        free(buffer);
-        return 0;
-    }
-
-    /* Calculate HMAC of buffer using the secret */
-    HMAC(EVP_sha1(), cookie_secret, NETSNMP_COOKIE_SECRET_LENGTH,
-         buffer, length, result, &resultlength);
-    free(buffer);
-
-    if (cookie_len != resultlength || memcmp(result, cookie, resultlength) != 0)
-        rc = 0;
-    else {
-        rc = 1;
+    rc = _dtlsudp_cookie_matches(&cachep->sas, cookie, cookie_len);
+    if (rc)
         cachep->flags |= NETSNMP_BIO_HAVE_COOKIE;
-    }
 
     DEBUGMSGT(("dtlsudp:cookie", "verify cookie: %d\n", rc));
 
     return rc;
 }
+
+/*
+ * Returns 1 if buf holds a ClientHello carrying a cookie which we gave
+ * to this peer, i.e. the peer has shown that it really receives at its
+ * address.  Only the first fragment of a ClientHello is looked at; it
+ * is where the cookie is.
+ */
+static int _dtlsudp_hello_has_cookie(const netsnmp_sockaddr_storage *peer,
+                                     const u_char *buf, int len)
+{
+    const u_char *cp = buf + 13;    /* the DTLS record header */
+    const u_char *end = buf + len;
+    u_int cookie_len;
+
+    if (len < 13 + 12 || buf[0] != 22)      /* handshake */
+        return 0;
+    /* the handshake header: type, length, seq, offset, fragment length */
+    if (cp[0] != 1 || cp[6] || cp[7] || cp[8]) /* first ClientHello fragment */
+        return 0;
+    cp += 12;
+    /* version, random, session id */
+    if (end - cp < 2 + 32 + 1)
+        return 0;
+    cp += 2 + 32;
+    if (end - cp < 1 + cp[0] + 1)
+        return 0;
+    cp += 1 + cp[0];
+    cookie_len = *cp++;
+    if (cookie_len == 0 || cookie_len > (size_t)(end - cp))
+        return 0;
+    return _dtlsudp_cookie_matches(peer, cp, cookie_len);
+}
 #endif /* #ifdef HAVE_SSL_CTX_SET_COOKIE_GENERATE_CB */
 
 #endif /* HAVE_LIBSSL_DTLS */
@@ -3,6 +3,7 @@
 #include <net-snmp/types.h>
 
 netsnmp_feature_require(cert_util);
+netsnmp_feature_require(container_hash);
 
 #ifdef HAVE_STRING_H
 #include <string.h>
@@ -23,6 +24,7 @@ netsnmp_feature_require(cert_util);
 #endif
 #include <errno.h>
 #include <ctype.h>
+#include <time.h>
 #include "../memcheck.h"
 
 /* OpenSSL Includes */
@@ -35,6 +37,7 @@ netsnmp_feature_require(cert_util);
 
 #include <net-snmp/config_api.h>
 #include <net-snmp/library/container.h>
+#include <net-snmp/library/container_hash.h>
 #include <net-snmp/library/cert_util.h>
 #include <net-snmp/library/snmp_openssl.h>
 #include <net-snmp/library/default_store.h>
@@ -59,6 +62,11 @@ netsnmp_feature_require(cert_util);
 #define LOGANDDIE(msg) do { snmp_log(LOG_ERR, "%s\n", msg); return 0; } while(0)
 
 int openssl_local_index;
+static int tls_session_key_index = -1;
+
+static const unsigned char tls_session_id_context[] = "net-snmp";
+
+static int _tls_new_client_session(SSL *ssl, SSL_SESSION *session);
 
 #ifndef HAVE_ERR_GET_ERROR_ALL
 /*
@@ -680,6 +688,15 @@ sslctx_client_setup(const SSL_METHOD *method, _netsnmpTLSBaseData *tlsbase) {
         }
     }
 
+    /* hand new sessions to our own cache; see
+       netsnmp_tlsbase_resume_session() */
+    if (!netsnmp_ds_get_boolean(NETSNMP_DS_LIBRARY_ID,
+                                NETSNMP_DS_LIB_TLS_NO_RESUMPTION)) {
+        SSL_CTX_set_session_cache_mode(the_ctx, SSL_SESS_CACHE_CLIENT |
+                                       SSL_SESS_CACHE_NO_INTERNAL_STORE);
+        SSL_CTX_sess_set_new_cb(the_ctx, _tls_new_client_session);
+    }
+
     return _sslctx_common_setup(the_ctx, tlsbase);
 
 err:
@@ -759,6 +776,28 @@ sslctx_server_setup(const SSL_METHOD *method) {
 
     SSL_CTX_set_options(the_ctx, SSL_OP_CIPHER_SERVER_PREFERENCE);
 
+    /* let returning clients resume their sessions, by session id or
+       session ticket, instead of doing a full handshake */
+    SSL_CTX_set_session_id_context(the_ctx, tls_session_id_context,
+                                   sizeof(tls_session_id_context) - 1);
+    if (netsnmp_ds_get_boolean(NETSNMP_DS_LIBRARY_ID,
+                               NETSNMP_DS_LIB_TLS_NO_RESUMPTION)) {
+        SSL_CTX_set_session_cache_mode(the_ctx, SSL_SESS_CACHE_OFF);
+        SSL_CTX_set_options(the_ctx, SSL_OP_NO_TICKET);
+    } else {
+        int value;
+
+        SSL_CTX_set_session_cache_mode(the_ctx, SSL_SESS_CACHE_SERVER);
+        value = netsnmp_ds_get_int(NETSNMP_DS_LIBRARY_ID,
+                                   NETSNMP_DS_LIB_TLS_SESSION_CACHE_SIZE);
+        if (value > 0)
+            SSL_CTX_sess_set_cache_size(the_ctx, value);
+        value = netsnmp_ds_get_int(NETSNMP_DS_LIBRARY_ID,
+                                   NETSNMP_DS_LIB_TLS_SESSION_TIMEOUT);
+        if (value > 0)
+            SSL_CTX_set_timeout(the_ctx, value);
+    }
+
     return _sslctx_common_setup(the_ctx, NULL);
     
 err:
@@ -767,6 +806,192 @@ err:
     return NULL;
 }
 
+/*
+ * Client side session reuse.  Sessions are remembered by the peer they
+ * were established with and by the identities they were verified
+ * against, and are offered again for the next connection made with the
+ * same parameters.  The server's certificate is still checked after a
+ * resumed handshake, since the peer certificate is part of the session.
+ */
+typedef struct tls_client_session_s {
+    char        *key;           /* first; see netsnmp_compare_cstring() */
+    SSL_SESSION *session;
+} tls_client_session;
+
+#define TLS_CLIENT_SESSIONS_DEFAULT_MAX 1024
+
+static netsnmp_container *tls_client_sessions = NULL;
+
+static u_int
+_tls_client_session_hash(const void *data)
+{
+    const tls_client_session *entry = data;
+
+    return netsnmp_hash_direct_cstring(entry->key);
+}
+
+static void
+_tls_client_session_free(void *data, void *context)
+{
+    tls_client_session *entry = data;
+
+    if (!entry)
+        return;
+    SSL_SESSION_free(entry->session);
+    free(entry->key);
+    free(entry);
+}
+
+static netsnmp_container *
+_tls_client_session_container(void)
+{
+    if (NULL == tls_client_sessions) {
+        tls_client_sessions = netsnmp_container_get_hash();
+        if (NULL == tls_client_sessions) {
+            snmp_log(LOG_ERR, "failed to allocate the tls session cache\n");
+            return NULL;
+        }
+        tls_client_sessions->compare = netsnmp_compare_cstring;
+        tls_client_sessions->container_name = strdup("tls_client_sessions");
+        netsnmp_container_hash_set_func(tls_client_sessions,
+                                        _tls_client_session_hash);
+    }
+    return tls_client_sessions;
+}
+
+static void
+_tls_session_key_free(void *parent, void *ptr, CRYPTO_EX_DATA *ad,
+                      int idx, long argl, void *argp)
+{
+    free(ptr);
+}
+
+/* called by OpenSSL whenever a client connection gets a new session */
+static int
+_tls_new_client_session(SSL *ssl, SSL_SESSION *session)
+{
+    netsnmp_container *c = _tls_client_session_container();
+    tls_client_session *entry, lookup;
+    int max;
+
+    if (NULL == c || tls_session_key_index < 0)
+        return 0;
+    lookup.key = SSL_get_ex_data(ssl, tls_session_key_index);
+    if (NULL == lookup.key)
+        return 0;
+
+    entry = CONTAINER_FIND(c, &lookup);
+    if (entry) {
+        SSL_SESSION_free(entry->session);
+        entry->session = session;
+        DEBUGMSGTL(("tls:session", "replaced the session for %s\n",
+                    entry->key));
+        return 1;
+    }
+
+    max = netsnmp_ds_get_int(NETSNMP_DS_LIBRARY_ID,
+                             NETSNMP_DS_LIB_TLS_SESSION_CACHE_SIZE);
+    if (max <= 0)
+        max = TLS_CLIENT_SESSIONS_DEFAULT_MAX;
+    if (CONTAINER_SIZE(c) >= (size_t)max) {
+        DEBUGMSGTL(("tls:session", "session cache full; not saving %s\n",
+                    lookup.key));
+        return 0;
+    }
+
+    entry = SNMP_MALLOC_TYPEDEF(tls_client_session);
+    if (NULL == entry)
+        return 0;
+    entry->key = strdup(lookup.key);
+    entry->session = session;
+    if (NULL == entry->key || CONTAINER_INSERT(c, entry) != 0) {
+        free(entry->key);
+        free(entry);
+        return 0;
+    }
+    DEBUGMSGTL(("tls:session", "saved a session for %s\n", entry->key));
+    return 1;
+}
+
+/*
+ * Offer a previously established session to a new client connection
+ * with the given peer (a transport specific address string).  Must be
+ * called before the handshake starts.
+ */
+void
+netsnmp_tlsbase_resume_session(SSL *ssl, _netsnmpTLSBaseData *tlsdata,
+                               const char *peer)
+{
+    netsnmp_container *c;
+    tls_client_session *entry, lookup;
+    char *key;
+
+    if (NULL == ssl || NULL == tlsdata || NULL == peer ||
+        tls_session_key_index < 0 ||
+        netsnmp_ds_get_boolean(NETSNMP_DS_LIBRARY_ID,
+                               NETSNMP_DS_LIB_TLS_NO_RESUMPTION))
+        return;
+
+#define TLS_KEY_STR(x) ((x) ? (x) : "")
+    if (asprintf(&key, "%s|%s|%s|%s|%s|%s", peer,
+                 TLS_KEY_STR(tlsdata->our_identity),
+                 TLS_KEY_STR(tlsdata->their_identity),
+                 TLS_KEY_STR(tlsdata->their_fingerprint),
+                 TLS_KEY_STR(tlsdata->their_hostname),
+                 TLS_KEY_STR(tlsdata->trust_cert)) < 0)
+        return;
+#undef TLS_KEY_STR
+    if (!SSL_set_ex_data(ssl, tls_session_key_index, key)) {
+        free(key);
+        return;
+    }
+
+    c = _tls_client_session_container();
+    if (NULL == c)
+        return;
+    lookup.key = key;
+    entry = CONTAINER_FIND(c, &lookup);
+    if (NULL == entry)
+        return;
+
+    if (SSL_SESSION_get_time(entry->session) +
+        SSL_SESSION_get_timeout(entry->session) <= (long)time(NULL)) {
+        DEBUGMSGTL(("tls:session", "session for %s expired\n", key));
+        CONTAINER_REMOVE(c, entry);
+        _tls_client_session_free(entry, NULL);
+        return;
+    }
+    if (SSL_set_session(ssl, entry->session) == 1)
+        DEBUGMSGTL(("tls:session", "offering the saved session for %s\n",
+                    key));
+}
+
+/*
+ * Count a completed handshake, as either a full or a resumed one.
+ */
+void
+netsnmp_tlsbase_count_handshake(SSL *ssl)
+{
+    if (NULL == ssl)
+        return;
+    if (SSL_session_reused(ssl)) {
+        DEBUGMSGTL(("tls:session", "resumed a session\n"));
+        snmp_increment_statistic(STAT_NSTLSTM_RESUMEDHANDSHAKES);
+    } else
+        snmp_increment_statistic(STAT_NSTLSTM_FULLHANDSHAKES);
+}
+
+static int
+tls_shutdown(int majorid, int minorid, void *serverarg, void *clientarg)
+{
+    if (tls_client_sessions) {
+        CONTAINER_CLEAR(tls_client_sessions, _tls_client_session_free, NULL);
+        CONTAINER_FREE(tls_client_sessions);
+        tls_client_sessions = NULL;
+    }
+    return 0;
+}
+
 int
 netsnmp_tlsbase_config(struct netsnmp_transport_s *t, const char *token, const char *value) {
     _netsnmpTLSBaseData *tlsdata;
@@ -855,6 +1080,8 @@ tls_bootstrap(int majorid, int minorid, void *serverarg, void *clientarg) {
 
     openssl_local_index =
         SSL_get_ex_new_index(0, indexname, NULL, NULL, NULL);
+    tls_session_key_index =
+        SSL_get_ex_new_index(0, NULL, NULL, NULL, _tls_session_key_free);
 
     return 0;
 }
@@ -921,6 +1148,17 @@ netsnmp_tlsbase_ctor(void) {
                                NETSNMP_DS_LIBRARY_ID,
                                NETSNMP_DS_LIB_TLS_MAX_VERSION);
 
+    /* (D)TLS session resumption */
+    netsnmp_ds_register_config(ASN_BOOLEAN, "snmp", "tlsNoSessionResumption",
+                               NETSNMP_DS_LIBRARY_ID,
+                               NETSNMP_DS_LIB_TLS_NO_RESUMPTION);
+    netsnmp_ds_register_config(ASN_INTEGER, "snmp", "tlsSessionCacheSize",
+                               NETSNMP_DS_LIBRARY_ID,
+                               NETSNMP_DS_LIB_TLS_SESSION_CACHE_SIZE);
+    netsnmp_ds_register_config(ASN_INTEGER, "snmp", "tlsSessionTimeout",
+                               NETSNMP_DS_LIBRARY_ID,
+                               NETSNMP_DS_LIB_TLS_SESSION_TIMEOUT);
+
     /*
      * for the client
      */
@@ -952,6 +1190,9 @@ netsnmp_tlsbase_ctor(void) {
     snmp_register_callback(SNMP_CALLBACK_LIBRARY,
 			   SNMP_CALLBACK_POST_PREMIB_READ_CONFIG,
 			   tls_bootstrap, NULL);
+    snmp_register_callback(SNMP_CALLBACK_LIBRARY,
+			   SNMP_CALLBACK_SHUTDOWN,
+			   tls_shutdown, NULL);
 
 }
 
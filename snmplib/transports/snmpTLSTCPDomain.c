@@ -567,6 +567,7 @@ netsnmp_tlstcp_accept(netsnmp_transport *t)
         tlsdata->ssl = NULL;
         return -1;
     }   
+    netsnmp_tlsbase_count_handshake(ssl);
 
     /*
      * currently netsnmp_tlsbase_wrapup_recv is where we check for
@@ -785,6 +786,14 @@ netsnmp_tlstcp_open_client(netsnmp_transport *t)
 
     SSL_set_ex_data(ssl, tls_get_verify_info_index(), verify_info);
 
+    /* offer the session from a previous connection to this server */
+    {
+        char peer[SPRINT_MAX_LEN];
+
+        snprintf(peer, sizeof(peer), "tcp:%s", tlsdata->addr_string);
+        netsnmp_tlsbase_resume_session(ssl, tlsdata, peer);
+    }
+
     /* Then have SSL do it's connection over the BIO */
     rc = SSL_connect(ssl);
     if (rc <= 0) {
@@ -793,6 +802,7 @@ netsnmp_tlstcp_open_client(netsnmp_transport *t)
         BIO_free(bio);
         return NULL;
     }
+    netsnmp_tlsbase_count_handshake(ssl);
 
     /* RFC5953 Section 5.3.1: Establishing a Session as a Client
        3) continued:
@@ -0,0 +1,161 @@
+/* HEADER Testing the skiplist container */
+/*
+ * Load the same (shuffled) set of indexes into a skiplist and a binary
+ * array, and check that lookups, iteration and removal agree.
+ */
+
+static const char test_name[] = "skiplist-container-test";
+#define NUM_ENTRIES 5000
+oid                 oids[NUM_ENTRIES][2];
+netsnmp_index       idx[NUM_ENTRIES], key, *ip, *ip2;
+int                 order[NUM_ENTRIES];
+netsnmp_container  *sl, *ba, *dup;
+netsnmp_iterator   *it;
+netsnmp_void_array *va;
+oid                 key_oids[2];
+int                 i, j, tmp, bad;
+size_t              n;
+
+init_snmp(test_name);
+
+sl = netsnmp_container_find("skiplist:table_container");
+OK(sl != NULL, "skiplist container found by name");
+OK(sl && sl->get_iterator && sl->find_next,
+   "skiplist supports find_next and iterators");
+sl->compare = netsnmp_compare_netsnmp_index;
+sl->ncompare = netsnmp_ncompare_netsnmp_index;
+ba = netsnmp_container_get_binary_array();
+ba->compare = netsnmp_compare_netsnmp_index;
+
+/* entries { i / 10, i % 10 }, with only the even ones in use */
+for (i = 0; i < NUM_ENTRIES; ++i) {
+    oids[i][0] = 2 * (i / 10);
+    oids[i][1] = 2 * (i % 10);
+    idx[i].oids = oids[i];
+    idx[i].len = 2;
+    order[i] = i;
+}
+for (i = NUM_ENTRIES - 1; i > 0; --i) {
+    j = random() % (i + 1);
+    tmp = order[i];
+    order[i] = order[j];
+    order[j] = tmp;
+}
+for (i = 0; i < NUM_ENTRIES; ++i) {
+    CONTAINER_INSERT(sl, &idx[order[i]]);
+    CONTAINER_INSERT(ba, &idx[order[i]]);
+}
+OKF(CONTAINER_SIZE(sl) == NUM_ENTRIES,
+    ("size after %d shuffled inserts", NUM_ENTRIES));
+OK(CONTAINER_INSERT(sl, &idx[17]) != 0 && CONTAINER_SIZE(sl) == NUM_ENTRIES,
+   "duplicate keys are rejected by default");
+
+/* ordered iteration */
+bad = 0;
+i = 0;
+it = CONTAINER_ITERATOR(sl);
+for (ip = ITERATOR_FIRST(it); ip; ip = ITERATOR_NEXT(it), ++i)
+    if (ip != &idx[i])
+        ++bad;
+OKF(bad == 0 && i == NUM_ENTRIES, ("iteration in order (%d entries)", i));
+OK(ITERATOR_LAST(it) == &idx[NUM_ENTRIES - 1], "iterator last");
+ITERATOR_RELEASE(it);
+
+/* exact and next lookups, for present and absent keys */
+key.oids = key_oids;
+key.len = 2;
+bad = 0;
+for (i = 0; i < 2 * (NUM_ENTRIES / 10) + 1; ++i) {
+    for (j = 0; j < 21; ++j) {
+        key_oids[0] = i;
+        key_oids[1] = j;
+        if (CONTAINER_FIND(sl, &key) != CONTAINER_FIND(ba, &key))
+            ++bad;
+        if (CONTAINER_NEXT(sl, &key) != CONTAINER_NEXT(ba, &key))
+            ++bad;
+    }
+}
+OKF(bad == 0, ("find/find_next agree with binary_array (%d mismatches)",
+               bad));
+OK(CONTAINER_FIRST(sl) == &idx[0], "first entry");
+
+/* partial key subsets */
+key.len = 1;
+key_oids[0] = 4;
+va = CONTAINER_GET_SUBSET(sl, &key);
+OK(va && va->size == 10 && va->array[0] == &idx[20] &&
+   va->array[9] == &idx[29], "subset for a partial index");
+if (va) {
+    free(va->array);
+    free(va);
+}
+key_oids[0] = 5;
+OK(CONTAINER_GET_SUBSET(sl, &key) == NULL, "empty subset");
+key.len = 2;
+
+/* shallow copies */
+dup = CONTAINER_DUP(sl, NULL, 0);
+OK(dup && CONTAINER_SIZE(dup) == NUM_ENTRIES &&
+   CONTAINER_FIRST(dup) == &idx[0], "duplicate container");
+if (dup)
+    CONTAINER_FREE(dup);
+
+/* remove every other entry, in shuffled order */
+for (i = 0; i < NUM_ENTRIES; ++i) {
+    if (order[i] & 1) {
+        CONTAINER_REMOVE(sl, &idx[order[i]]);
+        CONTAINER_REMOVE(ba, &idx[order[i]]);
+    }
+}
+OKF(CONTAINER_SIZE(sl) == NUM_ENTRIES / 2, ("size after removals"));
+OK(CONTAINER_REMOVE(sl, &idx[1]) != 0, "removing a missing entry fails");
+bad = 0;
+for (i = 0; i < NUM_ENTRIES; ++i) {
+    if (CONTAINER_FIND(sl, &idx[i]) != CONTAINER_FIND(ba, &idx[i]) ||
+        CONTAINER_NEXT(sl, &idx[i]) != CONTAINER_NEXT(ba, &idx[i]))
+        ++bad;
+}
+OKF(bad == 0, ("lookups agree after removals (%d mismatches)", bad));
+
+/* iterator removal */
+it = CONTAINER_ITERATOR(sl);
+n = 0;
+for (ip = ITERATOR_FIRST(it); ip; ip = ITERATOR_NEXT(it)) {
+    if (ip->oids[0] % 4 == 0) {
+        ITERATOR_REMOVE(it);
+        ++n;
+    }
+}
+ITERATOR_RELEASE(it);
+OKF(n > 0 && CONTAINER_SIZE(sl) == NUM_ENTRIES / 2 - n,
+    ("iterator removed %d entries", (int)n));
+bad = 0;
+for (ip = CONTAINER_FIRST(sl); ip; ip = ip2) {
+    ip2 = CONTAINER_NEXT(sl, ip);
+    if (ip->oids[0] % 4 == 0 || (ip2 && sl->compare(ip, ip2) >= 0))
+        ++bad;
+}
+OK(bad == 0, "remaining entries in order");
+
+/* duplicates, when allowed, are kept and skipped by find_next */
+CONTAINER_CLEAR(sl, NULL, NULL);
+OK(CONTAINER_SIZE(sl) == 0 && CONTAINER_FIRST(sl) == NULL, "cleared");
+tmp = -1;
+CONTAINER_SET_OPTIONS(sl, CONTAINER_KEY_ALLOW_DUPLICATES, tmp);
+OK(tmp != -1, "allow duplicates option");
+CONTAINER_INSERT(sl, &idx[3]);
+CONTAINER_INSERT(sl, &idx[1]);
+CONTAINER_INSERT(sl, &idx[3]);
+CONTAINER_INSERT(sl, &idx[3]);
+CONTAINER_INSERT(sl, &idx[2]);
+OK(CONTAINER_SIZE(sl) == 5, "duplicates inserted");
+OK(CONTAINER_NEXT(sl, &idx[2]) == &idx[3] &&
+   CONTAINER_NEXT(sl, &idx[3]) == NULL, "find_next skips duplicates");
+CONTAINER_REMOVE(sl, &idx[3]);
+OK(CONTAINER_SIZE(sl) == 4 && CONTAINER_FIND(sl, &idx[3]) == &idx[3],
+   "one duplicate removed");
+
+CONTAINER_FREE(sl);
+CONTAINER_FREE(ba);
+
+snmp_shutdown(test_name);
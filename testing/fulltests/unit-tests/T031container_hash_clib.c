@@ -0,0 +1,147 @@
+/* HEADER Testing the hash container */
+/*
+ * Exact-match lookups, removal and iteration on an unordered hash
+ * container, alone and as a secondary index of a sorted table.
+ */
+
+static const char test_name[] = "hash-container-test";
+#define NUM_ENTRIES 20000
+typedef struct { long ifindex; netsnmp_index idx; } test_entry;
+oid                 oids[NUM_ENTRIES][3];
+test_entry          ent[NUM_ENTRIES], lkey;
+netsnmp_index       key, *ip;
+netsnmp_container  *h, *dup, *primary, *byindex;
+netsnmp_iterator   *it;
+oid                 key_oids[3];
+int                 i, tmp, bad;
+size_t              n;
+char               *seen;
+
+init_snmp(test_name);
+
+h = netsnmp_container_find("hash");
+OK(h != NULL, "hash container found by name");
+h->compare = netsnmp_compare_netsnmp_index;
+OK(h->flags & CONTAINER_KEY_UNSORTED, "hash container reports unsorted");
+
+for (i = 0; i < NUM_ENTRIES; ++i) {
+    oids[i][0] = i % 7;
+    oids[i][1] = 2 * i;
+    oids[i][2] = 1;
+    ent[i].ifindex = 2 * i + 1;
+    ent[i].idx.oids = oids[i];
+    ent[i].idx.len = 3;
+}
+for (i = 0; i < NUM_ENTRIES; ++i)
+    CONTAINER_INSERT(h, &ent[i].idx);
+OKF(CONTAINER_SIZE(h) == NUM_ENTRIES, ("size after %d inserts", NUM_ENTRIES));
+OK(CONTAINER_INSERT(h, &ent[42].idx) != 0 && CONTAINER_SIZE(h) == NUM_ENTRIES,
+   "duplicate keys are rejected by default");
+
+/* present and absent keys */
+key.oids = key_oids;
+key.len = 3;
+bad = 0;
+for (i = 0; i < 2 * NUM_ENTRIES; ++i) {
+    key_oids[0] = (i / 2) % 7;
+    key_oids[1] = i;
+    key_oids[2] = 1;
+    ip = CONTAINER_FIND(h, &key);
+    if ((i & 1) ? (ip != NULL) : (ip != &ent[i / 2].idx))
+        ++bad;
+}
+OKF(bad == 0, ("exact lookups (%d mismatches)", bad));
+
+/* no ordering */
+OK(CONTAINER_NEXT(h, &ent[0].idx) == NULL, "find_next with a key fails");
+OK(CONTAINER_FIRST(h) != NULL, "first returns an entry");
+OK(CONTAINER_GET_SUBSET(h, &ent[0].idx) == NULL, "get_subset fails");
+
+/* remove two thirds, checking that probing past removed entries works */
+for (i = 0; i < NUM_ENTRIES; ++i)
+    if (i % 3)
+        CONTAINER_REMOVE(h, &ent[i].idx);
+OKF(CONTAINER_SIZE(h) == (NUM_ENTRIES + 2) / 3, ("size after removals"));
+OK(CONTAINER_REMOVE(h, &ent[1].idx) != 0, "removing a missing entry fails");
+bad = 0;
+for (i = 0; i < NUM_ENTRIES; ++i)
+    if (CONTAINER_FIND(h, &ent[i].idx) != ((i % 3) ? NULL : &ent[i].idx))
+        ++bad;
+OKF(bad == 0, ("lookups after removals (%d mismatches)", bad));
+
+/* reinserting reuses removed slots */
+for (i = 0; i < NUM_ENTRIES; ++i)
+    if (i % 3 == 1)
+        CONTAINER_INSERT(h, &ent[i].idx);
+bad = 0;
+for (i = 0; i < NUM_ENTRIES; ++i)
+    if (CONTAINER_FIND(h, &ent[i].idx) != ((i % 3 == 2) ? NULL : &ent[i].idx))
+        ++bad;
+OKF(bad == 0, ("lookups after reinsertion (%d mismatches)", bad));
+
+/* iteration visits every entry once; iterator removal */
+seen = calloc(NUM_ENTRIES, 1);
+bad = 0;
+n = 0;
+it = CONTAINER_ITERATOR(h);
+for (ip = ITERATOR_FIRST(it); ip; ip = ITERATOR_NEXT(it)) {
+    i = ip->oids[1] / 2;
+    if (seen[i]++)
+        ++bad;
+    if (i % 3 == 1) {
+        ITERATOR_REMOVE(it);
+        ++n;
+    }
+}
+ITERATOR_RELEASE(it);
+OKF(bad == 0 && n == (NUM_ENTRIES + 1) / 3,
+    ("iteration visited each entry once, removed %d", (int)n));
+bad = 0;
+for (i = 0; i < NUM_ENTRIES; ++i)
+    if (CONTAINER_FIND(h, &ent[i].idx) != ((i % 3) ? NULL : &ent[i].idx))
+        ++bad;
+OKF(bad == 0 && CONTAINER_SIZE(h) == (NUM_ENTRIES + 2) / 3,
+    ("lookups after iterator removal (%d mismatches)", bad));
+free(seen);
+
+/* shallow copies */
+dup = CONTAINER_DUP(h, NULL, 0);
+OK(dup && CONTAINER_SIZE(dup) == CONTAINER_SIZE(h) &&
+   CONTAINER_FIND(dup, &ent[3].idx) == &ent[3].idx, "duplicate container");
+if (dup)
+    CONTAINER_FREE(dup);
+
+/* duplicates, when allowed */
+CONTAINER_CLEAR(h, NULL, NULL);
+OK(CONTAINER_SIZE(h) == 0 && CONTAINER_FIRST(h) == NULL, "cleared");
+tmp = -1;
+CONTAINER_SET_OPTIONS(h, CONTAINER_KEY_ALLOW_DUPLICATES, tmp);
+OK(tmp != -1 && (h->flags & CONTAINER_KEY_UNSORTED),
+   "allow duplicates option, still unsorted");
+memcpy(oids[1], oids[0], sizeof(oids[0]));
+CONTAINER_INSERT(h, &ent[0].idx);
+CONTAINER_INSERT(h, &ent[1].idx);
+OK(CONTAINER_SIZE(h) == 2, "duplicates inserted");
+CONTAINER_REMOVE(h, &ent[1].idx);
+OK(CONTAINER_SIZE(h) == 1 && CONTAINER_FIND(h, &ent[1].idx) == &ent[0].idx,
+   "the exact duplicate was removed");
+CONTAINER_FREE(h);
+
+/* as a secondary index, keyed on the leading long */
+primary = netsnmp_container_find("table_container");
+primary->compare = netsnmp_compare_long;
+byindex = netsnmp_container_find("hash");
+byindex->compare = netsnmp_compare_long;
+byindex->container_name = strdup("byindex");
+netsnmp_container_add_index(primary, byindex);
+for (i = 2; i < 1000; ++i)
+    CONTAINER_INSERT(primary, &ent[i]);
+OK(CONTAINER_SIZE(byindex) == CONTAINER_SIZE(primary),
+   "secondary index populated");
+lkey.ifindex = 2 * 500 + 1;
+OK(CONTAINER_FIND(byindex, &lkey) == (void *)&ent[500], "secondary lookup");
+CONTAINER_REMOVE(primary, &ent[500]);
+OK(CONTAINER_FIND(byindex, &lkey) == NULL, "removed from secondary index");
+CONTAINER_FREE(primary);
+
+snmp_shutdown(test_name);
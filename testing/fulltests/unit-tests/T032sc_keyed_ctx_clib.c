@@ -0,0 +1,130 @@
+/* HEADER Cached keyed HMAC and cipher state */
+/*
+ * The _ctx variants of the scapi functions must give the same results
+ * as the uncached ones, also after the key changes.  The authPriv
+ * timings (HMAC + encrypt of a typical message) are printed for
+ * reference only.
+ */
+
+#ifdef HAVE_EVP_SHA384
+const oid      *auth_oid = usmHMAC384SHA512AuthProtocol;
+#else
+const oid      *auth_oid = usmHMACSHA1AuthProtocol;
+#endif
+#if defined(HAVE_AES) && defined(NETSNMP_DRAFT_BLUMENTHAL_AES_04)
+const oid      *priv_oid = usmAES256PrivProtocol;
+#elif defined(HAVE_AES)
+const oid      *priv_oid = usmAESPrivProtocol;
+#else
+const oid      *priv_oid = usmDESPrivProtocol;
+#endif
+netsnmp_sc_ctx *auth_ctx = NULL, *priv_ctx = NULL, *ref;
+u_char          auth_key[64], priv_key[32], iv[16];
+u_char          msg[484], ct1[600], ct2[600], pt[600];
+u_char          mac1[64], mac2[64];
+size_t          mac1_len, mac2_len, ct1_len, ct2_len, pt_len;
+int             i, round, same_mac = 1, same_ct = 1, same_pt = 1;
+int             rc1, rc2;
+const int       iterations = 20000;
+struct timeval  start, end;
+long            usec;
+
+for (i = 0; i < (int) sizeof(auth_key); i++)
+    auth_key[i] = i * 7 + 1;
+for (i = 0; i < (int) sizeof(priv_key); i++)
+    priv_key[i] = i * 13 + 5;
+for (i = 0; i < (int) sizeof(msg); i++)
+    msg[i] = i & 0xff;
+
+for (round = 0; round < 6; round++) {
+    /* the key changes half way through */
+    if (round == 3) {
+        auth_key[10] ^= 0x55;
+        priv_key[3] ^= 0xaa;
+    }
+    for (i = 0; i < (int) sizeof(iv); i++)
+        iv[i] = round * 31 + i;
+    msg[round] ^= 0xff;
+
+    mac1_len = mac2_len = sizeof(mac1);
+    rc1 = sc_generate_keyed_hash(auth_oid, 10, auth_key, sizeof(auth_key),
+                                 msg, sizeof(msg), mac1, &mac1_len);
+    rc2 = sc_generate_keyed_hash_ctx(&auth_ctx, auth_oid, 10, auth_key,
+                                     sizeof(auth_key), msg, sizeof(msg),
+                                     mac2, &mac2_len);
+    if (rc1 != SNMPERR_SUCCESS || rc2 != SNMPERR_SUCCESS ||
+        mac1_len != mac2_len || memcmp(mac1, mac2, mac1_len) != 0)
+        same_mac = 0;
+    if (sc_check_keyed_hash_ctx(&auth_ctx, auth_oid, 10, auth_key,
+                                sizeof(auth_key), msg, sizeof(msg), mac1,
+                                sc_get_auth_maclen(sc_get_authtype(auth_oid,
+                                                                   10)))
+        != SNMPERR_SUCCESS)
+        same_mac = 0;
+
+    ct1_len = ct2_len = sizeof(ct1);
+    rc1 = sc_encrypt(priv_oid, 10, priv_key, sizeof(priv_key), iv,
+                     sizeof(iv), msg, sizeof(msg), ct1, &ct1_len);
+    rc2 = sc_encrypt_ctx(&priv_ctx, priv_oid, 10, priv_key, sizeof(priv_key),
+                         iv, sizeof(iv), msg, sizeof(msg), ct2, &ct2_len);
+    if (rc1 != SNMPERR_SUCCESS || rc2 != SNMPERR_SUCCESS ||
+        ct1_len != ct2_len || memcmp(ct1, ct2, ct1_len) != 0)
+        same_ct = 0;
+
+    pt_len = sizeof(pt);
+    rc2 = sc_decrypt_ctx(&priv_ctx, priv_oid, 10, priv_key, sizeof(priv_key),
+                         iv, sizeof(iv), ct2, ct2_len, pt, &pt_len);
+    if (rc2 != SNMPERR_SUCCESS || pt_len < sizeof(msg) ||
+        memcmp(pt, msg, sizeof(msg)) != 0)
+        same_pt = 0;
+}
+OK(same_mac, "cached HMAC matches, also after a key change");
+OK(same_ct, "cached encryption matches, also after a key change");
+OK(same_pt, "cached decryption round trip");
+
+/* a shared context stays valid for the holder whose key didn't change */
+ref = sc_ctx_ref(&auth_ctx);
+auth_key[0] ^= 1;
+mac2_len = sizeof(mac2);
+sc_generate_keyed_hash_ctx(&auth_ctx, auth_oid, 10, auth_key,
+                           sizeof(auth_key), msg, sizeof(msg), mac2,
+                           &mac2_len);
+auth_key[0] ^= 1;
+mac2_len = sizeof(mac2);
+rc2 = sc_generate_keyed_hash_ctx(&ref, auth_oid, 10, auth_key,
+                                 sizeof(auth_key), msg, sizeof(msg), mac2,
+                                 &mac2_len);
+OK(rc2 == SNMPERR_SUCCESS && ref != auth_ctx &&
+   memcmp(mac1, mac2, mac1_len) == 0, "shared context after a key change");
+sc_ctx_free(&ref);
+OK(ref == NULL, "sc_ctx_free() clears the pointer");
+
+netsnmp_get_monotonic_clock(&start);
+for (i = 0; i < iterations; i++) {
+    ct1_len = sizeof(ct1);
+    mac1_len = sizeof(mac1);
+    sc_encrypt(priv_oid, 10, priv_key, sizeof(priv_key), iv, sizeof(iv),
+               msg, sizeof(msg), ct1, &ct1_len);
+    sc_generate_keyed_hash(auth_oid, 10, auth_key, sizeof(auth_key),
+                           ct1, ct1_len, mac1, &mac1_len);
+}
+netsnmp_get_monotonic_clock(&end);
+usec = (end.tv_sec - start.tv_sec) * 1000000 + end.tv_usec - start.tv_usec;
+printf("# authPriv uncached: %ld ns/message\n", usec * 1000 / iterations);
+
+netsnmp_get_monotonic_clock(&start);
+for (i = 0; i < iterations; i++) {
+    ct2_len = sizeof(ct2);
+    mac2_len = sizeof(mac2);
+    sc_encrypt_ctx(&priv_ctx, priv_oid, 10, priv_key, sizeof(priv_key), iv,
+                   sizeof(iv), msg, sizeof(msg), ct2, &ct2_len);
+    sc_generate_keyed_hash_ctx(&auth_ctx, auth_oid, 10, auth_key,
+                               sizeof(auth_key), ct2, ct2_len, mac2,
+                               &mac2_len);
+}
+netsnmp_get_monotonic_clock(&end);
+usec = (end.tv_sec - start.tv_sec) * 1000000 + end.tv_usec - start.tv_usec;
+printf("# authPriv cached:   %ld ns/message\n", usec * 1000 / iterations);
+
+sc_ctx_free(&auth_ctx);
+sc_ctx_free(&priv_ctx);
@@ -0,0 +1,112 @@
+/* HEADER OID comparison implementations */
+/*
+ * Every implementation of the OID comparison functions (see
+ * netsnmp_oid_compare_impl()) must give the same results as comparing
+ * one sub-identifier at a time, for all lengths, mismatch positions and
+ * alignments.
+ */
+
+static const char *impls[] = { "scalar", "sse2", "avx2" };
+static const oid values[] = {
+    0, 1, 2, 0x7fffffffUL, 0x80000000UL, 0xffffffffUL,
+#if ULONG_MAX > 0xffffffffUL
+    0x100000000UL, 0x8000000000000000UL, 0xffffffffffffffffUL,
+#endif
+};
+#define MAXLEN 40
+#define NVALUES (sizeof(values) / sizeof(values[0]))
+oid             buf1[MAXLEN + 4], buf2[MAXLEN + 4];
+oid            *name1, *name2;
+const char     *impl;
+size_t          ii, len1, len2, pos, v, align, min_len, max_len, i;
+size_t          offpt;
+int             expect, expect_n, expect_off, rc, bad;
+
+for (ii = 0; ii < sizeof(impls) / sizeof(impls[0]); ii++) {
+    impl = netsnmp_oid_compare_impl(impls[ii]);
+    if (!impl) {
+        OKF(1, ("%s: not supported by this CPU", impls[ii]));
+        continue;
+    }
+    bad = 0;
+    for (align = 0; align < 4 && !bad; align++) {
+        name1 = buf1 + align;
+        name2 = buf2 + (3 - align);
+        for (len1 = 0; len1 <= MAXLEN && !bad; len1++) {
+            for (len2 = len1 ? len1 - 1 : 0; len2 <= len1 + 1 && len2 <= MAXLEN;
+                 len2++) {
+                min_len = len1 < len2 ? len1 : len2;
+                /* pos == min_len: no mismatch within the shorter OID */
+                for (pos = 0; pos <= min_len; pos++) {
+                    for (v = 0; v < NVALUES; v++) {
+                        for (i = 0; i < MAXLEN; i++)
+                            name1[i] = name2[i] = 1000 + i * 7;
+                        if (pos < min_len) {
+                            name1[pos] = values[v];
+                            name2[pos] = values[(v + 1) % NVALUES];
+                        } else if (v > 0)
+                            continue;
+
+                        /* the expected results, one sub-id at a time */
+                        for (i = 0; i < min_len; i++)
+                            if (name1[i] != name2[i])
+                                break;
+                        expect_off = i + 1;
+                        if (i < min_len)
+                            expect = name1[i] < name2[i] ? -1 : 1;
+                        else
+                            expect = len1 < len2 ? -1 : len1 > len2;
+
+                        if (snmp_oid_compare(name1, len1, name2, len2)
+                            != expect)
+                            bad = 1;
+                        if (snmp_oid_compare(name2, len2, name1, len1)
+                            != -expect)
+                            bad = 1;
+                        rc = netsnmp_oid_compare_ll(name1, len1, name2, len2,
+                                                    &offpt);
+                        if (rc != expect || offpt != (size_t) expect_off)
+                            bad = 1;
+                        for (max_len = 0; max_len <= MAXLEN; max_len += 3) {
+                            if (i < min_len && i < max_len)
+                                expect_n = expect;
+                            else if (min_len >= max_len)
+                                expect_n = 0;
+                            else
+                                expect_n = expect;
+                            if (snmp_oid_ncompare(name1, len1, name2, len2,
+                                                  max_len) != expect_n)
+                                bad = 1;
+                        }
+                        if ((netsnmp_oid_equals(name1, len1, name2, len2)
+                             == 0) != (expect == 0))
+                            bad = 1;
+                        if ((netsnmp_oid_is_subtree(name1, len1, name2, len2)
+                             == 0) != (len1 <= len2 && i >= len1))
+                            bad = 1;
+                        if (netsnmp_oid_find_prefix(name1, len1, name2, len2)
+                            != (len1 && len2 ? (int) i : -1))
+                            bad = 1;
+                        if (bad) {
+                            OKF(0, ("%s: len1 %d len2 %d mismatch at %d"
+                                    " value %d align %d", impl, (int) len1,
+                                    (int) len2, (int) pos, (int) v,
+                                    (int) align));
+                            break;
+                        }
+                    }
+                    if (bad)
+                        break;
+                }
+                if (bad)
+                    break;
+            }
+        }
+    }
+    OKF(!bad, ("%s: same results as comparing one sub-identifier at a time",
+               impl));
+}
+
+OKF(netsnmp_oid_compare_impl("none") == NULL, ("unknown implementation"));
+impl = netsnmp_oid_compare_impl(NULL);
+OKF(impl != NULL, ("default implementation: %s", impl ? impl : "(none)"));
@@ -0,0 +1,68 @@
+/* HEADER Cached OID encoding */
+/*
+ * asn_realloc_rbuild_objid_cached() must give the same results as
+ * asn_realloc_rbuild_objid() for sequences of OIDs that share prefixes of
+ * every length, including invalid ones.
+ */
+
+static const oid column[] = { 1, 3, 6, 1, 2, 1, 2, 2, 1, 2 };
+static const oid subids[] = { 0, 1, 39, 40, 127, 128, 16383, 16384,
+                              0x7fffffffUL, 0xffffffffUL };
+netsnmp_oid_cache cache;
+oid             name[MAX_OID_LEN], prev[MAX_OID_LEN];
+u_char         *pkt1, *pkt2;
+size_t          pkt1_len = 16, pkt2_len = 16, off1, off2;
+size_t          name_len, prev_len = 0;
+unsigned int    seed = 1, r;
+int             n, rc1, rc2, same = 1, built = 0;
+
+pkt1 = malloc(pkt1_len);
+pkt2 = malloc(pkt2_len);
+cache.name_len = 0;
+
+for (n = 0; n < 20000; n++) {
+    seed = seed * 1103515245 + 12345;
+    r = seed >> 8;
+
+    /* keep a prefix of the previous OID, or start from a column */
+    if (prev_len && r % 4) {
+        name_len = r % (prev_len + 1);
+        memcpy(name, prev, name_len * sizeof(oid));
+    } else {
+        name_len = (r >> 4) % (OID_LENGTH(column) + 1);
+        memcpy(name, column, name_len * sizeof(oid));
+    }
+    while (name_len < (r >> 8) % 24) {
+        seed = seed * 1103515245 + 12345;
+        name[name_len] = subids[(seed >> 8) % OID_LENGTH(subids)];
+        if (name_len == 0)
+            name[0] %= 3;
+        name_len++;
+    }
+    if (name_len > 1 && r % 7 == 0)
+        name[1] = 40 + r % 50;  /* sometimes invalid */
+    memcpy(prev, name, name_len * sizeof(oid));
+    prev_len = name_len;
+
+    off1 = off2 = 0;
+    rc1 = asn_realloc_rbuild_objid(&pkt1, &pkt1_len, &off1, 1, ASN_OBJECT_ID,
+                                   name, name_len);
+    rc2 = asn_realloc_rbuild_objid_cached(&pkt2, &pkt2_len, &off2, 1,
+                                          ASN_OBJECT_ID, name, name_len,
+                                          &cache);
+    /* a failed encoding may leave different bytes behind */
+    if (rc1 != rc2 || (rc1 && off1 != off2) ||
+        (rc1 && memcmp(pkt1 + pkt1_len - off1, pkt2 + pkt2_len - off2,
+                       off1) != 0)) {
+        if (same)
+            OKF(0, ("encoding OID %d differs", n));
+        same = 0;
+    }
+    built += rc1;
+}
+
+OKF(same, ("cached encoding matches asn_realloc_rbuild_objid()"));
+OKF(built > 10000, ("%d of %d OIDs encoded", built, n));
+
+free(pkt1);
+free(pkt2);
@@ -0,0 +1,95 @@
+/* HEADER Request expiry and retries */
+/*
+ * An unanswered request is resent session.retries times and then
+ * dropped, and a request that can't be resent for the moment doesn't
+ * stop snmp_sess_timeout() from returning.
+ */
+
+SOCK_STARTUP;
+
+netsnmp_session     session;
+struct session_list *sessp;
+netsnmp_transport  *transport;
+netsnmp_pdu        *pdu;
+struct sockaddr_in  addr;
+socklen_t           addr_len = sizeof(addr);
+struct timeval      timeout;
+fd_set              fdset;
+char                peername[64], buf[1500];
+u_char              community[] = "public";
+int                 sock, numfds, block, i, packets;
+
+/* a peer which never answers */
+sock = socket(AF_INET, SOCK_DGRAM, 0);
+memset(&addr, 0, sizeof(addr));
+addr.sin_family = AF_INET;
+addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+OKF(sock >= 0 && bind(sock, (struct sockaddr *)&addr, sizeof(addr)) == 0 &&
+    getsockname(sock, (struct sockaddr *)&addr, &addr_len) == 0,
+    ("bound the peer's socket"));
+
+FD_ZERO(&fdset);
+init_snmp("testing");
+snmp_sess_init(&session);
+#if !defined(NETSNMP_DISABLE_SNMPV2C)
+session.version = SNMP_VERSION_2c;
+#else
+session.version = SNMP_VERSION_1;
+#endif
+snprintf(peername, sizeof(peername), "udp:127.0.0.1:%d",
+         ntohs(addr.sin_port));
+session.peername = peername;
+session.community = community;
+session.community_len = strlen((char *) community);
+session.retries = 2;
+session.timeout = 10000;
+sessp = snmp_sess_open(&session);
+OKF(sessp != NULL, ("opened a session to %s", peername));
+
+#define REQUEST_PENDING()                                               \
+    (numfds = 0, block = 0,                                             \
+     snmp_sess_select_info_flags(sessp, &numfds, &fdset, &timeout,      \
+                                 &block, NETSNMP_SELECT_NOALARMS),      \
+     !block)
+
+#define COUNT_PACKETS()                                                 \
+    for (packets = 0;                                                   \
+         recv(sock, buf, sizeof(buf), MSG_DONTWAIT) > 0; packets++)
+
+/* the request is sent, resent twice and then dropped */
+pdu = snmp_pdu_create(SNMP_MSG_GET);
+snmp_add_null_var(pdu, (const oid[]) { 1, 3, 6, 1, 2, 1, 1, 1, 0 }, 9);
+OKF(snmp_sess_async_send(sessp, pdu, NULL, NULL) != 0, ("sent a request"));
+OKF(REQUEST_PENDING(), ("the request is outstanding"));
+for (i = 0; i < 200 && REQUEST_PENDING(); i++) {
+    usleep(5000);
+    snmp_sess_timeout(sessp);
+}
+OKF(!REQUEST_PENDING(), ("the request expired"));
+COUNT_PACKETS();
+OKF(packets == 3, ("the request was sent %d times", packets));
+
+/* a request that can't be resent is kept for later */
+pdu = snmp_pdu_create(SNMP_MSG_GET);
+snmp_add_null_var(pdu, (const oid[]) { 1, 3, 6, 1, 2, 1, 1, 1, 0 }, 9);
+OKF(snmp_sess_async_send(sessp, pdu, NULL, NULL) != 0, ("sent a request"));
+transport = snmp_sess_transport(sessp);
+snmp_sess_transport_set(sessp, NULL);
+usleep(20000);
+snmp_sess_timeout(sessp);
+snmp_sess_timeout(sessp);
+snmp_sess_transport_set(sessp, transport);
+OKF(REQUEST_PENDING(), ("the request is still outstanding"));
+for (i = 0; i < 200 && REQUEST_PENDING(); i++) {
+    usleep(5000);
+    snmp_sess_timeout(sessp);
+}
+OKF(!REQUEST_PENDING(), ("the request expired"));
+COUNT_PACKETS();
+OKF(packets == 3, ("the request was sent %d times", packets));
+
+snmp_sess_close(sessp);
+close(sock);
+snmp_shutdown("testing");
+
+SOCK_CLEANUP;
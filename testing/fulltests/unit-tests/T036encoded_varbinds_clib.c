@@ -0,0 +1,113 @@
+/* HEADER Sending pre-encoded variable-bindings */
+/*
+ * snmp_async_send_encoded() must send the same packet as
+ * snmp_async_send(), and a copy of the PDU whose variables were changed
+ * afterwards must be sent with the new variables.
+ */
+
+SOCK_STARTUP;
+
+netsnmp_session     session, *ss;
+netsnmp_pdu        *template_pdu, *pdu;
+netsnmp_encoded_varbinds *ev;
+struct sockaddr_in  addr;
+socklen_t           addr_len = sizeof(addr);
+char                peername[64];
+u_char              buf1[1500], buf2[1500], buf3[1500];
+u_char              community[] = "public";
+const oid           descr[] = { 1, 3, 6, 1, 2, 1, 1, 1, 0 };
+const oid           contact[] = { 1, 3, 6, 1, 2, 1, 1, 4, 0 };
+long                uptime = 4242;
+ssize_t             len1, len2, len3;
+int                 sock, i, found_old, found_new, found_added;
+
+/* a notification receiver */
+sock = socket(AF_INET, SOCK_DGRAM, 0);
+memset(&addr, 0, sizeof(addr));
+addr.sin_family = AF_INET;
+addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+OKF(sock >= 0 && bind(sock, (struct sockaddr *)&addr, sizeof(addr)) == 0 &&
+    getsockname(sock, (struct sockaddr *)&addr, &addr_len) == 0,
+    ("bound the receiver's socket"));
+
+init_snmp("testing");
+snmp_sess_init(&session);
+#if !defined(NETSNMP_DISABLE_SNMPV2C)
+session.version = SNMP_VERSION_2c;
+#else
+session.version = SNMP_VERSION_1;
+#endif
+snprintf(peername, sizeof(peername), "udp:127.0.0.1:%d",
+         ntohs(addr.sin_port));
+session.peername = peername;
+session.community = community;
+session.community_len = strlen((char *) community);
+ss = snmp_open(&session);
+OKF(ss != NULL, ("opened a session to %s", peername));
+
+#define SEND(send, rbuf, rlen)                                          \
+    do {                                                                \
+        pdu->reqid = pdu->msgid = 1234;                                 \
+        OKF(send != 0, ("sent " #send));                                \
+        rlen = recv(sock, rbuf, sizeof(rbuf), MSG_DONTWAIT);            \
+    } while (0)
+
+#define CONTAINS(found, rbuf, rlen, str)                                \
+    do {                                                                \
+        found = 0;                                                      \
+        for (i = 0; i + (ssize_t) strlen(str) <= rlen; i++)             \
+            if (memcmp(rbuf + i, str, strlen(str)) == 0)                \
+                found = 1;                                              \
+    } while (0)
+
+template_pdu = snmp_pdu_create(SNMP_MSG_TRAP2);
+snmp_pdu_add_variable(template_pdu, descr, OID_LENGTH(descr),
+                      ASN_OCTET_STR, "original value", 14);
+snmp_pdu_add_variable(template_pdu, contact, OID_LENGTH(contact),
+                      ASN_TIMETICKS, &uptime, sizeof(uptime));
+ev = snmp_pdu_encode_variables(template_pdu);
+OKF(ev != NULL, ("encoded the variables"));
+
+/* the same packet, built from the encoding or from the variables */
+pdu = snmp_clone_pdu(template_pdu);
+SEND(snmp_async_send_encoded(ss, pdu, ev, NULL, NULL), buf1, len1);
+pdu = snmp_clone_pdu(template_pdu);
+SEND(snmp_async_send(ss, pdu, NULL, NULL), buf2, len2);
+OKF(len1 > 0 && len1 == len2 && memcmp(buf1, buf2, len1) == 0,
+    ("the same packet (%d and %d bytes)", (int) len1, (int) len2));
+
+/* the variable-bindings really are copied from the encoding */
+pdu = snmp_clone_pdu(template_pdu);
+snmp_set_var_typed_value(pdu->variables, ASN_OCTET_STR, "changed", 7);
+SEND(snmp_async_send_encoded(ss, pdu, ev, NULL, NULL), buf3, len3);
+OKF(len3 == len1 && memcmp(buf1, buf3, len1) == 0,
+    ("snmp_async_send_encoded() sends the encoded variables"));
+
+/* a copy with other variables is not sent with the encoding */
+pdu = snmp_clone_pdu(template_pdu);
+snmp_set_var_typed_value(pdu->variables, ASN_OCTET_STR, "changed", 7);
+snmp_add_var(pdu, contact, OID_LENGTH(contact), 's', "added value");
+SEND(snmp_async_send(ss, pdu, NULL, NULL), buf3, len3);
+CONTAINS(found_old, buf3, len3, "original value");
+CONTAINS(found_new, buf3, len3, "changed");
+CONTAINS(found_added, buf3, len3, "added value");
+OKF(len3 > 0 && !found_old && found_new && found_added,
+    ("a changed copy is sent with its own variables"));
+
+/* and neither is the template, once changed */
+snmp_set_var_typed_value(template_pdu->variables, ASN_OCTET_STR,
+                         "changed", 7);
+pdu = snmp_clone_pdu(template_pdu);
+SEND(snmp_async_send(ss, pdu, NULL, NULL), buf3, len3);
+CONTAINS(found_old, buf3, len3, "original value");
+CONTAINS(found_new, buf3, len3, "changed");
+OKF(len3 > 0 && !found_old && found_new,
+    ("the changed template is sent with its new variables"));
+
+snmp_free_encoded_variables(ev);
+snmp_free_pdu(template_pdu);
+snmp_close(ss);
+close(sock);
+snmp_shutdown("testing");
+
+SOCK_CLEANUP;
@@ -0,0 +1,84 @@
+/* HEADER Debug call sites follow token changes */
+/*
+ * A DEBUGMSGTL() call site remembers whether its token is enabled.  It
+ * must notice every later change of the token set: new tokens, tokens
+ * enabled or disabled, and "print everything" being switched on or off.
+ * A site whose token is a buffer must follow changes of its contents.
+ */
+
+#ifndef NETSNMP_NO_DEBUGGING
+static const char *changes[] = {
+    "none", "none", "register", "none", "disable", "enable", "disable",
+    "all", "not all", "other token",
+};
+/* whether the site is expected to print after each change */
+static const int expected[] = { 0, 0, 1, 1, 0, 1, 0, 1, 0, 0 };
+#define PHASES (sizeof(expected) / sizeof(expected[0]))
+char            logfile[64], logopt[80], line[256], tokbuf[32];
+int             printed[PHASES], printed_unset = 0, printed_other = 0;
+FILE           *fp;
+unsigned int    phase;
+int             n;
+
+snprintf(logfile, sizeof(logfile), "/tmp/T037debug_site.%d.log",
+         (int) getpid());
+snprintf(logopt, sizeof(logopt), "f%s", logfile);
+snmp_disable_log();
+snmp_log_options(logopt, 0, NULL);
+snmp_set_do_debugging(1);
+debug_register_tokens("T037other");
+
+for (phase = 0; phase < PHASES; phase++) {
+    if (strcmp(changes[phase], "register") == 0)
+        debug_register_tokens("T037site");
+    else if (strcmp(changes[phase], "disable") == 0)
+        debug_disable_token_logs("T037site");
+    else if (strcmp(changes[phase], "enable") == 0)
+        debug_enable_token_logs("T037site");
+    else if (strcmp(changes[phase], "all") == 0)
+        snmp_set_do_debugoutputall(1);
+    else if (strcmp(changes[phase], "not all") == 0)
+        snmp_set_do_debugoutputall(0);
+    else if (strcmp(changes[phase], "other token") == 0)
+        debug_register_tokens("T037siteother");
+    /* the same call site every time */
+    DEBUGMSGTL(("T037site", "phase %u\n", phase));
+}
+
+/* one buffer, rewritten like the token passed to config handlers */
+for (n = 0; n < 2; n++) {
+    strcpy(tokbuf, n == 0 ? "T037unset" : "T037other");
+    DEBUGMSGTL((tokbuf, "buffer %s\n", tokbuf));
+}
+
+snmp_set_do_debugging(0);
+snmp_disable_log();
+
+memset(printed, 0, sizeof(printed));
+fp = fopen(logfile, "r");
+OKF(fp != NULL, ("read the log file %s", logfile));
+while (fp && fgets(line, sizeof(line), fp)) {
+    const char     *cp = strstr(line, "T037site: phase ");
+
+    if (cp && sscanf(cp + 16, "%d", &n) == 1 && n >= 0 &&
+        n < (int) PHASES)
+        printed[n]++;
+    if (strstr(line, "buffer T037unset"))
+        printed_unset++;
+    if (strstr(line, "buffer T037other"))
+        printed_other++;
+}
+if (fp)
+    fclose(fp);
+unlink(logfile);
+
+for (phase = 0; phase < PHASES; phase++)
+    OKF(printed[phase] == expected[phase],
+        ("after \"%s\": printed %d times, expected %d", changes[phase],
+         printed[phase], expected[phase]));
+OKF(printed_unset == 0 && printed_other == 1,
+    ("a token buffer with new contents: printed %d and %d times, "
+     "expected 0 and 1", printed_unset, printed_other));
+#else
+OKF(1, ("debugging is not supported"));
+#endif /* NETSNMP_NO_DEBUGGING */
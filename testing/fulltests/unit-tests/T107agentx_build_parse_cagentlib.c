@@ -0,0 +1,84 @@
+/* HEADER AgentX build/parse round trip with a reused buffer */
+/*
+ * Encode a response carrying long OIDs and octet strings, parse it back
+ * and compare.  The packet is encoded repeatedly into the same buffer, the
+ * way a session reuses its send buffer, and must not need to grow after
+ * the first packet.  "make microbench" reports the time and allocations
+ * per packet (agentx/build and agentx/parse).
+ */
+
+netsnmp_session session;
+netsnmp_pdu *pdu, *parsed;
+netsnmp_variable_list *vp, *vp2;
+oid             name[100], value[MAX_OID_LEN];
+u_char          string[300];
+u_char         *buf = NULL;
+size_t          buf_len = 0, out_len, first_len = 0;
+int             i, rc, grew = 0, same = 1;
+
+memset(&session, 0, sizeof(session));
+session.version = AGENTX_VERSION_1;
+
+for (i = 0; i < (int) OID_LENGTH(name); i++)
+    name[i] = i + 1;
+for (i = 0; i < (int) OID_LENGTH(value); i++)
+    value[i] = 4000000000U - i;
+for (i = 0; i < (int) sizeof(string); i++)
+    string[i] = i & 0xff;
+
+pdu = snmp_pdu_create(AGENTX_MSG_RESPONSE);
+pdu->sessid = 1;
+pdu->transid = 2;
+pdu->reqid = 3;
+pdu->flags |= AGENTX_FLAGS_NETWORK_BYTE_ORDER;
+for (i = 0; i < 20; i++) {
+    name[OID_LENGTH(name) - 1] = i;
+    snmp_pdu_add_variable(pdu, name, OID_LENGTH(name), ASN_OCTET_STR,
+                          string, sizeof(string) - i);
+    snmp_pdu_add_variable(pdu, name, 40, ASN_OBJECT_ID,
+                          value, sizeof(value));
+    snmp_pdu_add_variable(pdu, name, 12, ASN_INTEGER, &i, sizeof(i));
+}
+
+for (i = 0; i < 2; i++) {
+    u_char         *old = buf;
+    size_t          old_len = buf_len;
+
+    if (buf == NULL) {
+        buf_len = SNMP_MIN_MAX_LEN;
+        buf = malloc(buf_len);
+    }
+    out_len = 0;
+    rc = agentx_realloc_build(&session, pdu, &buf, &buf_len, &out_len);
+    OKF(rc == 0, ("agentx_realloc_build() pass %d", i));
+    if (i == 0)
+        first_len = out_len;
+    else
+        grew = (buf != old || buf_len != old_len);
+}
+OKF(!grew, ("second build reuses the buffer (%" NETSNMP_PRIz "u bytes)",
+            buf_len));
+OKF(out_len == first_len, ("identical encodings (%" NETSNMP_PRIz "u bytes)",
+                           out_len));
+
+parsed = snmp_pdu_create(0);
+rc = agentx_parse(&session, parsed, buf, out_len);
+OKF(rc == 0, ("agentx_parse() of %" NETSNMP_PRIz "u bytes", out_len));
+
+for (vp = pdu->variables, vp2 = parsed->variables; vp && vp2;
+     vp = vp->next_variable, vp2 = vp2->next_variable) {
+    if (vp->type != vp2->type || vp->val_len != vp2->val_len ||
+        snmp_oid_compare(vp->name, vp->name_length,
+                         vp2->name, vp2->name_length) != 0 ||
+        memcmp(vp->val.string, vp2->val.string, vp->val_len) != 0) {
+        printf("# mismatch: type %d/%d len %d/%d\n", vp->type, vp2->type,
+               (int) vp->val_len, (int) vp2->val_len);
+        same = 0;
+    }
+}
+OKF(same && vp == NULL && vp2 == NULL, ("parsed varbinds match"));
+snmp_free_pdu(parsed);
+
+free(buf);
+snmp_free_pdu(pdu);
+netsnmp_cleanup_session(&session);
@@ -0,0 +1,1354 @@
+/*
+ * snmplibbench.c - microbenchmarks for the hot paths of the library.
+ *
+ * Each benchmark runs its operation in a loop, growing the number of
+ * iterations until the loop takes at least the minimum time, and
+ * reports the time and the number of heap allocations per operation.
+ * Run by "make microbench" in the testing directory; give benchmark
+ * name prefixes as arguments to run only some of them.
+ */
+#include <net-snmp/net-snmp-config.h>
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#include <strings.h>
+#endif
+#include <sys/types.h>
+#ifdef TIME_WITH_SYS_TIME
+# include <sys/time.h>
+# include <time.h>
+#else
+# ifdef HAVE_SYS_TIME_H
+#  include <sys/time.h>
+# else
+#  include <time.h>
+# endif
+#endif
+#include <stdio.h>
+#ifdef HAVE_SYS_SOCKET_H
+#include <sys/socket.h>
+#endif
+#ifdef HAVE_NETINET_IN_H
+#include <netinet/in.h>
+#endif
+
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/library/container.h>
+#include <net-snmp/library/snmpusm.h>
+#include <net-snmp/library/scapi.h>
+#include <net-snmp/library/transform_oids.h>
+#ifdef NETSNMP_BENCH_AGENTX
+#include <net-snmp/agent/net-snmp-agent-includes.h>
+#include <agentx/protocol.h>
+#endif
+
+/*
+ * Allocations are counted by interposing malloc, which needs the
+ * glibc entry points behind it; elsewhere only times are reported.
+ * realloc() counts as an allocation.
+ */
+#if defined(__GLIBC__)
+#define BENCH_COUNT_ALLOCS 1
+
+extern void    *__libc_malloc(size_t);
+extern void    *__libc_calloc(size_t, size_t);
+extern void    *__libc_realloc(void *, size_t);
+
+static int      counting;
+static unsigned long alloc_count;
+
+void *
+malloc(size_t size)
+{
+    if (counting)
+        alloc_count++;
+    return __libc_malloc(size);
+}
+
+void *
+calloc(size_t nmemb, size_t size)
+{
+    if (counting)
+        alloc_count++;
+    return __libc_calloc(nmemb, size);
+}
+
+void *
+realloc(void *ptr, size_t size)
+{
+    if (counting)
+        alloc_count++;
+    return __libc_realloc(ptr, size);
+}
+#endif /* __GLIBC__ */
+
+typedef struct bench_s {
+    const char     *name;
+    void            (*run)(long n);
+} bench;
+
+/*
+ * the state of the benchmark being run
+ */
+static struct {
+    struct timeval  start;
+    double          elapsed_ns;
+    const char     *skipped;
+} timer;
+
+static int      min_msec = 500;
+static int      json;
+
+static volatile long sink;
+
+static void
+bench_start(void)
+{
+    netsnmp_get_monotonic_clock(&timer.start);
+#ifdef BENCH_COUNT_ALLOCS
+    counting = 1;
+#endif
+}
+
+static void
+bench_stop(void)
+{
+    struct timeval  now, diff;
+
+#ifdef BENCH_COUNT_ALLOCS
+    counting = 0;
+#endif
+    netsnmp_get_monotonic_clock(&now);
+    NETSNMP_TIMERSUB(&now, &timer.start, &diff);
+    timer.elapsed_ns += diff.tv_sec * 1e9 + diff.tv_usec * 1e3;
+}
+
+static void
+bench_skip(const char *why)
+{
+    timer.skipped = why;
+}
+
+/*
+ * test data
+ */
+static const oid if_descr_1[] = { 1, 3, 6, 1, 2, 1, 2, 2, 1, 2, 1 };
+static const oid if_descr_2[] = { 1, 3, 6, 1, 2, 1, 2, 2, 1, 2, 2 };
+static const oid long_oid[] = { 1, 3, 6, 1, 4, 1, 8072, 2, 2, 4, 2, 1, 2,
+    10, 200, 3000, 40000, 500000, 6000000, 70000000, 4294967295U };
+
+#define BENCH_STRING "Linux host 6.1.0 #1 SMP x86_64, a typical sysDescr value"
+
+static void
+bench_oid_compare_equal(long n)
+{
+    long            i;
+
+    bench_start();
+    for (i = 0; i < n; i++)
+        sink += snmp_oid_compare(if_descr_1, OID_LENGTH(if_descr_1),
+                                 if_descr_1, OID_LENGTH(if_descr_1));
+    bench_stop();
+}
+
+static void
+bench_oid_compare_last(long n)
+{
+    long            i;
+
+    bench_start();
+    for (i = 0; i < n; i++)
+        sink += snmp_oid_compare(if_descr_1, OID_LENGTH(if_descr_1),
+                                 if_descr_2, OID_LENGTH(if_descr_2));
+    bench_stop();
+}
+
+static void
+bench_oid_compare_long(long n)
+{
+    long            i;
+
+    bench_start();
+    for (i = 0; i < n; i++)
+        sink += snmp_oid_compare(long_oid, OID_LENGTH(long_oid),
+                                 long_oid, OID_LENGTH(long_oid) - 1);
+    bench_stop();
+}
+
+static void
+bench_oid_compare_ll(long n)
+{
+    size_t          offset;
+    long            i;
+
+    bench_start();
+    for (i = 0; i < n; i++)
+        sink += netsnmp_oid_compare_ll(if_descr_1, OID_LENGTH(if_descr_1),
+                                       if_descr_2, OID_LENGTH(if_descr_2),
+                                       &offset);
+    bench_stop();
+    sink += offset;
+}
+
+static void
+bench_oid_ncompare(long n)
+{
+    long            i;
+
+    bench_start();
+    for (i = 0; i < n; i++)
+        sink += snmp_oid_ncompare(long_oid, OID_LENGTH(long_oid),
+                                  long_oid, OID_LENGTH(long_oid),
+                                  OID_LENGTH(long_oid) - 1);
+    bench_stop();
+}
+
+static void
+bench_oid_equals(long n)
+{
+    long            i;
+
+    bench_start();
+    for (i = 0; i < n; i++)
+        sink += netsnmp_oid_equals(long_oid, OID_LENGTH(long_oid),
+                                   long_oid, OID_LENGTH(long_oid));
+    bench_stop();
+}
+
+static void
+bench_oid_is_subtree(long n)
+{
+    long            i;
+
+    bench_start();
+    for (i = 0; i < n; i++)
+        sink += netsnmp_oid_is_subtree(long_oid, 13, long_oid,
+                                       OID_LENGTH(long_oid));
+    bench_stop();
+}
+
+static void
+bench_oid_find_prefix(long n)
+{
+    long            i;
+
+    bench_start();
+    for (i = 0; i < n; i++)
+        sink += netsnmp_oid_find_prefix(long_oid, OID_LENGTH(long_oid),
+                                        long_oid, OID_LENGTH(long_oid) - 1);
+    bench_stop();
+}
+
+static void
+bench_asn_build_int(long n)
+{
+    u_char          buf[16];
+    size_t          len;
+    long            value = 123456789, i;
+
+    bench_start();
+    for (i = 0; i < n; i++) {
+        len = sizeof(buf);
+        asn_build_int(buf, &len, ASN_INTEGER, &value, sizeof(value));
+    }
+    bench_stop();
+}
+
+static void
+bench_asn_parse_int(long n)
+{
+    u_char          buf[16], type;
+    size_t          len = sizeof(buf);
+    long            value = 123456789, i;
+
+    asn_build_int(buf, &len, ASN_INTEGER, &value, sizeof(value));
+    bench_start();
+    for (i = 0; i < n; i++) {
+        len = sizeof(buf);
+        asn_parse_int(buf, &len, &type, &value, sizeof(value));
+    }
+    bench_stop();
+    sink += value;
+}
+
+static void
+bench_asn_build_counter64(long n)
+{
+    struct counter64 value = { 0x12345678, 0x9abcdef0 };
+    u_char          buf[16];
+    size_t          len;
+    long            i;
+
+    bench_start();
+    for (i = 0; i < n; i++) {
+        len = sizeof(buf);
+        asn_build_unsigned_int64(buf, &len, ASN_COUNTER64, &value,
+                                 sizeof(value));
+    }
+    bench_stop();
+}
+
+static void
+bench_asn_parse_counter64(long n)
+{
+    struct counter64 value = { 0x12345678, 0x9abcdef0 };
+    u_char          buf[16], type;
+    size_t          len = sizeof(buf);
+    long            i;
+
+    asn_build_unsigned_int64(buf, &len, ASN_COUNTER64, &value,
+                             sizeof(value));
+    bench_start();
+    for (i = 0; i < n; i++) {
+        len = sizeof(buf);
+        asn_parse_unsigned_int64(buf, &len, &type, &value, sizeof(value));
+    }
+    bench_stop();
+    sink += value.low;
+}
+
+static void
+bench_asn_build_string(long n)
+{
+    u_char          buf[128];
+    size_t          len;
+    long            i;
+
+    bench_start();
+    for (i = 0; i < n; i++) {
+        len = sizeof(buf);
+        asn_build_string(buf, &len, ASN_OCTET_STR,
+                         (const u_char *) BENCH_STRING,
+                         sizeof(BENCH_STRING) - 1);
+    }
+    bench_stop();
+}
+
+static void
+bench_asn_parse_string(long n)
+{
+    u_char          buf[128], str[128], type;
+    size_t          len = sizeof(buf), str_len;
+    long            i;
+
+    asn_build_string(buf, &len, ASN_OCTET_STR,
+                     (const u_char *) BENCH_STRING,
+                     sizeof(BENCH_STRING) - 1);
+    bench_start();
+    for (i = 0; i < n; i++) {
+        len = sizeof(buf);
+        str_len = sizeof(str);
+        asn_parse_string(buf, &len, &type, str, &str_len);
+    }
+    bench_stop();
+    sink += str_len;
+}
+
+static void
+bench_asn_build_objid(long n)
+{
+    u_char          buf[128];
+    size_t          len;
+    long            i;
+
+    bench_start();
+    for (i = 0; i < n; i++) {
+        len = sizeof(buf);
+        asn_build_objid(buf, &len, ASN_OBJECT_ID, long_oid,
+                        OID_LENGTH(long_oid));
+    }
+    bench_stop();
+}
+
+static void
+bench_asn_parse_objid(long n)
+{
+    u_char          buf[128], type;
+    oid             name[MAX_OID_LEN];
+    size_t          len = sizeof(buf), name_len;
+    long            i;
+
+    asn_build_objid(buf, &len, ASN_OBJECT_ID, long_oid,
+                    OID_LENGTH(long_oid));
+    bench_start();
+    for (i = 0; i < n; i++) {
+        len = sizeof(buf);
+        name_len = MAX_OID_LEN;
+        asn_parse_objid(buf, &len, &type, name, &name_len);
+    }
+    bench_stop();
+    sink += name_len;
+}
+
+static void
+bench_asn_rbuild_objid(long n)
+{
+    u_char          buf[128], *pkt = buf;
+    size_t          pkt_len = sizeof(buf), offset;
+    long            i;
+
+    bench_start();
+    for (i = 0; i < n; i++) {
+        offset = 0;
+        asn_realloc_rbuild_objid(&pkt, &pkt_len, &offset, 0, ASN_OBJECT_ID,
+                                 long_oid, OID_LENGTH(long_oid));
+    }
+    bench_stop();
+}
+
+/*
+ * the names in a GETBULK walk of three ifTable columns
+ */
+#define WALK_OIDS 75
+static oid      walk_oids[WALK_OIDS][11];
+
+static void
+bench_init_walk(void)
+{
+    static const oid column[] = { 1, 3, 6, 1, 2, 1, 2, 2, 1, 0, 0 };
+    static const int columns[] = { 2, 3, 10 };
+    int             i;
+
+    for (i = 0; i < WALK_OIDS; i++) {
+        memcpy(walk_oids[i], column, sizeof(column));
+        walk_oids[i][9] = columns[i % 3];
+        walk_oids[i][10] = i / 3 + 1;
+    }
+}
+
+static void
+bench_asn_rbuild_objid_walk(long n, netsnmp_oid_cache *cache)
+{
+    u_char          buf[1024], *pkt = buf;
+    size_t          pkt_len = sizeof(buf), offset = 0;
+    long            i;
+
+    bench_init_walk();
+    if (cache)
+        cache->name_len = 0;
+    bench_start();
+    for (i = 0; i < n; i++) {
+        if (i % WALK_OIDS == 0)
+            offset = 0;
+        asn_realloc_rbuild_objid_cached(&pkt, &pkt_len, &offset, 0,
+                                        ASN_OBJECT_ID,
+                                        walk_oids[i % WALK_OIDS], 11, cache);
+    }
+    bench_stop();
+}
+
+static void
+bench_asn_rbuild_objid_walk_uncached(long n)
+{
+    bench_asn_rbuild_objid_walk(n, NULL);
+}
+
+static void
+bench_asn_rbuild_objid_walk_cached(long n)
+{
+    netsnmp_oid_cache cache;
+
+    bench_asn_rbuild_objid_walk(n, &cache);
+}
+
+static void
+bench_asn_parse_objid_walk(long n)
+{
+    u_char          buf[WALK_OIDS * 16], *data[WALK_OIDS], *p, type;
+    oid             name[MAX_OID_LEN];
+    size_t          len = sizeof(buf), name_len = 0;
+    long            i;
+
+    bench_init_walk();
+    for (i = 0, p = buf; i < WALK_OIDS; i++) {
+        data[i] = p;
+        p = asn_build_objid(p, &len, ASN_OBJECT_ID, walk_oids[i], 11);
+    }
+    bench_start();
+    for (i = 0; i < n; i++) {
+        len = 16;
+        name_len = MAX_OID_LEN;
+        asn_parse_objid(data[i % WALK_OIDS], &len, &type, name, &name_len);
+    }
+    bench_stop();
+    sink += name_len;
+}
+
+/*
+ * a response to a GET of a typical mix of objects
+ */
+static netsnmp_pdu *
+bench_create_pdu(void)
+{
+    static const oid sys_descr[] = { 1, 3, 6, 1, 2, 1, 1, 1, 0 };
+    static const oid sys_object_id[] = { 1, 3, 6, 1, 2, 1, 1, 2, 0 };
+    static const oid sys_uptime[] = { 1, 3, 6, 1, 2, 1, 1, 3, 0 };
+    static const oid if_index[] = { 1, 3, 6, 1, 2, 1, 2, 2, 1, 1, 1 };
+    static const oid if_in_octets[] = { 1, 3, 6, 1, 2, 1, 2, 2, 1, 10, 1 };
+    static const oid if_hc_in[] = { 1, 3, 6, 1, 2, 1, 31, 1, 1, 1, 6, 1 };
+    static const oid ip_addr[] = { 1, 3, 6, 1, 2, 1, 4, 20, 1, 1, 192,
+        168, 1, 1 };
+    static const oid net_snmp[] = { 1, 3, 6, 1, 4, 1, 8072, 3, 2, 10 };
+    static const u_char addr[] = { 192, 168, 1, 1 };
+    struct counter64 c64 = { 1, 0x89abcdef };
+    netsnmp_pdu    *pdu;
+    long            value;
+    u_long          uvalue;
+    int             i;
+
+    pdu = snmp_pdu_create(SNMP_MSG_RESPONSE);
+    pdu->version = SNMP_VERSION_2c;
+    pdu->reqid = 0x12345678;
+    snmp_pdu_add_variable(pdu, sys_descr, OID_LENGTH(sys_descr),
+                          ASN_OCTET_STR, BENCH_STRING,
+                          sizeof(BENCH_STRING) - 1);
+    snmp_pdu_add_variable(pdu, sys_object_id, OID_LENGTH(sys_object_id),
+                          ASN_OBJECT_ID, net_snmp, sizeof(net_snmp));
+    uvalue = 123456789;
+    snmp_pdu_add_variable(pdu, sys_uptime, OID_LENGTH(sys_uptime),
+                          ASN_TIMETICKS, &uvalue, sizeof(uvalue));
+    for (i = 0; i < 3; i++) {
+        value = 1;
+        snmp_pdu_add_variable(pdu, if_index, OID_LENGTH(if_index),
+                              ASN_INTEGER, &value, sizeof(value));
+        uvalue = 4000000000U;
+        snmp_pdu_add_variable(pdu, if_in_octets, OID_LENGTH(if_in_octets),
+                              ASN_COUNTER, &uvalue, sizeof(uvalue));
+    }
+    snmp_pdu_add_variable(pdu, if_hc_in, OID_LENGTH(if_hc_in),
+                          ASN_COUNTER64, &c64, sizeof(c64));
+    snmp_pdu_add_variable(pdu, ip_addr, OID_LENGTH(ip_addr),
+                          ASN_IPADDRESS, addr, sizeof(addr));
+    return pdu;
+}
+
+/*
+ * a response to a GETBULK walking the ifTable: max-repetitions 25 of
+ * ifDescr, ifType and ifInOctets
+ */
+static netsnmp_pdu *
+bench_create_bulk_pdu(void)
+{
+    static const int columns[] = { 2, 3, 10 };
+    oid             name[] = { 1, 3, 6, 1, 2, 1, 2, 2, 1, 0, 0 };
+    netsnmp_pdu    *pdu;
+    long            value = 6;
+    u_long          uvalue = 4000000000U;
+    int             i, j;
+
+    pdu = snmp_pdu_create(SNMP_MSG_RESPONSE);
+    pdu->version = SNMP_VERSION_2c;
+    pdu->reqid = 0x12345678;
+    for (i = 1; i <= 25; i++) {
+        for (j = 0; j < 3; j++) {
+            name[9] = columns[j];
+            name[10] = i;
+            if (j == 0)
+                snmp_pdu_add_variable(pdu, name, OID_LENGTH(name),
+                                      ASN_OCTET_STR, "eth0", 4);
+            else if (j == 1)
+                snmp_pdu_add_variable(pdu, name, OID_LENGTH(name),
+                                      ASN_INTEGER, &value, sizeof(value));
+            else
+                snmp_pdu_add_variable(pdu, name, OID_LENGTH(name),
+                                      ASN_COUNTER, &uvalue, sizeof(uvalue));
+        }
+    }
+    return pdu;
+}
+
+static void
+bench_pdu_rbuild_pdu(long n, netsnmp_pdu *pdu)
+{
+    u_char         *pkt;
+    size_t          pkt_len = 1024, offset;
+    long            i;
+
+    pkt = malloc(pkt_len);
+    bench_start();
+    for (i = 0; i < n; i++) {
+        offset = 0;
+        snmp_pdu_realloc_rbuild(&pkt, &pkt_len, &offset, pdu);
+    }
+    bench_stop();
+    free(pkt);
+    snmp_free_pdu(pdu);
+}
+
+static void
+bench_pdu_rbuild(long n)
+{
+    bench_pdu_rbuild_pdu(n, bench_create_pdu());
+}
+
+static void
+bench_pdu_rbuild_bulk(long n)
+{
+    bench_pdu_rbuild_pdu(n, bench_create_bulk_pdu());
+}
+
+static void
+bench_pdu_parse_pdu(long n, netsnmp_pdu *pdu)
+{
+    u_char         *pkt, *data;
+    size_t          pkt_len = 1024, offset = 0, len;
+    long            i;
+
+    pkt = malloc(pkt_len);
+    if (!snmp_pdu_realloc_rbuild(&pkt, &pkt_len, &offset, pdu)) {
+        bench_skip("can't build the PDU");
+        goto out;
+    }
+    data = pkt + pkt_len - offset;
+    snmp_free_pdu(pdu);
+    pdu = NULL;
+
+    bench_start();
+    for (i = 0; i < n; i++) {
+        pdu = SNMP_MALLOC_TYPEDEF(netsnmp_pdu);
+        pdu->version = SNMP_VERSION_2c;
+        len = offset;
+        snmp_pdu_parse(pdu, data, &len);
+        snmp_free_pdu(pdu);
+    }
+    bench_stop();
+    pdu = NULL;
+  out:
+    free(pkt);
+    snmp_free_pdu(pdu);
+}
+
+static void
+bench_pdu_parse(long n)
+{
+    bench_pdu_parse_pdu(n, bench_create_pdu());
+}
+
+static void
+bench_pdu_parse_bulk(long n)
+{
+    bench_pdu_parse_pdu(n, bench_create_bulk_pdu());
+}
+
+/*
+ * snmp_sess_send() of responses over UDP to a socket of our own, which
+ * is drained now and then.  Includes cloning the PDU that is sent.
+ */
+static void
+bench_session_send(long n)
+{
+    struct sockaddr_in sin;
+    socklen_t       sin_len = sizeof(sin);
+    static u_char   community[] = "public";
+    netsnmp_session session;
+    struct session_list *ss = NULL;
+    netsnmp_pdu    *pdu = bench_create_bulk_pdu();
+    char            peer[64], buf[2048];
+    int             sock;
+    long            i;
+
+    sock = socket(AF_INET, SOCK_DGRAM, 0);
+    memset(&sin, 0, sizeof(sin));
+    sin.sin_family = AF_INET;
+    sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (sock < 0 || bind(sock, (struct sockaddr *) &sin, sizeof(sin)) < 0 ||
+        getsockname(sock, (struct sockaddr *) &sin, &sin_len) < 0) {
+        bench_skip("can't open a UDP socket");
+        goto out;
+    }
+    snprintf(peer, sizeof(peer), "udp:127.0.0.1:%d", ntohs(sin.sin_port));
+    snmp_sess_init(&session);
+    session.version = SNMP_VERSION_2c;
+    session.peername = peer;
+    session.community = community;
+    session.community_len = sizeof(community) - 1;
+    ss = snmp_sess_open(&session);
+    if (ss == NULL) {
+        bench_skip("can't open a session");
+        goto out;
+    }
+
+    bench_start();
+    for (i = 0; i < n; i++) {
+        if (!snmp_sess_send(ss, snmp_clone_pdu(pdu)))
+            break;
+        if (i % 64 == 63)
+            while (recv(sock, buf, sizeof(buf), MSG_DONTWAIT) > 0)
+                ;
+    }
+    bench_stop();
+    if (i < n)
+        bench_skip("snmp_sess_send() failed");
+  out:
+    if (ss)
+        snmp_sess_close(ss);
+    if (sock >= 0)
+        close(sock);
+    snmp_free_pdu(pdu);
+}
+
+#ifdef NETSNMP_BENCH_AGENTX
+/*
+ * an AgentX response from a subagent to a GETBULK of 25 rows of ifAlias,
+ * ifType and ifInOctets, with ifAlias values of 80 characters
+ */
+static netsnmp_pdu *
+bench_create_agentx_pdu(void)
+{
+    static const int columns[] = { 18, 3, 10 };
+    oid             name[] = { 1, 3, 6, 1, 2, 1, 31, 1, 1, 1, 0, 0 };
+    u_char          alias[80];
+    netsnmp_pdu    *pdu;
+    long            value = 6;
+    u_long          uvalue = 4000000000U;
+    int             i, j;
+
+    memset(alias, 'a', sizeof(alias));
+    pdu = snmp_pdu_create(AGENTX_MSG_RESPONSE);
+    pdu->version = AGENTX_VERSION_1;
+    pdu->sessid = 1;
+    pdu->transid = 2;
+    pdu->reqid = 3;
+    pdu->flags |= AGENTX_FLAGS_NETWORK_BYTE_ORDER;
+    for (i = 1; i <= 25; i++) {
+        for (j = 0; j < 3; j++) {
+            name[10] = columns[j];
+            name[11] = i;
+            if (j == 0)
+                snmp_pdu_add_variable(pdu, name, OID_LENGTH(name),
+                                      ASN_OCTET_STR, alias, sizeof(alias));
+            else if (j == 1)
+                snmp_pdu_add_variable(pdu, name, OID_LENGTH(name),
+                                      ASN_INTEGER, &value, sizeof(value));
+            else
+                snmp_pdu_add_variable(pdu, name, OID_LENGTH(name),
+                                      ASN_COUNTER, &uvalue, sizeof(uvalue));
+        }
+    }
+    return pdu;
+}
+
+/*
+ * agentx_realloc_build() into the same buffer each time, the way a
+ * session reuses its send buffer: no allocations once it is big enough
+ */
+static void
+bench_agentx_build(long n)
+{
+    netsnmp_session session;
+    netsnmp_pdu    *pdu = bench_create_agentx_pdu();
+    u_char         *pkt;
+    size_t          pkt_len = SNMP_MIN_MAX_LEN, offset = 0;
+    long            i;
+
+    memset(&session, 0, sizeof(session));
+    session.version = AGENTX_VERSION_1;
+    pkt = malloc(pkt_len);
+    if (agentx_realloc_build(&session, pdu, &pkt, &pkt_len, &offset) != 0) {
+        bench_skip("can't build the PDU");
+        goto out;
+    }
+    bench_start();
+    for (i = 0; i < n; i++) {
+        offset = 0;
+        agentx_realloc_build(&session, pdu, &pkt, &pkt_len, &offset);
+    }
+    bench_stop();
+    sink += offset;
+  out:
+    free(pkt);
+    snmp_free_pdu(pdu);
+}
+
+/*
+ * agentx_parse() of the same response: the PDU, its varbinds and the
+ * values too long for a varbind's own buffer are the only allocations
+ */
+static void
+bench_agentx_parse(long n)
+{
+    netsnmp_session session;
+    netsnmp_pdu    *pdu = bench_create_agentx_pdu();
+    u_char         *pkt;
+    size_t          pkt_len = SNMP_MIN_MAX_LEN, offset = 0;
+    long            i;
+
+    memset(&session, 0, sizeof(session));
+    session.version = AGENTX_VERSION_1;
+    pkt = malloc(pkt_len);
+    if (agentx_realloc_build(&session, pdu, &pkt, &pkt_len, &offset) != 0) {
+        bench_skip("can't build the PDU");
+        goto out;
+    }
+    snmp_free_pdu(pdu);
+    pdu = NULL;
+
+    bench_start();
+    for (i = 0; i < n; i++) {
+        pdu = snmp_pdu_create(0);
+        agentx_parse(&session, pdu, pkt, offset);
+        snmp_free_pdu(pdu);
+    }
+    bench_stop();
+    pdu = NULL;
+  out:
+    free(pkt);
+    snmp_free_pdu(pdu);
+}
+#endif /* NETSNMP_BENCH_AGENTX */
+
+static void
+bench_sprint_objid(long n, int format)
+{
+    u_char         *buf = NULL;
+    size_t          buf_len = 0, out_len;
+    int             saved;
+    long            i;
+
+    saved = netsnmp_ds_get_int(NETSNMP_DS_LIBRARY_ID,
+                               NETSNMP_DS_LIB_OID_OUTPUT_FORMAT);
+    netsnmp_ds_set_int(NETSNMP_DS_LIBRARY_ID,
+                       NETSNMP_DS_LIB_OID_OUTPUT_FORMAT, format);
+    bench_start();
+    for (i = 0; i < n; i++) {
+        out_len = 0;
+        sprint_realloc_objid(&buf, &buf_len, &out_len, 1, if_descr_1,
+                             OID_LENGTH(if_descr_1));
+    }
+    bench_stop();
+    netsnmp_ds_set_int(NETSNMP_DS_LIBRARY_ID,
+                       NETSNMP_DS_LIB_OID_OUTPUT_FORMAT, saved);
+    free(buf);
+}
+
+static void
+bench_sprint_objid_module(long n)
+{
+    bench_sprint_objid(n, NETSNMP_OID_OUTPUT_MODULE);
+}
+
+static void
+bench_sprint_objid_numeric(long n)
+{
+    bench_sprint_objid(n, NETSNMP_OID_OUTPUT_NUMERIC);
+}
+
+static void
+bench_read_objid(long n, const char *input)
+{
+    oid             name[MAX_OID_LEN];
+    size_t          name_len = MAX_OID_LEN;
+    long            i;
+
+    if (!read_objid(input, name, &name_len)) {
+        bench_skip("object not found, are the MIBs installed?");
+        return;
+    }
+    bench_start();
+    for (i = 0; i < n; i++) {
+        name_len = MAX_OID_LEN;
+        read_objid(input, name, &name_len);
+    }
+    bench_stop();
+}
+
+static void
+bench_read_objid_numeric(long n)
+{
+    bench_read_objid(n, ".1.3.6.1.2.1.2.2.1.2.1");
+}
+
+static void
+bench_read_objid_module(long n)
+{
+    bench_read_objid(n, "IF-MIB::ifDescr.1");
+}
+
+/*
+ * containers of BENCH_ROWS two sub-identifier indexes, as in a table
+ */
+#define BENCH_ROWS 10000
+
+static netsnmp_index *
+bench_create_rows(void)
+{
+    netsnmp_index  *rows;
+    oid            *oids;
+    int             i, j;
+
+    rows = calloc(BENCH_ROWS, sizeof(netsnmp_index));
+    oids = calloc(BENCH_ROWS, 2 * sizeof(oid));
+    if (!rows || !oids) {
+        free(rows);
+        free(oids);
+        return NULL;
+    }
+    for (i = 0; i < BENCH_ROWS; i++) {
+        /* a fixed permutation, so the rows are not inserted in order */
+        j = (i * 7919) % BENCH_ROWS;
+        oids[2 * i] = 1 + j / 100;
+        oids[2 * i + 1] = 1 + j % 100;
+        rows[i].oids = &oids[2 * i];
+        rows[i].len = 2;
+    }
+    return rows;
+}
+
+static void
+bench_free_rows(netsnmp_index *rows)
+{
+    if (rows) {
+        free(rows[0].oids);
+        free(rows);
+    }
+}
+
+static void
+bench_container_insert(long n, const char *type)
+{
+    netsnmp_container *c = netsnmp_container_find(type);
+    netsnmp_index  *rows = bench_create_rows();
+    long            i;
+    int             row = 0;
+
+    if (!c || !rows) {
+        bench_skip("can't create the container");
+        goto out;
+    }
+    c->compare = netsnmp_compare_netsnmp_index;
+    bench_start();
+    for (i = 0; i < n; i++) {
+        CONTAINER_INSERT(c, &rows[row]);
+        if (++row == BENCH_ROWS) {
+            /* empty the container again, untimed */
+            bench_stop();
+            CONTAINER_CLEAR(c, NULL, NULL);
+            row = 0;
+            bench_start();
+        }
+    }
+    bench_stop();
+    CONTAINER_CLEAR(c, NULL, NULL);
+  out:
+    if (c)
+        CONTAINER_FREE(c);
+    bench_free_rows(rows);
+}
+
+static void
+bench_container_find(long n, const char *type)
+{
+    netsnmp_container *c = netsnmp_container_find(type);
+    netsnmp_index  *rows = bench_create_rows();
+    long            i;
+    int             row = 0;
+
+    if (!c || !rows) {
+        bench_skip("can't create the container");
+        goto out;
+    }
+    c->compare = netsnmp_compare_netsnmp_index;
+    for (i = 0; i < BENCH_ROWS; i++)
+        CONTAINER_INSERT(c, &rows[i]);
+    /* let a lazily sorted container sort itself first */
+    CONTAINER_FIND(c, &rows[0]);
+    bench_start();
+    for (i = 0; i < n; i++) {
+        sink += (CONTAINER_FIND(c, &rows[row]) != NULL);
+        if (++row == BENCH_ROWS)
+            row = 0;
+    }
+    bench_stop();
+    CONTAINER_CLEAR(c, NULL, NULL);
+  out:
+    if (c)
+        CONTAINER_FREE(c);
+    bench_free_rows(rows);
+}
+
+static void
+bench_binary_array_insert(long n)
+{
+    bench_container_insert(n, "binary_array");
+}
+
+static void
+bench_binary_array_find(long n)
+{
+    bench_container_find(n, "binary_array");
+}
+
+static void
+bench_skiplist_insert(long n)
+{
+    bench_container_insert(n, "skiplist");
+}
+
+static void
+bench_skiplist_find(long n)
+{
+    bench_container_find(n, "skiplist");
+}
+
+static void
+bench_hash_insert(long n)
+{
+    bench_container_insert(n, "hash");
+}
+
+static void
+bench_hash_find(long n)
+{
+    bench_container_find(n, "hash");
+}
+
+static void
+bench_ssll_find(long n)
+{
+    bench_container_find(n, "sorted_singly_linked_list");
+}
+
+#ifdef NETSNMP_SECMOD_USM
+/*
+ * the authentication and encryption of a 484 byte message
+ */
+#define BENCH_MSG_LEN 484
+
+static u_char   bench_key[32] = {
+    0x6b, 0x0c, 0xd5, 0x8e, 0x11, 0x97, 0x2a, 0xa3,
+    0x41, 0x8d, 0x3c, 0x5f, 0x70, 0x02, 0x9b, 0xe4,
+    0x25, 0xb6, 0xd8, 0x19, 0x4a, 0x7e, 0xc3, 0x50,
+    0x8f, 0x61, 0x33, 0xaa, 0x07, 0xec, 0x9d, 0x14
+};
+
+static void
+bench_auth(long n, const oid *type, size_t type_len, int use_ctx)
+{
+    netsnmp_sc_ctx *ctx = NULL;
+    u_char          msg[BENCH_MSG_LEN], mac[USM_MAX_AUTHSIZE];
+    size_t          mac_len;
+    long            i;
+    int             rc;
+
+    memset(msg, 0xa5, sizeof(msg));
+    mac_len = sizeof(mac);
+    if (sc_generate_keyed_hash(type, type_len, bench_key, 20, msg,
+                               sizeof(msg), mac, &mac_len) !=
+        SNMPERR_SUCCESS) {
+        bench_skip("authentication protocol not supported");
+        return;
+    }
+    bench_start();
+    for (i = 0; i < n; i++) {
+        mac_len = sizeof(mac);
+        if (use_ctx)
+            rc = sc_generate_keyed_hash_ctx(&ctx, type, type_len, bench_key,
+                                            20, msg, sizeof(msg), mac,
+                                            &mac_len);
+        else
+            rc = sc_generate_keyed_hash(type, type_len, bench_key, 20, msg,
+                                        sizeof(msg), mac, &mac_len);
+        sink += rc;
+    }
+    bench_stop();
+    sc_ctx_free(&ctx);
+}
+
+static void
+bench_auth_sha1(long n)
+{
+    bench_auth(n, usmHMACSHA1AuthProtocol,
+               OID_LENGTH(usmHMACSHA1AuthProtocol), 0);
+}
+
+static void
+bench_auth_sha1_ctx(long n)
+{
+    bench_auth(n, usmHMACSHA1AuthProtocol,
+               OID_LENGTH(usmHMACSHA1AuthProtocol), 1);
+}
+
+#ifdef HAVE_AES
+static void
+bench_priv_aes(long n, int decrypt, int use_ctx)
+{
+    netsnmp_sc_ctx *ctx = NULL;
+    u_char          plain[BENCH_MSG_LEN], cipher[BENCH_MSG_LEN];
+    u_char          iv[16];
+    size_t          len;
+    long            i;
+    int             rc;
+
+    memset(plain, 0x5a, sizeof(plain));
+    memset(iv, 0x11, sizeof(iv));
+    len = sizeof(cipher);
+    if (sc_encrypt(usmAESPrivProtocol, OID_LENGTH(usmAESPrivProtocol),
+                   bench_key, 16, iv, sizeof(iv), plain, sizeof(plain),
+                   cipher, &len) != SNMPERR_SUCCESS) {
+        bench_skip("privacy protocol not supported");
+        return;
+    }
+    bench_start();
+    for (i = 0; i < n; i++) {
+        len = sizeof(cipher);
+        if (decrypt && use_ctx)
+            rc = sc_decrypt_ctx(&ctx, usmAESPrivProtocol,
+                                OID_LENGTH(usmAESPrivProtocol), bench_key,
+                                16, iv, sizeof(iv), cipher, sizeof(cipher),
+                                plain, &len);
+        else if (decrypt)
+            rc = sc_decrypt(usmAESPrivProtocol,
+                            OID_LENGTH(usmAESPrivProtocol), bench_key, 16,
+                            iv, sizeof(iv), cipher, sizeof(cipher), plain,
+                            &len);
+        else if (use_ctx)
+            rc = sc_encrypt_ctx(&ctx, usmAESPrivProtocol,
+                                OID_LENGTH(usmAESPrivProtocol), bench_key,
+                                16, iv, sizeof(iv), plain, sizeof(plain),
+                                cipher, &len);
+        else
+            rc = sc_encrypt(usmAESPrivProtocol,
+                            OID_LENGTH(usmAESPrivProtocol), bench_key, 16,
+                            iv, sizeof(iv), plain, sizeof(plain), cipher,
+                            &len);
+        sink += rc;
+    }
+    bench_stop();
+    sc_ctx_free(&ctx);
+}
+
+static void
+bench_encrypt_aes(long n)
+{
+    bench_priv_aes(n, 0, 0);
+}
+
+static void
+bench_encrypt_aes_ctx(long n)
+{
+    bench_priv_aes(n, 0, 1);
+}
+
+static void
+bench_decrypt_aes(long n)
+{
+    bench_priv_aes(n, 1, 0);
+}
+
+static void
+bench_decrypt_aes_ctx(long n)
+{
+    bench_priv_aes(n, 1, 1);
+}
+#endif /* HAVE_AES */
+#endif /* NETSNMP_SECMOD_USM */
+
+static const bench benchmarks[] = {
+    { "oid_compare/equal",              bench_oid_compare_equal },
+    { "oid_compare/last",               bench_oid_compare_last },
+    { "oid_compare/long",               bench_oid_compare_long },
+    { "oid_compare_ll",                 bench_oid_compare_ll },
+    { "oid_ncompare",                   bench_oid_ncompare },
+    { "oid_equals",                     bench_oid_equals },
+    { "oid_is_subtree",                 bench_oid_is_subtree },
+    { "oid_find_prefix",                bench_oid_find_prefix },
+    { "asn_build_int",                  bench_asn_build_int },
+    { "asn_parse_int",                  bench_asn_parse_int },
+    { "asn_build_counter64",            bench_asn_build_counter64 },
+    { "asn_parse_counter64",            bench_asn_parse_counter64 },
+    { "asn_build_string",               bench_asn_build_string },
+    { "asn_parse_string",               bench_asn_parse_string },
+    { "asn_build_objid",                bench_asn_build_objid },
+    { "asn_parse_objid",                bench_asn_parse_objid },
+    { "asn_rbuild_objid",               bench_asn_rbuild_objid },
+    { "asn_rbuild_objid/walk",          bench_asn_rbuild_objid_walk_uncached },
+    { "asn_rbuild_objid/walk/cached",   bench_asn_rbuild_objid_walk_cached },
+    { "asn_parse_objid/walk",           bench_asn_parse_objid_walk },
+    { "pdu_rbuild",                     bench_pdu_rbuild },
+    { "pdu_parse",                      bench_pdu_parse },
+    { "pdu_rbuild/bulk",                bench_pdu_rbuild_bulk },
+    { "pdu_parse/bulk",                 bench_pdu_parse_bulk },
+    { "session/send",                   bench_session_send },
+#ifdef NETSNMP_BENCH_AGENTX
+    { "agentx/build",                   bench_agentx_build },
+    { "agentx/parse",                   bench_agentx_parse },
+#endif
+    { "sprint_objid/module",            bench_sprint_objid_module },
+    { "sprint_objid/numeric",           bench_sprint_objid_numeric },
+    { "read_objid/numeric",             bench_read_objid_numeric },
+    { "read_objid/module",              bench_read_objid_module },
+    { "container/binary_array/insert",  bench_binary_array_insert },
+    { "container/binary_array/find",    bench_binary_array_find },
+    { "container/skiplist/insert",      bench_skiplist_insert },
+    { "container/skiplist/find",        bench_skiplist_find },
+    { "container/hash/insert",          bench_hash_insert },
+    { "container/hash/find",            bench_hash_find },
+    { "container/ssll/find",            bench_ssll_find },
+#ifdef NETSNMP_SECMOD_USM
+    { "usm/auth/sha1",                  bench_auth_sha1 },
+    { "usm/auth/sha1/ctx",              bench_auth_sha1_ctx },
+#ifdef HAVE_AES
+    { "usm/encrypt/aes",                bench_encrypt_aes },
+    { "usm/encrypt/aes/ctx",            bench_encrypt_aes_ctx },
+    { "usm/decrypt/aes",                bench_decrypt_aes },
+    { "usm/decrypt/aes/ctx",            bench_decrypt_aes_ctx },
+#endif
+#endif
+};
+
+static void
+usage(void)
+{
+    fprintf(stderr,
+            "USAGE: snmplibbench [-j] [-l] [-o IMPL] [-t MSEC] [NAME]...\n\n");
+    fprintf(stderr, "  -j\t\tprint the results as JSON\n");
+    fprintf(stderr, "  -l\t\tlist the benchmarks\n");
+    fprintf(stderr,
+            "  -o IMPL\tcompare OIDs with IMPL (scalar, sse2 or avx2)\n");
+    fprintf(stderr,
+            "  -t MSEC\trun each benchmark for at least MSEC milliseconds"
+            " (default 500)\n");
+    fprintf(stderr, "  NAME\t\trun only the benchmarks starting with NAME\n");
+}
+
+static int
+selected(const char *name, int argc, char **argv)
+{
+    int             i;
+
+    if (argc == 0)
+        return 1;
+    for (i = 0; i < argc; i++)
+        if (!strncmp(name, argv[i], strlen(argv[i])))
+            return 1;
+    return 0;
+}
+
+/*
+ * Run a benchmark with more and more iterations until it takes long
+ * enough to time.
+ */
+static void
+run_bench(const bench *b, int first)
+{
+    double          target = min_msec * 1e6;
+    unsigned long   allocs = 0;
+    long            n = 1, next;
+
+    for (;;) {
+        memset(&timer, 0, sizeof(timer));
+#ifdef BENCH_COUNT_ALLOCS
+        alloc_count = 0;
+#endif
+        b->run(n);
+#ifdef BENCH_COUNT_ALLOCS
+        allocs = alloc_count;
+#endif
+        if (timer.skipped || timer.elapsed_ns >= target || n >= 1000000000L)
+            break;
+        if (timer.elapsed_ns < 1000)
+            next = n * 100;
+        else
+            next = (long) (n * target * 1.2 / timer.elapsed_ns);
+        if (next > n * 100)
+            next = n * 100;
+        n = next > n ? next : n + 1;
+    }
+
+    if (json) {
+        printf("%s\n {\"name\":\"%s\"", first ? "" : ",", b->name);
+        if (timer.skipped)
+            printf(",\"skipped\":\"%s\"}", timer.skipped);
+        else {
+            printf(",\"iterations\":%ld,\"nsPerOp\":%.2f", n,
+                   timer.elapsed_ns / n);
+#ifdef BENCH_COUNT_ALLOCS
+            printf(",\"allocsPerOp\":%.2f}", (double) allocs / n);
+#else
+            printf(",\"allocsPerOp\":null}");
+#endif
+        }
+    } else if (timer.skipped)
+        printf("%-32s skipped: %s\n", b->name, timer.skipped);
+    else {
+        printf("%-32s %12ld %12.1f ns/op", b->name, n, timer.elapsed_ns / n);
+#ifdef BENCH_COUNT_ALLOCS
+        printf(" %8.2f allocs/op", (double) allocs / n);
+#endif
+        printf("\n");
+    }
+    fflush(stdout);
+}
+
+int
+main(int argc, char *argv[])
+{
+    const char     *oid_impl = NULL;
+    int             ch, list = 0, first = 1;
+    size_t          i;
+
+    while ((ch = getopt(argc, argv, "hjlo:t:")) != EOF) {
+        switch (ch) {
+        case 'j':
+            json = 1;
+            break;
+        case 'l':
+            list = 1;
+            break;
+        case 'o':
+            oid_impl = optarg;
+            break;
+        case 't':
+            min_msec = atoi(optarg);
+            if (min_msec <= 0) {
+                usage();
+                return 1;
+            }
+            break;
+        default:
+            usage();
+            return ch == 'h' ? 0 : 1;
+        }
+    }
+    argc -= optind;
+    argv += optind;
+
+    if (list) {
+        for (i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++)
+            printf("%s\n", benchmarks[i].name);
+        return 0;
+    }
+
+    init_snmp("snmplibbench");
+
+    /* after init_snmp(), which compares OIDs while reading the MIBs */
+    oid_impl = netsnmp_oid_compare_impl(oid_impl);
+    if (!oid_impl) {
+        fprintf(stderr, "snmplibbench: OID comparison not available\n");
+        return 1;
+    }
+
+    if (json)
+        printf("{\"version\":\"%s\",\"oidCompare\":\"%s\""
+               ",\"benchmarks\":[", netsnmp_get_version(), oid_impl);
+    else
+        printf("OID comparison: %s\n", oid_impl);
+    for (i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++) {
+        if (!selected(benchmarks[i].name, argc, argv))
+            continue;
+        run_bench(&benchmarks[i], first);
+        first = 0;
+    }
+    if (json)
+        printf("\n]}\n");
+
+    snmp_shutdown("snmplibbench");
+    return 0;
+}
@@ -99,6 +99,7 @@
 #include "mibgroup/agent/nsModuleTable.h"
 #include "mibgroup/agent/nsDebug.h"
 #include "mibgroup/agent/nsCache.h"
+#include "mibgroup/agent/nsLatency.h"
 #include "mibgroup/agent/nsLogging.h"
 #include "mibgroup/utilities/iquery.h"
 #include "mibgroup/utilities/override.h"
@@ -59,6 +59,7 @@
   if (should_init("nsModuleTable")) init_nsModuleTable();
   if (should_init("nsDebug")) init_nsDebug();
   if (should_init("nsCache")) init_nsCache();
+  if (should_init("nsLatency")) init_nsLatency();
   if (should_init("nsLogging")) init_nsLogging();
 
 #ifdef USING_HOST_MODULE
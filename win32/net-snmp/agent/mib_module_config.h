@@ -210,6 +210,9 @@
 /* Define if compiling with the agent/nsCache module files.  */
 #define USING_AGENT_NSCACHE_MODULE 1
  
+/* Define if compiling with the agent/nsLatency module files.  */
+#define USING_AGENT_NSLATENCY_MODULE 1
+ 
 /* Define if compiling with the agent/nsLogging module files.  */
 #define USING_AGENT_NSLOGGING_MODULE 1
  
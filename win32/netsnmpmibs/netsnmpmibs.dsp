@@ -405,6 +405,10 @@ SOURCE=..\..\agent\mibgroup\agent\nsDebug.c
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\agent\mibgroup\agent\nsLatency.c
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\agent\mibgroup\agent\nsLogging.c
 # End Source File
 # Begin Source File